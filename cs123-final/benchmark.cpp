@@ -0,0 +1,732 @@
+/**
+  Command line benchmarks for the model code.  Each benchmark prints
+  its timings and checks that the fast path gives the same answer as
+  the reference one; the exit code is non-zero if any check fails.
+**/
+
+#include "benchmark.h"
+#include <GL/gl.h>
+#include "glm.h"
+#include "common.h"
+#include "targa.h"
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using std::cout;
+using std::endl;
+
+#define DRAGON_PATH "../cs123-final/models/xyzrgb_dragon.obj"
+
+/**
+  Wall clock time in milliseconds.
+**/
+static double bench_now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+  Allocates an empty model that glmDelete() can free.
+**/
+static GLMmodel *bench_new_model(const char *name) {
+    GLMmodel *model = (GLMmodel *)calloc(1, sizeof(GLMmodel));
+    model->pathname = strdup(name);
+    return model;
+}
+
+/**
+  Gives every triangle corner of a model its own vertex, the way meshes
+  exported as triangle soup (STL and friends) come in.
+**/
+static void bench_unweld(GLMmodel *model) {
+    GLfloat *vertices = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (3 * model->numtriangles + 1));
+    GLuint n = 0;
+    memset(vertices, 0, sizeof(GLfloat) * 3);
+    for (GLuint i = 0; i < model->numtriangles; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            ++n;
+            memcpy(&vertices[3 * n], &model->vertices[3 * model->triangles[i].vindices[k]], sizeof(GLfloat) * 3);
+            model->triangles[i].vindices[k] = n;
+        }
+    }
+    glmFree(model, model->vertices);
+    model->vertices = vertices;
+    model->numvertices = n;
+}
+
+/**
+  Builds a size x size grid of quads as triangle soup.  Every corner is
+  jittered by less than the weld epsilon, so welding has to match
+  nearby vertices rather than just identical ones.
+**/
+static GLMmodel *bench_soup(GLuint size, GLfloat jitter) {
+    GLMmodel *model = bench_new_model("soup");
+    model->numtriangles = 2 * size * size;
+    model->triangles = (GLMtriangle *)calloc(model->numtriangles, sizeof(GLMtriangle));
+    model->numvertices = 3 * model->numtriangles;
+    model->vertices = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    memset(model->vertices, 0, sizeof(GLfloat) * 3);
+    GLuint n = 0, t = 0;
+    static const int corners[6][2] = { {0, 0}, {1, 0}, {1, 1}, {0, 0}, {1, 1}, {0, 1} };
+    srand(1);
+    for (GLuint y = 0; y < size; ++y) {
+        for (GLuint x = 0; x < size; ++x) {
+            for (int c = 0; c < 6; ++c) {
+                ++n;
+                model->vertices[3 * n + 0] = (x + corners[c][0]) / (GLfloat)size + urand(-jitter, jitter);
+                model->vertices[3 * n + 1] = (y + corners[c][1]) / (GLfloat)size + urand(-jitter, jitter);
+                model->vertices[3 * n + 2] = urand(-jitter, jitter);
+                model->triangles[t + c / 3].vindices[c % 3] = n;
+            }
+            t += 2;
+        }
+    }
+    return model;
+}
+
+/**
+  Welds a copy of the model's vertices with both glmWeldVectors() and
+  glmWeldVectorsBrute() (unless there are more than brute_limit of
+  them) and checks the two agree.  Returns false on a mismatch.
+**/
+static bool bench_weld_model(const char *name, GLMmodel *model, GLfloat epsilon, GLuint brute_limit) {
+    size_t size = sizeof(GLfloat) * 3 * (model->numvertices + 1);
+    GLfloat *fast = (GLfloat *)malloc(size), *brute = (GLfloat *)malloc(size);
+    memcpy(fast, model->vertices, size);
+    memcpy(brute, model->vertices, size);
+
+    GLuint numfast = model->numvertices, numbrute = model->numvertices;
+    double t0 = bench_now();
+    GLfloat *fastcopies = glmWeldVectors(fast, &numfast, epsilon);
+    double tfast = bench_now() - t0;
+    cout << "  " << name << ": " << model->numvertices << " -> " << numfast
+         << " vertices, hashed " << tfast << " ms";
+
+    bool ok = true;
+    if (model->numvertices <= brute_limit) {
+        t0 = bench_now();
+        GLfloat *brutecopies = glmWeldVectorsBrute(brute, &numbrute, epsilon);
+        double tbrute = bench_now() - t0;
+        cout << ", brute force " << tbrute << " ms (" << tbrute / tfast << "x)";
+        ok = numfast == numbrute &&
+             !memcmp(fastcopies + 3, brutecopies + 3, sizeof(GLfloat) * 3 * numfast);
+        for (GLuint i = 1; ok && i <= model->numvertices; ++i)
+            ok = fast[3 * i] == brute[3 * i];
+        free(brutecopies);
+    } else {
+        cout << ", brute force skipped";
+    }
+    cout << (ok ? "" : "  MISMATCH") << endl;
+
+    free(fastcopies);
+    free(fast);
+    free(brute);
+    return ok;
+}
+
+/**
+  glmWeld: hashed grid against the quadratic reference, on the dragon
+  split into triangle soup and on synthetic soups of growing size.
+**/
+static bool bench_weld() {
+    bool ok = true;
+    const GLfloat epsilon = 1e-5f;
+    cout << "weld (epsilon " << epsilon << ")" << endl;
+
+    GLMmodel *dragon = glmReadOBJCached((char *)DRAGON_PATH, 0, 0, NULL);
+    glmUnitize(dragon);
+    bench_unweld(dragon);
+    ok &= bench_weld_model("dragon soup", dragon, epsilon, ~0u);
+    double t0 = bench_now();
+    glmWeld(dragon, epsilon);
+    cout << "  dragon glmWeld: " << bench_now() - t0 << " ms, "
+         << dragon->numvertices << " vertices" << endl;
+    glmDelete(dragon);
+
+    static const GLuint sizes[] = { 32, 100, 300, 600 };
+    for (unsigned i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        GLMmodel *soup = bench_soup(sizes[i], epsilon / 4);
+        char name[64];
+        sprintf(name, "soup %ux%u", sizes[i], sizes[i]);
+        ok &= bench_weld_model(name, soup, epsilon, 100000);
+        glmDelete(soup);
+    }
+    return ok;
+}
+
+/**
+  glmVertexCache: cache miss ratios before and after reordering the
+  dragon, for a few cache sizes, and what the reordering costs.
+**/
+static bool bench_vcache() {
+    static const GLuint sizes[] = { 8, 16, 32 };
+    GLfloat before[3][2], after[3][2];
+    cout << "vcache" << endl;
+    GLMmodel *dragon = glmReadOBJ((char *)DRAGON_PATH);
+    for (int i = 0; i < 3; ++i)
+        glmVertexCacheStats(dragon, sizes[i], &before[i][0], &before[i][1]);
+    double t0 = bench_now();
+    glmVertexCache(dragon);
+    double t = bench_now() - t0;
+    bool ok = true;
+    for (int i = 0; i < 3; ++i) {
+        glmVertexCacheStats(dragon, sizes[i], &after[i][0], &after[i][1]);
+        cout << "  dragon, " << sizes[i] << " entry FIFO: ACMR " << before[i][0] << " -> " << after[i][0]
+             << ", ATVR " << before[i][1] << " -> " << after[i][1] << endl;
+        ok &= after[i][0] <= before[i][0];
+    }
+    cout << "  reordered " << dragon->numtriangles << " triangles in " << t << " ms" << endl;
+    glmDelete(dragon);
+    return ok;
+}
+
+/**
+  Writes a small prop to path: a box with every face split into a grid
+  of quads, one group and material per face, like the crates and
+  barrels a level is littered with.
+**/
+static void bench_write_prop(const char *path, const char *mtlpath, const char *mtlname) {
+    static const int axes[6][3] = { {0, 1, 2}, {0, 1, 2}, {1, 2, 0}, {1, 2, 0}, {2, 0, 1}, {2, 0, 1} };
+    const int n = 4;
+    FILE *mtl = fopen(mtlpath, "w");
+    FILE *obj = fopen(path, "w");
+    fprintf(obj, "mtllib %s\n", mtlname);
+    for (int f = 0; f < 6; ++f) {
+        fprintf(mtl, "newmtl side%d\nKd %g 0.5 0.5\nNs 100\n", f, f / 6.0);
+        for (int y = 0; y <= n; ++y) {
+            for (int x = 0; x <= n; ++x) {
+                float p[3];
+                p[axes[f][0]] = x / (float)n - 0.5f;
+                p[axes[f][1]] = y / (float)n - 0.5f;
+                p[axes[f][2]] = f % 2 ? 0.5f : -0.5f;
+                fprintf(obj, "v %g %g %g\nvt %g %g\n", p[0], p[1], p[2], x / (float)n, y / (float)n);
+            }
+        }
+        fprintf(obj, "g side%d\nusemtl side%d\n", f, f);
+        int base = f * (n + 1) * (n + 1) + 1;
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                int a = base + y * (n + 1) + x, b = a + 1, c = a + n + 2, d = a + n + 1;
+                fprintf(obj, "f %d/%d %d/%d %d/%d\nf %d/%d %d/%d %d/%d\n", a, a, b, b, c, c, a, a, c, c, d, d);
+            }
+        }
+    }
+    fclose(obj);
+    fclose(mtl);
+}
+
+/**
+  Loads count copies of the prop and keeps them all around, then
+  deletes them.  Reports the two times in ms.
+**/
+static void bench_load_props(char *path, GLMmodel **props, int count, double *load, double *teardown) {
+    double t0 = bench_now();
+    for (int i = 0; i < count; ++i)
+        props[i] = glmReadOBJDeferred(path, 1, NULL);
+    *load = bench_now() - t0;
+    t0 = bench_now();
+    for (int i = 0; i < count; ++i)
+        glmDelete(props[i]);
+    *teardown = bench_now() - t0;
+}
+
+/**
+  Model arena: loading and deleting thousands of small props with
+  everything carved out of one block per model, against one malloc()
+  per array, group and name.
+**/
+static bool bench_arena() {
+    const int count = 5000, rounds = 3;
+    char path[] = "/tmp/glm-bench-prop.obj";
+    cout << "arena (" << count << " props)" << endl;
+    bench_write_prop(path, "/tmp/glm-bench-prop.mtl", "glm-bench-prop.mtl");
+
+    GLMmodel **props = (GLMmodel **)malloc(sizeof(GLMmodel *) * count);
+    double best[2][2] = { {1e30, 1e30}, {1e30, 1e30} };
+    for (int r = 0; r < rounds; ++r) {
+        for (int arena = 0; arena < 2; ++arena) {
+            double load, teardown;
+            glmUseArena(arena);
+            bench_load_props(path, props, count, &load, &teardown);
+            if (load < best[arena][0]) best[arena][0] = load;
+            if (teardown < best[arena][1]) best[arena][1] = teardown;
+        }
+    }
+    glmUseArena(GL_TRUE);
+
+    GLMmodel *prop = glmReadOBJDeferred(path, 1, NULL);
+    bool ok = prop->numtriangles == 6 * 2 * 16 && prop->numgroups == 7 && prop->nummaterials == 7;
+    cout << "  " << prop->numtriangles << " triangles, " << prop->numgroups << " groups, "
+         << prop->nummaterials << " materials each" << (ok ? "" : "  MISMATCH") << endl;
+    glmDelete(prop);
+    cout << "  malloc: load " << best[0][0] << " ms, teardown " << best[0][1] << " ms" << endl;
+    cout << "  arena:  load " << best[1][0] << " ms (" << best[0][0] / best[1][0] << "x), teardown "
+         << best[1][1] << " ms (" << best[0][1] / best[1][1] << "x)" << endl;
+
+    free(props);
+    remove(path);
+    remove("/tmp/glm-bench-prop.mtl");
+    return ok;
+}
+
+/**
+  Writes a scene to path with count groups, each with its own material
+  and a single quad, like a level exported as one file.  Every
+  material has a diffuse map, shared by materials at a time, and the
+  lines naming the same map end in different ways.
+**/
+static void bench_write_scene(const char *path, const char *mtlpath, const char *mtlname,
+                              int count, int shared) {
+    static const char *endings[] = { "\n", "\r\n", "  \n" };
+    FILE *mtl = fopen(mtlpath, "w");
+    FILE *obj = fopen(path, "w");
+    fprintf(obj, "mtllib %s\n", mtlname);
+    for (int i = 0; i < count; ++i) {
+        fprintf(mtl, "newmtl material%d\nKd %g 0.5 0.5\nmap_Kd texture%d.tga%s",
+                i, i / (double)count, i / shared, endings[i % 3]);
+        float x = i % 64, y = i / 64;
+        fprintf(obj, "v %g %g 0\nv %g %g 0\nv %g %g 0\nv %g %g 0\n",
+                x, y, x + 1, y, x + 1, y + 1, x, y + 1);
+        fprintf(obj, "g object%d\nusemtl material%d\nf %d %d %d\nf %d %d %d\n",
+                i, i, 4 * i + 1, 4 * i + 2, 4 * i + 3, 4 * i + 1, 4 * i + 3, 4 * i + 4);
+    }
+    fclose(obj);
+    fclose(mtl);
+}
+
+/**
+  Checks that two loads of the same file came out with the same groups,
+  materials and textures.
+**/
+static bool bench_same_names(GLMmodel *a, GLMmodel *b) {
+    if (a->numgroups != b->numgroups || a->nummaterials != b->nummaterials ||
+        a->numtextures != b->numtextures)
+        return false;
+    for (GLMgroup *g = a->groups, *h = b->groups; g && h; g = g->next, h = h->next)
+        if (strcmp(g->name, h->name) || g->material != h->material || g->numtriangles != h->numtriangles)
+            return false;
+    for (GLuint i = 0; i < a->nummaterials; ++i)
+        if (strcmp(a->materials[i].name, b->materials[i].name) ||
+            a->materials[i].textureid != b->materials[i].textureid)
+            return false;
+    for (GLuint i = 0; i < a->numtextures; ++i)
+        if (strcmp(a->textures[i].name, b->textures[i].name))
+            return false;
+    return true;
+}
+
+/**
+  Name lookups: loading scenes with thousands of groups and materials
+  with the loader's hash tables, against comparing every name.
+**/
+static bool bench_names() {
+    static const int counts[] = { 1000, 4000, 16000 };
+    const int shared = 8, rounds = 3;
+    char path[] = "/tmp/glm-bench-scene.obj";
+    bool ok = true;
+    cout << "names (" << shared << " materials per texture)" << endl;
+    for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+        bench_write_scene(path, "/tmp/glm-bench-scene.mtl", "glm-bench-scene.mtl", counts[c], shared);
+        double best[2] = { 1e30, 1e30 };
+        GLMmodel *models[2] = { NULL, NULL };
+        for (int r = 0; r < rounds; ++r) {
+            for (int hashed = 0; hashed < 2; ++hashed) {
+                glmUseHashedNames(hashed);
+                double t0 = bench_now();
+                GLMmodel *model = glmReadOBJDeferred(path, 1, NULL);
+                double t = bench_now() - t0;
+                if (t < best[hashed]) best[hashed] = t;
+                if (models[hashed])
+                    glmDelete(models[hashed]);
+                models[hashed] = model;
+            }
+        }
+        glmUseHashedNames(GL_TRUE);
+
+        bool same = bench_same_names(models[0], models[1]) &&
+                    models[1]->numtextures == (GLuint)(counts[c] + shared - 1) / shared;
+        cout << "  " << counts[c] << " groups and materials, " << models[1]->numtextures
+             << " textures: linear " << best[0] << " ms, hashed " << best[1] << " ms ("
+             << best[0] / best[1] << "x)" << (same ? "" : "  MISMATCH") << endl;
+        ok &= same;
+        glmDelete(models[0]);
+        glmDelete(models[1]);
+    }
+    remove(path);
+    remove("/tmp/glm-bench-scene.mtl");
+    return ok;
+}
+
+/**
+  Writes a model to path as a little endian binary PLY with a color per
+  vertex, the way the scanner hands out its meshes.
+**/
+static void bench_write_ply(GLMmodel *model, const char *path) {
+    FILE *ply = fopen(path, "wb");
+    fprintf(ply, "ply\nformat binary_little_endian 1.0\nelement vertex %u\n"
+            "property float x\nproperty float y\nproperty float z\n"
+            "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+            "element face %u\nproperty list uchar int vertex_indices\nend_header\n",
+            model->numvertices, model->numtriangles);
+    for (GLuint i = 1; i <= model->numvertices; ++i) {
+        unsigned char color[3] = { (unsigned char)i, (unsigned char)(i >> 8), (unsigned char)(i >> 16) };
+        fwrite(&model->vertices[3 * i], sizeof(GLfloat), 3, ply);
+        fwrite(color, 1, 3, ply);
+    }
+    for (GLuint i = 0; i < model->numtriangles; ++i) {
+        unsigned char count = 3;
+        int indices[3];
+        for (int k = 0; k < 3; ++k)
+            indices[k] = model->triangles[i].vindices[k] - 1;
+        fwrite(&count, 1, 1, ply);
+        fwrite(indices, sizeof(int), 3, ply);
+    }
+    fclose(ply);
+}
+
+/**
+  glmReadPLY: the dragon read from binary PLY against reading it from
+  OBJ, checking that both give the same vertices and triangles.
+**/
+static bool bench_ply() {
+    const int rounds = 5;
+    char path[] = "/tmp/glm-bench-dragon.ply";
+    cout << "ply" << endl;
+    GLMmodel *obj = glmReadOBJ((char *)DRAGON_PATH);
+    bench_write_ply(obj, path);
+    glmDelete(obj);
+
+    double best[2] = { 1e30, 1e30 };
+    GLMmodel *models[2] = { NULL, NULL };
+    for (int r = 0; r < rounds; ++r) {
+        for (int i = 0; i < 2; ++i) {
+            double t0 = bench_now();
+            GLMmodel *model = i ? glmReadPLY(path, NULL) : glmReadOBJ((char *)DRAGON_PATH);
+            double t = bench_now() - t0;
+            if (t < best[i]) best[i] = t;
+            if (models[i])
+                glmDelete(models[i]);
+            models[i] = model;
+        }
+    }
+
+    bool same = models[1] && models[1]->colors &&
+                models[0]->numvertices == models[1]->numvertices &&
+                models[0]->numtriangles == models[1]->numtriangles &&
+                !memcmp(models[0]->vertices + 3, models[1]->vertices + 3,
+                        sizeof(GLfloat) * 3 * models[0]->numvertices);
+    for (GLuint i = 0; same && i < models[0]->numtriangles; ++i)
+        same = !memcmp(models[0]->triangles[i].vindices, models[1]->triangles[i].vindices, sizeof(GLuint) * 3);
+    for (GLuint i = 1; same && i <= models[1]->numvertices; ++i)
+        same = models[1]->colors[4 * i] == (GLubyte)i && models[1]->colors[4 * i + 3] == 255;
+    cout << "  dragon, " << models[0]->numtriangles << " triangles: OBJ " << best[0] << " ms, binary PLY "
+         << best[1] << " ms (" << best[0] / best[1] << "x)" << (same ? "" : "  MISMATCH") << endl;
+    glmDelete(models[0]);
+    if (models[1])
+        glmDelete(models[1]);
+    remove(path);
+    return same;
+}
+
+/// one edge of a triangle, for bench_subdivide
+struct BenchEdge {
+    unsigned long long key;   ///< its two vertices, the smaller one in the high half
+    GLuint corner;            ///< 3 * triangle + k for the edge from corner k to k + 1
+};
+
+static int bench_compare_edges(const void *a, const void *b) {
+    unsigned long long x = ((const BenchEdge *)a)->key, y = ((const BenchEdge *)b)->key;
+    return x < y ? -1 : x > y;
+}
+
+/**
+  Splits every triangle of a model into four at the midpoints of its
+  edges, for a bigger model of the same shape.  Normals are dropped.
+**/
+static void bench_subdivide(GLMmodel *model) {
+    GLuint numtriangles = model->numtriangles, numcorners = 3 * numtriangles;
+    BenchEdge *edges = (BenchEdge *)malloc(sizeof(BenchEdge) * numcorners);
+    for (GLuint i = 0; i < numtriangles; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            GLuint a = model->triangles[i].vindices[k], b = model->triangles[i].vindices[(k + 1) % 3];
+            edges[3 * i + k].key = a < b ? (unsigned long long)a << 32 | b : (unsigned long long)b << 32 | a;
+            edges[3 * i + k].corner = 3 * i + k;
+        }
+    }
+    qsort(edges, numcorners, sizeof(BenchEdge), bench_compare_edges);
+
+    GLuint unique = 0;
+    for (GLuint i = 0; i < numcorners; ++i)
+        unique += i == 0 || edges[i].key != edges[i - 1].key;
+    GLuint n = model->numvertices;
+    GLfloat *vertices = (GLfloat *)malloc(sizeof(GLfloat) * 3 * (n + unique + 1));
+    memcpy(vertices, model->vertices, sizeof(GLfloat) * 3 * (n + 1));
+    GLuint *midpoints = (GLuint *)malloc(sizeof(GLuint) * numcorners);
+    for (GLuint i = 0; i < numcorners; ++i) {
+        if (i == 0 || edges[i].key != edges[i - 1].key) {
+            GLuint a = (GLuint)(edges[i].key >> 32), b = (GLuint)edges[i].key;
+            ++n;
+            for (int k = 0; k < 3; ++k)
+                vertices[3 * n + k] = .5f * (model->vertices[3 * a + k] + model->vertices[3 * b + k]);
+        }
+        midpoints[edges[i].corner] = n;
+    }
+    free(edges);
+
+    GLMtriangle *triangles = (GLMtriangle *)calloc(4 * numtriangles, sizeof(GLMtriangle));
+    for (GLuint i = 0; i < numtriangles; ++i) {
+        const GLuint *v = model->triangles[i].vindices, *m = &midpoints[3 * i];
+        const GLuint corners[4][3] = { {v[0], m[0], m[2]}, {m[0], v[1], m[1]}, {m[2], m[1], v[2]}, {m[0], m[1], m[2]} };
+        for (int j = 0; j < 4; ++j) {
+            memcpy(triangles[4 * i + j].vindices, corners[j], sizeof(corners[j]));
+            triangles[4 * i + j].visible = true;
+        }
+    }
+    free(midpoints);
+    for (GLMgroup *group = model->groups; group; group = group->next) {
+        GLuint *list = (GLuint *)malloc(sizeof(GLuint) * (4 * group->numtriangles + 1));
+        for (GLuint i = 0; i < 4 * group->numtriangles; ++i)
+            list[i] = 4 * group->triangles[i / 4] + i % 4;
+        glmFree(model, group->triangles);
+        group->triangles = list;
+        group->numtriangles *= 4;
+    }
+
+    glmFree(model, model->vertices);
+    glmFree(model, model->triangles);
+    glmFree(model, model->normals);
+    glmFree(model, model->facetnorms);
+    model->vertices = vertices;
+    model->numvertices = n;
+    model->triangles = triangles;
+    model->numtriangles = 4 * numtriangles;
+    model->normals = model->facetnorms = NULL;
+    model->numnormals = model->numfacetnorms = 0;
+}
+
+/**
+  Writes the vertices, normals and faces of a model the way glmWriteOBJ
+  used to, one fprintf() per line, with enough digits to read back the
+  same floats.
+**/
+static void bench_fprintf_obj(GLMmodel *model, const char *path) {
+    FILE *obj = fopen(path, "w");
+    for (GLuint i = 1; i <= model->numvertices; ++i)
+        fprintf(obj, "v %.9g %.9g %.9g\n", model->vertices[3 * i], model->vertices[3 * i + 1], model->vertices[3 * i + 2]);
+    for (GLuint i = 1; i <= model->numnormals; ++i)
+        fprintf(obj, "vn %.9g %.9g %.9g\n", model->normals[3 * i], model->normals[3 * i + 1], model->normals[3 * i + 2]);
+    for (GLMgroup *group = model->groups; group; group = group->next) {
+        fprintf(obj, "g %s\n", group->name);
+        for (GLuint i = 0; i < group->numtriangles; ++i) {
+            const GLMtriangle &t = model->triangles[group->triangles[i]];
+            fprintf(obj, "f %u//%u %u//%u %u//%u\n", t.vindices[0], t.nindices[0],
+                    t.vindices[1], t.nindices[1], t.vindices[2], t.nindices[2]);
+        }
+    }
+    fclose(obj);
+}
+
+/**
+  Whether two models have the same positions, normals and triangles,
+  to the bit.
+**/
+static bool bench_same_geometry(GLMmodel *a, GLMmodel *b) {
+    if (a->numvertices != b->numvertices || a->numnormals != b->numnormals ||
+        a->numtriangles != b->numtriangles ||
+        memcmp(a->vertices + 3, b->vertices + 3, sizeof(GLfloat) * 3 * a->numvertices) ||
+        memcmp(a->normals + 3, b->normals + 3, sizeof(GLfloat) * 3 * a->numnormals))
+        return false;
+    for (GLuint i = 0; i < a->numtriangles; ++i)
+        if (memcmp(a->triangles[i].vindices, b->triangles[i].vindices, sizeof(GLuint) * 3) ||
+            memcmp(a->triangles[i].nindices, b->triangles[i].nindices, sizeof(GLuint) * 3))
+            return false;
+    return true;
+}
+
+/**
+  glmWriteOBJ: exporting the dragon, subdivided up to a couple of
+  million triangles, against one fprintf() per line.  The export has to
+  read back as exactly the same model.
+**/
+static bool bench_export() {
+    const int levels = 3;
+    char path[] = "/tmp/glm-bench-export.obj";
+    bool ok = true;
+    cout << "export" << endl;
+    GLMmodel *dragon = glmReadOBJ((char *)DRAGON_PATH);
+    for (int level = 0; level <= levels; ++level) {
+        if (level)
+            bench_subdivide(dragon);
+        glmFacetNormals(dragon);
+        glmVertexNormals(dragon, 90.f);
+
+        double t0 = bench_now();
+        bench_fprintf_obj(dragon, path);
+        double reference = bench_now() - t0;
+        t0 = bench_now();
+        glmWriteOBJ(dragon, path, GLM_SMOOTH);
+        double t = bench_now() - t0;
+
+        GLMmodel *copy = glmReadOBJ(path);
+        bool same = bench_same_geometry(dragon, copy);
+        glmDelete(copy);
+        cout << "  dragon, " << dragon->numtriangles << " triangles: fprintf " << reference
+             << " ms, glmWriteOBJ " << t << " ms (" << reference / t << "x)"
+             << (same ? "" : "  MISMATCH") << endl;
+        ok &= same;
+    }
+    glmDelete(dragon);
+    remove(path);
+    return ok;
+}
+
+/**
+  Builds a size x size Targa in memory, uncompressed or run-length
+  encoded with a mix of repeated and literal packets.
+**/
+static unsigned char *bench_targa(int size, int bits, bool rle, int *length) {
+    int bytes = bits / 8;
+    unsigned char *data = (unsigned char *)malloc(18 + size * size * (bytes + 1));
+    unsigned char *p = data + 18;
+    memset(data, 0, 18);
+    data[2] = rle ? 10 : 2;
+    data[12] = data[14] = size & 0xff;
+    data[13] = data[15] = size >> 8;
+    data[16] = bits;
+    srand(bits + rle);
+    for (int n = 0; n < size * size; ) {
+        int count = 1 + rand() % 128;
+        if (count > size * size - n)
+            count = size * size - n;
+        bool run = rle && rand() % 2;
+        if (rle)
+            *p++ = (run ? 127 : -1) + count;
+        for (int i = 0; i < (run ? 1 : count) * bytes; ++i)
+            *p++ = rand();
+        n += count;
+    }
+    *length = p - data;
+    return data;
+}
+
+/**
+  Decodes a 24 or 32-bit Targa the way targa_loadFromData used to, one
+  pixel at a time.
+**/
+static void bench_decode_targa(unsigned char *data, unsigned char *image) {
+    int bytes = data[16] / 8;
+    int count = (data[12] | data[13] << 8) * (data[14] | data[15] << 8);
+    unsigned char *p = data + 18 + data[0];
+    int pixel[4];
+    for (int n = 0; n < count; ) {
+        int id = data[2] == 10 ? *p++ : 0;
+        if (id < 128) {
+            for (++id; id > 0 && n < count; --id, ++n, p += bytes) {
+                pixel[0] = p[2];
+                pixel[1] = p[1];
+                pixel[2] = p[0];
+                pixel[3] = bytes == 4 ? p[3] : 255;
+                image[4 * n + 0] = (unsigned char)pixel[0];
+                image[4 * n + 1] = (unsigned char)pixel[1];
+                image[4 * n + 2] = (unsigned char)pixel[2];
+                image[4 * n + 3] = (unsigned char)pixel[3];
+            }
+        }
+        else {
+            pixel[0] = p[2];
+            pixel[1] = p[1];
+            pixel[2] = p[0];
+            pixel[3] = bytes == 4 ? p[3] : 255;
+            p += bytes;
+            for (id -= 127; id > 0 && n < count; --id, ++n) {
+                image[4 * n + 0] = (unsigned char)pixel[0];
+                image[4 * n + 1] = (unsigned char)pixel[1];
+                image[4 * n + 2] = (unsigned char)pixel[2];
+                image[4 * n + 3] = (unsigned char)pixel[3];
+            }
+        }
+    }
+}
+
+/**
+  targa_loadFromData on raw and run-length encoded 24 and 32-bit
+  images, against decoding them a pixel at a time.
+**/
+static bool bench_targa_decode() {
+    const int rounds = 5;
+    const int size = 1024;
+    bool ok = true;
+    cout << "targa" << endl;
+    unsigned char *reference = (unsigned char *)malloc(4 * size * size);
+    for (int i = 0; i < 4; ++i) {
+        int bits = (i & 1) ? 32 : 24;
+        bool rle = i >= 2;
+        int length;
+        unsigned char *data = bench_targa(size, bits, rle, &length);
+
+        double best[2] = { 1e30, 1e30 };
+        Targa targa;
+        targa_init(&targa);
+        for (int r = 0; r < rounds; ++r) {
+            double t0 = bench_now();
+            bench_decode_targa(data, reference);
+            double t = bench_now() - t0;
+            if (t < best[0]) best[0] = t;
+            targa_free(&targa);
+            t0 = bench_now();
+            targa_loadFromData(&targa, data, length);
+            t = bench_now() - t0;
+            if (t < best[1]) best[1] = t;
+        }
+
+        bool same = targa.image && !memcmp(targa.image, reference, 4 * size * size);
+        cout << "  " << size << "x" << size << ", " << bits << "-bit " << (rle ? "RLE" : "raw")
+             << ": per pixel " << best[0] << " ms, targa_loadFromData " << best[1] << " ms ("
+             << best[0] / best[1] << "x)" << (same ? "" : "  MISMATCH") << endl;
+        ok &= same;
+        targa_free(&targa);
+        free(data);
+    }
+    free(reference);
+    return ok;
+}
+
+struct Benchmark {
+    const char *name;
+    bool (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    { "weld", bench_weld },
+    { "vcache", bench_vcache },
+    { "arena", bench_arena },
+    { "names", bench_names },
+    { "ply", bench_ply },
+    { "export", bench_export },
+    { "targa", bench_targa_decode },
+};
+
+int run_benchmarks(int argc, char *argv[]) {
+    int count = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    bool ok = true;
+    for (int i = 0; i < count; ++i) {
+        bool selected = argc == 0;
+        for (int j = 0; j < argc; ++j)
+            selected |= !strcmp(argv[j], benchmarks[i].name);
+        if (selected)
+            ok &= benchmarks[i].run();
+    }
+    for (int j = 0; j < argc; ++j) {
+        int i = 0;
+        while (i < count && strcmp(argv[j], benchmarks[i].name))
+            ++i;
+        if (i == count) {
+            cout << "unknown benchmark " << argv[j] << endl;
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+/**
+  Command line benchmarks for the model code, run with
+  "cs123-final --bench [name ...]".
+**/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+/**
+  Runs the named benchmarks (all of them if no names are given) and
+  returns the process exit code.
+**/
+int run_benchmarks(int argc, char *argv[]);
+
+#endif // BENCHMARK_H
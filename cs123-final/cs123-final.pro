@@ -5,6 +5,13 @@
 #-------------------------------------------------
 
 QT       += core gui opengl
+LIBS     += -lz
+
+# qmake CONFIG+=zstd to read zstd compressed models as well as gzip ones
+zstd {
+    DEFINES += GLM_ZSTD
+    LIBS    += -lzstd
+}
 
 TARGET = cs123-final
 TEMPLATE = app
@@ -16,22 +23,37 @@ SOURCES += main.cpp\
     drawengine.cpp \
     targa.cpp \
     glm.cpp \
+    glmcache.cpp \
+    glmmesh.cpp \
+    glmopt.cpp \
+    glmsimplify.cpp \
+    glmprogressive.cpp \
+    glmbricks.cpp \
+    glmbvh.cpp \
+    glmdeform.cpp \
+    glmply.cpp \
+    modelloader.cpp \
+    textureloader.cpp \
     CS123Vector.inl \
     CS123Matrix.inl \
     CS123Matrix.cpp \
-    particleemitter.cpp
+    particleemitter.cpp \
+    benchmark.cpp
 
 HEADERS  += mainwindow.h \
     glwidget.h \
     drawengine.h \
     targa.h \
     glm.h \
+    modelloader.h \
+    textureloader.h \
     common.h \
     CS123Vector.h \
     CS123Matrix.h \
     CS123Algebra.h \
     CS123Common.h \
-    particleemitter.h
+    particleemitter.h \
+    benchmark.h
 
 FORMS    += mainwindow.ui
 
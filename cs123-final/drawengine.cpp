@@ -18,6 +18,9 @@
 #include <iostream>
 #include <QFile>
 #include <QGLFramebufferObject>
+#include <QTime>
+#include <string.h>
+#include <time.h>
 #define GL_GLEXT_PROTOTYPES
 #include <GL/glext.h>
 #include <CS123Algebra.h>
@@ -26,6 +29,53 @@
 using std::cout;
 using std::endl;
 
+/// reorder model triangles into meshlets, and for the vertex cache within them,
+/// when they are loaded (the reordered model is kept in the .glmc cache, so this
+/// only costs once)
+static const bool optimize_models = true;
+
+/// fraction of the triangles kept in each level of detail of the dragon, and
+/// the projected size (pixels across its bounding sphere) below which it is used
+static const float lod_ratios[MAX_LODS] = {.5f, .25f, .1f, .02f};
+static const float lod_pixels[MAX_LODS] = {400.f, 200.f, 100.f, 40.f};
+
+/// time each frame may spend refining the progressive dragon, and how many
+/// vertex splits are applied between looks at the clock
+static const int refine_budget_ms = 2;
+static const GLuint refine_batch = 64;
+
+/// the dragon's bricks (made by cs123-final --brick) are drawn instead of
+/// loading it when they exist, keeping at most this many bytes of them on
+/// the card
+static const size_t paged_budget = 256 << 20;
+static const char *dragon_path = "../cs123-final/models/xyzrgb_dragon.obj";
+
+/// dragons drawn by the stress test (N steps through these), laid out in a
+/// grid below the scene with this much room for each
+static const int stress_counts[] = {0, 25, 100, 400, 1600};
+static const int num_stress_counts = sizeof(stress_counts) / sizeof(stress_counts[0]);
+static const float stress_spacing = 1.f;
+
+/// build the dragon's meshes with GLM_QUANTIZE (half the vertex memory, decoded
+/// by the _quantized variants of the shaders), and the attribute locations the
+/// packed attributes are bound to (the position has to be 0, which stands in
+/// for gl_Vertex)
+static const bool quantize_meshes = true;
+static const GLint position_attribute = 0, normal_attribute = 1, texcoord_attribute = 2;
+
+/// the wobble (W): a bulge this wide and this high, pulsing with this period,
+/// that sweeps across the dragon and back in wobble_sweep_ms
+static const float wobble_radius = .35f;
+static const float wobble_amplitude = .05f;
+static const float wobble_period_ms = 600.f;
+static const float wobble_sweep_ms = 4000.f;
+
+/// where the wobble is this frame, for wobble_vertex
+struct Wobble {
+    float center[3];
+    float amplitude;
+};
+
 extern "C"{
     extern void APIENTRY glActiveTexture (GLenum);
     extern GLboolean APIENTRY glIsRenderbufferEXT (GLuint);
@@ -43,6 +93,15 @@ extern "C"{
     extern void APIENTRY glFramebufferTexture2DEXT (GLenum, GLenum, GLenum, GLuint, GLint);
     extern void APIENTRY glFramebufferTexture3DEXT (GLenum, GLenum, GLenum, GLuint, GLint, GLint);
     extern void APIENTRY glFramebufferRenderbufferEXT (GLenum, GLenum, GLenum, GLuint);
+    extern void APIENTRY glGenBuffers (GLsizei, GLuint *);
+    extern void APIENTRY glDeleteBuffers (GLsizei, const GLuint *);
+    extern void APIENTRY glBindBuffer (GLenum, GLuint);
+    extern void APIENTRY glBufferData (GLenum, GLsizeiptr, const GLvoid *, GLenum);
+    extern void APIENTRY glEnableVertexAttribArray (GLuint);
+    extern void APIENTRY glDisableVertexAttribArray (GLuint);
+    extern void APIENTRY glVertexAttribPointer (GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid *);
+    extern void APIENTRY glVertexAttribDivisor (GLuint, GLuint);
+    extern void APIENTRY glVertexAttrib4fv (GLuint, const GLfloat *);
 }
 
 /**
@@ -79,6 +138,16 @@ DrawEngine::DrawEngine(const QGLContext *context,int w,int h) : context_(context
     //ideally we would now check to make sure all the OGL functions we use are supported
     //by the video card.  but that's a pain to do so we're not going to.
     cout << "Loading Resources..." << endl;
+    loader_ = NULL;
+    progressive_ = NULL;
+    paged_ = NULL;
+    glGenBuffers(1, &instance_vbo_);
+    stress_dragons_ = 0;
+    stress_instanced_ = true;
+    picked_triangle_ = -1;
+    pick_time_ = 0.f;
+    deform_ = NULL;
+    deform_time_ = 0.f;
     load_models();
     load_shaders();
     load_textures();
@@ -86,8 +155,9 @@ DrawEngine::DrawEngine(const QGLContext *context,int w,int h) : context_(context
     refract_center = Vector3(0,0,1);
     refract_cube_map = generate_refract_cube_map();
     refract_every_so_often = 0;
-    QFile checker_file("../cs123-final/textures/checker_texture.gif");
-    checker_texture = GLWidget::loadTexture(checker_file);
+    meshlets_drawn_ = meshlets_culled_ = 0;
+    bricks_drawn_ = bricks_paged_in_ = 0;
+    cull_meshlets_ = true;
     cout << "Rendering..." << endl;
 }
 
@@ -95,6 +165,14 @@ DrawEngine::DrawEngine(const QGLContext *context,int w,int h) : context_(context
   @paragraph Dtor
 **/
 DrawEngine::~DrawEngine() {
+    delete loader_;
+    if (progressive_)
+        glmDeleteProgressive(progressive_);
+    if (paged_)
+        glmDeletePaged(paged_);
+    if (deform_)
+        glmDeleteDeformable(deform_);
+    glDeleteBuffers(1, &instance_vbo_);
     glDeleteTextures(1, &checker_texture);
     foreach(QGLShaderProgram *sp,shader_programs_)
         delete sp;
@@ -102,20 +180,34 @@ DrawEngine::~DrawEngine() {
         delete fbo;
     foreach(GLuint id,textures_)
         ((QGLContext *)(context_))->deleteTexture(id);
-    foreach(Model m,models_)
-        glmDelete(m.model);
+    foreach(Model m,models_) {
+        if (m.mesh)
+            glmDeleteMesh(m.mesh);
+        for (int i = 0; i < m.num_lods; ++i)
+            glmDeleteMesh(m.lods[i]);
+        if (m.model)
+            glmDelete(m.model);
+        if (m.bvh)
+            glmDeleteBVH(m.bvh);
+    }
 }
 
 /**
   @paragraph Loads models used by the program.  Caleed by the ctor once upon
-  initialization.
+  initialization.  The dragon is read (and simplified into its levels of
+  detail) on a ModelLoader thread; upload_models() picks it up once it's done.
+  If the dragon has been cut into bricks it is paged in as it's drawn instead.
 **/
 void DrawEngine::load_models() {
     cout << "Loading models..." << endl;
-    models_["dragon"].model = glmReadOBJ("../cs123-final/models/xyzrgb_dragon.obj");
-    glmUnitize(models_["dragon"].model);
-    models_["dragon"].idx = glmList(models_["dragon"].model,GLM_SMOOTH);
-    cout << "models/xyzrgb_dragon_old.obj" << endl;
+    paged_ = glmReadPaged((char *)dragon_path, paged_budget);
+    if (paged_) {
+        cout << "dragon paged: " << paged_->numtriangles << " triangles in "
+             << paged_->numbricks << " bricks" << endl;
+    } else {
+        loader_ = new ModelLoader(dragon_path, optimize_models ? GLM_MESHLETS : 0, lod_ratios, MAX_LODS);
+        loader_->start(QThread::LowPriority);
+    }
     //Create grid
     models_["grid"].idx = glGenLists(1);
     glNewList(models_["grid"].idx,GL_COMPILE);
@@ -130,6 +222,9 @@ void DrawEngine::load_models() {
     }
     glEndList();
     cout << "grid compiled" << endl;
+    //the orbiting spheres, drawn instanced
+    models_["sphere"].model = glmSphere(.5f, 20, 20);
+    models_["sphere"].mesh = glmMesh(models_["sphere"].model, GLM_TEXTURE);
     models_["skybox"].idx = glGenLists(1);
     glNewList(models_["skybox"].idx,GL_COMPILE);
     //Be glad we wrote this for you...ugh.
@@ -176,13 +271,15 @@ void DrawEngine::load_shaders() {
                                                        "../cs123-final/shaders/reflect.frag");
     shader_programs_["reflect"]->link();
     cout << "shaders/reflect" << endl;
-    shader_programs_["refract"] = new QGLShaderProgram(context_);
-    shader_programs_["refract"]->addShaderFromSourceFile(QGLShader::Vertex,
-                                                       "../cs123-final/shaders/refract.vert");
-    shader_programs_["refract"]->addShaderFromSourceFile(QGLShader::Fragment,
-                                                       "../cs123-final/shaders/refract.frag");
-    shader_programs_["refract"]->link();
-    cout << "shaders/refract" << endl;
+    for (int quantized = 0; quantized < 2; ++quantized) {
+        QString name = quantized ? "refract_quantized" : "refract";
+        shader_programs_[name] = new QGLShaderProgram(context_);
+        add_vertex_shader(shader_programs_[name], "../cs123-final/shaders/refract.vert", quantized);
+        shader_programs_[name]->addShaderFromSourceFile(QGLShader::Fragment,
+                                                        "../cs123-final/shaders/refract.frag");
+        shader_programs_[name]->link();
+        cout << "shaders/" << name.toStdString() << endl;
+    }
     shader_programs_["brightpass"] = new QGLShaderProgram(context_);
     shader_programs_["brightpass"]->addShaderFromSourceFile(QGLShader::Fragment,
                                                        "../cs123-final/shaders/brightpass.frag");
@@ -194,6 +291,74 @@ void DrawEngine::load_shaders() {
                                                        "../cs123-final/shaders/blur.frag");
     shader_programs_["blur"]->link();
     cout << "shaders/blur" << endl;
+    for (int quantized = 0; quantized < 2; ++quantized) {
+        QString name = quantized ? "instanced_quantized" : "instanced";
+        shader_programs_[name] = new QGLShaderProgram(context_);
+        add_vertex_shader(shader_programs_[name], "../cs123-final/shaders/instanced.vert", quantized);
+        //out of the way of the mesh's attributes, even those the shader doesn't use
+        shader_programs_[name]->bindAttributeLocation("offset", texcoord_attribute + 1);
+        shader_programs_[name]->bindAttributeLocation("color", texcoord_attribute + 2);
+        shader_programs_[name]->addShaderFromSourceFile(QGLShader::Fragment,
+                                                        "../cs123-final/shaders/instanced.frag");
+        shader_programs_[name]->link();
+        cout << "shaders/" << name.toStdString() << endl;
+    }
+}
+
+/**
+  @paragraph Adds a vertex shader to a program with shaders/decode.glsl in front
+  of it, which gives the shader vertex() and vertex_normal(): from the fixed
+  function arrays, or decoded from a GLM_QUANTIZE mesh if quantized.
+
+  @param program:   the program to add the shader to
+  @param path:      the vertex shader source
+  @param quantized: decode GLM_QUANTIZE vertices
+**/
+void DrawEngine::add_vertex_shader(QGLShaderProgram *program, const QString &path, bool quantized) {
+    QFile decode("../cs123-final/shaders/decode.glsl"), file(path);
+    decode.open(QIODevice::ReadOnly);
+    file.open(QIODevice::ReadOnly);
+    QByteArray source(quantized ? "#define QUANTIZED\n" : "");
+    source += decode.readAll();
+    source += file.readAll();
+    program->addShaderFromSourceCode(QGLShader::Vertex, source);
+    program->bindAttributeLocation("position", position_attribute);
+    program->bindAttributeLocation("octahedral", normal_attribute);
+    program->bindAttributeLocation("texcoord", texcoord_attribute);
+}
+
+/**
+  @paragraph Binds the shader program to draw a mesh with: the named one, or its
+  _quantized variant with the mesh's decode scale and bias if the mesh was built
+  with GLM_QUANTIZE.
+
+  @param name: the program
+  @param mesh: the mesh about to be drawn
+
+  @return the bound program
+**/
+QGLShaderProgram *DrawEngine::bind_mesh_program(const QString &name, GLMmesh *mesh) {
+    if (!(mesh->mode & GLM_QUANTIZE)) {
+        shader_programs_[name]->bind();
+        return shader_programs_[name];
+    }
+    QGLShaderProgram *sp = shader_programs_[name + "_quantized"];
+    sp->bind();
+    sp->setUniformValue("decode_scale", QVector3D(mesh->scale[0], mesh->scale[1], mesh->scale[2]));
+    sp->setUniformValue("decode_bias", QVector3D(mesh->bias[0], mesh->bias[1], mesh->bias[2]));
+    return sp;
+}
+
+/**
+  @paragraph Builds a mesh of one of the dragon's models, quantized if
+  quantize_meshes is set.
+**/
+static GLMmesh *dragon_mesh(GLMmodel *model) {
+    GLMmesh *mesh = glmMesh(model, quantize_meshes ? GLM_SMOOTH | GLM_QUANTIZE : GLM_SMOOTH);
+    if (quantize_meshes)
+        glmMeshAttributes(mesh, position_attribute, normal_attribute, texcoord_attribute);
+    glmMeshlets(model, mesh, GLM_MESHLET_SIZE);
+    return mesh;
 }
 /**
   @paragraph Loads textures used by the program.  Caleed by the ctor once upon
@@ -208,7 +373,16 @@ void DrawEngine::load_textures() {
     fileList.append(new QFile("../cs123-final/textures/astra/negy.jpg"));
     fileList.append(new QFile("../cs123-final/textures/astra/posz.jpg"));
     fileList.append(new QFile("../cs123-final/textures/astra/negz.jpg"));
-    textures_["cube_map_1"] = load_cube_map(fileList);
+    //everything is queued first so it all decodes at once, then each texture is
+    //uploaded as soon as its image is ready
+    TextureLoader loader;
+    QList<int> faces;
+    foreach (QFile* f, fileList)
+        faces.append(loader.add(f->fileName(), true, 1024));
+    int checker = loader.add("../cs123-final/textures/checker_texture.gif");
+    textures_["cube_map_1"] = load_cube_map(loader, faces);
+    checker_texture = GLWidget::loadTexture(loader, checker);
+    loader.report();
     foreach (QFile* f, fileList)
         delete f;
 }
@@ -277,6 +451,200 @@ void DrawEngine::realloc_framebuffers(int w,int h) {
     }
 }
 
+/**
+  @paragraph Builds the GL side of the models the ModelLoader read: textures,
+  vertex and index buffers and meshlets.  Called by draw_frame once the loader
+  has finished.
+**/
+void DrawEngine::upload_models() {
+    if (!loader_->model) {
+        cout << "dragon failed to load" << endl;
+        delete loader_;
+        loader_ = NULL;
+        return;
+    }
+    Model &dragon = models_["dragon"];
+    dragon.model = loader_->model;
+    loader_->model = NULL;
+    glmLoadTextures(dragon.model, NULL);
+    float acmr, atvr;
+    glmVertexCacheStats(dragon.model, 32, &acmr, &atvr);
+    cout << "dragon vertex cache ACMR " << acmr << ", ATVR " << atvr << endl;
+    dragon.mesh = dragon_mesh(dragon.model);
+    cout << "dragon vertex buffer: " << dragon.mesh->numvertices << " vertices of " << dragon.mesh->stride
+         << " bytes, " << dragon.mesh->numvertices * dragon.mesh->stride / 1024 << " KB" << endl;
+    GLfloat dimensions[3];
+    glmDimensions(dragon.model, dimensions);
+    dragon.radius = .5f * sqrt(dimensions[0] * dimensions[0] + dimensions[1] * dimensions[1] +
+                               dimensions[2] * dimensions[2]);
+    dragon.bvh = loader_->bvh;
+    loader_->bvh = NULL;
+    //the levels of detail share the dragon's materials, so only their meshes are kept
+    for (int i = 0; i < loader_->num_lods; ++i) {
+        GLMmodel *lod = loader_->lods[i];
+        loader_->lods[i] = NULL;
+        cout << "dragon LOD " << i + 1 << ": " << lod->numtriangles << " triangles" << endl;
+        dragon.lods[dragon.num_lods++] = dragon_mesh(lod);
+        glmDelete(lod);
+    }
+    if (progressive_) {
+        cout << "dragon streamed " << progressive_->numapplied << " of " << progressive_->numsplits
+             << " vertex splits before it loaded" << endl;
+        glmDeleteProgressive(progressive_);
+        progressive_ = NULL;
+    }
+    delete loader_;
+    loader_ = NULL;
+}
+
+/**
+  @paragraph Applies the vertex splits of the progressive dragon that have been
+  streamed in, as many as fit in refine_budget_ms, so the frame rate stays
+  steady while detail fills in.
+**/
+void DrawEngine::refine_progressive() {
+    QTime timer;
+    timer.start();
+    while (glmRefineProgressive(progressive_, refine_batch) && timer.elapsed() < refine_budget_ms)
+        ;
+}
+
+/**
+  @paragraph glmDeform callback for the wobble: pushes the vertices inside the
+  bulge out along their normals, and puts the rest back where they belong.
+**/
+static void wobble_vertex(const GLfloat *rest, const GLfloat *normal, GLfloat *position, GLvoid *data) {
+    const Wobble *wobble = (const Wobble *)data;
+    float dx = rest[0] - wobble->center[0], dy = rest[1] - wobble->center[1], dz = rest[2] - wobble->center[2];
+    float s = (dx * dx + dy * dy + dz * dz) / (wobble_radius * wobble_radius);
+    float d = s < 1.f ? wobble->amplitude * (1.f - s) * (1.f - s) : 0.f;
+    for (int i = 0; i < 3; ++i)
+        position[i] = rest[i] + normal[i] * d;
+}
+
+/**
+  @paragraph Moves the wobble along and deforms the dragon to match.  Only the
+  vertices the bulge moves (in or out) and the normals around them are
+  recomputed.
+
+  @param time: the elapsed time in the program, in milliseconds
+**/
+void DrawEngine::wobble_dragon(float time) {
+    Wobble wobble;
+    float sweep = fmod(time, 2.f * wobble_sweep_ms) / wobble_sweep_ms;
+    wobble.center[0] = sweep < 1.f ? 2.f * sweep - 1.f : 3.f - 2.f * sweep;
+    wobble.center[1] = wobble.center[2] = 0.f;
+    wobble.amplitude = wobble_amplitude * sin(2.f * M_PI * time / wobble_period_ms);
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    glmDeform(deform_, wobble_vertex, &wobble);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    deform_time_ = (end.tv_sec - start.tv_sec) * 1e3f + (end.tv_nsec - start.tv_nsec) / 1e6f;
+}
+
+/**
+  @paragraph Draws the bricks of the paged dragon that are in view, scaled to
+  the unit cube like glmUnitize() does to the loaded one.
+**/
+void DrawEngine::draw_paged() {
+    float w = fabs(paged_->max[0]) + fabs(paged_->min[0]);
+    float h = fabs(paged_->max[1]) + fabs(paged_->min[1]);
+    float d = fabs(paged_->max[2]) + fabs(paged_->min[2]);
+    float scale = 2.f / qMax(qMax(w, h), d);
+    glPushMatrix();
+    glScalef(scale, scale, scale);
+    glTranslatef(-(paged_->max[0] + paged_->min[0]) / 2.f, -(paged_->max[1] + paged_->min[1]) / 2.f,
+                 -(paged_->max[2] + paged_->min[2]) / 2.f);
+    glmDrawPaged(paged_, GLM_SMOOTH, &bricks_drawn_, &bricks_paged_in_);
+    glPopMatrix();
+}
+
+/**
+  @paragraph Draws a mesh once for every instance, moved to the instance's
+  position, scaled and tinted by the instance shader.
+
+  @param m:         the model the mesh was built from
+  @param mesh:      the mesh to draw
+  @param instances: where and in what color to draw it
+  @param texture:   2D texture to modulate the colors with, or 0
+  @param instanced: draw them all in one instanced call (otherwise one
+                    call each, to compare)
+**/
+void DrawEngine::draw_instances(const Model &m, GLMmesh *mesh, const QVector<Instance> &instances,
+                                GLuint texture, bool instanced) {
+    QGLShaderProgram *sp = bind_mesh_program("instanced", mesh);
+    sp->setUniformValue("Texture", 0);
+    sp->setUniformValue("textured", texture != 0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    GLint offset = sp->attributeLocation("offset"), color = sp->attributeLocation("color");
+    if (instanced) {
+        glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(Instance) * instances.size(), instances.constData(), GL_STREAM_DRAW);
+        glEnableVertexAttribArray(offset);
+        glEnableVertexAttribArray(color);
+        glVertexAttribPointer(offset, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid *)offsetof(Instance, position));
+        glVertexAttribPointer(color, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (GLvoid *)offsetof(Instance, color));
+        glVertexAttribDivisor(offset, 1);
+        glVertexAttribDivisor(color, 1);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glmDrawMeshInstanced(m.model, mesh, GLM_NONE, instances.size());
+        glVertexAttribDivisor(offset, 0);
+        glVertexAttribDivisor(color, 0);
+        glDisableVertexAttribArray(offset);
+        glDisableVertexAttribArray(color);
+    } else {
+        foreach (const Instance &instance, instances) {
+            glVertexAttrib4fv(offset, instance.position);
+            glVertexAttrib4fv(color, instance.color);
+            glmDrawMesh(m.model, mesh, GLM_NONE);
+        }
+    }
+    sp->release();
+}
+
+/**
+  @paragraph Draws the checkered spheres orbiting the refracting sphere.
+**/
+void DrawEngine::draw_orbiting_spheres(float time) {
+    static const float colors[4][4] = {{1,0,0,1}, {0,1,0,1}, {0,0,1,1}, {1,0,1,1}};
+    QVector<Instance> spheres(4);
+    float r = 3;
+    for (int i = 0; i < 4; ++i) {
+        float angle = time / 1000 + i * M_PI / 3;
+        spheres[i].position[0] = refract_center.x + r * sin(angle);
+        spheres[i].position[1] = refract_center.y;
+        spheres[i].position[2] = refract_center.z + r * cos(angle);
+        spheres[i].scale = 1.f;
+        memcpy(spheres[i].color, colors[i], sizeof(spheres[i].color));
+    }
+    draw_instances(models_["sphere"], models_["sphere"].mesh, spheres, checker_texture, true);
+}
+
+/**
+  @paragraph Stress test: draws stress_dragons_ copies of the coarsest level
+  of detail of the dragon in a grid under the scene, instanced or with a draw
+  call each, to show what the draw calls cost.
+**/
+void DrawEngine::draw_stress_dragons() {
+    const Model &dragon = models_["dragon"];
+    if (!dragon.mesh)
+        return;
+    GLMmesh *mesh = dragon.num_lods ? dragon.lods[dragon.num_lods - 1] : dragon.mesh;
+    int side = (int)ceil(sqrt((float)stress_dragons_));
+    QVector<Instance> dragons(stress_dragons_);
+    for (int i = 0; i < stress_dragons_; ++i) {
+        dragons[i].position[0] = (i % side - (side - 1) / 2.f) * stress_spacing;
+        dragons[i].position[1] = -2.f;
+        dragons[i].position[2] = (i / side - (side - 1) / 2.f) * stress_spacing;
+        dragons[i].scale = .4f * stress_spacing;
+        dragons[i].color[0] = .5f + .5f * sin(i * .7f);
+        dragons[i].color[1] = .5f + .5f * sin(i * 1.3f + 2.f);
+        dragons[i].color[2] = .5f + .5f * sin(i * 2.1f + 4.f);
+        dragons[i].color[3] = 1.f;
+    }
+    draw_instances(dragon, mesh, dragons, 0, stress_instanced_);
+}
+
 /**
   @paragraph Should render one frame at the given elapsed time in the program.
   Assumes that the GL context is valid when this method is called.
@@ -290,6 +658,16 @@ void DrawEngine::realloc_framebuffers(int w,int h) {
 **/
 void DrawEngine::draw_frame(float time,int w,int h) {
     fps_ = 1000.f / (time - previous_time_),previous_time_ = time;
+    meshlets_drawn_ = meshlets_culled_ = 0;
+    bricks_drawn_ = bricks_paged_in_ = 0;
+    if (loader_ && loader_->isFinished())
+        upload_models();
+    if (loader_ && !progressive_)
+        progressive_ = loader_->take_progressive();
+    if (progressive_)
+        refine_progressive();
+    if (deform_)
+        wobble_dragon(time);
 
     Vector3 look_vector(camera_.eye.x - camera_.center.x, camera_.eye.y - camera_.center.y, camera_.eye.z - camera_.center.z);
     look_vector.normalize();
@@ -409,53 +787,14 @@ void DrawEngine::render_to_immediate_buffer(Vector3 eye, Vector3 pos, Vector3 up
     glEnable(GL_CULL_FACE);
     glActiveTexture(GL_TEXTURE0);
 
-    glPushMatrix();
-
-    // for a sphere orbiting our object vertically
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    float r = 3;
-    glTranslatef(r * sin(time/1000), 0, r * cos(time/1000));
-
-    glColor3f(1.0,0,0);
-
-    glEnable(GL_TEXTURE_2D);
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-    gluQuadricTexture(quad, true);
-    glBindTexture(GL_TEXTURE_2D, checker_texture);
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(0,1,0);
-
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + M_PI/3), 0, r * cos(time/1000 + M_PI/3));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(0,0,1);
+    // the spheres orbiting our sphere, in one instanced draw
+    draw_orbiting_spheres(time);
 
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + 2*M_PI/3), 0, r * cos(time/1000 + 2*M_PI/3));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(1,0,1);
-
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + M_PI), 0, r * cos(time/1000 + M_PI));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(1,1,1);
-
-    glPopMatrix();
     glPushMatrix();
 
     // for the klein bottle orbiting our sphere
     glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    r = 3;
+    float r = 3;
     glTranslatef(r * sin(time/1000 + 3*M_PI/2), 0, r * cos(time/1000 + 3*M_PI/2));
     glScalef(.05, .05, .05);
     glColor3f(.4,.6,.8);
@@ -507,8 +846,33 @@ void DrawEngine::render_scene(QGLFramebufferObject* fb, Vector3 look, Vector3 po
     shader_programs_["refract"]->setUniformValue("theta", theta);
     shader_programs_["refract"]->setUniformValue("phi", phi);
     glPushMatrix();
-    //glTranslatef(-1.25f,0.f,0.f);
-    //glCallList(models_["dragon"].idx);
+    glTranslatef(-1.25f,0.f,0.f);
+    if (paged_) {
+        draw_paged();
+    } else if (deform_) {
+        glmDrawDeformable(deform_,GLM_SMOOTH);
+    } else if (models_["dragon"].mesh) {
+        GLMmesh *dragon = pick_lod(models_["dragon"],Vector3(-1.25f,0.f,0.f),h);
+        QGLShaderProgram *sp = bind_mesh_program("refract", dragon);
+        sp->setUniformValue("CubeMap",GL_TEXTURE0);
+        sp->setUniformValue("theta", theta);
+        sp->setUniformValue("phi", phi);
+        if (cull_meshlets_)
+            glmDrawMeshlets(models_["dragon"].model,dragon,GLM_NONE,&meshlets_drawn_,&meshlets_culled_);
+        else
+            glmDrawMesh(models_["dragon"].model,dragon,GLM_NONE);
+        shader_programs_["refract"]->bind();
+    } else if (progressive_) {
+        //still loading: the progressive mesh, as far as it has come in
+        glmDrawProgressive(progressive_,GLM_SMOOTH);
+    } else {
+        //still loading: a wireframe stand-in
+        gluQuadricDrawStyle(quad, GLU_LINE);
+        gluSphere(quad, .5, 12, 8);
+        gluQuadricDrawStyle(quad, GLU_FILL);
+    }
+    glPopMatrix();
+    glPushMatrix();
     glTranslatef(refract_center.x, refract_center.y, refract_center.z);
     gluSphere(quad, 1, 20, 20);
     glTranslatef(-refract_center.x, -refract_center.y, -refract_center.z);
@@ -518,53 +882,16 @@ void DrawEngine::render_scene(QGLFramebufferObject* fb, Vector3 look, Vector3 po
 
     glBindTexture(GL_TEXTURE_CUBE_MAP, textures_["cube_map_1"]);
 
-    glPushMatrix();
-
-    // for a sphere orbiting our sphere vertically
+    // the spheres orbiting our sphere, in one instanced draw
+    draw_orbiting_spheres(time);
+    if (stress_dragons_)
+        draw_stress_dragons();
 
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    float r = 3;
-    glTranslatef(r * sin(time/1000), 0, r * cos(time/1000));
-
-    glColor3f(1.0,0,0);
-
-    glEnable(GL_TEXTURE_2D);
-    glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-    gluQuadricTexture(quad, true);
-    glBindTexture(GL_TEXTURE_2D, checker_texture);
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(0,1,0);
-
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + M_PI/3), 0, r * cos(time/1000 + M_PI/3));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(0,0,1);
-
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + 2*M_PI/3), 0, r * cos(time/1000 + 2*M_PI/3));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(1,0,1);
-
-    glPopMatrix();
-    glPushMatrix();
-
-    glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    glTranslatef(r * sin(time/1000 + M_PI), 0, r * cos(time/1000 + M_PI));
-    gluSphere(quad, .5, 20, 20);
-    glColor3f(1,1,1);
-
-    glPopMatrix();
     glPushMatrix();
 
     // for the klein bottle orbiting our sphere
     glTranslatef(refract_center.x, refract_center.y, refract_center.z);
-    r = 3;
+    float r = 3;
     glTranslatef(r * sin(time/1000 + 3*M_PI/2), 0, r * cos(time/1000 + 3*M_PI/2));
     glScalef(.05, .05, .05);
     glColor3f(.4,.6,.8);
@@ -583,6 +910,29 @@ void DrawEngine::render_scene(QGLFramebufferObject* fb, Vector3 look, Vector3 po
     fb->release();
 }
 
+/**
+  @paragraph Picks the level of detail of a model from how big it shows up on
+  screen: the coarser levels are used once its bounding sphere covers fewer
+  pixels than the thresholds in lod_pixels.
+
+  @param m:   the model, with its levels of detail
+  @param pos: where the model is drawn, in world space
+  @param h:   the viewport height
+  @return The mesh to draw.
+
+**/
+GLMmesh *DrawEngine::pick_lod(const Model &m, Vector3 pos, int h) {
+    Vector3 eye(camera_.eye.x, camera_.eye.y, camera_.eye.z);
+    float d = (pos - eye).getMagnitude();
+    if (d <= m.radius)
+        return m.mesh;
+    float pixels = m.radius * h / (d * tan(camera_.fovy * M_PI / 360.f));
+    GLMmesh *mesh = m.mesh;
+    for (int i = 0; i < m.num_lods && pixels < lod_pixels[i]; ++i)
+        mesh = m.lods[i];
+    return mesh;
+}
+
 /**
   @paragraph Renders the actual scene.  May be called multiple times by
   DrawEngine::draw_frame(float time,int w,int h) if necessary.
@@ -796,27 +1146,59 @@ void DrawEngine::mouse_wheel_event(int dx) {
         camera_.eye += (camera_.center - camera_.eye).getNormalized() * dx * .005;
 }
 
+/**
+  @paragraph Called by GLWidget when the mouse is pressed.  Casts a ray from the
+  eye through the pixel under the mouse and picks the dragon triangle it hits
+  first, with the dragon's BVH.  The BVH is of the dragon at rest, so nothing is
+  picked while it wobbles.
+
+  @param p: the mouse position, in pixels from the top left
+  @param w: the viewport width
+  @param h: the viewport height
+**/
+void DrawEngine::mouse_click_event(float2 p, int w, int h) {
+    const Model &dragon = models_["dragon"];
+    if (!dragon.bvh)
+        return;
+    if (deform_) {
+        picked_triangle_ = -1;
+        return;
+    }
+    float3 forward = (camera_.center - camera_.eye).getNormalized();
+    float3 right = forward.cross(camera_.up).getNormalized();
+    float3 above = right.cross(forward);
+    float scale = tan(camera_.fovy * M_PI / 360.f);
+    float x = (2.f * p.x / w - 1.f) * scale * w / h, y = (1.f - 2.f * p.y / h) * scale;
+    float3 direction = forward + right * x + above * y;
+    //the dragon is drawn moved over to x = -1.25
+    GLfloat origin[3] = {camera_.eye.x + 1.25f, camera_.eye.y, camera_.eye.z};
+    GLfloat ray[3] = {direction.x, direction.y, direction.z};
+    GLMhit hit;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool found = glmIntersect(dragon.bvh, origin, ray, camera_.far, &hit);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    pick_time_ = (end.tv_sec - start.tv_sec) * 1e6f + (end.tv_nsec - start.tv_nsec) / 1e3f;
+    picked_triangle_ = found ? (int)hit.triangle : -1;
+}
+
 /**
   @paragraph Loads the cube map into video memory.
 
-  @param files: a list of files containing the cube map images (should be length
-  six) in order.
+  @param loader: the loader decoding the cube map images.
+  @param faces: the loader's indices of the images (should be length six) in
+  order.
   @return The assigned OpenGL id to the cube map.
 **/
-GLuint DrawEngine::load_cube_map(QList<QFile *> files) {
+GLuint DrawEngine::load_cube_map(TextureLoader &loader, const QList<int> &faces) {
     GLuint id;
     glGenTextures(1,&id);
     glBindTexture(GL_TEXTURE_CUBE_MAP,id);
-    for(unsigned i = 0; i < 6; ++i) {
-        QImage image,texture;
-        image.load(files[i]->fileName());
-        image = image.mirrored(false,true);
-        texture = QGLWidget::convertToGLFormat(image);
-        texture = texture.scaledToWidth(1024,Qt::SmoothTransformation);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,3,3,texture.width(),texture.height(),0,GL_RGBA,GL_UNSIGNED_BYTE,texture.bits());
-        gluBuild2DMipmaps(GL_TEXTURE_CUBE_MAP_POSITIVE_X +i, 3, texture.width(), texture.height(), GL_RGBA, GL_UNSIGNED_BYTE, texture.bits());
-        cout << files[i]->fileName().toStdString() << endl;
-    }
+    //GL makes the mipmaps of each face as it goes in, rather than gluBuild2DMipmaps()
+    //scaling them down on this thread
+    glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_GENERATE_MIPMAP,GL_TRUE);
+    for(unsigned i = 0; i < 6; ++i)
+        loader.upload(faces[i],GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
     glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MIN_FILTER,GL_NEAREST_MIPMAP_NEAREST);
     glTexParameteri(GL_TEXTURE_CUBE_MAP,GL_TEXTURE_MAG_FILTER,GL_NEAREST_MIPMAP_NEAREST);
     glBindTexture(GL_TEXTURE_CUBE_MAP,0);
@@ -858,6 +1240,29 @@ void DrawEngine::create_blur_kernel(int radius,int w,int h,GLfloat* kernel,GLflo
   **/
 void DrawEngine::key_press_event(QKeyEvent *event) {
     switch(event->key()) {
-
+    case Qt::Key_C:
+        cull_meshlets_ = !cull_meshlets_;
+        break;
+    case Qt::Key_N:
+        for (int i = 0; i < num_stress_counts; ++i) {
+            if (stress_counts[i] == stress_dragons_) {
+                stress_dragons_ = stress_counts[(i + 1) % num_stress_counts];
+                break;
+            }
+        }
+        break;
+    case Qt::Key_I:
+        stress_instanced_ = !stress_instanced_;
+        break;
+    case Qt::Key_W:
+        if (deform_) {
+            glmDeleteDeformable(deform_);
+            deform_ = NULL;
+        } else if (models_["dragon"].model) {
+            deform_ = glmDeformable(models_["dragon"].model);
+            //the BVH is of the dragon at rest, so what was picked no longer is
+            picked_triangle_ = -1;
+        }
+        break;
     }
 }
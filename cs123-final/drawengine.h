@@ -3,8 +3,11 @@
 
 #include <QHash>
 #include <QString>
+#include <QVector>
 #include <qgl.h>
 #include "glm.h"
+#include "modelloader.h"
+#include "textureloader.h"
 #include "common.h"
 #include <CS123Algebra.h>
 
@@ -16,7 +19,18 @@ class QKeyEvent;
 
 struct Model {
     GLMmodel *model;
+    GLMmesh *mesh;
     GLuint idx;
+    GLMmesh *lods[MAX_LODS]; ///simplified meshes, coarser and coarser
+    int num_lods;
+    float radius; ///bounding sphere radius, for picking a level of detail
+    GLMbvh *bvh; ///BVH over the model's triangles, for picking with the mouse
+};
+
+struct Instance {
+    float position[3];
+    float scale;
+    float color[4];
 };
 
 struct Camera {
@@ -36,9 +50,25 @@ public:
     void resize_frame(int w, int h);
     void mouse_wheel_event(int dx);
     void mouse_drag_event(float2 p0, float2 p1);
+    void mouse_click_event(float2 p, int w, int h);
     void key_press_event(QKeyEvent *event);
     //getters and setters
     float fps() { return fps_; }
+    GLuint meshlets_drawn() { return meshlets_drawn_; }
+    GLuint meshlets_culled() { return meshlets_culled_; }
+    bool cull_meshlets() { return cull_meshlets_; }
+    bool paged() { return paged_ != NULL; }
+    GLuint bricks_drawn() { return bricks_drawn_; }
+    GLuint bricks_paged_in() { return bricks_paged_in_; }
+    int stress_dragons() { return stress_dragons_; }
+    bool stress_instanced() { return stress_instanced_; }
+    int picked_triangle() { return picked_triangle_; }
+    float pick_time() { return pick_time_; }
+    bool deforming() { return deform_ != NULL; }
+    GLuint deform_moved() { return deform_ ? deform_->nummoved : 0; }
+    GLuint deform_normals() { return deform_ ? deform_->numnormals : 0; }
+    float deform_time() { return deform_time_; }
+    bool loading() { return loader_ != NULL; }
 
     //member variables
 
@@ -52,13 +82,23 @@ protected:
     void realloc_framebuffers(int w, int h);
     void render_blur(float width, float height);
     void load_models();
+    void upload_models();
+    void refine_progressive();
+    void draw_paged();
+    void wobble_dragon(float time);
+    void draw_instances(const Model &m, GLMmesh *mesh, const QVector<Instance> &instances, GLuint texture, bool instanced);
+    void draw_orbiting_spheres(float time);
+    void draw_stress_dragons();
     void load_textures();
     void load_shaders();
-    GLuint load_cube_map(QList<QFile *> files);
+    void add_vertex_shader(QGLShaderProgram *program, const QString &path, bool quantized);
+    QGLShaderProgram *bind_mesh_program(const QString &name, GLMmesh *mesh);
+    GLuint load_cube_map(TextureLoader &loader, const QList<int> &faces);
     void create_fbos(int w, int h);
     void create_blur_kernel(int radius,int w,int h,GLfloat* kernel,GLfloat* offsets);
     void render_scene(QGLFramebufferObject* fb, Vector3 eye, Vector3 pos, Vector3 up, int w, int h, float time, float theta, float phi);
     void render_to_immediate_buffer(Vector3 eye, Vector3 pos, Vector3 up, int w, int h, float time);
+    GLMmesh *pick_lod(const Model &m, Vector3 pos, int h);
     GLuint generate_refract_cube_map();
 
     int refract_every_so_often;
@@ -73,6 +113,19 @@ protected:
     const QGLContext                            *context_; ///the current OpenGL context to render to
     float                                       previous_time_, fps_; ///the previous time and the fps counter
     Camera                                      camera_; ///a simple camera struct
+    GLuint                                      meshlets_drawn_, meshlets_culled_; ///meshlets drawn and culled in the last frame
+    bool                                        cull_meshlets_; ///cull meshlets against the camera before drawing
+    ModelLoader                                 *loader_; ///reads the dragon in the background, NULL once it's uploaded
+    GLMprogressive                              *progressive_; ///coarse dragon streamed in while the real one loads, NULL once it's uploaded
+    GLMpaged                                    *paged_; ///the dragon's bricks when it's drawn paged, else NULL
+    GLuint                                      bricks_drawn_, bricks_paged_in_; ///bricks drawn and paged in in the last frame
+    GLuint                                      instance_vbo_; ///per instance offsets and colors for draw_instances
+    int                                         stress_dragons_; ///dragons drawn by the stress test, 0 when it's off
+    bool                                        stress_instanced_; ///draw the stress test dragons in one call instead of one call each
+    int                                         picked_triangle_; ///dragon triangle last clicked on, -1 for none
+    float                                       pick_time_; ///microseconds the last pick took
+    GLMdeform                                   *deform_; ///the dragon while it wobbles, else NULL
+    float                                       deform_time_; ///milliseconds the last glmDeform took
 
     Vector3 refract_center;
     GLuint checker_texture;
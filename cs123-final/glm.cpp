@@ -20,7 +20,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef GLM_ZSTD
+#include <zstd.h>
+#endif
 #define GL_GLEXT_PROTOTYPES
 #include <GL/gl.h>
 #include <GL/glu.h>
@@ -46,14 +57,6 @@
 #define T(x) (model->triangles[(x)])
 GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat, GLboolean filtering, GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight);
 
-/* _GLMnode: general purpose node */
-typedef struct _GLMnode {
-    GLuint         index;
-    GLboolean      averaged;
-    struct _GLMnode* next;
-} GLMnode;
-
-
 /* glmMax: returns the maximum of two floats */
 static GLfloat
         glmMax(GLfloat a, GLfloat b)
@@ -129,8 +132,87 @@ static GLboolean glmEqual(GLfloat* u, GLfloat* v, GLfloat epsilon) {
 
 static GLint gl_max_texture_size;
 
-GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
-                      GLboolean filtering, GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight)
+/* _GLMtexload: a texture being loaded.  glmBeginTexture() maps the file
+   and sets up where its pixels go on the GL thread, glmDecodeTexture()
+   decodes them on any thread, and glmFinishTexture() uploads them, on
+   the GL thread again */
+typedef struct _GLMtexload {
+    Targa     targa;
+    GLubyte*  data;         /* what glTexImage2D() gets: pixels in the mapping,
+                               a malloc()ed image, or NULL (offset 0 of pbo) */
+    GLubyte*  decode;       /* where to decode the image to, NULL if not needed */
+    GLenum    format;       /* GL_BGRA straight from the mapping, else GL_RGBA */
+    GLuint    pbo;          /* pixel-unpack buffer being decoded into, or 0 */
+    GLboolean scale;        /* too big for a texture: gluBuild2DMipmaps() scales it */
+    double    decodetime;   /* milliseconds glmDecodeTexture() took */
+} GLMtexload;
+
+/* glmMilliseconds: a monotonic clock in milliseconds, for timings */
+static double glmMilliseconds(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/* glmBeginTexture: maps a Targa file and sets up where its pixels go.
+ * An uncompressed 32-bit image goes to GL straight out of the mapping,
+ * anything else is decoded into a mapped pixel-unpack buffer, and GL
+ * makes the mipmaps.  Only an image too big for a texture is decoded
+ * into client memory, for gluBuild2DMipmaps() to scale down.  Needs
+ * the GL context.
+ *
+ * load     - the texture to set up
+ * filename - name of the .tga file
+ */
+static GLvoid glmBeginTexture(GLMtexload* load, char* filename){
+    while (*filename==' ') filename++;
+    memset(load, 0, sizeof(GLMtexload));
+    targa_init(&load->targa);
+    load->format = GL_RGBA;
+    if (targa_mapFile(&load->targa, filename))
+        return;
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max_texture_size);
+    load->scale = load->targa.width > gl_max_texture_size ||
+                  load->targa.height > gl_max_texture_size;
+    if (targa_getBgraPixels(&load->targa, &load->data) == 0) {
+        load->format = GL_BGRA;
+    }
+    else if (load->scale) {
+        load->data = load->decode = (GLubyte*)malloc(load->targa.imageLength);
+    }
+    else {
+        glGenBuffers(1, &load->pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, load->pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, load->targa.imageLength, NULL, GL_STREAM_DRAW);
+        load->decode = (GLubyte*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        load->data = NULL; /* offset 0 in the buffer */
+    }
+}
+
+/* glmDecodeTexture: decodes the image of loads[i], if it needs it.  Safe
+ * to run on any thread, and for many textures at once (glmParallel()).
+ *
+ * i    - which texture
+ * data - the GLMtexload array
+ */
+static GLvoid glmDecodeTexture(GLuint i, GLvoid* data){
+    GLMtexload* load = (GLMtexload*)data + i;
+    double start = glmMilliseconds();
+    if (load->decode)
+        targa_decodeInto(&load->targa, load->decode, load->targa.imageLength);
+    load->decodetime = glmMilliseconds() - start;
+}
+
+/* glmFinishTexture: uploads a decoded texture and frees what loading it
+ * took.  Needs the GL context.  Returns the texture's id.
+ *
+ * load - the texture, after glmDecodeTexture()
+ * the rest as for glmLoadTexture()
+ */
+static GLuint glmFinishTexture(GLMtexload* load, GLboolean repeat, GLboolean filtering,
+                               GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight)
 {
     GLuint tex;
     int width, height,pixelsize;
@@ -139,15 +221,13 @@ GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
     GLubyte *data;
     int xSize2, ySize2;
 
-    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl_max_texture_size);
-    char *numefis = filename;
-    while (*numefis==' ') numefis++;
-    Targa t;
-    targa_init(&t);
-    targa_loadFromFile(&t,(char *)numefis);
-    data = t.image;
-    width = t.width;
-    height = t.height;
+    if (load->pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, load->pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    data = load->data;
+    width = load->targa.width;
+    height = load->targa.height;
     type = GL_RGBA;
 
     switch(type) {
@@ -196,27 +276,139 @@ GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (repeat) ? GL_REPEAT : GL_CLAMP);
 
 
-    if(mipmaps)
-        gluBuild2DMipmaps(GL_TEXTURE_2D, type, xSize2, ySize2, type, GL_UNSIGNED_BYTE, data);
-    else
-        glTexImage2D(GL_TEXTURE_2D, 0, type, xSize2, ySize2, 0, type, GL_UNSIGNED_BYTE, data);
+    if(mipmaps && load->scale)
+        gluBuild2DMipmaps(GL_TEXTURE_2D, type, xSize2, ySize2, load->format, GL_UNSIGNED_BYTE, data);
+    else if(load->targa.mapping) {
+        glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, mipmaps ? GL_TRUE : GL_FALSE);
+        glTexImage2D(GL_TEXTURE_2D, 0, type, xSize2, ySize2, 0, load->format, GL_UNSIGNED_BYTE, data);
+    }
 
-    targa_free(&t);
+    if(load->pbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &load->pbo);
+    }
+    else if(load->scale && load->format == GL_RGBA)
+        free(data);
+    targa_free(&load->targa);
     *texcoordwidth = xSize2;		// size of texture coords
     *texcoordheight = ySize2;
     return tex;
 }
 
+GLuint glmLoadTexture(char *filename, GLboolean alpha, GLboolean repeat,
+                      GLboolean filtering, GLboolean mipmaps, GLfloat *texcoordwidth, GLfloat *texcoordheight)
+{
+    GLMtexload load;
+    glmBeginTexture(&load, filename);
+    glmDecodeTexture(0, &load);
+    return glmFinishTexture(&load, repeat, filtering, mipmaps, texcoordwidth, texcoordheight);
+}
 
-/* glmWeldVectors: eliminate (weld) vectors that are within an
- * epsilon of each other.
+
+/* smallest arena block, and how arena allocations are aligned */
+#define GLM_ARENA_BLOCK 1024
+#define GLM_ARENA_ALIGN(n) (((n) + 15) & ~(size_t)15)
+#define GLM_ARENA_DATA(a) ((char*)(a) + GLM_ARENA_ALIGN(sizeof(GLMarena)))
+
+static GLboolean glmArenaOn = GL_TRUE;
+
+/* glmUseArena: turn the arena on or off for models loaded from now on */
+GLvoid glmUseArena(GLboolean use){
+    glmArenaOn = use;
+}
+
+/* glmInArena: is ptr inside one of the model's arena blocks? */
+static GLboolean glmInArena(GLMmodel* model, GLvoid* ptr){
+    GLMarena* arena;
+    for (arena = model->arena; arena; arena = arena->next)
+        if ((char*)ptr >= GLM_ARENA_DATA(arena) &&
+            (char*)ptr < GLM_ARENA_DATA(arena) + arena->size)
+            return GL_TRUE;
+    return GL_FALSE;
+}
+
+/* glmNewBlock: malloc an arena block that can hand out size bytes */
+static GLMarena* glmNewBlock(size_t size){
+    GLMarena* arena;
+    arena = (GLMarena*)malloc(GLM_ARENA_ALIGN(sizeof(GLMarena)) + size);
+    arena->next = NULL;
+    arena->size = size;
+    arena->used = 0;
+    return arena;
+}
+
+/* glmReserve: start a new block unless the current one has size bytes
+ * left.  Whatever is left of the old block is given up.
+ */
+GLvoid glmReserve(GLMmodel* model, size_t size){
+    GLMarena* arena;
+    size = GLM_ARENA_ALIGN(size);
+    if (!glmArenaOn || (model->arena && model->arena->used + size <= model->arena->size))
+        return;
+    arena = glmNewBlock(size > GLM_ARENA_BLOCK ? size : GLM_ARENA_BLOCK);
+    arena->next = model->arena;
+    model->arena = arena;
+}
+
+/* glmAlloc: bump allocate from the model's current block.  Requests
+ * that are large next to the block get a block of their own, linked in
+ * behind the current one so it keeps filling up.
+ */
+GLvoid* glmAlloc(GLMmodel* model, size_t size){
+    GLMarena* arena;
+    char* ptr;
+    if (!glmArenaOn)
+        return malloc(size);
+    size = GLM_ARENA_ALIGN(size);
+    arena = model->arena;
+    if (!arena || arena->used + size > arena->size) {
+        if (arena && size > GLM_ARENA_BLOCK / 4) {
+            arena = glmNewBlock(size);
+            arena->used = size;
+            arena->next = model->arena->next;
+            model->arena->next = arena;
+            return GLM_ARENA_DATA(arena);
+        }
+        glmReserve(model, size);
+        arena = model->arena;
+    }
+    ptr = GLM_ARENA_DATA(arena) + arena->used;
+    arena->used += size;
+    return ptr;
+}
+
+/* glmStrdup: strdup() into the model's arena */
+char* glmStrdup(GLMmodel* model, const char* s){
+    size_t len = strlen(s) + 1;
+    return (char*)memcpy(glmAlloc(model, len), s, len);
+}
+
+/* glmFree: free an array that belongs to a model.  Arrays of a model
+ * loaded from a binary cache point straight into the mapped cache file
+ * and are released along with the mapping instead, and arena memory is
+ * released with the arena.
+ */
+GLvoid glmFree(GLMmodel* model, GLvoid* ptr){
+    if (!ptr)
+        return;
+    if (model->mapping && (char*)ptr >= (char*)model->mapping &&
+        (char*)ptr < (char*)model->mapping + model->mappingsize)
+        return;
+    if (glmInArena(model, ptr))
+        return;
+    free(ptr);
+}
+
+/* glmWeldVectorsBrute: eliminate (weld) vectors that are within an
+ * epsilon of each other by comparing every vector against every copy
+ * kept so far.  Quadratic, kept as the reference for glmWeldVectors().
  *
  * vectors     - array of GLfloat[3]'s to be welded
  * numvectors - number of GLfloat[3]'s in vectors
  * epsilon     - maximum difference between vectors 
  *
  */
-GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
+GLfloat* glmWeldVectorsBrute(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
     GLfloat* copies;
     GLuint   copied;
     GLuint   i, j;
@@ -226,7 +418,7 @@ GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
     
     copied = 1;
     for (i = 1; i <= *numvectors; i++) {
-        for (j = 1; j <= copied; j++) {
+        for (j = 1; j < copied; j++) {
             if (glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
                 goto duplicate;
             }
@@ -249,6 +441,130 @@ GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
     return copies;
 }
 
+/* GLMweldcell: one occupied cell of the welding grid */
+typedef struct _GLMweldcell {
+    GLint  x, y, z;               /* cell coordinates */
+    GLuint first;                 /* first copy in the cell (0 = empty slot) */
+    GLuint last;                  /* last copy in the cell */
+} GLMweldcell;
+
+/* glmWeldCoord: grid coordinate of a vector component.  Far away
+ * components are clamped, which only makes their cells more crowded.
+ */
+static inline GLint glmWeldCoord(double v, double scale){
+    double c = floor(v * scale);
+    if (!(c > -1e9))
+        return -1000000000;
+    if (c > 1e9)
+        return 1000000000;
+    return (GLint)c;
+}
+
+/* glmWeldSlot: find the slot of a cell in the grid, or the empty slot
+ * it would go into.
+ */
+static inline GLuint glmWeldSlot(GLMweldcell* cells, GLuint mask, GLint x, GLint y, GLint z){
+    GLuint slot;
+    slot = ((GLuint)x * 73856093u ^ (GLuint)y * 19349663u ^ (GLuint)z * 83492791u);
+    slot = (slot ^ (slot >> 15)) & mask;
+    while (cells[slot].first &&
+           (cells[slot].x != x || cells[slot].y != y || cells[slot].z != z))
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/* glmWeldVectors: eliminate (weld) vectors that are within an
+ * epsilon of each other.  Each vector is replaced by the first copy
+ * kept so far that is within epsilon, exactly like
+ * glmWeldVectorsBrute(), but the copies are bucketed in a hashed grid
+ * so only the cells the epsilon box around a vector overlaps (usually
+ * eight) need to be searched.
+ *
+ * vectors     - array of GLfloat[3]'s to be welded
+ * numvectors - number of GLfloat[3]'s in vectors
+ * epsilon     - maximum difference between vectors 
+ *
+ */
+GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon){
+    GLMweldcell* cells;
+    GLfloat* copies;
+    GLuint*  next;
+    GLuint   copied, mask, slot, found;
+    GLuint   i, j;
+    GLint    lo[3], hi[3], x, y, z;
+    double   scale;
+    
+    /* nothing is ever within a non-positive epsilon */
+    if (!(epsilon > 0))
+        return glmWeldVectorsBrute(vectors, numvectors, epsilon);
+    
+    copies = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (*numvectors + 1));
+    memcpy(copies, vectors, (sizeof(GLfloat) * 3 * (*numvectors + 1)));
+    next = (GLuint*)malloc(sizeof(GLuint) * (*numvectors + 1));
+    
+    /* keep the grid at most half full */
+    for (mask = 1023; mask < *numvectors * 2; mask = mask * 2 + 1)
+        ;
+    cells = (GLMweldcell*)calloc(mask + 1, sizeof(GLMweldcell));
+    scale = 1.0 / (2.0 * epsilon);
+    
+    copied = 1;
+    for (i = 1; i <= *numvectors; i++) {
+        /* range of cells that can hold a copy within epsilon */
+        for (j = 0; j < 3; j++) {
+            lo[j] = glmWeldCoord((double)vectors[3 * i + j] - epsilon, scale);
+            hi[j] = glmWeldCoord((double)vectors[3 * i + j] + epsilon, scale);
+        }
+        
+        /* the lowest numbered copy within epsilon wins; copies within a
+        cell are in increasing order so the first match is the lowest */
+        found = 0;
+        for (x = lo[0]; x <= hi[0]; x++)
+            for (y = lo[1]; y <= hi[1]; y++)
+                for (z = lo[2]; z <= hi[2]; z++) {
+                    slot = glmWeldSlot(cells, mask, x, y, z);
+                    for (j = cells[slot].first; j && (!found || j < found); j = next[j]) {
+                        if (glmEqual(&vectors[3 * i], &copies[3 * j], epsilon)) {
+                            found = j;
+                            break;
+                        }
+                    }
+                }
+        
+        if (!found) {
+            /* must not be any duplicates -- add to the copies array */
+            copies[3 * copied + 0] = vectors[3 * i + 0];
+            copies[3 * copied + 1] = vectors[3 * i + 1];
+            copies[3 * copied + 2] = vectors[3 * i + 2];
+            next[copied] = 0;
+            x = glmWeldCoord(vectors[3 * i + 0], scale);
+            y = glmWeldCoord(vectors[3 * i + 1], scale);
+            z = glmWeldCoord(vectors[3 * i + 2], scale);
+            slot = glmWeldSlot(cells, mask, x, y, z);
+            if (cells[slot].first)
+                next[cells[slot].last] = copied;
+            else {
+                cells[slot].x = x;
+                cells[slot].y = y;
+                cells[slot].z = z;
+                cells[slot].first = copied;
+            }
+            cells[slot].last = copied;
+            found = copied;
+            copied++;
+        }
+        
+        /* set the first component of this vector to point at the correct
+        index into the new copies array */
+        vectors[3 * i + 0] = (GLfloat)found;
+    }
+    
+    free(cells);
+    free(next);
+    *numvectors = copied-1;
+    return copies;
+}
+
 /* glmFindGroup: Find a group in the model */
 GLMgroup* glmFindGroup(GLMmodel* model, char* name){
     GLMgroup* group;
@@ -262,21 +578,27 @@ GLMgroup* glmFindGroup(GLMmodel* model, char* name){
     return group;
 }
 
+/* glmNewGroup: Add a group that isn't in the model yet */
+static GLMgroup* glmNewGroup(GLMmodel* model, char* name){
+    GLMgroup* group;
+    group = (GLMgroup*)glmAlloc(model, sizeof(GLMgroup));
+    group->name = glmStrdup(model, name);
+    group->material = 0;
+    group->numtriangles = 0;
+    group->triangles = NULL;
+    group->next = model->groups;
+    model->groups = group;
+    model->numgroups++;
+    return group;
+}
+
 /* glmAddGroup: Add a group to the model */
 GLMgroup* glmAddGroup(GLMmodel* model, char* name){
     GLMgroup* group;
     
     group = glmFindGroup(model, name);
-    if (!group) {
-        group = (GLMgroup*)malloc(sizeof(GLMgroup));
-        group->name = strdup(name);
-        group->material = 0;
-        group->numtriangles = 0;
-        group->triangles = NULL;
-        group->next = model->groups;
-        model->groups = group;
-        model->numgroups++;
-    }
+    if (!group)
+        group = glmNewGroup(model, name);
     
     return group;
 }
@@ -300,6 +622,106 @@ GLuint glmFindMaterial(GLMmodel* model, char* name){
     found:
     return i;
 }
+
+/* GLMname: one slot of a name table */
+typedef struct _GLMname {
+    const char* name;             /* the name, NULL if the slot is empty */
+    GLuint      hash;             /* glmHashName() of the name */
+    GLuint      value;            /* what the name maps to */
+} GLMname;
+
+/* GLMnames: an open addressing hash table from names to indices that
+ * the loader finds groups, materials and textures in, instead of
+ * comparing against every one of them
+ */
+typedef struct _GLMnames {
+    GLuint   mask;                /* number of slots - 1 */
+    GLuint   count;               /* number of names in the table */
+    GLMname* slots;
+} GLMnames;
+
+static GLboolean glmHashOn = GL_TRUE;
+
+/* glmUseHashedNames: turn the loader's name tables on or off */
+GLvoid glmUseHashedNames(GLboolean use){
+    glmHashOn = use;
+}
+
+/* glmHashName: FNV-1a hash of the first length chars of name */
+static inline GLuint glmHashName(const char* name, size_t length){
+    GLuint hash;
+    size_t i;
+    hash = 2166136261u;
+    for (i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char)name[i]) * 16777619u;
+    return hash;
+}
+
+/* glmNameSlot: find the slot of a name in the table, or the empty slot
+ * it would go into
+ */
+static inline GLuint glmNameSlot(GLMnames* names, const char* name, size_t length, GLuint hash){
+    GLuint slot;
+    GLMname* entry;
+    slot = hash & names->mask;
+    for (;;) {
+        entry = &names->slots[slot];
+        if (!entry->name)
+            break;
+        if (entry->hash == hash && !strncmp(entry->name, name, length) && !entry->name[length])
+            break;
+        slot = (slot + 1) & names->mask;
+    }
+    return slot;
+}
+
+/* glmFindName: the value name maps to in the table, or NULL */
+static GLuint* glmFindName(GLMnames* names, const char* name, size_t length){
+    GLMname* entry;
+    if (!names->count)
+        return NULL;
+    entry = &names->slots[glmNameSlot(names, name, length, glmHashName(name, length))];
+    return entry->name ? &entry->value : NULL;
+}
+
+/* glmAddName: map name to value, unless the name is already in the
+ * table.  The table keeps the name pointer, so it must outlive it.
+ */
+static GLvoid glmAddName(GLMnames* names, const char* name, size_t length, GLuint value){
+    GLMname* old;
+    GLuint   oldsize, hash, slot, i;
+    if (2 * (names->count + 1) > names->mask + 1 || !names->slots) {
+        /* keep the table at most half full */
+        old = names->slots;
+        oldsize = names->slots ? names->mask + 1 : 0;
+        names->mask = oldsize ? 2 * oldsize - 1 : 63;
+        names->slots = (GLMname*)calloc(names->mask + 1, sizeof(GLMname));
+        for (i = 0; i < oldsize; i++) {
+            if (!old[i].name)
+                continue;
+            slot = old[i].hash & names->mask;
+            while (names->slots[slot].name)
+                slot = (slot + 1) & names->mask;
+            names->slots[slot] = old[i];
+        }
+        free(old);
+    }
+    hash = glmHashName(name, length);
+    slot = glmNameSlot(names, name, length, hash);
+    if (names->slots[slot].name)
+        return;
+    names->slots[slot].name  = name;
+    names->slots[slot].hash  = hash;
+    names->slots[slot].value = value;
+    names->count++;
+}
+
+/* glmDeleteNames: empty a name table */
+static GLvoid glmDeleteNames(GLMnames* names){
+    free(names->slots);
+    memset(names, 0, sizeof(GLMnames));
+}
+
 /* glmDirName: return the directory given a path
  *
  * path - filesystem path
@@ -316,62 +738,143 @@ static char* glmDirName(char* path){
     return dir;
 }
 
-int glmFindOrAddTexture(GLMmodel* model, char* name,mycallback *call){
+/* glmAddTexture: glmFindOrAddTexture(), looking the name up in textures
+ * if it is not NULL.  Names are compared without the blanks around
+ * them, so materials that refer to the same file on lines that end
+ * differently share one texture and it is only loaded once.
+ */
+static int glmAddTexture(GLMmodel* model, char* name, GLMnames* textures){
     GLuint i;
-    char *dir, *filename;
-    float width, height;
+    GLuint* found;
+    size_t length;
     char *numefis = name;
-    while (*numefis==' ') numefis++;
-    for (i = 0; i < model->numtextures; i++) {
-        if (!strcmp(model->textures[i].name, numefis))
-            return i;
-    }
-    char afis[80];
-    sprintf(afis,"Loading Textures (%s )...",name);
-    if (call) {
-        int procent = ((float)((float)model->numtextures*30/total_textures)/100)*(call->end-call->start)+call->start;
-        call->loadcallback(procent,afis); // textures represent 30% from the model (just saying :))
-    }
-    if (strstr(name,":\\")) {
-        filename = (char*)malloc(sizeof(char) * (strlen(name) + 1));
-        strcpy(filename,name);
+    while (isspace((unsigned char)*numefis)) numefis++;
+    length = strlen(numefis);
+    while (length && isspace((unsigned char)numefis[length-1])) length--;
+    if (textures && glmHashOn) {
+        found = glmFindName(textures, numefis, length);
+        if (found)
+            return *found;
     }
     else {
-        dir = glmDirName(model->pathname);
-        filename = (char*)malloc(sizeof(char) * (strlen(dir) + strlen(numefis) + 1));
-        strcpy(filename, dir);
-        //strcpy(filename, numefis);
-        strcat(filename, numefis);
-        free(dir);
-    }
-    int lung = strlen(filename);
-    if (filename[lung-1]<32) filename[lung-1]=0;
-    if (filename[lung-2]<32) filename[lung-2]=0;
+        for (i = 0; i < model->numtextures; i++) {
+            if (!strncmp(model->textures[i].name, numefis, length) &&
+                !model->textures[i].name[length])
+                return i;
+        }
+    }
+    /* only remember it: glmLoadTextures() makes the GL texture, on the
+    thread with the context */
     model->numtextures++;
     model->textures = (GLMtexture*)realloc(model->textures, sizeof(GLMtexture)*model->numtextures);
-    model->textures[model->numtextures-1].name = strdup(numefis);
-    model->textures[model->numtextures-1].id = glmLoadTexture(filename, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE, &width, &height);
-    model->textures[model->numtextures-1].width = width;
-    model->textures[model->numtextures-1].height = height;
-    free(filename);
+    model->textures[model->numtextures-1].name = (char*)glmAlloc(model, length + 1);
+    memcpy(model->textures[model->numtextures-1].name, numefis, length);
+    model->textures[model->numtextures-1].name[length] = '\0';
+    model->textures[model->numtextures-1].id = 0;
+    model->textures[model->numtextures-1].width = 0;
+    model->textures[model->numtextures-1].height = 0;
+    if (textures && glmHashOn)
+        glmAddName(textures, model->textures[model->numtextures-1].name, length,
+                   model->numtextures-1);
     return model->numtextures-1;
 }
 
+int glmFindOrAddTexture(GLMmodel* model, char* name){
+    return glmAddTexture(model, name, NULL);
+}
+
+/* glmLoadTextures: Loads the textures of a model that haven't been
+ * loaded yet into the current OpenGL context.  The files are mapped and
+ * the textures uploaded on this thread, the images decoded all at once
+ * by glmParallel(), and how long each took is printed.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid glmLoadTextures(GLMmodel* model, mycallback *call){
+    GLuint i, n;
+    GLuint* which;
+    GLMtexload* loads;
+    char *dir, *filename, *name;
+    float width, height;
+    char afis[80];
+    double start, upload;
+
+    which = (GLuint*)malloc(sizeof(GLuint) * (model->numtextures + 1));
+    n = 0;
+    for (i = 0; i < model->numtextures; i++)
+        if (!model->textures[i].id)
+            which[n++] = i;
+    if (!n) {
+        free(which);
+        return;
+    }
+    loads = (GLMtexload*)malloc(sizeof(GLMtexload) * n);
+
+    for (i = 0; i < n; i++) {
+        name = model->textures[which[i]].name;
+        sprintf(afis,"Loading Textures (%s )...",name);
+        if (call) {
+            int procent = ((float)((float)i*30/total_textures)/100)*(call->end-call->start)+call->start;
+            call->loadcallback(procent,afis); // textures represent 30% from the model (just saying :))
+        }
+        if (strstr(name,":\\")) {
+            filename = (char*)malloc(sizeof(char) * (strlen(name) + 1));
+            strcpy(filename,name);
+        }
+        else {
+            dir = glmDirName(model->pathname);
+            filename = (char*)malloc(sizeof(char) * (strlen(dir) + strlen(name) + 1));
+            strcpy(filename, dir);
+            strcat(filename, name);
+            free(dir);
+        }
+        int lung = strlen(filename);
+        if (filename[lung-1]<32) filename[lung-1]=0;
+        if (filename[lung-2]<32) filename[lung-2]=0;
+        glmBeginTexture(&loads[i], filename);
+        free(filename);
+    }
+
+    start = glmMilliseconds();
+    glmParallel(n, glmDecodeTexture, loads);
+    printf("glmLoadTextures(): decoded %u textures in %.1f ms\n", n, glmMilliseconds() - start);
+
+    for (i = 0; i < n; i++) {
+        start = glmMilliseconds();
+        model->textures[which[i]].id = glmFinishTexture(&loads[i], GL_TRUE, GL_TRUE, GL_TRUE, &width, &height);
+        upload = glmMilliseconds() - start;
+        model->textures[which[i]].width = width;
+        model->textures[which[i]].height = height;
+        printf("  %s: %.0fx%.0f, decode %.1f ms, upload %.1f ms\n", model->textures[which[i]].name,
+               width, height, loads[i].decodetime, upload);
+    }
+    free(loads);
+    free(which);
+}
+
 
 
 
 /* glmReadMTL: read a wavefront material library file
  *
- * model - properly initialized GLMmodel structure
- * name  - name of the material library
+ * model     - properly initialized GLMmodel structure
+ * name      - name of the material library
+ * call      - progress callback (or NULL)
+ * materials - table to put the material names in
+ * textures  - table the texture names are looked up and put in
  */
-static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
+static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call,
+                         GLMnames* materials, GLMnames* textures){
     FILE* file;
     char* dir;
     char* filename;
     char* texture;
     char    buf[1024];
     GLuint nummaterials, i;
+    if (call) {
+        snprintf(buf, sizeof(buf), "Reading Materials (%s )...", name);
+        call->loadcallback(call->start, buf);
+    }
     dir = glmDirName(model->pathname);
     filename = (char*)malloc(sizeof(char) * (strlen(dir) + strlen(name) + 1));
     strcpy(filename, dir);
@@ -404,7 +907,7 @@ static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
         }
     }
     rewind(file);
-    model->materials = (GLMmaterial*)malloc(sizeof(GLMmaterial) * nummaterials);
+    model->materials = (GLMmaterial*)glmAlloc(model, sizeof(GLMmaterial) * nummaterials);
     model->nummaterials = nummaterials;
     /* set the default material */
     for (i = 0; i < nummaterials; i++) {
@@ -424,7 +927,9 @@ static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
         model->materials[i].specular[3] = 1.0;
         model->materials[i].textureid = -1;
     }
-    model->materials[0].name = strdup("default");
+    model->materials[0].name = glmStrdup(model, "default");
+    glmDeleteNames(materials);
+    glmAddName(materials, model->materials[0].name, strlen(model->materials[0].name), 0);
     /* now, read in the data */
     nummaterials = 0;
     while(fscanf(file, "%s", buf) != EOF) {
@@ -437,7 +942,8 @@ static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
             fgets(buf, sizeof(buf), file);
             sscanf(buf, "%s %s", buf, buf);
             nummaterials++;
-            model->materials[nummaterials].name = strdup(buf);
+            model->materials[nummaterials].name = glmStrdup(model, buf);
+            glmAddName(materials, model->materials[nummaterials].name, strlen(buf), nummaterials);
             break;
         case 'N':
             if (buf[1]!='s') break; // 3DS pune 'i' aici pentru indici de refractie si se incurca
@@ -480,7 +986,7 @@ static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
             free(filename);
             if(strncmp(buf, "map_Kd", 6) == 0) 
             {
-                model->materials[nummaterials].textureid = glmFindOrAddTexture(model, texture, call);
+                model->materials[nummaterials].textureid = glmAddTexture(model, texture, textures);
                 free(texture);
             }
             else {
@@ -495,6 +1001,7 @@ static GLvoid glmReadMTL(GLMmodel* model, char* name, mycallback *call){
             break;
         }
     }
+    fclose(file);
 }
 
 /* glmWriteMTL: write a wavefront material library file
@@ -546,335 +1053,994 @@ static GLvoid glmWriteMTL(GLMmodel* model, char* modelpath, char* mtllibname){
 }
 
 
-/* glmFirstPass: first pass at a Wavefront OBJ file that gets all the
- * statistics of the model (such as #vertices, #normals, etc)
+/* glmNumThreads: number of threads the parallel paths use by default:
+ * one per online processor, unless overridden with $GLM_THREADS.
+ */
+GLuint glmNumThreads(){
+    static GLuint threads = 0;
+    char* env;
+    long n;
+    if (!threads) {
+        env = getenv("GLM_THREADS");
+        n = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? (GLuint)n : 1;
+    }
+    return threads;
+}
+
+/* _GLMjob: a glmParallel() call being worked on */
+typedef struct _GLMjob {
+    GLuint   count;               /* number of items */
+    GLuint   next;                /* next item to hand out */
+    GLvoid (*func)(GLuint, GLvoid*);
+    GLvoid*  data;
+} GLMjob;
+
+static void* glmParallelWorker(void* arg){
+    GLMjob* job = (GLMjob*)arg;
+    GLuint i;
+    while ((i = __sync_fetch_and_add(&job->next, 1)) < job->count)
+        job->func(i, job->data);
+    return NULL;
+}
+
+/* glmParallel: calls func(i, data) for every i in [0, count) on up to
+ * glmNumThreads() threads (the calling thread included) and returns
+ * once all of them are done.  Items are handed out one at a time, so
+ * uneven items balance out.
+ */
+GLvoid glmParallel(GLuint count, GLvoid (*func)(GLuint, GLvoid*), GLvoid* data){
+    GLMjob    job;
+    pthread_t* threads;
+    GLuint    numthreads, started, i;
+    job.count = count;
+    job.next  = 0;
+    job.func  = func;
+    job.data  = data;
+    numthreads = glmNumThreads();
+    if (numthreads > count)
+        numthreads = count;
+    if (numthreads <= 1) {
+        glmParallelWorker(&job);
+        return;
+    }
+    threads = (pthread_t*)malloc(sizeof(pthread_t) * numthreads);
+    for (started = 0; started < numthreads - 1; started++)
+        if (pthread_create(&threads[started], NULL, glmParallelWorker, &job))
+            break;
+    glmParallelWorker(&job);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+}
+
+/* glmMapFile: map a whole file read-only into memory.  Returns NULL if
+ * the file can't be opened.  An empty file maps to an empty string.
  *
- * model - properly initialized GLMmodel structure
- * file  - (fopen'd) file descriptor 
+ * filename - name of the file to map
+ * size     - will contain the length of the mapping on return
  */
-static GLvoid glmFirstPass(GLMmodel* model, FILE* file, mycallback *call) {
-    GLuint  numvertices;        /* number of vertices in model */
-    GLuint  numnormals;         /* number of normals in model */
-    GLuint  numtexcoords;       /* number of texcoords in model */
-    GLuint  numtriangles;       /* number of triangles in model */
-    GLMgroup* group;            /* current group */
-    unsigned    v, n, t;
-    char        buf[128];
-    /* make a default group */
-    group = glmAddGroup(model, "default");
-    numvertices = numnormals = numtexcoords = numtriangles = 0;
-    while(fscanf(file, "%s", buf) != EOF) {
-        switch(buf[0]) {
+static char* glmMapFile(char* filename, size_t* size){
+    struct stat st;
+    char* data;
+    int fd;
+    *size = 0;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return (char*)"";
+    }
+    data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    /* we only ever walk the file front to back */
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    *size = st.st_size;
+    return data;
+}
+
+/* glmUnmapFile: release a mapping made by glmMapFile */
+static GLvoid glmUnmapFile(char* data, size_t size){
+    if (size)
+        munmap(data, size);
+}
+
+/* glmIsBlank: true for the characters that separate tokens on a line */
+static inline GLboolean glmIsBlank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* glmSkipBlanks: skip blanks, but stop at the end of the line */
+static inline const char* glmSkipBlanks(const char* p, const char* end){
+    while (p < end && glmIsBlank(*p))
+        p++;
+    return p;
+}
+
+/* glmSkipLine: skip to the first character of the next line */
+static inline const char* glmSkipLine(const char* p, const char* end){
+    p = (const char*)memchr(p, '\n', end - p);
+    return p ? p + 1 : end;
+}
+
+/* glmSkipToken: skip a run of non-blank characters on the current line */
+static inline const char* glmSkipToken(const char* p, const char* end){
+    while (p < end && !glmIsBlank(*p) && *p != '\n')
+        p++;
+    return p;
+}
+
+/* exact powers of ten, used to scale the parsed mantissa */
+static const double glmPow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* glmDecimal: the float nearest mantissa * 10^exponent, worked out the
+ * way glmParseFloat() does it (glmFormatFloat() relies on that)
+ */
+static inline GLfloat glmDecimal(unsigned long long mantissa, int exponent){
+    double value = (double)mantissa;
+    if (mantissa == 0)
+        ;
+    else if (exponent < 0 && exponent >= -22)
+        value /= glmPow10[-exponent];
+    else if (exponent > 0 && exponent <= 22)
+        value *= glmPow10[exponent];
+    else if (exponent)
+        value *= pow(10.0, exponent);
+    return (GLfloat)value;
+}
+
+/* glmParseFloat: parse a decimal floating point number.  Returns a
+ * pointer just past the number.  Anything unusual (nan, inf, hex) is
+ * handed off to strtod.
+ *
+ * p   - start of the text (leading blanks are skipped)
+ * end - end of the text
+ * f   - will contain the parsed value on return
+ */
+static const char* glmParseFloat(const char* p, const char* end, GLfloat* f){
+    const char* start;
+    unsigned long long mantissa;
+    int digits, exponent, e, negative, esign, any;
+    GLfloat value;
+    char buf[64];
+    p = glmSkipBlanks(p, end);
+    start = p;
+    mantissa = 0;
+    digits = exponent = negative = any = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    /* integer part; digits that don't fit in the mantissa only move
+       the exponent */
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (digits < 18) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+        }
+        any = 1;
+        p++;
+    }
+    /* fractional part */
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 18) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+            any = 1;
+            p++;
+        }
+    }
+    if (!any) {
+        /* not a plain decimal number, let the C library sort it out */
+        p = glmSkipToken(start, end);
+        e = p - start < (int)sizeof(buf) ? p - start : (int)sizeof(buf) - 1;
+        memcpy(buf, start, e);
+        buf[e] = '\0';
+        *f = (GLfloat)strtod(buf, NULL);
+        return p;
+    }
+    /* exponent */
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* mark = p;
+        p++;
+        esign = 1;
+        if (p < end && (*p == '-' || *p == '+')) {
+            if (*p == '-') esign = -1;
+            p++;
+        }
+        if (p < end && *p >= '0' && *p <= '9') {
+            e = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                if (e < 10000) e = e * 10 + (*p - '0');
+                p++;
+            }
+            exponent += esign * e;
+        } else {
+            p = mark;
+        }
+    }
+    value = glmDecimal(mantissa, exponent);
+    *f = negative ? -value : value;
+    return p;
+}
+
+/* glmParseInt: parse a (possibly signed) decimal integer.  Returns a
+ * pointer just past the number, or p itself if there was no number.
+ *
+ * p   - start of the text (must not point at a blank)
+ * end - end of the text
+ * i   - will contain the parsed value on return
+ */
+static inline const char* glmParseInt(const char* p, const char* end, GLint* i){
+    const char* start = p;
+    GLint value = 0;
+    int negative = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p >= end || *p < '0' || *p > '9')
+        return start;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    *i = negative ? -value : value;
+    return p;
+}
+
+/* glmParseFaceVertex: parse one v, v/t, v//n or v/t/n face vertex.
+ * Missing indices are left at 0.  Returns p itself if there was no
+ * vertex to parse.
+ */
+static inline const char* glmParseFaceVertex(const char* p, const char* end,
+                                             GLuint* v, GLuint* t, GLuint* n){
+    const char* q;
+    GLint i;
+    *v = *t = *n = 0;
+    q = glmParseInt(p, end, &i);
+    if (q == p)
+        return p;
+    *v = (GLuint)i;
+    if (q < end && *q == '/') {
+        q++;
+        if (q < end && *q != '/') {
+            q = glmParseInt(q, end, &i);
+            *t = (GLuint)i;
+        }
+        if (q < end && *q == '/') {
+            q++;
+            q = glmParseInt(q, end, &i);
+            *n = (GLuint)i;
+        }
+    }
+    return q;
+}
+
+/* glmGrow: make sure an array has room for at least count elements,
+ * doubling its capacity when it doesn't.
+ */
+static GLvoid* glmGrow(GLvoid* array, GLuint* capacity, GLuint count, size_t size){
+    if (count <= *capacity)
+        return array;
+    while (*capacity < count)
+        *capacity = *capacity ? *capacity * 2 : 1024;
+    return realloc(array, size * *capacity);
+}
+
+/* glmReadWord: copy the first whitespace delimited word of the rest of
+ * the line into buf.
+ */
+static const char* glmReadWord(const char* p, const char* end, char* buf, size_t size){
+    const char* q;
+    size_t len;
+    p = glmSkipBlanks(p, end);
+    q = glmSkipToken(p, end);
+    len = (size_t)(q - p);
+    if (len >= size) len = size - 1;
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    return q;
+}
+
+/* _GLMrecord: a mtllib, usemtl or g line, remembered so the pieces of a
+ * file parsed in parallel can be stitched back together in order */
+typedef struct _GLMrecord {
+    char    type;                 /* 'm', 'u' or 'g' */
+    GLuint  triangle;             /* triangles in the chunk before this line */
+    char*   name;                 /* argument of the line */
+} GLMrecord;
+
+/* _GLMchunk: everything read from one piece of an OBJ file.  The
+ * arrays are 1-based like the ones in GLMmodel. */
+typedef struct _GLMchunk {
+    const char*  begin;           /* first byte of this piece */
+    const char*  end;             /* one past the last byte of this piece */
+    const char*  data;            /* start of the whole file (for progress) */
+    size_t       size;            /* length of the whole file */
+    mycallback*  call;            /* progress callback, or NULL */
+
+    GLuint       numvertices, maxvertices;
+    GLfloat*     vertices;
+    GLuint       numnormals, maxnormals;
+    GLfloat*     normals;
+    GLuint       numtexcoords, maxtexcoords;
+    GLfloat*     texcoords;
+    GLuint       numtriangles, maxtriangles;
+    GLMtriangle* triangles;
+    GLuint       numrecords, maxrecords;
+    GLMrecord*   records;
+
+    /* where this chunk's data goes in the model, set when stitching */
+    GLuint       firstvertex, firstnormal, firsttexcoord, firsttriangle;
+    GLMmodel*    model;
+} GLMchunk;
+
+/* glmAddRecord: remember a mtllib, usemtl or g line in a chunk */
+static GLvoid glmAddRecord(GLMchunk* chunk, char type, const char* name){
+    GLMrecord* record;
+    chunk->records = (GLMrecord*)glmGrow(chunk->records, &chunk->maxrecords,
+                                         chunk->numrecords + 1, sizeof(GLMrecord));
+    record = &chunk->records[chunk->numrecords++];
+    record->type = type;
+    record->triangle = chunk->numtriangles;
+    record->name = strdup(name);
+}
+
+/* glmParseChunk: single pass through a piece of a mapped Wavefront OBJ
+ * file that reads all the data into the chunk, growing its arrays as it
+ * goes.  The piece must start and end on a line boundary.
+ *
+ * chunk - chunk with begin/end set and everything else zeroed
+ */
+static GLvoid glmParseChunk(GLMchunk* chunk) {
+    GLuint  v, n, t, v0, n0, t0, vp, np, tp, corners;
+    GLMtriangle* triangle;
+    const char* p;
+    const char* end;
+    const char* tok;
+    const char* q;
+    const char* report;
+    size_t  len;
+    char        buf[1024];
+    char        afis[256];
+
+    p = chunk->begin;
+    end = chunk->end;
+    report = p;
+    while (p < end) {
+        /* skip blank space, including empty lines */
+        while (p < end && (glmIsBlank(*p) || *p == '\n'))
+            p++;
+        if (p >= end)
+            break;
+        if (chunk->call && p - report >= (1 << 22)) {
+            report = p;
+            sprintf(afis, "%s... ", chunk->call->text ? chunk->call->text : "Loading");
+            int procent = ((float)((float)(p - chunk->data)*70/chunk->size+30)/100)*(chunk->call->end-chunk->call->start)+chunk->call->start;
+            chunk->call->loadcallback(procent, afis); // Modelul e 70% din incarcare
+        }
+        tok = p;
+        p = glmSkipToken(p, end);
+        switch(tok[0]) {
         case '#':               /* comment */
-            /* eat up rest of line */
-            fgets(buf, sizeof(buf), file);
             break;
         case 'v':               /* v, vn, vt */
-            switch(buf[1]) {
+            switch(p - tok > 1 ? tok[1] : '\0') {
             case '\0':          /* vertex */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numvertices++;
+                v = ++chunk->numvertices;
+                chunk->vertices = (GLfloat*)glmGrow(chunk->vertices, &chunk->maxvertices,
+                                                    v + 1, 3 * sizeof(GLfloat));
+                p = glmParseFloat(p, end, &chunk->vertices[3 * v + 0]);
+                p = glmParseFloat(p, end, &chunk->vertices[3 * v + 1]);
+                p = glmParseFloat(p, end, &chunk->vertices[3 * v + 2]);
                 break;
             case 'n':           /* normal */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numnormals++;
+                n = ++chunk->numnormals;
+                chunk->normals = (GLfloat*)glmGrow(chunk->normals, &chunk->maxnormals,
+                                                   n + 1, 3 * sizeof(GLfloat));
+                p = glmParseFloat(p, end, &chunk->normals[3 * n + 0]);
+                p = glmParseFloat(p, end, &chunk->normals[3 * n + 1]);
+                p = glmParseFloat(p, end, &chunk->normals[3 * n + 2]);
                 break;
             case 't':           /* texcoord */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                numtexcoords++;
+                t = ++chunk->numtexcoords;
+                chunk->texcoords = (GLfloat*)glmGrow(chunk->texcoords, &chunk->maxtexcoords,
+                                                     t + 1, 2 * sizeof(GLfloat));
+                p = glmParseFloat(p, end, &chunk->texcoords[2 * t + 0]);
+                p = glmParseFloat(p, end, &chunk->texcoords[2 * t + 1]);
                 break;
             default:
-                printf("glmFirstPass(): Unknown token \"%s\".\n", buf);
+                glmReadWord(tok, p, buf, 128);
+                printf("glmReadOBJ(): Unknown token \"%s\".\n", buf);
                 exit(1);
                 break;
             }
             break;
-            case 'm': //mtllib
-                fgets(buf, sizeof(buf), file);
-                sscanf(buf, "%s %s", buf, buf);
-                model->mtllibname = strdup(buf);
-                glmReadMTL(model, buf, call);
-                break;
-            case 'u': //usemtl
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                break;
-            case 'g':               /* group */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
+        case 'm':               /* mtllib */
+            p = glmReadWord(p, end, buf, sizeof(buf));
+            glmAddRecord(chunk, 'm', buf);
+            break;
+        case 'u':               /* usemtl */
+            p = glmReadWord(p, end, buf, sizeof(buf));
+            glmAddRecord(chunk, 'u', buf);
+            break;
+        case 'g':               /* group */
+            /* the rest of the line is the group name */
+            q = (const char*)memchr(p, '\n', end - p);
+            if (!q) q = end;
 #if SINGLE_STRING_GROUP_NAMES
-                sscanf(buf, "%s", buf);
+            glmReadWord(p, q, buf, sizeof(buf));
 #else
-                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
+            len = (size_t)(q - p);
+            if (len >= sizeof(buf)) len = sizeof(buf) - 1;
+            memcpy(buf, p, len);
+            buf[len] = '\0';
 #endif
-                group = glmAddGroup(model, buf);
-                break;
-            case 'f':               /* face */
-                v = n = t = 0;
-                fscanf(file, "%s", buf);
-                /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-                if (strstr(buf, "//")) {
-                    /* v//n */
-                    sscanf(buf, "%d//%d", &v, &n);
-                    fscanf(file, "%d//%d", &v, &n);
-                    fscanf(file, "%d//%d", &v, &n);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d//%d", &v, &n) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
-                } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
-                    /* v/t/n */
-                    fscanf(file, "%d/%d/%d", &v, &t, &n);
-                    fscanf(file, "%d/%d/%d", &v, &t, &n);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
-                } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
-                    /* v/t */
-                    fscanf(file, "%d/%d", &v, &t);
-                    fscanf(file, "%d/%d", &v, &t);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d/%d", &v, &t) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
-                } else {
-                    /* v */
-                    fscanf(file, "%d", &v);
-                    fscanf(file, "%d", &v);
-                    numtriangles++;
-                    group->numtriangles++;
-                    while(fscanf(file, "%d", &v) > 0) {
-                        numtriangles++;
-                        group->numtriangles++;
-                    }
+            p = q;
+            glmAddRecord(chunk, 'g', buf);
+            break;
+        case 'f':               /* face */
+            /* can be one of %d, %d//%d, %d/%d, %d/%d/%d; anything past
+               the third vertex is triangulated as a fan */
+            corners = 0;
+            v0 = t0 = n0 = vp = tp = np = 0;
+            for (;;) {
+                p = glmSkipBlanks(p, end);
+                q = glmParseFaceVertex(p, end, &v, &t, &n);
+                if (q == p)
+                    break;
+                p = q;
+                if (corners == 0) {
+                    v0 = v; t0 = t; n0 = n;
+                } else if (corners >= 2) {
+                    chunk->triangles = (GLMtriangle*)glmGrow(chunk->triangles, &chunk->maxtriangles,
+                                                             chunk->numtriangles + 1, sizeof(GLMtriangle));
+                    triangle = &chunk->triangles[chunk->numtriangles++];
+                    memset(triangle, 0, sizeof(GLMtriangle));
+                    triangle->vindices[0] = v0;
+                    triangle->tindices[0] = t0;
+                    triangle->nindices[0] = n0;
+                    triangle->vindices[1] = vp;
+                    triangle->tindices[1] = tp;
+                    triangle->nindices[1] = np;
+                    triangle->vindices[2] = v;
+                    triangle->tindices[2] = t;
+                    triangle->nindices[2] = n;
                 }
-                break;
-                
-            default:
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-                break;
+                vp = v; tp = t; np = n;
+                corners++;
             }
-
+            break;
+        default:
+            break;
+        }
+        p = glmSkipLine(p, end);
     }
+}
+
+/* glmParseChunkWorker: glmParallel() body that parses chunk i */
+static GLvoid glmParseChunkWorker(GLuint i, GLvoid* data){
+    glmParseChunk(&((GLMchunk*)data)[i]);
+}
 
-    /* set the stats in the model structure */
+/* glmCopyChunkWorker: glmParallel() body that copies chunk i into its
+ * place in the model */
+static GLvoid glmCopyChunkWorker(GLuint i, GLvoid* data){
+    GLMchunk* chunk = &((GLMchunk*)data)[i];
+    GLMmodel* model = chunk->model;
+    if (chunk->numvertices)
+        memcpy(&model->vertices[3 * chunk->firstvertex], &chunk->vertices[3],
+               sizeof(GLfloat) * 3 * chunk->numvertices);
+    if (chunk->numnormals)
+        memcpy(&model->normals[3 * chunk->firstnormal], &chunk->normals[3],
+               sizeof(GLfloat) * 3 * chunk->numnormals);
+    if (chunk->numtexcoords)
+        memcpy(&model->texcoords[2 * chunk->firsttexcoord], &chunk->texcoords[2],
+               sizeof(GLfloat) * 2 * chunk->numtexcoords);
+    if (chunk->numtriangles)
+        memcpy(&model->triangles[chunk->firsttriangle], chunk->triangles,
+               sizeof(GLMtriangle) * chunk->numtriangles);
+    free(chunk->vertices);
+    free(chunk->normals);
+    free(chunk->texcoords);
+    free(chunk->triangles);
+}
+
+/* _GLMsegment: a run of consecutive triangles that belong to one group */
+typedef struct _GLMsegment {
+    GLMgroup* group;
+    GLuint    first;
+    GLuint    count;
+} GLMsegment;
+
+/* GLMlookup: the name tables of a model being loaded */
+typedef struct _GLMlookup {
+    GLMnames   groups;            /* group names to indices in grouplist */
+    GLMnames   materials;         /* material names to material indices */
+    GLMnames   textures;          /* texture names to texture indices */
+    GLMgroup** grouplist;         /* the groups in the order they were added */
+    GLuint     maxgroups;         /* capacity of grouplist */
+} GLMlookup;
+
+/* glmLookupGroup: glmAddGroup() through the loader's group table */
+static GLMgroup* glmLookupGroup(GLMmodel* model, char* name, GLMlookup* lookup){
+    GLMgroup* group;
+    GLuint*   found;
+    size_t    length;
+    if (!glmHashOn)
+        return glmAddGroup(model, name);
+    length = strlen(name);
+    found = glmFindName(&lookup->groups, name, length);
+    if (found)
+        return lookup->grouplist[*found];
+    group = glmNewGroup(model, name);
+    lookup->grouplist = (GLMgroup**)glmGrow(lookup->grouplist, &lookup->maxgroups,
+                                           lookup->groups.count + 1, sizeof(GLMgroup*));
+    lookup->grouplist[lookup->groups.count] = group;
+    glmAddName(&lookup->groups, group->name, length, lookup->groups.count);
+    return group;
+}
+
+/* glmLookupMaterial: glmFindMaterial() through the loader's material
+ * table
+ */
+static GLuint glmLookupMaterial(GLMmodel* model, char* name, GLMlookup* lookup){
+    GLuint* found;
+    if (!glmHashOn)
+        return glmFindMaterial(model, name);
+    found = glmFindName(&lookup->materials, name, strlen(name));
+    if (found)
+        return *found;
+    printf("glmFindMaterial():  can't find material \"%s\".\n", name);
+    return 0;
+}
+
+/* glmStitchChunks: put the pieces of a parsed OBJ file together into a
+ * model.  The vertex, normal, texcoord and triangle arrays are simply
+ * concatenated (OBJ indices are absolute, so nothing needs remapping);
+ * mtllib, usemtl and g lines are then replayed in file order to build
+ * the groups.
+ *
+ * model     - properly initialized GLMmodel structure
+ * chunks    - the parsed pieces, in file order
+ * numchunks - number of pieces
+ * adopt     - hand the arrays of a single piece over to the model instead
+ *             of copying them (streamed files, which would otherwise be
+ *             held twice at the end)
+ */
+static GLvoid glmStitchChunks(GLMmodel* model, GLMchunk* chunks, GLuint numchunks,
+                              GLboolean adopt, mycallback *call){
+    GLuint  numvertices, numnormals, numtexcoords, numtriangles;
+    GLuint  numsegments, maxsegments;
+    GLMsegment* segments;
+    GLMgroup* group;            /* current group */
+    GLuint  material;           /* current material */
+    GLuint  i, j, k, pos;
+    size_t  size;
+    GLMchunk* chunk;
+    GLMrecord* record;
+    GLMlookup lookup;
+
+    /* work out where each chunk goes */
+    numvertices = numnormals = numtexcoords = numtriangles = 0;
+    for (i = 0; i < numchunks; i++) {
+        chunks[i].model         = model;
+        chunks[i].firstvertex   = numvertices + 1;
+        chunks[i].firstnormal   = numnormals + 1;
+        chunks[i].firsttexcoord = numtexcoords + 1;
+        chunks[i].firsttriangle = numtriangles;
+        numvertices  += chunks[i].numvertices;
+        numnormals   += chunks[i].numnormals;
+        numtexcoords += chunks[i].numtexcoords;
+        numtriangles += chunks[i].numtriangles;
+    }
     model->numvertices  = numvertices;
     model->numnormals   = numnormals;
     model->numtexcoords = numtexcoords;
     model->numtriangles = numtriangles;
 
-    /* allocate memory for the triangles in each group */
-    group = model->groups;
-    while(group) {
-        group->triangles = (GLuint*)malloc(sizeof(GLuint) * group->numtriangles);
-        group->numtriangles = 0;
-        group = group->next;
-    }
-}
-
-/* glmSecondPass: second pass at a Wavefront OBJ file that gets all
- * the data.
- *
- * model - properly initialized GLMmodel structure
- * file  - (fopen'd) file descriptor 
- */
-static GLvoid glmSecondPass(GLMmodel* model, FILE* file, mycallback *call) {
-    GLuint  numvertices;        /* number of vertices in model */
-    GLuint  numnormals;         /* number of normals in model */
-    GLuint  numtexcoords;       /* number of texcoords in model */
-    GLuint  numtriangles;       /* number of triangles in model */
-    GLfloat*    vertices;           /* array of vertices  */
-    GLfloat*    normals;            /* array of normals */
-    GLfloat*    texcoords;          /* array of texture coordinates */
-    GLMgroup* group;            /* current group pointer */
-    GLuint  material;           /* current material */
-    GLuint  v, n, t;
-    char        buf[128];
-    /* set the pointer shortcuts */
-    vertices       = model->vertices;
-    normals    = model->normals;
-    texcoords    = model->texcoords;
-    group      = model->groups;
-    /* on the second pass through the file, read all the data into the
-    allocated arrays */
-    numvertices = numnormals = numtexcoords = 1;
-    numtriangles = 0;
+    /* everything the model keeps goes into one arena block: the arrays,
+       the group triangle lists and the groups with their names, plus
+       room for the materials */
+    assert(!adopt || numchunks == 1);
+    size = GLM_ARENA_ALIGN(sizeof(GLuint) * numtriangles) + GLM_ARENA_BLOCK;
+    if (!adopt) {
+        size += GLM_ARENA_ALIGN(sizeof(GLfloat) * 3 * (numvertices + 1)) +
+                GLM_ARENA_ALIGN(sizeof(GLMtriangle) * numtriangles);
+        if (numnormals)
+            size += GLM_ARENA_ALIGN(sizeof(GLfloat) * 3 * (numnormals + 1));
+        if (numtexcoords)
+            size += GLM_ARENA_ALIGN(sizeof(GLfloat) * 2 * (numtexcoords + 1));
+    }
+    for (i = 0; i < numchunks; i++)
+        for (j = 0; j < chunks[i].numrecords; j++)
+            size += GLM_ARENA_ALIGN(sizeof(GLMgroup)) + GLM_ARENA_ALIGN(sizeof(GLuint)) +
+                    GLM_ARENA_ALIGN(strlen(chunks[i].records[j].name) + 1);
+    glmReserve(model, size);
+
+    if (adopt) {
+        /* trimmed to size, which leaves them where they are */
+        chunk = &chunks[0];
+        model->vertices = (GLfloat*)realloc(chunk->vertices, sizeof(GLfloat) * 3 * (numvertices + 1));
+        if (numnormals)
+            model->normals = (GLfloat*)realloc(chunk->normals, sizeof(GLfloat) * 3 * (numnormals + 1));
+        if (numtexcoords)
+            model->texcoords = (GLfloat*)realloc(chunk->texcoords, sizeof(GLfloat) * 2 * (numtexcoords + 1));
+        if (numtriangles)
+            model->triangles = (GLMtriangle*)realloc(chunk->triangles, sizeof(GLMtriangle) * numtriangles);
+    } else {
+        model->vertices = (GLfloat*)glmAlloc(model, sizeof(GLfloat) * 3 * (numvertices + 1));
+        if (numnormals)
+            model->normals = (GLfloat*)glmAlloc(model, sizeof(GLfloat) * 3 * (numnormals + 1));
+        if (numtexcoords)
+            model->texcoords = (GLfloat*)glmAlloc(model, sizeof(GLfloat) * 2 * (numtexcoords + 1));
+        if (numtriangles)
+            model->triangles = (GLMtriangle*)glmAlloc(model, sizeof(GLMtriangle) * numtriangles);
+        glmParallel(numchunks, glmCopyChunkWorker, chunks);
+    }
+
+    /* replay the mtllib, usemtl and g lines in order, cutting the
+       triangles up into runs that belong to the same group */
+    segments = NULL;
+    numsegments = maxsegments = 0;
+    memset(&lookup, 0, sizeof(GLMlookup));
+    group = glmLookupGroup(model, (char*)"default", &lookup);
     material = 0;
-    while(fscanf(file, "%s", buf) != EOF) {
-        switch(buf[0]) {
-        case '#':               /* comment */
-            /* eat up rest of line */
-            fgets(buf, sizeof(buf), file);
-            break;
-        case 'v':               /* v, vn, vt */
-            switch(buf[1]) {
-            case '\0':          /* vertex */
-                fscanf(file, "%f %f %f", 
-                       &vertices[3 * numvertices + 0],
-                       &vertices[3 * numvertices + 1],
-                       &vertices[3 * numvertices + 2]);
-                numvertices++;
-                /*  if (numvertices%200==0)
-                        if (call)
-                        {
-                                sprintf(afis,"%s (%s )... ",call->text, group->name);
-                                int procent = ((float)((float)numvertices*70/model->numvertices+30)/100)*(call->end-call->start)+call->start;
-                                call->loadcallback(procent,afis); // Modelul e 70% din incarcare
-                        }*/
+    for (i = 0; i < numchunks; i++) {
+        chunk = &chunks[i];
+        pos = 0;
+        for (j = 0; j <= chunk->numrecords; j++) {
+            record = j < chunk->numrecords ? &chunk->records[j] : NULL;
+            k = record ? record->triangle : chunk->numtriangles;
+            if (k > pos) {
+                segments = (GLMsegment*)glmGrow(segments, &maxsegments,
+                                                numsegments + 1, sizeof(GLMsegment));
+                segments[numsegments].group = group;
+                segments[numsegments].first = chunk->firsttriangle + pos;
+                segments[numsegments].count = k - pos;
+                numsegments++;
+                group->numtriangles += k - pos;
+                pos = k;
+            }
+            if (!record)
                 break;
-            case 'n':           /* normal */
-                fscanf(file, "%f %f %f", 
-                       &normals[3 * numnormals + 0],
-                       &normals[3 * numnormals + 1],
-                       &normals[3 * numnormals + 2]);
-                numnormals++;
+            switch (record->type) {
+            case 'm':
+                model->mtllibname = glmStrdup(model, record->name);
+                glmReadMTL(model, record->name, call, &lookup.materials, &lookup.textures);
                 break;
-            case 't':           /* texcoord */
-                fscanf(file, "%f %f", 
-                       &texcoords[2 * numtexcoords + 0],
-                       &texcoords[2 * numtexcoords + 1]);
-                numtexcoords++;
+            case 'u':
+                group->material = material = glmLookupMaterial(model, record->name, &lookup);
+                break;
+            case 'g':
+                group = glmLookupGroup(model, record->name, &lookup);
+                group->material = material;
                 break;
             }
-            break;
-            case 'u':
-            fgets(buf, sizeof(buf), file);
-            sscanf(buf, "%s %s", buf, buf);
-            group->material = material = glmFindMaterial(model, buf);
-            break;
-            case 'g':               /* group */
-                /* eat up rest of line */
-                fgets(buf, sizeof(buf), file);
-#if SINGLE_STRING_GROUP_NAMES
-                sscanf(buf, "%s", buf);
-#else
-                buf[strlen(buf)-1] = '\0';  /* nuke '\n' */
+            free(record->name);
+        }
+        free(chunk->records);
+    }
+    glmDeleteNames(&lookup.groups);
+    glmDeleteNames(&lookup.materials);
+    glmDeleteNames(&lookup.textures);
+    free(lookup.grouplist);
+
+    /* allocate memory for the triangles in each group and fill it in */
+    for (group = model->groups; group; group = group->next) {
+        if (group->numtriangles)
+            group->triangles = (GLuint*)glmAlloc(model, sizeof(GLuint) * group->numtriangles);
+        group->numtriangles = 0;
+    }
+    for (i = 0; i < numsegments; i++) {
+        group = segments[i].group;
+        for (k = 0; k < segments[i].count; k++)
+            group->triangles[group->numtriangles++] = segments[i].first + k;
+    }
+    free(segments);
+}
+
+/* glmReadChunks: split a mapped OBJ file into pieces on line
+ * boundaries, parse them on numthreads threads and stitch the result
+ * into the model.
+ */
+static GLvoid glmReadChunks(GLMmodel* model, const char* data, size_t size,
+                            GLuint numthreads, mycallback *call){
+    GLMchunk* chunks;
+    GLuint  numchunks, i;
+    const char* p;
+    const char* end;
+
+    /* don't bother splitting below a couple of megabytes per piece */
+    numchunks = numthreads;
+    if (numchunks > size / (1 << 21) + 1)
+        numchunks = size / (1 << 21) + 1;
+    if (numchunks < 1)
+        numchunks = 1;
+    chunks = (GLMchunk*)calloc(numchunks, sizeof(GLMchunk));
+    p = data;
+    end = data + size;
+    for (i = 0; i < numchunks; i++) {
+        chunks[i].begin = p;
+        if (i == numchunks - 1)
+            p = end;
+        else {
+            p = data + size / numchunks * (i + 1);
+            if (p < chunks[i].begin)
+                p = chunks[i].begin;
+            p = glmSkipLine(p, end);
+        }
+        chunks[i].end  = p;
+        chunks[i].data = data;
+        chunks[i].size = size;
+    }
+    /* only the first piece reports progress */
+    chunks[0].call = call;
+    if (numchunks == 1)
+        glmParseChunk(&chunks[0]);
+    else
+        glmParallel(numchunks, glmParseChunkWorker, chunks);
+    glmStitchChunks(model, chunks, numchunks, GL_FALSE, call);
+    free(chunks);
+}
+
+/* bytes decompressed at a time from a compressed OBJ */
+#define GLM_STREAM_BLOCK (1 << 22)
+
+/* GLMstream: a compressed OBJ file being decompressed on one thread
+ * into two blocks that the reading thread takes turns parsing.  Each
+ * block ends on a line boundary; the partial line at the end of what
+ * was decompressed is carried over to the start of the next block.
+ */
+typedef struct _GLMstream {
+    gzFile          gz;           /* gzip input, or NULL */
+#ifdef GLM_ZSTD
+    FILE*           file;         /* zstd input, or NULL */
+    ZSTD_DStream*   zstd;
+    ZSTD_inBuffer   input;
+    char*           in;
+    GLboolean       unfinished;   /* the last frame isn't complete yet */
 #endif
-                group = glmFindGroup(model, buf);
-                group->material = material;
+    size_t          consumed;     /* compressed bytes read so far */
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    char*           blocks[2];
+    size_t          capacity[2];  /* size of each block */
+    size_t          length[2];    /* bytes waiting to be parsed */
+    GLboolean       full[2];      /* block is waiting to be parsed */
+    GLboolean       done;         /* no more blocks are coming */
+    GLboolean       failed;       /* the data is corrupt */
+    char*           carry;        /* partial line held over */
+    size_t          carried, maxcarry;
+} GLMstream;
+
+/* glmStreamRead: decompress up to size bytes.  Returns the number of
+ * bytes, 0 at the end of the data or -1 if it is corrupt.
+ */
+static long glmStreamRead(GLMstream* stream, char* buf, size_t size){
+    int n, error;
+    if (stream->gz) {
+        n = gzread(stream->gz, buf, size < (1u << 30) ? size : (1u << 30));
+        stream->consumed = gzoffset(stream->gz);
+        /* a truncated file just ends early, with an error to say so */
+        if (n == 0) {
+            gzerror(stream->gz, &error);
+            if (error != Z_OK)
+                return -1;
+        }
+        return n;
+    }
+#ifdef GLM_ZSTD
+    ZSTD_outBuffer output;
+    size_t ret;
+    output.dst = buf;
+    output.size = size;
+    output.pos = 0;
+    while (output.pos < output.size) {
+        if (stream->input.pos == stream->input.size) {
+            stream->input.size = fread(stream->in, 1, ZSTD_DStreamInSize(), stream->file);
+            stream->input.pos = 0;
+            stream->consumed += stream->input.size;
+            if (stream->input.size == 0)
                 break;
-case 'f':				/* face */
-    v = n = t = 0;
-    fscanf(file, "%s", buf);
-    /* can be one of %d, %d//%d, %d/%d, %d/%d/%d %d//%d */
-    if (strstr(buf, "//")) {
-        /* v//n */
-        sscanf(buf, "%d//%d", &v, &n);
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).nindices[0] = n;
-        fscanf(file, "%d//%d", &v, &n);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).nindices[1] = n;
-        fscanf(file, "%d//%d", &v, &n);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).nindices[2] = n;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d//%d", &v, &n) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).nindices[2] = n;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
         }
-    } else if (sscanf(buf, "%d/%d/%d", &v, &t, &n) == 3) {
-        /* v/t/n */
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).tindices[0] = t;
-        T(numtriangles).nindices[0] = n;
-        fscanf(file, "%d/%d/%d", &v, &t, &n);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).tindices[1] = t;
-        T(numtriangles).nindices[1] = n;
-        fscanf(file, "%d/%d/%d", &v, &t, &n);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).tindices[2] = t;
-        T(numtriangles).nindices[2] = n;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d/%d/%d", &v, &t, &n) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
-            T(numtriangles).nindices[0] = T(numtriangles-1).nindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
-            T(numtriangles).nindices[1] = T(numtriangles-1).nindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).tindices[2] = t;
-            T(numtriangles).nindices[2] = n;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
+        ret = ZSTD_decompressStream(stream->zstd, &output, &stream->input);
+        if (ZSTD_isError(ret))
+            return -1;
+        stream->unfinished = ret != 0;
+    }
+    /* a truncated file ends in the middle of a frame */
+    if (output.pos == 0 && stream->unfinished)
+        return -1;
+    return output.pos;
+#else
+    return -1;
+#endif
+}
+
+/* glmStreamWorker: thread that fills the blocks in turn until the
+ * data runs out
+ */
+static GLvoid* glmStreamWorker(GLvoid* data){
+    GLMstream* stream = (GLMstream*)data;
+    GLuint  b;
+    size_t  length;
+    long    n;
+    char*   eol;
+    b = 0;
+    n = 0;
+    for (;;) {
+        /* wait for the parser to be done with the block */
+        pthread_mutex_lock(&stream->mutex);
+        while (stream->full[b])
+            pthread_cond_wait(&stream->cond, &stream->mutex);
+        pthread_mutex_unlock(&stream->mutex);
+
+        /* the carried over line, then as much as fits; a line longer
+           than the block makes the block grow */
+        if (stream->capacity[b] <= stream->carried) {
+            stream->capacity[b] = 2 * stream->carried;
+            stream->blocks[b] = (char*)realloc(stream->blocks[b], stream->capacity[b]);
         }
-    } else if (sscanf(buf, "%d/%d", &v, &t) == 2) {
-        /* v/t */
-        T(numtriangles).vindices[0] = v;
-        T(numtriangles).tindices[0] = t;
-        fscanf(file, "%d/%d", &v, &t);
-        T(numtriangles).vindices[1] = v;
-        T(numtriangles).tindices[1] = t;
-        fscanf(file, "%d/%d", &v, &t);
-        T(numtriangles).vindices[2] = v;
-        T(numtriangles).tindices[2] = t;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d/%d", &v, &t) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).tindices[0] = T(numtriangles-1).tindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).tindices[1] = T(numtriangles-1).tindices[2];
-            T(numtriangles).vindices[2] = v;
-            T(numtriangles).tindices[2] = t;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
+        memcpy(stream->blocks[b], stream->carry, stream->carried);
+        length = stream->carried;
+        eol = NULL;
+        for (;;) {
+            if (length == stream->capacity[b]) {
+                stream->capacity[b] *= 2;
+                stream->blocks[b] = (char*)realloc(stream->blocks[b], stream->capacity[b]);
+            }
+            n = glmStreamRead(stream, stream->blocks[b] + length, stream->capacity[b] - length);
+            if (n <= 0)
+                break;
+            length += n;
+            if (length < stream->capacity[b])
+                continue;
+            eol = (char*)memrchr(stream->blocks[b], '\n', length);
+            if (eol)
+                break;
         }
-    } else {
-        /* v */
-        sscanf(buf, "%d", &v);
-        T(numtriangles).vindices[0] = v;
-        fscanf(file, "%d", &v);
-        T(numtriangles).vindices[1] = v;
-        fscanf(file, "%d", &v);
-        T(numtriangles).vindices[2] = v;
-        group->triangles[group->numtriangles++] = numtriangles;
-        numtriangles++;
-        while(fscanf(file, "%d", &v) > 0) {
-            T(numtriangles).vindices[0] = T(numtriangles-1).vindices[0];
-            T(numtriangles).vindices[1] = T(numtriangles-1).vindices[2];
-            T(numtriangles).vindices[2] = v;
-            group->triangles[group->numtriangles++] = numtriangles;
-            numtriangles++;
+        if (n < 0)
+            stream->failed = GL_TRUE;
+
+        /* keep the partial line for the next block */
+        stream->carried = n > 0 ? stream->blocks[b] + length - (eol + 1) : 0;
+        if (stream->carried > stream->maxcarry) {
+            stream->maxcarry = stream->carried;
+            stream->carry = (char*)realloc(stream->carry, stream->maxcarry);
         }
+        memcpy(stream->carry, stream->blocks[b] + length - stream->carried, stream->carried);
+
+        pthread_mutex_lock(&stream->mutex);
+        stream->length[b] = length - stream->carried;
+        stream->full[b] = GL_TRUE;
+        if (n <= 0)
+            stream->done = GL_TRUE;
+        pthread_cond_broadcast(&stream->cond);
+        pthread_mutex_unlock(&stream->mutex);
+        if (n <= 0)
+            return NULL;
+        b ^= 1;
     }
-    break;
-            default:
-    /* eat up rest of line */
-    fgets(buf, sizeof(buf), file);
-    break;
 }
+
+/* glmIsCompressed: does a mapped file start like gzip or zstd data? */
+static GLboolean glmIsCompressed(const char* data, size_t size){
+    const unsigned char* u = (const unsigned char*)data;
+    if (size >= 2 && u[0] == 0x1f && u[1] == 0x8b)
+        return GL_TRUE;
+    if (size >= 4 && u[0] == 0x28 && u[1] == 0xb5 && u[2] == 0x2f && u[3] == 0xfd)
+        return GL_TRUE;
+    return GL_FALSE;
+}
+
+/* glmReadStream: read a gzip or zstd compressed OBJ file into a model
+ * without decompressing it anywhere first.  The file is decompressed a
+ * block at a time on a second thread while the previous block is being
+ * parsed, so besides the model only the two blocks are ever in memory.
+ */
+static GLvoid glmReadStream(GLMmodel* model, char* filename, const char* data,
+                            size_t size, mycallback *call){
+    GLMstream stream;
+    GLMchunk  chunk;
+    pthread_t thread;
+    GLuint    b;
+    char      afis[256];
+    memset(&stream, 0, sizeof(GLMstream));
+    if ((unsigned char)data[0] == 0x1f) {
+        stream.gz = gzopen(filename, "rb");
+        if (stream.gz)
+            gzbuffer(stream.gz, 1 << 17);
+    }
+#ifdef GLM_ZSTD
+    else {
+        stream.file = fopen(filename, "rb");
+        stream.zstd = ZSTD_createDStream();
+        stream.in = (char*)malloc(ZSTD_DStreamInSize());
+        stream.input.src = stream.in;
+    }
+    if (!stream.gz && !stream.file) {
+#else
+    else {
+        fprintf(stderr, "glmReadOBJ() failed: \"%s\" is zstd compressed, "
+                "which needs a build with GLM_ZSTD.\n", filename);
+        exit(1);
+    }
+    if (!stream.gz) {
+#endif
+        fprintf(stderr, "glmReadOBJ() failed: can't decompress \"%s\".\n", filename);
+        exit(1);
+    }
+    pthread_mutex_init(&stream.mutex, NULL);
+    pthread_cond_init(&stream.cond, NULL);
+    for (b = 0; b < 2; b++) {
+        stream.capacity[b] = GLM_STREAM_BLOCK;
+        stream.blocks[b] = (char*)malloc(GLM_STREAM_BLOCK);
+    }
+    pthread_create(&thread, NULL, glmStreamWorker, &stream);
+
+    /* parse the blocks in turn, all into the one chunk */
+    memset(&chunk, 0, sizeof(GLMchunk));
+    for (b = 0; ; b ^= 1) {
+        pthread_mutex_lock(&stream.mutex);
+        while (!stream.full[b] && !stream.done)
+            pthread_cond_wait(&stream.cond, &stream.mutex);
+        if (!stream.full[b]) {
+            pthread_mutex_unlock(&stream.mutex);
+            break;
+        }
+        pthread_mutex_unlock(&stream.mutex);
+        if (call) {
+            sprintf(afis, "%s... ", call->text ? call->text : "Loading");
+            call->loadcallback(call->start + (int)((double)stream.consumed / size *
+                                                   (call->end - call->start)), afis);
+        }
+        chunk.begin = stream.blocks[b];
+        chunk.end = stream.blocks[b] + stream.length[b];
+        glmParseChunk(&chunk);
+        pthread_mutex_lock(&stream.mutex);
+        stream.full[b] = GL_FALSE;
+        pthread_cond_broadcast(&stream.cond);
+        pthread_mutex_unlock(&stream.mutex);
+    }
+    pthread_join(thread, NULL);
+    if (stream.failed) {
+        fprintf(stderr, "glmReadOBJ() failed: \"%s\" is corrupt.\n", filename);
+        exit(1);
     }
 
-#if 0
-    /* announce the memory requirements */
-    printf(" Memory: %d bytes\n",
-           numvertices  * 3*sizeof(GLfloat) +
-           numnormals   * 3*sizeof(GLfloat) * (numnormals ? 1 : 0) +
-           numtexcoords * 3*sizeof(GLfloat) * (numtexcoords ? 1 : 0) +
-           numtriangles * sizeof(GLMtriangle));
+    for (b = 0; b < 2; b++)
+        free(stream.blocks[b]);
+    free(stream.carry);
+    if (stream.gz)
+        gzclose(stream.gz);
+#ifdef GLM_ZSTD
+    if (stream.file) {
+        fclose(stream.file);
+        ZSTD_freeDStream(stream.zstd);
+        free(stream.in);
+    }
 #endif
+    pthread_mutex_destroy(&stream.mutex);
+    pthread_cond_destroy(&stream.cond);
+    glmStitchChunks(model, &chunk, 1, GL_TRUE, call);
 }
 
 
@@ -1038,7 +2204,7 @@ GLvoid glmFacetNormals(GLMmodel* model) {
     assert(model->vertices);
     /* clobber any old facetnormals */
     if (model->facetnorms)
-        free(model->facetnorms);
+        glmFree(model, model->facetnorms);
     /* allocate memory for the new facet normals */
     model->numfacetnorms = model->numtriangles;
     model->facetnorms = (GLfloat*)malloc(sizeof(GLfloat) *
@@ -1063,6 +2229,125 @@ GLvoid glmFacetNormals(GLMmodel* model) {
     }
 }
 
+/* vertices handed to a thread at a time by glmVertexNormals() */
+#define GLM_SMOOTH_BLOCK 4096
+
+/* GLMsmooth: shared state of the glmVertexNormals() workers */
+typedef struct _GLMsmooth {
+    GLMmodel* model;
+    GLfloat   cos_angle;
+    GLuint*   offsets;            /* vertex -> first entry in members */
+    GLuint*   members;            /* triangles around each vertex */
+    GLubyte*  averaged;           /* entry went into the vertex average */
+    GLfloat*  average;            /* averaged normal of each vertex */
+    GLuint*   first;              /* normals of / first normal of each vertex */
+} GLMsmooth;
+
+/* glmSmoothAverage: average the facet normals around a block of
+ * vertices and count the normals each vertex will need.
+ */
+static GLvoid glmSmoothAverage(GLuint block, GLvoid* data){
+    GLMsmooth* smooth = (GLMsmooth*)data;
+    GLMmodel*  model = smooth->model;
+    GLfloat*   reference;
+    GLfloat*   facet;
+    GLfloat*   average;
+    GLfloat    dot;
+    GLuint     v, last, k, count;
+    GLboolean  avg;
+    v = block * GLM_SMOOTH_BLOCK + 1;
+    last = v + GLM_SMOOTH_BLOCK - 1;
+    if (last > model->numvertices)
+        last = model->numvertices;
+    for (; v <= last; v++) {
+        average = &smooth->average[3 * v];
+        average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
+        count = 0;
+        avg = GL_FALSE;
+        if (smooth->offsets[v] == smooth->offsets[v + 1]) {
+            fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
+            smooth->first[v] = 0;
+            continue;
+        }
+        /* only average if the dot product of the angle between the facet
+        normal and the one of the first triangle in the list is greater
+        than the cosine of the threshold angle -- or, said another way,
+        the angle between the two facet normals is less than (or equal
+        to) the threshold angle */
+        reference = &model->facetnorms[3 * T(smooth->members[smooth->offsets[v]]).findex];
+        for (k = smooth->offsets[v]; k < smooth->offsets[v + 1]; k++) {
+            facet = &model->facetnorms[3 * T(smooth->members[k]).findex];
+            dot = glmDot(facet, reference);
+            if (dot > smooth->cos_angle) {
+                smooth->averaged[k] = GL_TRUE;
+                average[0] += facet[0];
+                average[1] += facet[1];
+                average[2] += facet[2];
+                avg = GL_TRUE;      /* we averaged at least one normal! */
+            } else {
+                smooth->averaged[k] = GL_FALSE;
+                count++;
+            }
+        }
+        if (avg) {
+            /* normalize the averaged normal, it comes before the others */
+            glmNormalize(average);
+            count++;
+        }
+        smooth->first[v] = count;
+    }
+}
+
+/* glmSmoothAssign: write the normals of a block of vertices and point
+ * the corners of their triangles at them.
+ */
+static GLvoid glmSmoothAssign(GLuint block, GLvoid* data){
+    GLMsmooth* smooth = (GLMsmooth*)data;
+    GLMmodel*  model = smooth->model;
+    GLfloat*   normal;
+    GLfloat*   facet;
+    GLuint     v, last, k, t, n, avg;
+    v = block * GLM_SMOOTH_BLOCK + 1;
+    last = v + GLM_SMOOTH_BLOCK - 1;
+    if (last > model->numvertices)
+        last = model->numvertices;
+    for (; v <= last; v++) {
+        if (smooth->offsets[v] == smooth->offsets[v + 1])
+            continue;
+        n = smooth->first[v];
+        avg = 0;
+        for (k = smooth->offsets[v]; k < smooth->offsets[v + 1] && !avg; k++)
+            if (smooth->averaged[k])
+                avg = n++;
+        if (avg)
+            memcpy(&model->normals[3 * avg], &smooth->average[3 * v], sizeof(GLfloat) * 3);
+        
+        /* set the normal of this vertex in each triangle it is in */
+        for (k = smooth->offsets[v]; k < smooth->offsets[v + 1]; k++) {
+            t = smooth->members[k];
+            if (smooth->averaged[k]) {
+                /* if this corner was averaged, use the average normal */
+                normal = NULL;
+            } else {
+                /* if this corner wasn't averaged, use the facet normal */
+                facet = &model->facetnorms[3 * T(t).findex];
+                normal = &model->normals[3 * n];
+                normal[0] = facet[0];
+                normal[1] = facet[1];
+                normal[2] = facet[2];
+            }
+            if (T(t).vindices[0] == v)
+                T(t).nindices[0] = normal ? n : avg;
+            else if (T(t).vindices[1] == v)
+                T(t).nindices[1] = normal ? n : avg;
+            else if (T(t).vindices[2] == v)
+                T(t).nindices[2] = normal ? n : avg;
+            if (normal)
+                n++;
+        }
+    }
+}
+
 /* glmVertexNormals: Generates smooth vertex normals for a model.
  * First builds a list of all the triangles each vertex is in.   Then
  * loops through each vertex in the the list averaging all the facet
@@ -1080,142 +2365,72 @@ GLvoid glmFacetNormals(GLMmodel* model) {
  * angle - maximum angle (in degrees) to smooth across
  */
 GLvoid glmVertexNormals(GLMmodel* model, GLfloat angle){
-    GLMnode*    node;
-    GLMnode*    tail;
-    GLMnode** members;
-    GLfloat*    normals;
-    GLuint  numnormals;
-    GLfloat average[3];
-    GLfloat dot, cos_angle;
-    GLuint  i, avg;
+    GLMsmooth smooth;
+    GLuint*  offsets;
+    GLuint*  members;
+    GLuint   numblocks;
+    GLuint   i, j, v, n;
     assert(model);
     assert(model->facetnorms);
     /* calculate the cosine of the angle (in degrees) */
-    cos_angle = cos(angle * M_PI / 180.0);
+    smooth.cos_angle = cos(angle * M_PI / 180.0);
     /* nuke any previous normals */
     if (model->normals)
-        free(model->normals);
-    /* allocate space for new normals */
-    model->numnormals = model->numtriangles * 3; /* 3 normals per triangle */
-    model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-    /* allocate a structure that will hold a linked list of triangle
-    indices for each vertex */
-    members = (GLMnode**)malloc(sizeof(GLMnode*) * (model->numvertices + 1));
-    for (i = 1; i <= model->numvertices; i++)
-        members[i] = NULL;
-    /* for every triangle, create a node for each vertex in it */
+        glmFree(model, model->normals);
+    model->normals = NULL;
+    
+    /* build the table of triangles around each vertex: count the
+    triangles of every vertex, turn the counts into offsets and drop
+    the triangles in.  Each vertex gets its triangles in decreasing
+    order (last corner first), which is the order the smoothing below
+    has always visited them in. */
+    offsets = (GLuint*)calloc(model->numvertices + 2, sizeof(GLuint));
     for (i = 0; i < model->numtriangles; i++) {
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[0]];
-        members[T(i).vindices[0]] = node;
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[1]];
-        members[T(i).vindices[1]] = node;
-        node = (GLMnode*)malloc(sizeof(GLMnode));
-        node->index = i;
-        node->next  = members[T(i).vindices[2]];
-        members[T(i).vindices[2]] = node;
-    }
+        offsets[T(i).vindices[0] + 1]++;
+        offsets[T(i).vindices[1] + 1]++;
+        offsets[T(i).vindices[2] + 1]++;
+    }
+    for (v = 1; v <= model->numvertices; v++)
+        offsets[v + 1] += offsets[v];
+    members = (GLuint*)malloc(sizeof(GLuint) * (offsets[model->numvertices + 1] + 1));
+    i = model->numtriangles;
+    while (i--) {
+        for (j = 3; j--; )
+            members[offsets[T(i).vindices[j]]++] = i;
+    }
+    /* the fill moved every offset onto the next vertex's start */
+    for (v = model->numvertices + 1; v > 0; v--)
+        offsets[v] = offsets[v - 1];
+    offsets[0] = offsets[1] = 0;
     
-    /* calculate the average normal for each vertex */
-    numnormals = 1;
-    for (i = 1; i <= model->numvertices; i++) {
-        /* calculate an average normal for this vertex by averaging the
-        facet normal of every triangle this vertex is in */
-        node = members[i];
-        if (!node)
-            fprintf(stderr, "glmVertexNormals(): vertex w/o a triangle\n");
-        average[0] = 0.0; average[1] = 0.0; average[2] = 0.0;
-        avg = 0;
-        while (node) {
-            /* only average if the dot product of the angle between the two
-        facet normals is greater than the cosine of the threshold
-        angle -- or, said another way, the angle between the two
-            facet normals is less than (or equal to) the threshold angle */
-            dot = glmDot(&model->facetnorms[3 * T(node->index).findex],
-                         &model->facetnorms[3 * T(members[i]->index).findex]);
-            if (dot > cos_angle) {
-                node->averaged = GL_TRUE;
-                average[0] += model->facetnorms[3 * T(node->index).findex + 0];
-                average[1] += model->facetnorms[3 * T(node->index).findex + 1];
-                average[2] += model->facetnorms[3 * T(node->index).findex + 2];
-                avg = 1;            /* we averaged at least one normal! */
-            } else {
-                node->averaged = GL_FALSE;
-            }
-            node = node->next;
-        }
-        if (avg) {
-            /* normalize the averaged normal */
-            glmNormalize(average);
-            /* add the normal to the vertex normals list */
-            model->normals[3 * numnormals + 0] = average[0];
-            model->normals[3 * numnormals + 1] = average[1];
-            model->normals[3 * numnormals + 2] = average[2];
-            avg = numnormals;
-            numnormals++;
-        }
-        
-        /* set the normal of this vertex in each triangle it is in */
-        node = members[i];
-        while (node) {
-            if (node->index==204543)  {
-                printf("");
-            }
-            if (node->averaged) {
-
-                /* if this node was averaged, use the average normal */
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = avg;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = avg;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = avg;
-            } else {
-                /* if this node wasn't averaged, use the facet normal */
-                model->normals[3 * numnormals + 0] = 
-                        model->facetnorms[3 * T(node->index).findex + 0];
-                model->normals[3 * numnormals + 1] = 
-                        model->facetnorms[3 * T(node->index).findex + 1];
-                model->normals[3 * numnormals + 2] = 
-                        model->facetnorms[3 * T(node->index).findex + 2];
-                if (T(node->index).vindices[0] == i)
-                    T(node->index).nindices[0] = numnormals;
-                else if (T(node->index).vindices[1] == i)
-                    T(node->index).nindices[1] = numnormals;
-                else if (T(node->index).vindices[2] == i)
-                    T(node->index).nindices[2] = numnormals;
-                numnormals++;
-            }
-            node = node->next;
-        }
-    }
+    smooth.model    = model;
+    smooth.offsets  = offsets;
+    smooth.members  = members;
+    smooth.averaged = (GLubyte*)malloc(offsets[model->numvertices + 1] + 1);
+    smooth.average  = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    smooth.first    = (GLuint*)malloc(sizeof(GLuint) * (model->numvertices + 2));
     
-    model->numnormals = numnormals - 1;
-    /* free the member information */
-    for (i = 1; i <= model->numvertices; i++) {
-        node = members[i];
-        while (node) {
-            tail = node;
-            node = node->next;
-            free(tail);
-        }
-    }
-    free(members);
-    /* pack the normals array (we previously allocated the maximum
-    number of normals that could possibly be created (numtriangles *
-    3), so get rid of some of them (usually alot unless none of the
-    facet normals were averaged)) */
-    normals = model->normals;
+    /* decide which facet normals each vertex averages */
+    numblocks = (model->numvertices + GLM_SMOOTH_BLOCK - 1) / GLM_SMOOTH_BLOCK;
+    glmParallel(numblocks, glmSmoothAverage, &smooth);
+    
+    /* number the normals in vertex order: the average (if any) first,
+    then one copy of the facet normal per corner that wasn't averaged */
+    n = 1;
+    for (v = 1; v <= model->numvertices; v++) {
+        i = smooth.first[v];
+        smooth.first[v] = n;
+        n += i;
+    }
+    model->numnormals = n - 1;
     model->normals = (GLfloat*)malloc(sizeof(GLfloat)* 3* (model->numnormals+1));
-    for (i = 1; i <= model->numnormals; i++) {
-        model->normals[3 * i + 0] = normals[3 * i + 0];
-        model->normals[3 * i + 1] = normals[3 * i + 1];
-        model->normals[3 * i + 2] = normals[3 * i + 2];
-    }
-    free(normals);
+    glmParallel(numblocks, glmSmoothAssign, &smooth);
+    
+    free(smooth.first);
+    free(smooth.average);
+    free(smooth.averaged);
+    free(members);
+    free(offsets);
 }
 
 GLvoid glmLinearTexture(GLMmodel* model){
@@ -1225,7 +2440,7 @@ GLvoid glmLinearTexture(GLMmodel* model){
     GLuint i;
     assert(model);
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numvertices;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     
@@ -1274,7 +2489,7 @@ GLvoid glmSpheremapTexture(GLMmodel* model){
     assert(model);
     assert(model->normals);
     if (model->texcoords)
-        free(model->texcoords);
+        glmFree(model, model->texcoords);
     model->numtexcoords = model->numnormals;
     model->texcoords=(GLfloat*)malloc(sizeof(GLfloat)*2*(model->numtexcoords+1));
     for (i = 1; i <= model->numnormals; i++) {
@@ -1312,6 +2527,74 @@ GLvoid glmSpheremapTexture(GLMmodel* model){
     }
 }
 
+/* glmSphere: Builds a sphere centered at the origin, with its poles on
+ * the Z axis like gluSphere(), as a model with vertex normals and
+ * texture coordinates (s around, t from the -Z pole up) in a single
+ * group.  Free it with glmDelete().
+ *
+ * radius - radius of the sphere
+ * slices - subdivisions around the Z axis
+ * stacks - subdivisions along the Z axis
+ */
+GLMmodel* glmSphere(GLfloat radius, GLuint slices, GLuint stacks){
+    GLMmodel*    model;
+    GLMgroup*    group;
+    GLMtriangle* triangle;
+    GLfloat      rho, theta;
+    GLuint       i, j, k, n, corners[4];
+    static const GLuint quad[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+    assert(slices >= 3 && stacks >= 2);
+
+    model = (GLMmodel*)calloc(1, sizeof(GLMmodel));
+    model->pathname = strdup("sphere");
+
+    /* a grid of (stacks + 1) x (slices + 1) corners, the seam doubled so
+    it can have both s = 0 and s = 1 */
+    n = (stacks + 1) * (slices + 1);
+    model->numvertices = model->numnormals = model->numtexcoords = n;
+    model->vertices  = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (n + 1));
+    model->normals   = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (n + 1));
+    model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) * 2 * (n + 1));
+    n = 1;
+    for (i = 0; i <= stacks; i++) {
+        rho = M_PI - M_PI * i / stacks;
+        for (j = 0; j <= slices; j++, n++) {
+            theta = 2.0 * M_PI * j / slices;
+            model->normals[3 * n + 0] = sin(rho) * cos(theta);
+            model->normals[3 * n + 1] = sin(rho) * sin(theta);
+            model->normals[3 * n + 2] = cos(rho);
+            for (k = 0; k < 3; k++)
+                model->vertices[3 * n + k] = radius * model->normals[3 * n + k];
+            model->texcoords[2 * n + 0] = (GLfloat)j / slices;
+            model->texcoords[2 * n + 1] = (GLfloat)i / stacks;
+        }
+    }
+
+    /* two triangles per quad, but one at the poles */
+    model->triangles = (GLMtriangle*)calloc(2 * slices * (stacks - 1), sizeof(GLMtriangle));
+    group = glmAddGroup(model, (char*)"sphere");
+    group->triangles = (GLuint*)malloc(sizeof(GLuint) * 2 * slices * (stacks - 1));
+    for (i = 0; i < stacks; i++) {
+        for (j = 0; j < slices; j++) {
+            corners[0] = i * (slices + 1) + j + 1;
+            corners[1] = corners[0] + 1;
+            corners[2] = corners[1] + slices + 1;
+            corners[3] = corners[0] + slices + 1;
+            for (n = 0; n < 2; n++) {
+                if ((i == 0 && n == 0) || (i == stacks - 1 && n == 1))
+                    continue;
+                triangle = &model->triangles[model->numtriangles];
+                for (k = 0; k < 3; k++)
+                    triangle->vindices[k] = triangle->nindices[k] =
+                        triangle->tindices[k] = corners[quad[n][k]];
+                triangle->visible = true;
+                group->triangles[group->numtriangles++] = model->numtriangles++;
+            }
+        }
+    }
+    return model;
+}
+
 /* glmDelete: Deletes a GLMmodel structure.
  *
  * model - initialized GLMmodel structure
@@ -1319,22 +2602,24 @@ GLvoid glmSpheremapTexture(GLMmodel* model){
 GLvoid glmDelete(GLMmodel* model){
     GLMgroup* group;
     GLuint i;
+    GLMarena* arena;
     assert(model);
-    if (model->pathname)     free(model->pathname);
-    if (model->mtllibname) free(model->mtllibname);
-    if (model->vertices)     free(model->vertices);
-    if (model->normals)  free(model->normals);
-    if (model->texcoords)  free(model->texcoords);
-    if (model->facetnorms) free(model->facetnorms);
-    if (model->triangles)  free(model->triangles);
+    glmFree(model, model->pathname);
+    glmFree(model, model->mtllibname);
+    glmFree(model, model->vertices);
+    glmFree(model, model->colors);
+    glmFree(model, model->normals);
+    glmFree(model, model->texcoords);
+    glmFree(model, model->facetnorms);
+    glmFree(model, model->triangles);
     if (model->materials) {
         for (i = 0; i < model->nummaterials; i++)
-            free(model->materials[i].name);
-        free(model->materials);
+            glmFree(model, model->materials[i].name);
+        glmFree(model, model->materials);
     }
     if (model->textures) {
         for (i = 0; i < model->numtextures; i++) {
-            free(model->textures[i].name);
+            glmFree(model, model->textures[i].name);
             glDeleteTextures(1,&model->textures[i].id);
         }
         free(model->textures);
@@ -1343,9 +2628,16 @@ GLvoid glmDelete(GLMmodel* model){
     while(model->groups) {
         group = model->groups;
         model->groups = model->groups->next;
-        free(group->name);
-        free(group->triangles);
-        free(group);
+        glmFree(model, group->name);
+        glmFree(model, group->triangles);
+        glmFree(model, group);
+    }
+    if (model->mapping)
+        munmap(model->mapping, model->mappingsize);
+    while (model->arena) {
+        arena = model->arena;
+        model->arena = arena->next;
+        free(arena);
     }
     free(model);
 }
@@ -1361,22 +2653,50 @@ GLMmodel* glmReadOBJ(char* filename){
     return glmReadOBJ(filename,0);
 }
 GLMmodel* glmReadOBJ(char* filename,mycallback *call){
+    return glmReadOBJParallel(filename, 1, call);
+}
+
+/* glmReadOBJParallel: Reads a model description from a Wavefront .OBJ
+ * file, splitting the file into pieces that are parsed on several
+ * threads.  The model is the same as the one glmReadOBJ() returns.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of threads to parse on (0 = glmNumThreads())
+ */
+GLMmodel* glmReadOBJParallel(char* filename, GLuint numthreads, mycallback *call){
     GLMmodel* model;
-    FILE*   file;
+    model = glmReadOBJDeferred(filename, numthreads, call);
+    glmLoadTextures(model, call);
+    return model;
+}
+
+/* glmReadOBJDeferred: Same as glmReadOBJParallel(), but leaves loading
+ * the textures to glmLoadTextures(), so that it can run on a thread
+ * without an OpenGL context.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of threads to parse on (0 = glmNumThreads())
+ */
+GLMmodel* glmReadOBJDeferred(char* filename, GLuint numthreads, mycallback *call){
+    GLMmodel* model;
+    char*   data;
+    size_t  size;
     //if (call) call->loadcallback(0,"Loading Models...");
-    /* open the file */
-    file = fopen(filename, "r");
-    if (!file) {
+    /* map the file */
+    data = glmMapFile(filename, &size);
+    if (!data) {
         fprintf(stderr, "glmReadOBJ() failed: can't open data file \"%s\".\n",
                 filename);
         exit(1);
     }
     /* allocate a new model */
     model = (GLMmodel*)malloc(sizeof(GLMmodel));
-    model->pathname    = strdup(filename);
+    model->arena         = NULL;
+    model->pathname    = glmStrdup(model, filename);
     model->mtllibname    = NULL;
     model->numvertices   = 0;
     model->vertices    = NULL;
+    model->colors        = NULL;
     model->numnormals    = 0;
     model->normals     = NULL;
     model->numtexcoords  = 0;
@@ -1394,33 +2714,317 @@ GLMmodel* glmReadOBJ(char* filename,mycallback *call){
     model->position[0]   = 0.0;
     model->position[1]   = 0.0;
     model->position[2]   = 0.0;
-    /* make a first pass through the file to get a count of the number
-    of vertices, normals, texcoords & triangles */
-    glmFirstPass(model, file, call);
-    /* allocate memory */
-    model->vertices = (GLfloat*)malloc(sizeof(GLfloat) *
-                                       3 * (model->numvertices + 1));
-    model->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) *
-                                            model->numtriangles);
-    if (model->numnormals) {
-        model->normals = (GLfloat*)malloc(sizeof(GLfloat) *
-                                          3 * (model->numnormals + 1));
+    model->mapping       = NULL;
+    model->mappingsize   = 0;
+    /* read everything, one pass per piece of the file, or streamed
+       through the decompressor if the file is compressed */
+    if (numthreads == 0)
+        numthreads = glmNumThreads();
+    if (glmIsCompressed(data, size))
+        glmReadStream(model, filename, data, size, call);
+    else
+        glmReadChunks(model, data, size, numthreads, call);
+    /* release the file */
+    glmUnmapFile(data, size);
+    return model;
+}
+
+/* glmScanOBJ: Walks through a Wavefront .OBJ file without building a
+ * model, for files that don't fit in memory.  The file is only mapped
+ * and read front to back.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * vertex   - called with the position of every v line, or NULL
+ * triangle - called with the vertex indices of every triangle of every
+ *            f line (polygons are split into fans), or NULL
+ * data     - passed on to vertex and triangle
+ */
+GLboolean glmScanOBJ(char* filename, GLvoid (*vertex)(GLvoid*, GLfloat*),
+                     GLvoid (*triangle)(GLvoid*, GLuint*), GLvoid* data, mycallback *call){
+    const char* p;
+    const char* q;
+    const char* end;
+    const char* tok;
+    const char* report;
+    char*   file;
+    size_t  size;
+    GLuint  corners, v, t, n, vindices[3];
+    GLfloat position[3];
+    char    afis[256];
+    file = glmMapFile(filename, &size);
+    if (!file)
+        return GL_FALSE;
+    p = file;
+    end = file + size;
+    report = p;
+    while (p < end) {
+        while (p < end && (glmIsBlank(*p) || *p == '\n'))
+            p++;
+        if (p >= end)
+            break;
+        if (call && p - report >= (1 << 24)) {
+            report = p;
+            sprintf(afis, "%s... ", call->text ? call->text : "Scanning");
+            call->loadcallback(call->start + (int)((double)(p - file) / size *
+                                                   (call->end - call->start)), afis);
+        }
+        tok = p;
+        p = glmSkipToken(p, end);
+        if (tok[0] == 'v' && p - tok == 1 && vertex) {
+            p = glmParseFloat(p, end, &position[0]);
+            p = glmParseFloat(p, end, &position[1]);
+            p = glmParseFloat(p, end, &position[2]);
+            vertex(data, position);
+        } else if (tok[0] == 'f' && p - tok == 1 && triangle) {
+            corners = 0;
+            for (;;) {
+                p = glmSkipBlanks(p, end);
+                q = glmParseFaceVertex(p, end, &v, &t, &n);
+                if (q == p)
+                    break;
+                p = q;
+                if (corners < 2) {
+                    vindices[corners] = v;
+                } else {
+                    vindices[2] = v;
+                    triangle(data, vindices);
+                    vindices[1] = v;
+                }
+                corners++;
+            }
+        }
+        p = glmSkipLine(p, end);
+    }
+    glmUnmapFile(file, size);
+    return GL_TRUE;
+}
+
+/* items formatted per glmParallel() call, and calls per batch written */
+#define GLM_WRITE_CHUNK 16384
+#define GLM_WRITE_BATCH 16
+
+/* longest line a formatted item can take: "vn" and three floats of up
+ * to 15 characters, or "f" and three v/t/n corners of 10 digit indices
+ */
+#define GLM_WRITE_LINE 112
+
+/* glmFormatUint: write i in decimal, returns a pointer just past it */
+static inline char* glmFormatUint(char* p, GLuint i){
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + i % 10;
+        i /= 10;
+    } while (i);
+    while (n)
+        *p++ = digits[--n];
+    return p;
+}
+
+/* glmRoundDigits: f (positive) rounded to the given number of
+ * significant digits as mantissa * 10^exponent, where 10^e10 <= f
+ */
+static inline unsigned long long glmRoundDigits(GLfloat f, int e10, int digits, int* exponent){
+    double scaled;
+    int shift;
+    shift = digits - 1 - e10;
+    scaled = (double)f;
+    if (shift > 0 && shift <= 22)
+        scaled *= glmPow10[shift];
+    else if (shift < 0 && shift >= -22)
+        scaled /= glmPow10[-shift];
+    else if (shift)
+        scaled *= pow(10.0, shift);
+    *exponent = -shift;
+    return (unsigned long long)(scaled + 0.5);
+}
+
+/* glmFormatFloat: write the shortest decimal that glmParseFloat() reads
+ * back as exactly f.  Plain notation is used unless the number is very
+ * large or very small.  Returns a pointer just past it.
+ */
+static char* glmFormatFloat(char* p, GLfloat f){
+    unsigned long long mantissa, m;
+    char digits[20];
+    int e10, lo, hi, mid, exponent, e, n, point, i;
+    if (f != f) {
+        memcpy(p, "nan", 3);
+        return p + 3;
+    }
+    if (signbit(f)) {
+        *p++ = '-';
+        f = -f;
+    }
+    if (f == 0.0f) {
+        *p++ = '0';
+        return p;
+    }
+    if (isinf(f)) {
+        memcpy(p, "inf", 3);
+        return p + 3;
+    }
+
+    /* the decimal exponent of the leading digit, estimated from the
+       binary one */
+    frexpf(f, &e10);
+    e10 = (int)floor((e10 - 1) * 0.30102999566398120);
+    if (glmDecimal(1, e10) > f)
+        e10--;
+    else if (glmDecimal(1, e10 + 1) <= f)
+        e10++;
+
+    /* if some number of digits reads back as f so does every longer
+       one, so search for the fewest; 9 digits are always enough for a
+       float */
+    lo = 1;
+    hi = 9;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        m = glmRoundDigits(f, e10, mid, &e);
+        if (glmDecimal(m, e) == f)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    mantissa = glmRoundDigits(f, e10, lo, &exponent);
+    while (mantissa % 10 == 0) {
+        mantissa /= 10;
+        exponent++;
+    }
+
+    /* digits, and where the decimal point goes among them */
+    n = 0;
+    for (m = mantissa; m; m /= 10)
+        digits[n++] = '0' + m % 10;
+    point = n + exponent;
+    if (exponent >= 0 && point <= 9) {
+        while (n)
+            *p++ = digits[--n];
+        for (i = 0; i < exponent; i++)
+            *p++ = '0';
+    } else if (exponent < 0 && point > 0) {
+        for (i = 0; i < point; i++)
+            *p++ = digits[--n];
+        *p++ = '.';
+        while (n)
+            *p++ = digits[--n];
+    } else if (exponent < 0 && point > -4) {
+        *p++ = '0';
+        *p++ = '.';
+        for (i = point; i < 0; i++)
+            *p++ = '0';
+        while (n)
+            *p++ = digits[--n];
+    } else {
+        *p++ = digits[--n];
+        if (n) {
+            *p++ = '.';
+            while (n)
+                *p++ = digits[--n];
+        }
+        *p++ = 'e';
+        e = point - 1;
+        if (e < 0) {
+            *p++ = '-';
+            e = -e;
+        }
+        p = glmFormatUint(p, e);
     }
-    if (model->numtexcoords) {
-        model->texcoords = (GLfloat*)malloc(sizeof(GLfloat) *
-                                            2 * (model->numtexcoords + 1));
+    return p;
+}
+
+/* GLMwriter: what glmWriteItems() is writing, and the buffers the
+ * chunks of a batch are formatted into
+ */
+typedef struct _GLMwriter {
+    GLMmodel*     model;
+    GLuint        mode;           /* face corners to write, as for glmWriteOBJ() */
+    const char*   prefix;         /* "v", "vn" or "vt", or NULL for faces */
+    const GLfloat* vectors;       /* 1-based array of size-float vectors */
+    GLuint        size;
+    const GLuint* triangles;      /* triangles of the group, for faces */
+    GLuint        first;          /* first item of the current batch */
+    GLuint        count;          /* items in all */
+    char*         buffers[GLM_WRITE_BATCH];
+    size_t        lengths[GLM_WRITE_BATCH];
+} GLMwriter;
+
+/* glmWriteChunk: glmParallel() body that formats chunk i of the batch */
+static GLvoid glmWriteChunk(GLuint i, GLvoid* data){
+    GLMwriter* writer = (GLMwriter*)data;
+    GLMmodel*  model = writer->model;
+    GLMtriangle* triangle;
+    GLuint     item, last, k, j;
+    char*      p;
+    item = writer->first + i * GLM_WRITE_CHUNK;
+    last = item + GLM_WRITE_CHUNK < writer->count ? item + GLM_WRITE_CHUNK : writer->count;
+    if (!writer->buffers[i])
+        writer->buffers[i] = (char*)malloc(GLM_WRITE_CHUNK * GLM_WRITE_LINE);
+    p = writer->buffers[i];
+    for (; item < last; item++) {
+        if (writer->prefix) {
+            for (j = 0; writer->prefix[j]; j++)
+                *p++ = writer->prefix[j];
+            for (k = 0; k < writer->size; k++) {
+                *p++ = ' ';
+                p = glmFormatFloat(p, writer->vectors[writer->size * (item + 1) + k]);
+            }
+        } else {
+            triangle = &T(writer->triangles[item]);
+            *p++ = 'f';
+            for (k = 0; k < 3; k++) {
+                *p++ = ' ';
+                p = glmFormatUint(p, triangle->vindices[k]);
+                if (writer->mode & GLM_TEXTURE) {
+                    *p++ = '/';
+                    p = glmFormatUint(p, triangle->tindices[k]);
+                } else if (writer->mode & (GLM_SMOOTH | GLM_FLAT)) {
+                    *p++ = '/';
+                }
+                if (writer->mode & GLM_SMOOTH) {
+                    *p++ = '/';
+                    p = glmFormatUint(p, triangle->nindices[k]);
+                } else if (writer->mode & GLM_FLAT) {
+                    *p++ = '/';
+                    p = glmFormatUint(p, triangle->findex);
+                }
+            }
+        }
+        *p++ = '\n';
     }
-    /* rewind to beginning of file and read in the data this pass */
-    rewind(file);
-    
-    glmSecondPass(model, file,call);
-    /* close the file */
-    fclose(file);
-    return model;
+    writer->lengths[i] = p - writer->buffers[i];
+}
+
+/* glmWriteItems: format count items in parallel, a batch of chunks at
+ * a time, and write them out in order
+ */
+static GLvoid glmWriteItems(GLMwriter* writer, FILE* file, GLuint count){
+    GLuint numchunks, i;
+    writer->count = count;
+    for (writer->first = 0; writer->first < count;
+         writer->first += GLM_WRITE_BATCH * GLM_WRITE_CHUNK) {
+        numchunks = (count - writer->first + GLM_WRITE_CHUNK - 1) / GLM_WRITE_CHUNK;
+        if (numchunks > GLM_WRITE_BATCH)
+            numchunks = GLM_WRITE_BATCH;
+        glmParallel(numchunks, glmWriteChunk, writer);
+        for (i = 0; i < numchunks; i++)
+            fwrite(writer->buffers[i], 1, writer->lengths[i], file);
+    }
+}
+
+/* glmWriteVectors: write a 1-based array of vectors, one per line */
+static GLvoid glmWriteVectors(GLMwriter* writer, FILE* file, const char* prefix,
+                              const GLfloat* vectors, GLuint size, GLuint count){
+    writer->prefix  = prefix;
+    writer->vectors = vectors;
+    writer->size    = size;
+    glmWriteItems(writer, file, count);
 }
 
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
- * a file.
+ * a file.  The numbers are formatted on glmParallel() threads into
+ * buffers that are written out in order; floats get the fewest digits
+ * that glmReadOBJ() reads back as the same value.
  *
  * model - initialized GLMmodel structure
  * filename - name of the file to write the Wavefront .OBJ format data to
@@ -1438,6 +3042,7 @@ GLvoid glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode){
     GLuint  i;
     FILE*   file;
     GLMgroup* group;  
+    GLMwriter writer;
     assert(model);
     /* do a bit of warning */
     if (mode & GLM_FLAT && !model->facetnorms) {
@@ -1501,45 +3106,29 @@ GLvoid glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode){
     }
     
     /* spit out the vertices */
+    memset(&writer, 0, sizeof(GLMwriter));
+    writer.model = model;
+    writer.mode = mode;
     fprintf(file, "\n");
     fprintf(file, "# %d vertices\n", model->numvertices);
-    for (i = 1; i <= model->numvertices; i++) {
-        fprintf(file, "v %f %f %f\n", 
-                model->vertices[3 * i + 0],
-                model->vertices[3 * i + 1],
-                model->vertices[3 * i + 2]);
-    }
+    glmWriteVectors(&writer, file, "v", model->vertices, 3, model->numvertices);
     
     /* spit out the smooth/flat normals */
     if (mode & GLM_SMOOTH) {
         fprintf(file, "\n");
         fprintf(file, "# %d normals\n", model->numnormals);
-        for (i = 1; i <= model->numnormals; i++) {
-            fprintf(file, "vn %f %f %f\n", 
-                    model->normals[3 * i + 0],
-                    model->normals[3 * i + 1],
-                    model->normals[3 * i + 2]);
-        }
+        glmWriteVectors(&writer, file, "vn", model->normals, 3, model->numnormals);
     } else if (mode & GLM_FLAT) {
         fprintf(file, "\n");
         fprintf(file, "# %d normals\n", model->numfacetnorms);
-        for (i = 1; i <= model->numnormals; i++) {
-            fprintf(file, "vn %f %f %f\n", 
-                    model->facetnorms[3 * i + 0],
-                    model->facetnorms[3 * i + 1],
-                    model->facetnorms[3 * i + 2]);
-        }
+        glmWriteVectors(&writer, file, "vn", model->facetnorms, 3, model->numfacetnorms);
     }
     
     /* spit out the texture coordinates */
     if (mode & GLM_TEXTURE) {
         fprintf(file, "\n");
-        fprintf(file, "# %d texcoords\n", model->texcoords);
-        for (i = 1; i <= model->numtexcoords; i++) {
-            fprintf(file, "vt %f %f\n", 
-                    model->texcoords[2 * i + 0],
-                    model->texcoords[2 * i + 1]);
-        }
+        fprintf(file, "# %d texcoords\n", model->numtexcoords);
+        glmWriteVectors(&writer, file, "vt", model->texcoords, 2, model->numtexcoords);
     }
     
     fprintf(file, "\n");
@@ -1547,71 +3136,71 @@ GLvoid glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode){
     fprintf(file, "# %d faces (triangles)\n", model->numtriangles);
     fprintf(file, "\n");
     
+    writer.prefix = NULL;
     group = model->groups;
     while(group) {
         fprintf(file, "g %s\n", group->name);
         if (mode & GLM_MATERIAL)
             fprintf(file, "usemtl %s\n", model->materials[group->material].name);
-        for (i = 0; i < group->numtriangles; i++) {
-            if (mode & GLM_SMOOTH && mode & GLM_TEXTURE) {
-                fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).nindices[0],
-                        T(group->triangles[i]).tindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).nindices[1],
-                        T(group->triangles[i]).tindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).nindices[2],
-                        T(group->triangles[i]).tindices[2]);
-            } else if (mode & GLM_FLAT && mode & GLM_TEXTURE) {
-                fprintf(file, "f %d/%d %d/%d %d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).findex);
-            } else if (mode & GLM_TEXTURE) {
-                fprintf(file, "f %d/%d %d/%d %d/%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).tindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).tindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).tindices[2]);
-            } else if (mode & GLM_SMOOTH) {
-                fprintf(file, "f %d//%d %d//%d %d//%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).nindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).nindices[1],
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).nindices[2]);
-            } else if (mode & GLM_FLAT) {
-                fprintf(file, "f %d//%d %d//%d %d//%d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).findex,
-                        T(group->triangles[i]).vindices[2],
-                        T(group->triangles[i]).findex);
-            } else {
-                fprintf(file, "f %d %d %d\n",
-                        T(group->triangles[i]).vindices[0],
-                        T(group->triangles[i]).vindices[1],
-                        T(group->triangles[i]).vindices[2]);
-            }
-        }
+        writer.triangles = group->triangles;
+        glmWriteItems(&writer, file, group->numtriangles);
         fprintf(file, "\n");
         group = group->next;
     }
     
+    for (i = 0; i < GLM_WRITE_BATCH; i++)
+        free(writer.buffers[i]);
     fclose(file);
 }
 
+/* GLMbatch: a group of the model with the state glmDraw() draws it in */
+typedef struct _GLMbatch {
+    GLuint    textureid;          /* texture of the group's material */
+    GLuint    material;           /* index to material for group */
+    GLuint    index;              /* position of the group in the model */
+    GLMgroup* group;
+} GLMbatch;
+
+/* glmCompareBatches: order batches by texture, then material, then
+ * where the groups are in the file
+ */
+static int glmCompareBatches(const void* a, const void* b){
+    const GLMbatch* x = (const GLMbatch*)a;
+    const GLMbatch* y = (const GLMbatch*)b;
+    if (x->textureid != y->textureid)
+        return x->textureid < y->textureid ? -1 : 1;
+    if (x->material != y->material)
+        return x->material < y->material ? -1 : 1;
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+/* glmBatchGroups: collects the groups glmDraw() draws (only the one
+ * named drawonly if it is not NULL) sorted so that groups sharing a
+ * material are next to each other.  Returns the number of batches.
+ */
+static GLuint glmBatchGroups(GLMmodel* model, char* drawonly, GLMbatch* batches){
+    GLMgroup* group;
+    GLuint    i, numbatches;
+    numbatches = 0;
+    for (group = model->groups, i = 0; group; group = group->next, i++) {
+        if (drawonly && strcmp(group->name, drawonly))
+            continue;
+        batches[numbatches].material = group->material;
+        batches[numbatches].textureid = model->materials ?
+            model->materials[group->material].textureid : (GLuint)-1;
+        batches[numbatches].index = i;
+        batches[numbatches].group = group;
+        numbatches++;
+    }
+    qsort(batches, numbatches, sizeof(GLMbatch), glmCompareBatches);
+    return numbatches;
+}
+
 /* glmDraw: Renders the model to the current OpenGL context using the
- * mode specified.
+ * mode specified.  Groups that share a material are drawn together, in
+ * one glBegin()/glEnd(), and the material and texture are only set
+ * when they change, so the state changes go with the number of
+ * materials rather than the number of groups.
  *
  * model - initialized GLMmodel structure
  * mode  - a bitwise OR of values describing what is to be rendered.
@@ -1619,7 +3208,8 @@ GLvoid glmWriteOBJ(GLMmodel* model, char* filename, GLuint mode){
  *             GLM_FLAT     -  render with facet normals
  *             GLM_SMOOTH   -  render with vertex normals
  *             GLM_TEXTURE  -  render with texture coords
- *             GLM_COLOR    -  render with colors (color material)
+ *             GLM_COLOR    -  render with colors (color material, or the
+ *                             vertex colors if the model has them)
  *             GLM_MATERIAL -  render with materials
  *             GLM_COLOR and GLM_MATERIAL should not both be specified.  
  *             GLM_FLAT and GLM_SMOOTH should not both be specified.  
@@ -1629,10 +3219,11 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode){
     glmDraw(model,mode,0);
 }
 GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
-    static GLuint i;
-    static GLMgroup* group;
-    static GLMtriangle* triangle;
-    static GLMmaterial* material;
+    GLuint i, b, numbatches;
+    GLMbatch* batches;
+    GLMgroup* group;
+    GLMtriangle* triangle;
+    GLMmaterial* material;
     GLuint textureid;
     assert(model);
     assert(model->vertices);
@@ -1657,9 +3248,9 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
                "and smooth render mode requested (using smooth).\n");
         mode &= ~GLM_FLAT;
     }
-    if (mode & GLM_COLOR && !model->materials) {
+    if (mode & GLM_COLOR && !model->materials && !model->colors) {
         printf("glmDraw() warning: color render mode requested "
-               "with no materials defined.\n");
+               "with no materials or vertex colors defined.\n");
         mode &= ~GLM_COLOR;
     }
     if (mode & GLM_MATERIAL && !model->materials) {
@@ -1685,41 +3276,39 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
        schemes (and these branches will always go one way), probably
        wouldn't gain too much?  */
     
-    textureid = -1;
-    group = model->groups;
-    while (group)  {
-        if (drawonly)
-            if (strcmp(group->name,drawonly))  {
-            group=group->next;
-            continue;
-         }
-
-        material = &model->materials[group->material];
-        if (material) {
-            textureid = material->textureid;
+    batches = (GLMbatch*)malloc(sizeof(GLMbatch) * (model->numgroups + 1));
+    numbatches = glmBatchGroups(model, drawonly, batches);
+    for (b = 0; b < numbatches; b++)  {
+        group = batches[b].group;
+
+        /* the groups of a batch go in one glBegin()/glEnd() */
+        if (b == 0 || batches[b].material != batches[b - 1].material)  {
+            if (b > 0)
+                glEnd();
+
+            material = &model->materials[batches[b].material];
+            if (mode & GLM_MATERIAL)  {
+                glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+                glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+                glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+                glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+            }
 
-        }
-        else textureid = -1;
-        if (mode & GLM_MATERIAL)  {
-            glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
-            glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
-            glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
-        }
+            textureid = batches[b].textureid;
+            if (mode & GLM_TEXTURE && (b == 0 || textureid != batches[b - 1].textureid))  {
+                if(textureid == (GLuint)-1)
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                else{
+                    glBindTexture(GL_TEXTURE_2D, model->textures[textureid].id);
+                }
+            }
 
-        if (mode & GLM_TEXTURE)  {
-            if(textureid == -1)
-                glBindTexture(GL_TEXTURE_2D, 0);
-            else{
-                glBindTexture(GL_TEXTURE_2D, model->textures[textureid].id);
+            if (mode & GLM_COLOR && !model->colors) {
+                glColor3fv(material->diffuse);
             }
+
+            glBegin(GL_TRIANGLES);
         }
-        
-        if (mode & GLM_COLOR) {
-            glColor3fv(material->diffuse);
-        }
-        
-        glBegin(GL_TRIANGLES);
         for (i = 0; i < group->numtriangles; i++) {
             triangle = &T(group->triangles[i]);
 #ifdef DebugVisibleSurfaces
@@ -1732,6 +3321,8 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
                 glNormal3fv(&model->normals[3 * triangle->nindices[0]]);
             if (mode & GLM_TEXTURE)
                 glTexCoord2fv(&model->texcoords[2 * triangle->tindices[0]]);
+            if (mode & GLM_COLOR && model->colors)
+                glColor4ubv(&model->colors[4 * triangle->vindices[0]]);
             glVertex3fv(&model->vertices[3 * triangle->vindices[0]]);
             
             if (mode & GLM_SMOOTH)
@@ -1740,19 +3331,23 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode,char *drawonly){
 	    {
 		glTexCoord2fv(&model->texcoords[2 * triangle->tindices[1]]);
             }
+            if (mode & GLM_COLOR && model->colors)
+                glColor4ubv(&model->colors[4 * triangle->vindices[1]]);
             glVertex3fv(&model->vertices[3 * triangle->vindices[1]]);
             
             if (mode & GLM_SMOOTH)
                 glNormal3fv(&model->normals[3 * triangle->nindices[2]]);
             if (mode & GLM_TEXTURE)
                 glTexCoord2fv(&model->texcoords[2 * triangle->tindices[2]]);
+            if (mode & GLM_COLOR && model->colors)
+                glColor4ubv(&model->colors[4 * triangle->vindices[2]]);
             glVertex3fv(&model->vertices[3 * triangle->vindices[2]]);
             
         }
-        glEnd();
-        
-        group = group->next;
     }
+    if (numbatches)
+        glEnd();
+    free(batches);
 }
 
 /* glmList: Generates and returns a display list for the model using
@@ -1789,6 +3384,7 @@ GLuint glmList(GLMmodel* model, GLuint mode){
 GLvoid  glmWeld(GLMmodel* model, GLfloat epsilon){
     GLfloat* vectors;
     GLfloat* copies;
+    GLubyte* colors;
     GLuint   numvectors;
     GLuint   i;
     
@@ -1807,9 +3403,19 @@ GLvoid  glmWeld(GLMmodel* model, GLfloat epsilon){
         T(i).vindices[1] = (GLuint)vectors[3 * T(i).vindices[1] + 0];
         T(i).vindices[2] = (GLuint)vectors[3 * T(i).vindices[2] + 0];
     }
+
+    /* a welded vertex keeps the color of the last vertex welded into it */
+    if (model->colors) {
+        colors = (GLubyte*)malloc(sizeof(GLubyte) * 4 * (numvectors + 1));
+        memset(colors, 0, sizeof(GLubyte) * 4);
+        for (i = 1; i <= model->numvertices; i++)
+            memcpy(&colors[4 * (GLuint)vectors[3 * i + 0]], &model->colors[4 * i], sizeof(GLubyte) * 4);
+        glmFree(model, model->colors);
+        model->colors = colors;
+    }
     
     /* free space for old vertices */
-    free(vectors);
+    glmFree(model, vectors);
     
     /* allocate space for the new vertices */
     model->numvertices = numvectors;
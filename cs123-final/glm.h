@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdio.h>
+
 #ifndef M_PI
 #define M_PI 3.14159265f
 #endif
@@ -11,6 +14,17 @@
 #define GLM_COLOR    (1 << 3)       /* render with colors */
 #define GLM_MATERIAL (1 << 4)       /* render with materials */
 #define GLM_BUMP     (1 << 5)       /* render with bump map */
+#define GLM_QUANTIZE (1 << 6)       /* glmMesh(): pack the vertex attributes */
+
+/* processing applied by glmReadOBJCached() and kept in the cache */
+#define GLM_VERTEX_CACHE (1 << 0)   /* glmVertexCache() the model */
+#define GLM_MESHLETS     (1 << 1)   /* glmMeshletOrder() the model */
+
+/* glmReadOBJCached() options that don't change what's in the cache */
+#define GLM_DEFER_TEXTURES (1 << 16) /* leave the textures to glmLoadTextures() */
+
+/* triangles per meshlet */
+#define GLM_MESHLET_SIZE 64
 
 /* GLMmaterial: Structure that defines a material in a model. 
  */
@@ -57,6 +71,16 @@ typedef struct _GLMgroup {
     struct _GLMgroup* next;           /* pointer to next group in model */
 } GLMgroup;
 
+/* GLMarena: One block of memory that the arrays, names and groups of
+ * a loaded model are carved out of.  The blocks of a model are chained
+ * and glmDelete() releases them all at once.
+ */
+typedef struct _GLMarena {
+    struct _GLMarena* next;       /* block allocated before this one */
+    size_t   size;                /* bytes this block can hand out */
+    size_t   used;                /* bytes handed out so far */
+} GLMarena;
+
 /* GLMmodel: Structure that defines a model.
  */
 typedef struct _GLMmodel {
@@ -65,6 +89,7 @@ typedef struct _GLMmodel {
 
     GLuint   numvertices;         /* number of vertices in model */
     GLfloat* vertices;            /* array of vertices  */
+    GLubyte* colors;              /* array of vertex colors (RGBA), or NULL */
 
     GLuint   numnormals;          /* number of normals in model */
     GLfloat* normals;             /* array of normals */
@@ -90,8 +115,200 @@ typedef struct _GLMmodel {
 
     GLfloat position[3];          /* position of the model */
 
+    GLvoid*  mapping;             /* binary cache the arrays point into */
+    size_t   mappingsize;         /* length of the mapped cache */
+
+    GLMarena* arena;              /* blocks glmAlloc() hands out from */
+
 } GLMmodel;
 
+/* GLMmeshgroup: the part of a mesh that draws one group of a model.
+ * The group's vertices are contiguous in the vertex buffer and its
+ * indices count from the first of them.
+ */
+typedef struct _GLMmeshgroup {
+    GLMgroup* group;              /* group of the model this draws */
+    GLuint    material;           /* index to material for group */
+    GLuint    basevertex;         /* first vertex of the group */
+    GLuint    numvertices;        /* number of vertices of the group */
+    GLuint    first;              /* byte offset of the first index */
+    GLuint    count;              /* number of indices */
+    GLenum    type;               /* GL_UNSIGNED_SHORT or GL_UNSIGNED_INT */
+} GLMmeshgroup;
+
+/* GLMmeshlet: a run of triangles of a mesh group that is culled as a
+ * whole.  The normal cone is set up so that every triangle faces away
+ * from an eye e if dot(center - e, axis) >= cutoff * |center - e| +
+ * radius (cutoff is 1 if the triangles face too many ways for that).
+ */
+typedef struct _GLMmeshlet {
+    GLuint  group;                /* index of the mesh group */
+    GLuint  first;                /* byte offset of the first index */
+    GLuint  count;                /* number of indices */
+    GLfloat center[3];            /* bounding sphere */
+    GLfloat radius;
+    GLfloat axis[3];              /* normal cone */
+    GLfloat cutoff;
+} GLMmeshlet;
+
+/* GLMmesh: Structure that holds a model in vertex and index buffers.
+ * Every distinct (vertex, normal, texcoord) combination of the model
+ * is stored once, interleaved as position, normal, texcoord.
+ */
+typedef struct _GLMmesh {
+    GLuint  mode;                 /* GLM_FLAT/GLM_SMOOTH/GLM_TEXTURE/GLM_QUANTIZE it was built with */
+    GLuint  stride;               /* bytes per vertex */
+    GLuint  normaloffset;         /* byte offset of the normal (0 = none) */
+    GLuint  texcoordoffset;       /* byte offset of the texcoord (0 = none) */
+    GLuint  numvertices;          /* number of vertices in the buffer */
+    GLuint  numindices;           /* number of indices in the buffer */
+    GLuint  vbo;                  /* vertex buffer object */
+    GLuint  ibo;                  /* index buffer object */
+    GLint   attributes[3];        /* generic attribute locations, -1 = fixed function */
+    GLfloat scale[3];             /* GLM_QUANTIZE positions are q * scale + bias */
+    GLfloat bias[3];
+
+    GLuint        numgroups;      /* number of groups in mesh */
+    GLMmeshgroup* groups;         /* array of groups, in model order */
+
+    GLuint        nummeshlets;    /* number of meshlets (0 = none) */
+    GLMmeshlet*   meshlets;       /* array of meshlets, in group order */
+} GLMmesh;
+
+/* GLMvsplit: a vertex split of a progressive mesh, the inverse of one
+ * edge collapse.  It brings in the next vertex and appends the
+ * triangles that the collapse removed.
+ */
+typedef struct _GLMvsplit {
+    GLuint  vertex;               /* vertex that splits in two */
+    GLfloat position[3];          /* where it goes back to */
+    GLuint  numtriangles;         /* triangles it brings back */
+    GLuint  numcorners;           /* corners it moves over to the new vertex */
+} GLMvsplit;
+
+/* GLMprogressive: a progressive mesh, a coarse base mesh plus the vertex
+ * splits that refine it back into the full model.  Vertices and
+ * triangles are ordered so that each split adds the next vertex and the
+ * next few triangles: any number of splits draws out of a prefix of the
+ * vertex and index arrays.  Indices are 1-based like GLMmodel's.
+ */
+typedef struct _GLMprogressive {
+    GLuint     numvertices;       /* vertices of the full mesh */
+    GLuint     numtriangles;      /* triangles of the full mesh */
+    GLuint     numsplits;         /* number of vertex splits */
+    GLuint     numcorners;        /* corners moved by all the splits */
+    GLuint     basevertices;      /* vertices of the base mesh */
+    GLuint     basetriangles;     /* triangles of the base mesh */
+
+    GLfloat*   vertices;          /* position of each vertex as it comes in */
+    GLfloat*   normals;           /* normal of each vertex in the full mesh */
+    GLuint*    indices;           /* vertices of each triangle as it comes in */
+    GLMvsplit* splits;            /* array of vertex splits */
+    GLuint*    corners;           /* 3 * triangle + corner for every moved corner */
+
+    volatile GLuint numloaded;    /* splits read so far by glmStreamProgressive() */
+    GLuint     loadedtriangles;   /* triangles read so far */
+    GLuint     loadedcorners;     /* corners read so far */
+    FILE*      file;              /* where the rest is streamed from, or NULL */
+
+    GLuint     numapplied;        /* splits glmRefineProgressive() has applied */
+    GLuint     numdrawn;          /* triangles that are drawn */
+    GLuint     nextcorner;        /* first corner of the next split */
+    GLuint     vbo;               /* positions, then normals (0 = not built yet) */
+    GLuint     ibo;               /* indices */
+} GLMprogressive;
+
+/* GLMbrick: a spatial brick of a paged mesh */
+typedef struct _GLMbrick {
+    GLfloat    min[3], max[3];    /* bounding box */
+    unsigned long long offset;    /* of its vertices in the brick file */
+    GLuint     numtriangles;      /* triangles (3 vertices each) */
+    GLuint     vbo;               /* vertex buffer while paged in, else 0 */
+    GLuint     frame;             /* last frame it was visible in */
+    GLint      prev, next;        /* recently used list of paged in bricks */
+} GLMbrick;
+
+/* GLMbrickorder: a visible brick and its distance from the eye */
+typedef struct _GLMbrickorder {
+    GLuint     brick;
+    GLfloat    distance;
+} GLMbrickorder;
+
+/* GLMpaged: a mesh too large to load, cut into bricks on disk by
+ * glmBrickOBJ() that are paged in as they come into view.
+ */
+typedef struct _GLMpaged {
+    int        fd;                /* the brick file */
+    GLuint     numbricks;         /* number of bricks */
+    GLMbrick*  bricks;            /* array of bricks */
+    GLuint     numtriangles;      /* triangles of all the bricks */
+    GLfloat    min[3], max[3];    /* bounding box of the mesh */
+
+    size_t     budget;            /* most bytes of bricks to keep paged in */
+    size_t     resident;          /* bytes of bricks paged in */
+    GLuint     maxpageins;        /* most bricks to page in per frame */
+    GLuint     frame;             /* frames drawn */
+    GLint      first, last;       /* most and least recently used bricks */
+    GLMbrickorder* order;         /* scratch space for sorting bricks */
+} GLMpaged;
+
+/* GLMbvhnode: a node of a GLMbvh, 32 bytes.  The left child of an
+ * inner node is the node after it and its right child is node offset;
+ * a leaf holds the count triangles from triangle offset of the BVH.
+ */
+typedef struct _GLMbvhnode {
+    GLfloat  min[3];              /* bounding box */
+    GLuint   offset;              /* right child, or first triangle of a leaf */
+    GLfloat  max[3];
+    GLushort count;               /* triangles of a leaf, 0 for inner nodes */
+    GLushort axis;                /* axis an inner node is split along */
+} GLMbvhnode;
+
+/* GLMbvh: a bounding volume hierarchy over the triangles of a model */
+typedef struct _GLMbvh {
+    GLuint      numnodes;         /* number of nodes */
+    GLMbvhnode* nodes;            /* array of nodes, the root first */
+    GLuint      numtriangles;     /* number of triangles */
+    GLuint*     triangles;        /* model triangle of each, in leaf order */
+    GLfloat*    corners;          /* first corner and two edges of each */
+} GLMbvh;
+
+/* GLMhit: where a ray hits a model */
+typedef struct _GLMhit {
+    GLuint  triangle;             /* index of the triangle hit */
+    GLfloat t;                    /* distance along the ray */
+    GLfloat u, v;                 /* barycentric coords of the hit on it */
+} GLMhit;
+
+/* GLMdeform: a model whose vertices move every frame.  Each vertex has
+ * a single normal, the area weighted average of the facets around it,
+ * and the triangles around each vertex are kept so that only the
+ * normals near moved vertices need recomputing.  Indices are 1-based
+ * like GLMmodel's.
+ */
+typedef struct _GLMdeform {
+    GLuint   numvertices;         /* number of vertices */
+    GLuint   numtriangles;        /* number of triangles */
+    GLfloat* rest;                /* where the vertices move from */
+    GLfloat* restnormals;         /* vertex normals at rest */
+    GLfloat* vertices;            /* where the vertices are now */
+    GLfloat* normals;             /* vertex normals now */
+    GLfloat* facetnorms;          /* facet normals now, scaled by twice the area */
+    GLuint*  indices;             /* vertices of each triangle */
+    GLuint*  offsets;             /* first entry in adjacency of each vertex */
+    GLuint*  adjacency;           /* triangles around each vertex */
+    GLubyte* moved;               /* vertices the last glmDeform() moved */
+    GLubyte* facets;              /* triangles being updated (all 0 between calls) */
+    GLubyte* stale;               /* vertices being updated (all 0 between calls) */
+    GLuint*  vertexlist;          /* moved, then stale vertices, while updating */
+    GLuint*  trianglelist;        /* changed triangles, while updating */
+    GLuint   nummoved;            /* vertices the last glmDeform() moved */
+    GLuint   numnormals;          /* vertex normals it recomputed */
+    GLuint   first, last;         /* vertices to upload (first > last = none) */
+    GLuint   vbo;                 /* positions, then normals (0 = not built yet) */
+    GLuint   ibo;                 /* indices */
+} GLMdeform;
+
 struct mycallback
 {
     void (*loadcallback)(int,char *);
@@ -182,6 +399,15 @@ GLvoid glmLinearTexture(GLMmodel* model);
  */
 GLvoid glmSpheremapTexture(GLMmodel* model);
 
+/* glmSphere: Builds a sphere around the origin as a model with vertex
+ * normals and texture coordinates, laid out like gluSphere().
+ *
+ * radius - radius of the sphere
+ * slices - subdivisions around the Z axis
+ * stacks - subdivisions along the Z axis
+ */
+GLMmodel* glmSphere(GLfloat radius, GLuint slices, GLuint stacks);
+
 /* glmDelete: Deletes a GLMmodel structure.
  *
  * model - initialized GLMmodel structure
@@ -190,7 +416,8 @@ GLvoid glmDelete(GLMmodel* model);
 
 /* glmReadOBJ: Reads a model description from a Wavefront .OBJ file.
  * Returns a pointer to the created object which should be free'd with
- * glmDelete().
+ * glmDelete().  gzip compressed files (and zstd ones, in a build with
+ * GLM_ZSTD) are decompressed as they are parsed.
  *
  * filename - name of the file containing the Wavefront .OBJ format data.  
  */
@@ -198,8 +425,79 @@ GLvoid glmDelete(GLMmodel* model);
 GLMmodel* glmReadOBJ(char* filename);
 GLMmodel* glmReadOBJ(char* filename,mycallback *call);
 
+/* glmReadOBJParallel: Same as glmReadOBJ(), but splits the file into
+ * pieces at line boundaries and parses them on several threads.  Group
+ * and material assignment is replayed in file order afterwards, so the
+ * model is identical to the one glmReadOBJ() returns.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of threads to use (0 = glmNumThreads())
+ */
+GLMmodel* glmReadOBJParallel(char* filename, GLuint numthreads, mycallback *call);
+
+/* glmReadOBJDeferred: Same as glmReadOBJParallel(), but leaves loading
+ * the textures to glmLoadTextures(), so that it can run on a thread
+ * without an OpenGL context.
+ */
+GLMmodel* glmReadOBJDeferred(char* filename, GLuint numthreads, mycallback *call);
+
+/* glmReadOBJCached: Reads a model through a binary cache kept next to
+ * the .OBJ file (filename + ".glmc").  If the cache is up to date with
+ * the .OBJ (same size and modification time, or same contents hash)
+ * and was built with the same flags it is mapped and the model's
+ * arrays point straight into it; otherwise the .OBJ is parsed with
+ * glmReadOBJParallel(), processed as the flags ask and the cache is
+ * (re)written.  Free the model with glmDelete() as usual.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of threads to parse on if the cache is stale
+ * flags      - a bitwise OR of the processing to apply
+ *              GLM_VERTEX_CACHE - reorder for the vertex cache
+ *              GLM_MESHLETS     - reorder into meshlets (and for the
+ *                                 vertex cache within them)
+ *              GLM_DEFER_TEXTURES - don't load the textures (to read
+ *                                 on a thread without a GL context)
+ */
+GLMmodel* glmReadOBJCached(char* filename, GLuint numthreads, GLuint flags, mycallback *call);
+
+/* glmReadPLY: Reads a model from a Stanford .PLY file, ASCII or binary
+ * in either byte order.  Vertex colors go into model->colors, vertex
+ * normals (if the file has them) into model->normals and the triangles
+ * into a single group.  Returns NULL if the file can't be read.  Free
+ * the model with glmDelete() as usual.
+ *
+ * filename - name of the file containing the .PLY data.
+ */
+GLMmodel* glmReadPLY(char* filename, mycallback *call);
+
+/* glmScanOBJ: Walks through a Wavefront .OBJ file without building a
+ * model (for files larger than memory), calling vertex() with every
+ * vertex position and triangle() with the vertex indices of every
+ * triangle.  Returns GL_FALSE if the file can't be opened.
+ *
+ * filename - name of the file containing the Wavefront .OBJ format data.
+ * vertex   - called for every vertex, or NULL
+ * triangle - called for every triangle (polygons become fans), or NULL
+ * data     - passed on to vertex and triangle
+ */
+GLboolean glmScanOBJ(char* filename, GLvoid (*vertex)(GLvoid*, GLfloat*),
+                     GLvoid (*triangle)(GLvoid*, GLuint*), GLvoid* data, mycallback *call);
+
+/* glmWriteCache: Writes a model to a binary cache file that
+ * glmReadOBJCached() can map.  Returns GL_FALSE if the file couldn't be
+ * written.
+ *
+ * model     - initialized GLMmodel structure
+ * cachename - name of the cache file to write
+ * flags     - processing that was applied to the model
+ * srcsize, srcmtime, srchash - identity of the .OBJ the model came from
+ */
+GLboolean glmWriteCache(GLMmodel* model, char* cachename, GLuint flags, unsigned long long srcsize,
+                        unsigned long long srcmtime, unsigned long long srchash);
+
 /* glmWriteOBJ: Writes a model description in Wavefront .OBJ format to
- * a file.
+ * a file.  Lines are formatted in parallel and floats are written with
+ * the fewest digits that glmReadOBJ() reads back as the same value.
  *
  * model    - initialized GLMmodel structure
  * filename - name of the file to write the Wavefront .OBJ format data to
@@ -238,6 +536,313 @@ GLvoid glmDraw(GLMmodel* model, GLuint mode);
  */
 GLuint glmList(GLMmodel* model, GLuint mode);
 
+/* glmMesh: Builds vertex and index buffers for the model in the current
+ * OpenGL context.  The index buffer uses 16-bit indices for every group
+ * that has few enough vertices.
+ *
+ * With GLM_QUANTIZE the vertices are packed into 8 to 16 bytes instead
+ * of 12 to 32: positions as three shorts spanning the bounds of the
+ * mesh (a shader gets the position back as q * mesh->scale +
+ * mesh->bias), normals as two shorts of an octahedral encoding (divide
+ * by 32767 and unfold) and texcoords as half floats.  Only a shader can
+ * decode them, so such a mesh has to be drawn through
+ * glmMeshAttributes().
+ *
+ * model    - initialized GLMmodel structure
+ * mode     - a bitwise OR of the attributes to put in the buffer.
+ *            GLM_NONE     -  only vertices
+ *            GLM_FLAT     -  facet normals
+ *            GLM_SMOOTH   -  vertex normals
+ *            GLM_TEXTURE  -  texture coords
+ *            GLM_QUANTIZE -  pack the attributes as above
+ *            GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+GLMmesh* glmMesh(GLMmodel* model, GLuint mode);
+
+/* glmMeshAttributes: Makes glmDrawMesh() feed the mesh through generic
+ * vertex attributes (for shaders on contexts without the fixed function
+ * arrays) instead of glVertexPointer() and friends.  Pass -1 for an
+ * attribute the shader doesn't use, or -1 for all of them to go back to
+ * the fixed function arrays.
+ */
+GLvoid glmMeshAttributes(GLMmesh* mesh, GLint position, GLint normal, GLint texcoord);
+
+/* glmDrawMesh: Renders a mesh built by glmMesh() with glDrawElements().
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * mode     - a bitwise OR of values describing what is to be rendered.
+ *            GLM_TEXTURE  -  bind the textures of the materials
+ *            GLM_COLOR    -  render with colors (color material)
+ *            GLM_MATERIAL -  render with materials
+ *            Normals and texcoords are drawn if the mesh has them.
+ */
+GLvoid glmDrawMesh(GLMmodel* model, GLMmesh* mesh, GLuint mode);
+
+/* glmDrawMeshInstanced: Renders count instances of a mesh in one
+ * instanced draw per group.  The bound shader places each instance,
+ * from gl_InstanceID or per instance attributes (glVertexAttribDivisor()).
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * mode     - as for glmDrawMesh()
+ * count    - number of instances
+ */
+GLvoid glmDrawMeshInstanced(GLMmodel* model, GLMmesh* mesh, GLuint mode, GLsizei count);
+
+/* glmMeshlets: Splits every group of a mesh into meshlets of size
+ * triangles and works out their bounding spheres and normal cones.
+ * The model should have been through glmMeshletOrder() with the same
+ * size, so that every meshlet is a compact patch.
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * size     - number of triangles per meshlet
+ */
+GLvoid glmMeshlets(GLMmodel* model, GLMmesh* mesh, GLuint size);
+
+/* glmDrawMeshlets: Renders a mesh like glmDrawMesh(), but leaves out
+ * the meshlets that are outside the view frustum of the current
+ * projection and modelview matrices, or (with back faces culled) face
+ * away from the eye.
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh(), with glmMeshlets()
+ * mode     - as for glmDrawMesh()
+ * drawn    - if not NULL, the number of meshlets drawn is added to it
+ * culled   - if not NULL, the number of meshlets culled is added to it
+ */
+GLvoid glmDrawMeshlets(GLMmodel* model, GLMmesh* mesh, GLuint mode, GLuint* drawn, GLuint* culled);
+
+/* glmFrustum: Gets the planes of the view frustum of the current
+ * projection and modelview matrices, in object space.  Each plane is
+ * (a, b, c, d) with a*x + b*y + c*z + d >= 0 on the inside; they are
+ * left, right, bottom, top, near and far.
+ *
+ * planes - receives the planes
+ */
+GLvoid glmFrustum(GLfloat planes[6][4]);
+
+/* glmDeleteMesh: Deletes a mesh and its buffers.
+ *
+ * mesh     - mesh returned by glmMesh()
+ */
+GLvoid glmDeleteMesh(GLMmesh* mesh);
+
+/* glmVertexCache: Reorders the triangles of each group of a model for
+ * the post-transform vertex cache (Forsyth's algorithm), then renumbers
+ * vertices, normals, texcoords and facet normals in the order the
+ * triangles use them and stores the triangles in drawing order.
+ * Drawing the model gives the same picture as before.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid glmVertexCache(GLMmodel* model);
+
+/* glmMeshletOrder: Like glmVertexCache(), but first splits every group
+ * into clusters of size triangles that hang together, so that every
+ * meshlet glmMeshlets() makes of the group covers a small patch.
+ *
+ * model - initialized GLMmodel structure
+ * size  - number of triangles per cluster
+ */
+GLvoid glmMeshletOrder(GLMmodel* model, GLuint size);
+
+/* glmVertexCacheStats: Simulates a FIFO post-transform vertex cache
+ * while the groups of a model are drawn.
+ *
+ * model     - initialized GLMmodel structure
+ * cachesize - number of vertices the cache holds
+ * acmr      - will contain the average cache miss ratio (vertices
+ *             transformed per triangle, 0.5 - 3.0) on return
+ * atvr      - will contain the average transformed vertex ratio
+ *             (vertices transformed per vertex used, 1.0 is perfect)
+ */
+GLvoid glmVertexCacheStats(GLMmodel* model, GLuint cachesize, GLfloat* acmr, GLfloat* atvr);
+
+/* glmSimplify: Simplifies a model by quadric error metric edge
+ * collapses.  Returns a new model with the same groups and about ratio
+ * times the triangles; only positions, vertex colors and texcoords
+ * are kept, so generate normals with glmFacetNormals() and
+ * glmVertexNormals().
+ * Materials and textures are not copied (groups keep their material
+ * index): draw it with glmDrawMesh(model, mesh, mode) using the
+ * original model.
+ *
+ * model - initialized GLMmodel structure
+ * ratio - fraction of the triangles to keep (0.5 = half)
+ */
+GLMmodel* glmSimplify(GLMmodel* model, GLfloat ratio);
+
+/* glmProgressive: Builds a progressive mesh out of a model by running
+ * glmSimplify()'s collapses down to a base mesh of about ratio times
+ * the triangles.  Only positions and one normal per vertex are kept.
+ *
+ * model - initialized GLMmodel structure
+ * ratio - fraction of the triangles in the base mesh (0.01 = 1%)
+ */
+GLMprogressive* glmProgressive(GLMmodel* model, GLfloat ratio);
+
+/* glmWriteProgressive: Writes a progressive mesh next to the .OBJ it
+ * was built from, as <name>.obj.glmp, base mesh first and then the
+ * splits in order.  Returns GL_FALSE if the file couldn't be written.
+ *
+ * pm       - progressive mesh from glmProgressive()
+ * filename - name of the .OBJ file
+ */
+GLboolean glmWriteProgressive(GLMprogressive* pm, char* filename);
+
+/* glmReadProgressive: Opens the progressive mesh written for an .OBJ
+ * file and reads its base mesh.  The splits are left in the file for
+ * glmStreamProgressive().  Returns NULL if there is no progressive
+ * mesh, or the .OBJ changed since it was written.
+ *
+ * filename - name of the .OBJ file
+ */
+GLMprogressive* glmReadProgressive(char* filename);
+
+/* glmStreamProgressive: Reads up to count more splits of a progressive
+ * mesh from its file.  Returns how many were read, 0 once all of them
+ * are in.  Can run on another thread than glmRefineProgressive().
+ *
+ * pm    - progressive mesh from glmReadProgressive()
+ * count - most splits to read
+ */
+GLuint glmStreamProgressive(GLMprogressive* pm, GLuint count);
+
+/* glmRefineProgressive: Applies up to count more of the splits that
+ * have been read to the progressive mesh's vertex and index buffers in
+ * the current OpenGL context (building them with the base mesh on the
+ * first call).  Returns how many were applied.  Normals are not
+ * refreshed: every vertex keeps its normal from the full mesh, also
+ * the ones a split moves, so a partly refined mesh is shaded as the
+ * full model would be rather than by its own facets.
+ *
+ * pm    - progressive mesh
+ * count - most splits to apply
+ */
+GLuint glmRefineProgressive(GLMprogressive* pm, GLuint count);
+
+/* glmDrawProgressive: Renders a progressive mesh as far as it has been
+ * refined.
+ *
+ * pm   - progressive mesh
+ * mode - GLM_NONE or GLM_SMOOTH (per vertex normals)
+ */
+GLvoid glmDrawProgressive(GLMprogressive* pm, GLuint mode);
+
+/* glmDeleteProgressive: Deletes a progressive mesh, its buffers (if it
+ * has any, so in the context it was drawn in) and its open file.
+ *
+ * pm - progressive mesh
+ */
+GLvoid glmDeleteProgressive(GLMprogressive* pm);
+
+/* glmBVH: Builds a bounding volume hierarchy over the triangles of a
+ * model (binned SAH, in parallel).  It copies the triangles, so
+ * rebuild it if the model's vertices move.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLMbvh* glmBVH(GLMmodel* model);
+
+/* glmIntersect: Finds the closest triangle a ray hits, either side.
+ * Returns GL_FALSE if it hits none.
+ *
+ * bvh       - BVH from glmBVH()
+ * origin    - start of the ray
+ * direction - direction of the ray (hit->t is in its lengths)
+ * tmax      - how far along the ray to look (FLT_MAX for all the way)
+ * hit       - receives the triangle, distance and barycentric coords
+ */
+GLboolean glmIntersect(GLMbvh* bvh, GLfloat* origin, GLfloat* direction, GLfloat tmax, GLMhit* hit);
+
+/* glmOccluded: Whether a ray hits any triangle before tmax.  Stops at
+ * the first one it finds, so it's cheaper than glmIntersect().
+ *
+ * bvh       - BVH from glmBVH()
+ * origin    - start of the ray
+ * direction - direction of the ray
+ * tmax      - how far along the ray to look
+ */
+GLboolean glmOccluded(GLMbvh* bvh, GLfloat* origin, GLfloat* direction, GLfloat tmax);
+
+/* glmDeleteBVH: Deletes a BVH.
+ *
+ * bvh - BVH from glmBVH()
+ */
+GLvoid glmDeleteBVH(GLMbvh* bvh);
+
+/* glmDeformable: Gets a model ready to have its vertices moved every
+ * frame by glmDeform().  The model itself isn't changed.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLMdeform* glmDeformable(GLMmodel* model);
+
+/* glmDeform: Moves the vertices of a deformable model and recomputes
+ * the facet and vertex normals around the ones that moved, on all
+ * threads.  Returns the number of vertices that moved.
+ *
+ * deform - deformable model from glmDeformable()
+ * move   - called for every vertex, from several threads at once, with
+ *          its rest position, rest normal and current position, which
+ *          it sets to the new one
+ * data   - passed on to move()
+ */
+GLuint glmDeform(GLMdeform* deform, GLvoid (*move)(const GLfloat* rest, const GLfloat* normal,
+                                                   GLfloat* position, GLvoid* data), GLvoid* data);
+
+/* glmDrawDeformable: Uploads the vertices that changed since the last
+ * draw into a dynamic vertex buffer in the current OpenGL context and
+ * renders the deformable model.
+ *
+ * deform - deformable model from glmDeformable()
+ * mode   - GLM_NONE or GLM_SMOOTH (per vertex normals)
+ */
+GLvoid glmDrawDeformable(GLMdeform* deform, GLuint mode);
+
+/* glmDeleteDeformable: Deletes a deformable model.
+ *
+ * deform - deformable model from glmDeformable()
+ */
+GLvoid glmDeleteDeformable(GLMdeform* deform);
+
+/* glmBrickOBJ: Converts a Wavefront .OBJ file, however large, into
+ * spatial bricks saved next to it (as <filename>.glmb) for
+ * glmReadPaged().  Only positions and smooth normals are kept.
+ *
+ * filename       - name of the .OBJ file
+ * bricktriangles - most triangles per brick
+ */
+GLboolean glmBrickOBJ(char* filename, GLuint bricktriangles, mycallback *call);
+
+/* glmReadPaged: Opens the bricks saved by glmBrickOBJ() for an .OBJ
+ * file.  Returns NULL if there are none, or the .OBJ has changed since.
+ *
+ * filename - name of the .OBJ file
+ * budget   - most bytes of bricks to keep paged in at once
+ */
+GLMpaged* glmReadPaged(char* filename, size_t budget);
+
+/* glmDrawPaged: Renders the bricks of a paged mesh that are in the view
+ * frustum, paging missing ones in (nearest first) and the least
+ * recently drawn ones out to stay within the budget.
+ *
+ * paged    - paged mesh from glmReadPaged()
+ * mode     - GLM_NONE or GLM_SMOOTH (per vertex normals)
+ * drawn    - if not NULL, the number of bricks drawn is added to it
+ * pagedin  - if not NULL, the number of bricks paged in is added to it
+ */
+GLvoid glmDrawPaged(GLMpaged* paged, GLuint mode, GLuint* drawn, GLuint* pagedin);
+
+/* glmDeletePaged: Deletes a paged mesh and the buffers of the bricks
+ * it has paged in (so in the context it was drawn in).
+ *
+ * paged - paged mesh from glmReadPaged()
+ */
+GLvoid glmDeletePaged(GLMpaged* paged);
+
 /* glmWeld: eliminate (weld) vectors that are within an epsilon of
  * each other.
  *
@@ -248,6 +853,23 @@ GLuint glmList(GLMmodel* model, GLuint mode);
  */
 GLvoid glmWeld(GLMmodel* model, GLfloat epsilon);
 
+/* glmWeldVectors: eliminate (weld) vectors that are within an epsilon
+ * of each other.  Returns a malloc()'d array of the copies that were
+ * kept, and replaces the first component of each vector with the index
+ * of its copy.  Vectors are looked up in a hashed grid, so this is
+ * close to linear in the number of vectors.
+ *
+ * vectors    - array of GLfloat[3]'s to be welded (1-based)
+ * numvectors - number of GLfloat[3]'s in vectors, number kept on return
+ * epsilon    - maximum difference between vectors
+ */
+GLfloat* glmWeldVectors(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon);
+
+/* glmWeldVectorsBrute: same as glmWeldVectors(), but compares every
+ * vector against every copy (quadratic).  Only useful as a reference.
+ */
+GLfloat* glmWeldVectorsBrute(GLfloat* vectors, GLuint* numvectors, GLfloat epsilon);
+
 /* glmReadPPM: read a PPM raw (type P6) file.  The PPM file has a header
  * that should look something like:
  *
@@ -279,3 +901,58 @@ GLvoid glmWeld(GLMmodel* model, GLfloat epsilon);
 GLubyte* glmReadPPM(char* filename, int* width, int* height);
 
 GLMgroup* glmFindGroup(GLMmodel* model, char* name);
+
+/* glmFindOrAddTexture: Returns the index of the named texture in the
+ * model, adding it if needed.  New textures are loaded (relative to the
+ * model's directory) by glmLoadTextures().
+ */
+int glmFindOrAddTexture(GLMmodel* model, char* name);
+
+/* glmLoadTextures: Loads the textures of a model that haven't been
+ * loaded yet into the current OpenGL context.  The images are decoded
+ * in parallel; only the uploads happen on the calling thread.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid glmLoadTextures(GLMmodel* model, mycallback *call);
+
+/* glmFree: Frees an array that belongs to the model, unless it points
+ * into the model's mapped binary cache or came from glmAlloc().
+ */
+GLvoid glmFree(GLMmodel* model, GLvoid* ptr);
+
+/* glmAlloc: Allocates size bytes from the model's arena.  The memory
+ * lives until glmDelete(); glmFree() on it does nothing.
+ */
+GLvoid* glmAlloc(GLMmodel* model, size_t size);
+
+/* glmStrdup: Copies a string into the model's arena. */
+char* glmStrdup(GLMmodel* model, const char* s);
+
+/* glmReserve: Makes sure the next size bytes of glmAlloc() calls come
+ * out of a single block, so a loader that knows how much it needs up
+ * front does one allocation.
+ */
+GLvoid glmReserve(GLMmodel* model, size_t size);
+
+/* glmUseArena: Turns the arena on or off (it is on by default).  With
+ * it off glmAlloc() is plain malloc(); benchmarks use this to compare.
+ */
+GLvoid glmUseArena(GLboolean use);
+
+/* glmUseHashedNames: Turns the hash tables the loader looks up group,
+ * material and texture names in on or off (they are on by default).
+ * With them off every lookup compares against all the names so far;
+ * benchmarks use this to compare.
+ */
+GLvoid glmUseHashedNames(GLboolean use);
+
+/* glmNumThreads: Number of threads the parallel paths use by default
+ * (one per processor, or $GLM_THREADS).
+ */
+GLuint glmNumThreads();
+
+/* glmParallel: Calls func(i, data) for every i in [0, count) spread
+ * over glmNumThreads() threads, and returns when all calls are done.
+ */
+GLvoid glmParallel(GLuint count, GLvoid (*func)(GLuint, GLvoid*), GLvoid* data);
@@ -0,0 +1,713 @@
+/*
+      glmbricks.cpp
+
+      Out-of-core meshes: models too large to load are cut once into
+      spatial bricks on disk, and only the bricks in view are paged in.
+
+      glmBrickOBJ() converts an .OBJ into <name>.obj.glmb in three passes
+      over the file (glmScanOBJ()), never holding more than a grid of
+      counters and a small write buffer per brick in memory:
+
+        1. the vertex positions go to a scratch file, which is then
+           mapped so triangles can look their corners up;
+        2. every triangle adds its area weighted normal to its corners
+           (in a second mapped scratch file) and counts itself in the
+           cell of a fine grid its center falls in.  The grid is then
+           split kd-tree style along its longest side at the median
+           until every box holds at most the requested number of
+           triangles; those boxes are the bricks;
+        3. every triangle is appended to its brick as three vertices
+           of position and normal, ready to draw with glDrawArrays().
+
+      Each brick starts on a GLM_BRICK_ALIGN boundary so it can be
+      mapped on its own.  glmDrawPaged() culls the bricks against the
+      view frustum, pages in the visible ones nearest first (mmap() of
+      the brick, copied into a vertex buffer, unmapped), and evicts the
+      least recently drawn bricks to stay within a memory budget.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "glm.h"
+
+#define GLM_BRICK_MAGIC   "GLMB"
+#define GLM_BRICK_VERSION 1
+#define GLM_BRICK_ALIGN   65536       /* a multiple of any page size */
+#define GLM_BRICK_GRID    128         /* cells along the longest side of the grid */
+#define GLM_BRICK_STAGE   64          /* triangles buffered per brick while writing */
+#define GLM_BRICK_VERTEX  (6 * sizeof(GLfloat))
+
+/* GLMbrickheader: first bytes of a .glmb file, followed by numbricks
+ * GLMbrickrecords */
+typedef struct _GLMbrickheader {
+    char   magic[4];              /* GLM_BRICK_MAGIC */
+    GLuint version;               /* GLM_BRICK_VERSION */
+    unsigned long long srcsize;   /* size of the .OBJ */
+    unsigned long long srcmtime;  /* modification time of the .OBJ */
+    GLuint numbricks;
+    GLuint numtriangles;
+    GLfloat min[3], max[3];       /* bounds of the whole mesh */
+} GLMbrickheader;
+
+/* GLMbrickrecord: a brick as stored in the file */
+typedef struct _GLMbrickrecord {
+    unsigned long long offset;    /* of its first vertex */
+    GLuint  numtriangles;
+    GLuint  pad;
+    GLfloat min[3], max[3];
+} GLMbrickrecord;
+
+/* GLMbricker: state of a conversion */
+typedef struct _GLMbricker {
+    FILE*     positionfile;       /* pass 1 */
+    GLuint    numvertices;
+    GLfloat   min[3], max[3];
+
+    GLfloat*  positions;          /* mapped scratch files, pass 2 and 3 */
+    GLfloat*  normals;
+    size_t    mapsize;
+
+    GLuint    dims[3];            /* the grid */
+    GLfloat   cellsize;
+    GLuint*   counts;             /* triangles per cell */
+    GLuint*   cellbricks;         /* brick of each cell */
+    unsigned long long* sums;     /* summed volume table of counts */
+    GLuint    target;             /* most triangles per brick */
+
+    GLuint    numbricks, maxbricks;
+    GLMbrickrecord* bricks;
+    GLuint    numtriangles;
+    GLuint*   written;            /* triangles written per brick */
+    GLuint*   staged;             /* triangles waiting per brick */
+    GLfloat*  stage;              /* GLM_BRICK_STAGE triangles per brick */
+    int       fd;
+    GLboolean failed;
+} GLMbricker;
+
+/* glmBrickName: return the name of the brick file (plus suffix) for a
+ * model file
+ *
+ * NOTE: the return value should be free'd.
+ */
+static char* glmBrickName(char* filename, const char* suffix){
+    char* name;
+    name = (char*)malloc(strlen(filename) + strlen(suffix) + 1);
+    strcpy(name, filename);
+    strcat(name, suffix);
+    return name;
+}
+
+/* glmBrickVertex: pass 1, save a vertex position and grow the bounds */
+static GLvoid glmBrickVertex(GLvoid* data, GLfloat* v){
+    GLMbricker* b = (GLMbricker*)data;
+    GLuint k;
+    for (k = 0; k < 3; k++) {
+        if (b->numvertices == 0 || v[k] < b->min[k]) b->min[k] = v[k];
+        if (b->numvertices == 0 || v[k] > b->max[k]) b->max[k] = v[k];
+    }
+    b->numvertices++;
+    if (fwrite(v, sizeof(GLfloat), 3, b->positionfile) != 3)
+        b->failed = GL_TRUE;
+}
+
+/* glmBrickCell: the grid cell a triangle's center falls in, or -1 for a
+ * triangle with a corner that doesn't exist */
+static GLint glmBrickCell(GLMbricker* b, GLuint* vindices, GLfloat* p[3]){
+    GLint  c[3];
+    GLuint k;
+    for (k = 0; k < 3; k++) {
+        if (vindices[k] < 1 || vindices[k] > b->numvertices)
+            return -1;
+        p[k] = &b->positions[3 * vindices[k]];
+    }
+    for (k = 0; k < 3; k++) {
+        c[k] = (GLint)(((p[0][k] + p[1][k] + p[2][k]) / 3 - b->min[k]) / b->cellsize);
+        if (c[k] < 0) c[k] = 0;
+        if (c[k] >= (GLint)b->dims[k]) c[k] = b->dims[k] - 1;
+    }
+    return (c[2] * b->dims[1] + c[1]) * b->dims[0] + c[0];
+}
+
+/* glmBrickCount: pass 2, add a triangle's normal to its corners and
+ * count it in its cell */
+static GLvoid glmBrickCount(GLvoid* data, GLuint* vindices){
+    GLMbricker* b = (GLMbricker*)data;
+    GLfloat* p[3];
+    GLfloat  u[3], v[3], n[3];
+    GLint    cell;
+    GLuint   k;
+    cell = glmBrickCell(b, vindices, p);
+    if (cell < 0)
+        return;
+    for (k = 0; k < 3; k++) {
+        u[k] = p[1][k] - p[0][k];
+        v[k] = p[2][k] - p[0][k];
+    }
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+    for (k = 0; k < 3; k++) {
+        b->normals[3 * vindices[k] + 0] += n[0];
+        b->normals[3 * vindices[k] + 1] += n[1];
+        b->normals[3 * vindices[k] + 2] += n[2];
+    }
+    b->counts[cell]++;
+    b->numtriangles++;
+}
+
+/* glmBrickSum: triangles in the box of cells [lo, hi) */
+static unsigned long long glmBrickSum(GLMbricker* b, GLuint* lo, GLuint* hi){
+    GLuint sx = b->dims[0] + 1, sy = b->dims[1] + 1;
+#define S(x, y, z) b->sums[((size_t)(z) * sy + (y)) * sx + (x)]
+    return S(hi[0], hi[1], hi[2]) - S(lo[0], hi[1], hi[2]) - S(hi[0], lo[1], hi[2]) -
+           S(hi[0], hi[1], lo[2]) + S(lo[0], lo[1], hi[2]) + S(lo[0], hi[1], lo[2]) +
+           S(hi[0], lo[1], lo[2]) - S(lo[0], lo[1], lo[2]);
+#undef S
+}
+
+/* glmBrickSplit: make a brick of a box of cells, or split it in two
+ * along its longest side where half its triangles are on either side */
+static GLvoid glmBrickSplit(GLMbricker* b, GLuint* lo, GLuint* hi){
+    unsigned long long count, half;
+    GLuint axis, k, x, y, z, mid, lower, upper, cut[3];
+    count = glmBrickSum(b, lo, hi);
+    if (count == 0)
+        return;
+    axis = 0;
+    for (k = 1; k < 3; k++)
+        if (hi[k] - lo[k] > hi[axis] - lo[axis])
+            axis = k;
+    if (count > b->target && hi[axis] - lo[axis] > 1) {
+        /* the first slab boundary with at least half below it */
+        half = (count + 1) / 2;
+        memcpy(cut, hi, sizeof(cut));
+        lower = lo[axis] + 1;
+        upper = hi[axis] - 1;
+        while (lower < upper) {
+            mid = (lower + upper) / 2;
+            cut[axis] = mid;
+            if (glmBrickSum(b, lo, cut) >= half)
+                upper = mid;
+            else
+                lower = mid + 1;
+        }
+        cut[axis] = lower;
+        glmBrickSplit(b, lo, cut);
+        memcpy(cut, lo, sizeof(cut));
+        cut[axis] = lower;
+        glmBrickSplit(b, cut, hi);
+        return;
+    }
+    if (b->numbricks == b->maxbricks) {
+        b->maxbricks = b->maxbricks ? b->maxbricks * 2 : 256;
+        b->bricks = (GLMbrickrecord*)realloc(b->bricks, sizeof(GLMbrickrecord) * b->maxbricks);
+    }
+    memset(&b->bricks[b->numbricks], 0, sizeof(GLMbrickrecord));
+    b->bricks[b->numbricks].numtriangles = (GLuint)count;
+    for (z = lo[2]; z < hi[2]; z++)
+        for (y = lo[1]; y < hi[1]; y++)
+            for (x = lo[0]; x < hi[0]; x++)
+                b->cellbricks[(z * b->dims[1] + y) * b->dims[0] + x] = b->numbricks;
+    b->numbricks++;
+}
+
+/* glmBrickFlush: write the staged triangles of a brick */
+static GLvoid glmBrickFlush(GLMbricker* b, GLuint brick){
+    size_t size = (size_t)b->staged[brick] * 3 * GLM_BRICK_VERTEX;
+    off_t offset = b->bricks[brick].offset +
+                   (unsigned long long)b->written[brick] * 3 * GLM_BRICK_VERTEX;
+    if (!size)
+        return;
+    if (pwrite(b->fd, &b->stage[(size_t)brick * GLM_BRICK_STAGE * 18], size, offset) != (ssize_t)size)
+        b->failed = GL_TRUE;
+    b->written[brick] += b->staged[brick];
+    b->staged[brick] = 0;
+}
+
+/* glmBrickWrite: pass 3, append a triangle to its brick */
+static GLvoid glmBrickWrite(GLvoid* data, GLuint* vindices){
+    GLMbricker* b = (GLMbricker*)data;
+    GLMbrickrecord* brick;
+    GLfloat* p[3];
+    GLfloat* out;
+    GLfloat* n;
+    GLfloat  l;
+    GLint    cell;
+    GLuint   i, k, id;
+    cell = glmBrickCell(b, vindices, p);
+    if (cell < 0)
+        return;
+    id = b->cellbricks[cell];
+    brick = &b->bricks[id];
+    out = &b->stage[((size_t)id * GLM_BRICK_STAGE + b->staged[id]) * 18];
+    for (i = 0; i < 3; i++) {
+        n = &b->normals[3 * vindices[i]];
+        l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (k = 0; k < 3; k++) {
+            out[6 * i + k] = p[i][k];
+            out[6 * i + 3 + k] = l > 0 ? n[k] / l : 0;
+            if (b->written[id] + b->staged[id] == 0 && i == 0) {
+                brick->min[k] = brick->max[k] = p[i][k];
+            } else {
+                if (p[i][k] < brick->min[k]) brick->min[k] = p[i][k];
+                if (p[i][k] > brick->max[k]) brick->max[k] = p[i][k];
+            }
+        }
+    }
+    if (++b->staged[id] == GLM_BRICK_STAGE)
+        glmBrickFlush(b, id);
+}
+
+/* glmBrickMap: map a scratch file of size bytes, zero filled, and
+ * unlink it so it goes away with the mapping */
+static GLfloat* glmBrickMap(char* name, size_t size, GLboolean writable){
+    GLfloat* data;
+    int fd;
+    fd = open(name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0)
+        return NULL;
+    unlink(name);
+    if (writable && ftruncate(fd, size) < 0) {
+        close(fd);
+        return NULL;
+    }
+    data = (GLfloat*)mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                          MAP_SHARED, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+/* glmBrickOBJ: Converts an .OBJ into spatial bricks on disk for
+ * glmReadPaged().
+ *
+ * filename       - name of the .OBJ file
+ * bricktriangles - most triangles per brick (as long as a grid cell
+ *                  doesn't hold more by itself)
+ */
+GLboolean glmBrickOBJ(char* filename, GLuint bricktriangles, mycallback *call){
+    GLMbricker     b;
+    GLMbrickheader header;
+    struct stat    st;
+    char*          posname;
+    char*          nrmname;
+    char*          name;
+    char*          tmpname;
+    GLfloat        extent, zero[3] = { 0, 0, 0 };
+    GLuint         lo[3], hi[3], x, y, z, i, sx, sy;
+    unsigned long long offset, size;
+    size_t         cells;
+    mycallback     pass;
+    assert(filename);
+    if (stat(filename, &st) < 0)
+        return GL_FALSE;
+    memset(&b, 0, sizeof(b));
+    b.fd = -1;
+    b.target = bricktriangles ? bricktriangles : 1;
+    name    = glmBrickName(filename, ".glmb");
+    tmpname = glmBrickName(filename, ".glmb.tmp");
+    posname = glmBrickName(filename, ".glmb.pos");
+    nrmname = glmBrickName(filename, ".glmb.nrm");
+    if (call)
+        pass = *call;
+
+    /* 1: positions to disk */
+    b.positionfile = fopen(posname, "wb");
+    if (!b.positionfile) {
+        fprintf(stderr, "glmBrickOBJ() failed: can't open scratch file \"%s\".\n", posname);
+        b.failed = GL_TRUE;
+        goto done;
+    }
+    fwrite(zero, sizeof(GLfloat), 3, b.positionfile);
+    if (call) {
+        pass.end = call->start + (call->end - call->start) / 3;
+        pass.text = (char*)"Reading vertices";
+    }
+    if (!glmScanOBJ(filename, glmBrickVertex, NULL, &b, call ? &pass : NULL))
+        b.failed = GL_TRUE;
+    if (fclose(b.positionfile) != 0)
+        b.failed = GL_TRUE;
+    if (b.failed || !b.numvertices)
+        goto done;
+    b.mapsize = sizeof(GLfloat) * 3 * ((size_t)b.numvertices + 1);
+    b.positions = glmBrickMap(posname, b.mapsize, GL_FALSE);
+    b.normals = glmBrickMap(nrmname, b.mapsize, GL_TRUE);
+    if (!b.positions || !b.normals) {
+        b.failed = GL_TRUE;
+        goto done;
+    }
+
+    /* 2: normals and the grid */
+    extent = 0;
+    for (i = 0; i < 3; i++)
+        if (b.max[i] - b.min[i] > extent)
+            extent = b.max[i] - b.min[i];
+    b.cellsize = extent > 0 ? extent / GLM_BRICK_GRID : 1;
+    for (i = 0; i < 3; i++) {
+        b.dims[i] = (GLuint)ceil((b.max[i] - b.min[i]) / b.cellsize);
+        if (b.dims[i] < 1) b.dims[i] = 1;
+        if (b.dims[i] > GLM_BRICK_GRID) b.dims[i] = GLM_BRICK_GRID;
+    }
+    cells = (size_t)b.dims[0] * b.dims[1] * b.dims[2];
+    b.counts = (GLuint*)calloc(cells, sizeof(GLuint));
+    if (call) {
+        pass.start = pass.end;
+        pass.end = call->start + 2 * (call->end - call->start) / 3;
+        pass.text = (char*)"Sorting triangles";
+    }
+    if (!glmScanOBJ(filename, NULL, glmBrickCount, &b, call ? &pass : NULL)) {
+        b.failed = GL_TRUE;
+        goto done;
+    }
+
+    /* cut the grid into bricks */
+    sx = b.dims[0] + 1;
+    sy = b.dims[1] + 1;
+    b.sums = (unsigned long long*)calloc((size_t)sx * sy * (b.dims[2] + 1),
+                                         sizeof(unsigned long long));
+    for (z = 1; z <= b.dims[2]; z++)
+        for (y = 1; y <= b.dims[1]; y++)
+            for (x = 1; x <= b.dims[0]; x++)
+                b.sums[((size_t)z * sy + y) * sx + x] =
+                    b.counts[((z - 1) * b.dims[1] + (y - 1)) * b.dims[0] + (x - 1)] +
+                    b.sums[((size_t)(z - 1) * sy + y) * sx + x] +
+                    b.sums[((size_t)z * sy + (y - 1)) * sx + x] +
+                    b.sums[((size_t)z * sy + y) * sx + (x - 1)] -
+                    b.sums[((size_t)(z - 1) * sy + (y - 1)) * sx + x] -
+                    b.sums[((size_t)(z - 1) * sy + y) * sx + (x - 1)] -
+                    b.sums[((size_t)z * sy + (y - 1)) * sx + (x - 1)] +
+                    b.sums[((size_t)(z - 1) * sy + (y - 1)) * sx + (x - 1)];
+    b.cellbricks = (GLuint*)calloc(cells, sizeof(GLuint));
+    lo[0] = lo[1] = lo[2] = 0;
+    memcpy(hi, b.dims, sizeof(hi));
+    glmBrickSplit(&b, lo, hi);
+    free(b.sums);
+    b.sums = NULL;
+
+    /* lay the bricks out in the file */
+    offset = sizeof(GLMbrickheader) + sizeof(GLMbrickrecord) * (unsigned long long)b.numbricks;
+    for (i = 0; i < b.numbricks; i++) {
+        offset = (offset + GLM_BRICK_ALIGN - 1) / GLM_BRICK_ALIGN * GLM_BRICK_ALIGN;
+        b.bricks[i].offset = offset;
+        offset += (unsigned long long)b.bricks[i].numtriangles * 3 * GLM_BRICK_VERTEX;
+    }
+    size = offset;
+
+    /* 3: the triangles into their bricks */
+    b.fd = open(tmpname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (b.fd < 0 || ftruncate(b.fd, size) < 0) {
+        fprintf(stderr, "glmBrickOBJ() failed: can't open file \"%s\" to write.\n", tmpname);
+        b.failed = GL_TRUE;
+        goto done;
+    }
+    b.written = (GLuint*)calloc(b.numbricks + 1, sizeof(GLuint));
+    b.staged  = (GLuint*)calloc(b.numbricks + 1, sizeof(GLuint));
+    b.stage   = (GLfloat*)malloc(sizeof(GLfloat) * 18 * GLM_BRICK_STAGE * (b.numbricks + 1));
+    if (call) {
+        pass.start = pass.end;
+        pass.end = call->end;
+        pass.text = (char*)"Writing bricks";
+    }
+    if (!glmScanOBJ(filename, NULL, glmBrickWrite, &b, call ? &pass : NULL)) {
+        b.failed = GL_TRUE;
+        goto done;
+    }
+    for (i = 0; i < b.numbricks; i++)
+        glmBrickFlush(&b, i);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GLM_BRICK_MAGIC, 4);
+    header.version      = GLM_BRICK_VERSION;
+    header.srcsize      = st.st_size;
+    header.srcmtime     = st.st_mtime;
+    header.numbricks    = b.numbricks;
+    header.numtriangles = b.numtriangles;
+    memcpy(header.min, b.min, sizeof(header.min));
+    memcpy(header.max, b.max, sizeof(header.max));
+    if (pwrite(b.fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        pwrite(b.fd, b.bricks, sizeof(GLMbrickrecord) * b.numbricks, sizeof(header)) !=
+            (ssize_t)(sizeof(GLMbrickrecord) * b.numbricks))
+        b.failed = GL_TRUE;
+
+done:
+    if (b.fd >= 0 && close(b.fd) < 0)
+        b.failed = GL_TRUE;
+    if (!b.failed && b.fd >= 0 && rename(tmpname, name) < 0)
+        b.failed = GL_TRUE;
+    if (b.failed) {
+        fprintf(stderr, "glmBrickOBJ() failed: can't convert \"%s\".\n", filename);
+        remove(tmpname);
+    }
+    remove(posname);
+    remove(nrmname);
+    if (b.positions)
+        munmap(b.positions, b.mapsize);
+    if (b.normals)
+        munmap(b.normals, b.mapsize);
+    free(b.counts);
+    free(b.cellbricks);
+    free(b.bricks);
+    free(b.written);
+    free(b.staged);
+    free(b.stage);
+    free(name);
+    free(tmpname);
+    free(posname);
+    free(nrmname);
+    return !b.failed && b.numtriangles > 0;
+}
+
+/* glmReadPaged: Opens the bricks an .OBJ was converted into by
+ * glmBrickOBJ().  Nothing is paged in until the bricks are drawn.
+ * Returns NULL if there are none, the .OBJ changed since, or the brick
+ * file is too short for the bricks it lists (paging those in would
+ * fault past its end).
+ *
+ * filename - name of the .OBJ file
+ * budget   - most bytes of bricks to keep paged in
+ */
+GLMpaged* glmReadPaged(char* filename, size_t budget){
+    GLMbrickheader  header;
+    GLMbrickrecord* records;
+    GLMpaged*       paged;
+    struct stat     st, bst;
+    char*           name;
+    unsigned long long size;
+    GLuint          i;
+    int             fd;
+    if (stat(filename, &st) < 0)
+        return NULL;
+    name = glmBrickName(filename, ".glmb");
+    fd = open(name, O_RDONLY);
+    free(name);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &bst) < 0 ||
+        pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, GLM_BRICK_MAGIC, 4) ||
+        header.version != GLM_BRICK_VERSION ||
+        header.srcsize != (unsigned long long)st.st_size ||
+        header.srcmtime != (unsigned long long)st.st_mtime ||
+        header.numbricks > (bst.st_size - sizeof(header)) / sizeof(GLMbrickrecord)) {
+        close(fd);
+        return NULL;
+    }
+    records = (GLMbrickrecord*)malloc(sizeof(GLMbrickrecord) * (header.numbricks + 1));
+    if (pread(fd, records, sizeof(GLMbrickrecord) * header.numbricks, sizeof(header)) !=
+        (ssize_t)(sizeof(GLMbrickrecord) * header.numbricks)) {
+        free(records);
+        close(fd);
+        return NULL;
+    }
+    for (i = 0; i < header.numbricks; i++) {
+        size = (unsigned long long)records[i].numtriangles * 3 * GLM_BRICK_VERTEX;
+        if (records[i].offset > (unsigned long long)bst.st_size ||
+            size > (unsigned long long)bst.st_size - records[i].offset) {
+            fprintf(stderr, "glmReadPaged() failed: brick %u is past the end of the file.\n", i);
+            free(records);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    paged = (GLMpaged*)calloc(1, sizeof(GLMpaged));
+    paged->fd = fd;
+    paged->numbricks = header.numbricks;
+    paged->numtriangles = header.numtriangles;
+    memcpy(paged->min, header.min, sizeof(paged->min));
+    memcpy(paged->max, header.max, sizeof(paged->max));
+    paged->budget = budget;
+    paged->maxpageins = 4;
+    paged->first = paged->last = -1;
+    paged->bricks = (GLMbrick*)calloc(paged->numbricks + 1, sizeof(GLMbrick));
+    paged->order = (GLMbrickorder*)malloc(sizeof(GLMbrickorder) * (paged->numbricks + 1));
+    for (i = 0; i < paged->numbricks; i++) {
+        memcpy(paged->bricks[i].min, records[i].min, sizeof(records[i].min));
+        memcpy(paged->bricks[i].max, records[i].max, sizeof(records[i].max));
+        paged->bricks[i].offset = records[i].offset;
+        paged->bricks[i].numtriangles = records[i].numtriangles;
+        paged->bricks[i].prev = paged->bricks[i].next = -1;
+    }
+    free(records);
+    return paged;
+}
+
+/* glmPagedUnlink: take a paged in brick out of the recently used list */
+static GLvoid glmPagedUnlink(GLMpaged* paged, GLint i){
+    GLMbrick* brick = &paged->bricks[i];
+    if (brick->prev >= 0)
+        paged->bricks[brick->prev].next = brick->next;
+    else
+        paged->first = brick->next;
+    if (brick->next >= 0)
+        paged->bricks[brick->next].prev = brick->prev;
+    else
+        paged->last = brick->prev;
+    brick->prev = brick->next = -1;
+}
+
+/* glmPagedTouch: make a paged in brick the most recently used */
+static GLvoid glmPagedTouch(GLMpaged* paged, GLint i){
+    GLMbrick* brick = &paged->bricks[i];
+    if (paged->first == i)
+        return;
+    if (brick->prev >= 0 || brick->next >= 0 || paged->last == i)
+        glmPagedUnlink(paged, i);
+    brick->next = paged->first;
+    if (paged->first >= 0)
+        paged->bricks[paged->first].prev = i;
+    paged->first = i;
+    if (paged->last < 0)
+        paged->last = i;
+}
+
+/* glmPagedEvict: drop the least recently used brick's buffer */
+static GLvoid glmPagedEvict(GLMpaged* paged){
+    GLMbrick* brick;
+    GLint i = paged->last;
+    brick = &paged->bricks[i];
+    glmPagedUnlink(paged, i);
+    glDeleteBuffers(1, &brick->vbo);
+    brick->vbo = 0;
+    paged->resident -= (size_t)brick->numtriangles * 3 * GLM_BRICK_VERTEX;
+}
+
+/* glmPagedLoad: map a brick and copy it into a vertex buffer */
+static GLboolean glmPagedLoad(GLMpaged* paged, GLint i){
+    GLMbrick* brick = &paged->bricks[i];
+    size_t    size = (size_t)brick->numtriangles * 3 * GLM_BRICK_VERTEX;
+    GLvoid*   data;
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, paged->fd, brick->offset);
+    if (data == MAP_FAILED)
+        return GL_FALSE;
+    madvise(data, size, MADV_SEQUENTIAL);
+    glGenBuffers(1, &brick->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, brick->vbo);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    munmap(data, size);
+    paged->resident += size;
+    glmPagedTouch(paged, i);
+    return GL_TRUE;
+}
+
+/* glmCompareBrickOrder: qsort() order of bricks, nearest first */
+static int glmCompareBrickOrder(const void* a, const void* b){
+    GLfloat x = ((const GLMbrickorder*)a)->distance;
+    GLfloat y = ((const GLMbrickorder*)b)->distance;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* glmDrawPaged: Renders the bricks of a paged mesh that are in the view
+ * frustum of the current projection and modelview matrices.  Visible
+ * bricks that aren't paged in yet are paged in nearest first, at most
+ * maxpageins per call, evicting the least recently drawn bricks that
+ * aren't visible to stay within the budget; what doesn't fit is left
+ * out.
+ *
+ * paged    - paged mesh from glmReadPaged()
+ * mode     - GLM_NONE or GLM_SMOOTH (vertex normals)
+ * drawn    - if not NULL, the number of bricks drawn is added to it
+ * pagedin  - if not NULL, the number of bricks paged in is added to it
+ */
+GLvoid glmDrawPaged(GLMpaged* paged, GLuint mode, GLuint* drawn, GLuint* pagedin){
+    GLMbrick* brick;
+    GLfloat   planes[6][4], p[3];
+    GLuint    numvisible, numdrawn, numpaged, i, j, k;
+    size_t    size;
+    assert(paged);
+    glmFrustum(planes);
+    paged->frame++;
+
+    /* the bricks in view, nearest (to the near plane) first */
+    numvisible = 0;
+    for (i = 0; i < paged->numbricks; i++) {
+        brick = &paged->bricks[i];
+        for (j = 0; j < 6; j++) {
+            /* the corner of the box furthest along the plane normal */
+            for (k = 0; k < 3; k++)
+                p[k] = planes[j][k] > 0 ? brick->max[k] : brick->min[k];
+            if (planes[j][0] * p[0] + planes[j][1] * p[1] + planes[j][2] * p[2] + planes[j][3] < 0)
+                break;
+        }
+        if (j < 6)
+            continue;
+        brick->frame = paged->frame;
+        paged->order[numvisible].brick = i;
+        paged->order[numvisible].distance =
+            planes[4][0] * (brick->min[0] + brick->max[0]) / 2 +
+            planes[4][1] * (brick->min[1] + brick->max[1]) / 2 +
+            planes[4][2] * (brick->min[2] + brick->max[2]) / 2 + planes[4][3];
+        numvisible++;
+    }
+    qsort(paged->order, numvisible, sizeof(GLMbrickorder), glmCompareBrickOrder);
+
+    /* page in what's missing, making room from the bricks out of view */
+    numpaged = 0;
+    for (i = 0; i < numvisible; i++) {
+        brick = &paged->bricks[paged->order[i].brick];
+        if (brick->vbo) {
+            glmPagedTouch(paged, paged->order[i].brick);
+            continue;
+        }
+        if (numpaged == paged->maxpageins)
+            continue;
+        size = (size_t)brick->numtriangles * 3 * GLM_BRICK_VERTEX;
+        while (paged->resident + size > paged->budget && paged->last >= 0 &&
+               paged->bricks[paged->last].frame != paged->frame)
+            glmPagedEvict(paged);
+        if (paged->resident + size > paged->budget)
+            continue;
+        if (glmPagedLoad(paged, paged->order[i].brick))
+            numpaged++;
+    }
+
+    numdrawn = 0;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (mode & GLM_SMOOTH)
+        glEnableClientState(GL_NORMAL_ARRAY);
+    for (i = 0; i < numvisible; i++) {
+        brick = &paged->bricks[paged->order[i].brick];
+        if (!brick->vbo)
+            continue;
+        glBindBuffer(GL_ARRAY_BUFFER, brick->vbo);
+        glVertexPointer(3, GL_FLOAT, GLM_BRICK_VERTEX, NULL);
+        if (mode & GLM_SMOOTH)
+            glNormalPointer(GL_FLOAT, GLM_BRICK_VERTEX, (GLubyte*)NULL + 3 * sizeof(GLfloat));
+        glDrawArrays(GL_TRIANGLES, 0, 3 * brick->numtriangles);
+        numdrawn++;
+    }
+    if (mode & GLM_SMOOTH)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (drawn)
+        *drawn += numdrawn;
+    if (pagedin)
+        *pagedin += numpaged;
+}
+
+/* glmDeletePaged: Deletes a paged mesh and the buffers of its paged in
+ * bricks.
+ *
+ * paged - paged mesh from glmReadPaged()
+ */
+GLvoid glmDeletePaged(GLMpaged* paged){
+    GLuint i;
+    assert(paged);
+    for (i = 0; i < paged->numbricks; i++)
+        if (paged->bricks[i].vbo)
+            glDeleteBuffers(1, &paged->bricks[i].vbo);
+    close(paged->fd);
+    free(paged->bricks);
+    free(paged->order);
+    free(paged);
+}
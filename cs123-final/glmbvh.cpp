@@ -0,0 +1,527 @@
+/*
+      glmbvh.cpp
+
+      Bounding volume hierarchy over the triangles of a GLMmodel, for ray
+      picking and visibility queries.
+
+      glmBVH() builds the tree top down.  Each node is split where the
+      surface area heuristic says a ray is cheapest to trace through it,
+      evaluated at GLM_BVH_BINS planes per axis across the triangle
+      centers (binned SAH, see Wald's "On fast Construction of SAH-based
+      Bounding Volume Hierarchies").  The first levels are split on the
+      calling thread; the subtrees below them are built by glmParallel()
+      and then stitched into one array.
+
+      Nodes are 32 bytes and stored depth first, so the left child of a
+      node is the node after it, and the triangles are copied in leaf
+      order (as a corner and two edges, ready for the ray test) so that
+      a leaf reads one contiguous run of them.
+*/
+
+#include <math.h>
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "glm.h"
+
+#define T(x) (model->triangles[(x)])
+
+#define GLM_BVH_BINS     16           /* split planes tried per axis */
+#define GLM_BVH_LEAF     16           /* most triangles in a leaf */
+#define GLM_BVH_DEPTH    64           /* below this, split at the median */
+#define GLM_BVH_STACK    128          /* deepest tree a ray can walk */
+#define GLM_BVH_TASK     0xffff       /* count of a subtree left to a task */
+#define GLM_BVH_TASKMIN  4096         /* fewest triangles for a task */
+#define GLM_BVH_CHUNK    4096         /* triangles per parallel item */
+#define GLM_BVH_TRAVERSE 1.0          /* cost of a node, against a triangle */
+
+/* GLMbvhlist: a growable array of nodes */
+typedef struct _GLMbvhlist {
+    GLMbvhnode* nodes;
+    GLuint      numnodes, maxnodes;
+} GLMbvhlist;
+
+/* GLMbvhtask: a subtree built on its own */
+typedef struct _GLMbvhtask {
+    GLuint      first, count;         /* its run of triangles */
+    GLMbvhlist  list;                 /* its nodes, the root first */
+} GLMbvhtask;
+
+/* GLMbvhbuild: state of a build */
+typedef struct _GLMbvhbuild {
+    GLMmodel*   model;
+    GLMbvh*     bvh;
+    GLfloat*    bounds;               /* min and max of each triangle */
+    GLfloat*    centers;              /* center of each triangle's bounds */
+    GLuint*     indices;              /* the triangles, partitioned in place */
+    GLMbvhlist* top;                  /* the nodes above the tasks */
+    GLuint      taskdepth;            /* depth at which subtrees become tasks */
+    GLMbvhtask* tasks;
+    GLuint      numtasks, maxtasks;
+} GLMbvhbuild;
+
+/* GLMbvhbin: triangles whose centers fall between two split planes */
+typedef struct _GLMbvhbin {
+    GLfloat min[3], max[3];
+    GLuint  count;
+} GLMbvhbin;
+
+/* glmBVHArea: half the surface area of a box */
+static GLfloat glmBVHArea(GLfloat* min, GLfloat* max){
+    GLfloat x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+    if (x < 0.0)
+        return 0.0;
+    return x * y + y * z + z * x;
+}
+
+/* glmBVHGrow: grow the box min, max around the box lo, hi */
+static inline GLvoid glmBVHGrow(GLfloat* min, GLfloat* max, const GLfloat* lo, const GLfloat* hi){
+    GLuint k;
+    for (k = 0; k < 3; k++) {
+        if (lo[k] < min[k]) min[k] = lo[k];
+        if (hi[k] > max[k]) max[k] = hi[k];
+    }
+}
+
+/* glmBVHEmpty: make a box that holds nothing */
+static inline GLvoid glmBVHEmpty(GLfloat* min, GLfloat* max){
+    min[0] = min[1] = min[2] = FLT_MAX;
+    max[0] = max[1] = max[2] = -FLT_MAX;
+}
+
+/* glmBVHAdd: append a node to a list and return its index */
+static GLuint glmBVHAdd(GLMbvhlist* list){
+    if (list->numnodes == list->maxnodes) {
+        list->maxnodes = list->maxnodes ? list->maxnodes * 2 : 64;
+        list->nodes = (GLMbvhnode*)realloc(list->nodes, sizeof(GLMbvhnode) * list->maxnodes);
+    }
+    memset(&list->nodes[list->numnodes], 0, sizeof(GLMbvhnode));
+    return list->numnodes++;
+}
+
+/* glmBVHBoundsWorker: bounds and center of a chunk of triangles */
+static GLvoid glmBVHBoundsWorker(GLuint chunk, GLvoid* data){
+    GLMbvhbuild* b = (GLMbvhbuild*)data;
+    GLMmodel* model = b->model;
+    GLfloat*  v;
+    GLuint    i, end, c, k;
+    end = (chunk + 1) * GLM_BVH_CHUNK;
+    if (end > model->numtriangles)
+        end = model->numtriangles;
+    for (i = chunk * GLM_BVH_CHUNK; i < end; i++) {
+        glmBVHEmpty(&b->bounds[6 * i], &b->bounds[6 * i + 3]);
+        for (c = 0; c < 3; c++) {
+            v = &model->vertices[3 * T(i).vindices[c]];
+            glmBVHGrow(&b->bounds[6 * i], &b->bounds[6 * i + 3], v, v);
+        }
+        for (k = 0; k < 3; k++)
+            b->centers[3 * i + k] = (b->bounds[6 * i + k] + b->bounds[6 * i + 3 + k]) / 2.0;
+        b->indices[i] = i;
+    }
+}
+
+/* glmBVHSelect: reorder the triangles in [first, end) so that none
+ * before mid has its center further along axis than the one at mid,
+ * and none after it less far (quickselect, three way partitions) */
+static GLvoid glmBVHSelect(GLMbvhbuild* b, GLuint first, GLuint end, GLuint mid, GLuint axis){
+    GLuint* indices = b->indices;
+    GLfloat pivot, c;
+    GLuint  lt, gt, i, t;
+    while (end - first > 1) {
+        pivot = b->centers[3 * indices[first + (end - first) / 2] + axis];
+        lt = i = first;
+        gt = end;
+        while (i < gt) {
+            c = b->centers[3 * indices[i] + axis];
+            t = indices[i];
+            if (c < pivot) {
+                indices[i++] = indices[lt];
+                indices[lt++] = t;
+            } else if (c > pivot) {
+                indices[i] = indices[--gt];
+                indices[gt] = t;
+            } else {
+                i++;
+            }
+        }
+        /* [first, lt) < pivot, [lt, gt) == pivot, [gt, end) > pivot */
+        if (mid < lt)
+            end = lt;
+        else if (mid >= gt)
+            first = gt;
+        else
+            return;
+    }
+}
+
+/* glmBVHSplit: build the subtree over count triangles starting at
+ * first into list, and return the index of its root.  At taskdepth a
+ * big enough subtree is only set aside as a task.
+ */
+static GLuint glmBVHSplit(GLMbvhbuild* b, GLMbvhlist* list, GLuint first, GLuint count, GLuint depth){
+    GLMbvhbin  bins[3][GLM_BVH_BINS];
+    GLMbvhbin* bin;
+    GLfloat    cmin[3], cmax[3], lmin[3], lmax[3], rmin[3], rmax[3];
+    GLfloat    scale[3], areas[GLM_BVH_BINS], cost, best, area;
+    GLuint     counts[GLM_BVH_BINS], node, axis, split, mid, left, right, i, j, k, n, t;
+    GLuint*    indices = b->indices;
+    GLMbvhtask* task;
+
+    node = glmBVHAdd(list);
+    glmBVHEmpty(list->nodes[node].min, list->nodes[node].max);
+    glmBVHEmpty(cmin, cmax);
+    for (i = first; i < first + count; i++) {
+        t = indices[i];
+        glmBVHGrow(list->nodes[node].min, list->nodes[node].max, &b->bounds[6 * t], &b->bounds[6 * t + 3]);
+        glmBVHGrow(cmin, cmax, &b->centers[3 * t], &b->centers[3 * t]);
+    }
+
+    if (list == b->top && depth == b->taskdepth && count >= GLM_BVH_TASKMIN) {
+        if (b->numtasks == b->maxtasks) {
+            b->maxtasks = b->maxtasks ? b->maxtasks * 2 : 16;
+            b->tasks = (GLMbvhtask*)realloc(b->tasks, sizeof(GLMbvhtask) * b->maxtasks);
+        }
+        task = &b->tasks[b->numtasks];
+        memset(task, 0, sizeof(GLMbvhtask));
+        task->first = first;
+        task->count = count;
+        list->nodes[node].count = GLM_BVH_TASK;
+        list->nodes[node].offset = b->numtasks++;
+        return node;
+    }
+
+    /* the cheapest split plane over all three axes */
+    best = count * glmBVHArea(list->nodes[node].min, list->nodes[node].max);
+    axis = 3;
+    split = 0;
+    if (count > 1 && depth < GLM_BVH_DEPTH) {
+        for (k = 0; k < 3; k++) {
+            scale[k] = cmax[k] > cmin[k] ? GLM_BVH_BINS / (cmax[k] - cmin[k]) : 0.0;
+            for (j = 0; j < GLM_BVH_BINS; j++) {
+                glmBVHEmpty(bins[k][j].min, bins[k][j].max);
+                bins[k][j].count = 0;
+            }
+        }
+        for (i = first; i < first + count; i++) {
+            t = indices[i];
+            for (k = 0; k < 3; k++) {
+                j = (GLuint)((b->centers[3 * t + k] - cmin[k]) * scale[k]);
+                if (j >= GLM_BVH_BINS)
+                    j = GLM_BVH_BINS - 1;
+                bin = &bins[k][j];
+                glmBVHGrow(bin->min, bin->max, &b->bounds[6 * t], &b->bounds[6 * t + 3]);
+                bin->count++;
+            }
+        }
+        area = glmBVHArea(list->nodes[node].min, list->nodes[node].max);
+        for (k = 0; k < 3; k++) {
+            if (scale[k] == 0.0)
+                continue;
+            /* sweep from the right for the right hand sides, then from
+            the left for the left hand sides */
+            glmBVHEmpty(rmin, rmax);
+            n = 0;
+            for (j = GLM_BVH_BINS - 1; j > 0; j--) {
+                glmBVHGrow(rmin, rmax, bins[k][j].min, bins[k][j].max);
+                n += bins[k][j].count;
+                areas[j] = glmBVHArea(rmin, rmax);
+                counts[j] = n;
+            }
+            glmBVHEmpty(lmin, lmax);
+            n = 0;
+            for (j = 1; j < GLM_BVH_BINS; j++) {
+                glmBVHGrow(lmin, lmax, bins[k][j - 1].min, bins[k][j - 1].max);
+                n += bins[k][j - 1].count;
+                if (!n || !counts[j])
+                    continue;
+                cost = GLM_BVH_TRAVERSE * area + n * glmBVHArea(lmin, lmax) + counts[j] * areas[j];
+                if (cost < best) {
+                    best = cost;
+                    axis = k;
+                    split = j;
+                }
+            }
+        }
+    }
+
+    if (axis == 3 && count <= GLM_BVH_LEAF) {
+        list->nodes[node].offset = first;
+        list->nodes[node].count = count;
+        return node;
+    }
+
+    if (axis < 3) {
+        /* partition around the plane */
+        i = first;
+        j = first + count;
+        while (i < j) {
+            t = indices[i];
+            n = (GLuint)((b->centers[3 * t + axis] - cmin[axis]) * scale[axis]);
+            if (n >= GLM_BVH_BINS)
+                n = GLM_BVH_BINS - 1;
+            if (n < split) {
+                i++;
+            } else {
+                indices[i] = indices[--j];
+                indices[j] = t;
+            }
+        }
+        mid = i;
+    } else {
+        /* too many for a leaf, but no plane helps (or the tree is too
+        deep already): halve them along the longest side of the centers */
+        axis = 0;
+        for (k = 1; k < 3; k++)
+            if (cmax[k] - cmin[k] > cmax[axis] - cmin[axis])
+                axis = k;
+        mid = first + count / 2;
+        glmBVHSelect(b, first, first + count, mid, axis);
+    }
+
+    list->nodes[node].axis = axis;
+    left = glmBVHSplit(b, list, first, mid - first, depth + 1);
+    assert(left == node + 1);
+    right = glmBVHSplit(b, list, mid, first + count - mid, depth + 1);
+    list->nodes[node].offset = right;
+    return node;
+}
+
+/* glmBVHTaskWorker: build the subtree of a task */
+static GLvoid glmBVHTaskWorker(GLuint i, GLvoid* data){
+    GLMbvhbuild* b = (GLMbvhbuild*)data;
+    glmBVHSplit(b, &b->tasks[i].list, b->tasks[i].first, b->tasks[i].count, b->taskdepth);
+}
+
+/* glmBVHCopy: copy the subtree at node i of nodes into the BVH, depth
+ * first, putting the subtrees of tasks in their place */
+static GLvoid glmBVHCopy(GLMbvhbuild* b, GLMbvhnode* nodes, GLuint i){
+    GLMbvh* bvh = b->bvh;
+    GLuint  j;
+    if (nodes[i].count == GLM_BVH_TASK) {
+        glmBVHCopy(b, b->tasks[nodes[i].offset].list.nodes, 0);
+        return;
+    }
+    j = bvh->numnodes++;
+    bvh->nodes[j] = nodes[i];
+    if (nodes[i].count == 0) {
+        glmBVHCopy(b, nodes, i + 1);
+        bvh->nodes[j].offset = bvh->numnodes;
+        glmBVHCopy(b, nodes, nodes[i].offset);
+    }
+}
+
+/* glmBVHCornerWorker: copy a chunk of triangles in leaf order */
+static GLvoid glmBVHCornerWorker(GLuint chunk, GLvoid* data){
+    GLMbvhbuild* b = (GLMbvhbuild*)data;
+    GLMmodel* model = b->model;
+    GLfloat*  dst;
+    GLfloat*  v[3];
+    GLuint    i, end, c, k;
+    end = (chunk + 1) * GLM_BVH_CHUNK;
+    if (end > model->numtriangles)
+        end = model->numtriangles;
+    for (i = chunk * GLM_BVH_CHUNK; i < end; i++) {
+        dst = &b->bvh->corners[9 * i];
+        for (c = 0; c < 3; c++)
+            v[c] = &model->vertices[3 * T(b->indices[i]).vindices[c]];
+        for (k = 0; k < 3; k++) {
+            dst[k] = v[0][k];
+            dst[3 + k] = v[1][k] - v[0][k];
+            dst[6 + k] = v[2][k] - v[0][k];
+        }
+    }
+}
+
+/* glmBVH: Builds a bounding volume hierarchy over the triangles of a
+ * model, for glmIntersect() and glmOccluded().  It keeps a copy of the
+ * triangles, so it goes stale if the model's vertices move.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLMbvh* glmBVH(GLMmodel* model){
+    GLMbvhbuild b;
+    GLMbvhlist  top;
+    GLMbvh*     bvh;
+    GLuint      numchunks, i, n;
+    assert(model);
+    assert(model->vertices);
+
+    bvh = (GLMbvh*)calloc(1, sizeof(GLMbvh));
+    bvh->numtriangles = model->numtriangles;
+    if (!model->numtriangles)
+        return bvh;
+
+    memset(&b, 0, sizeof(b));
+    b.model = model;
+    b.bvh = bvh;
+    b.bounds  = (GLfloat*)malloc(sizeof(GLfloat) * 6 * model->numtriangles);
+    b.centers = (GLfloat*)malloc(sizeof(GLfloat) * 3 * model->numtriangles);
+    b.indices = (GLuint*)malloc(sizeof(GLuint) * model->numtriangles);
+    numchunks = (model->numtriangles + GLM_BVH_CHUNK - 1) / GLM_BVH_CHUNK;
+    glmParallel(numchunks, glmBVHBoundsWorker, &b);
+
+    /* split into about four tasks per thread, then build those */
+    for (b.taskdepth = 0, n = 1; n < 4 * glmNumThreads(); n *= 2)
+        b.taskdepth++;
+    memset(&top, 0, sizeof(top));
+    b.top = &top;
+    glmBVHSplit(&b, &top, 0, model->numtriangles, 0);
+    glmParallel(b.numtasks, glmBVHTaskWorker, &b);
+
+    n = top.numnodes;
+    for (i = 0; i < b.numtasks; i++)
+        n += b.tasks[i].list.numnodes;
+    bvh->nodes = (GLMbvhnode*)malloc(sizeof(GLMbvhnode) * n);
+    glmBVHCopy(&b, top.nodes, 0);
+    bvh->triangles = b.indices;
+    bvh->corners = (GLfloat*)malloc(sizeof(GLfloat) * 9 * model->numtriangles);
+    glmParallel(numchunks, glmBVHCornerWorker, &b);
+
+    for (i = 0; i < b.numtasks; i++)
+        free(b.tasks[i].list.nodes);
+    free(b.tasks);
+    free(top.nodes);
+    free(b.bounds);
+    free(b.centers);
+    return bvh;
+}
+
+/* glmBVHBox: whether a ray hits a node's box before tmax */
+static inline GLboolean glmBVHBox(const GLMbvhnode* node, const GLfloat* origin,
+                                  const GLfloat* inverse, GLfloat tmax){
+    GLfloat t0, t1, tnear = 0.0, tfar = tmax;
+    GLuint  k;
+    for (k = 0; k < 3; k++) {
+        t0 = (node->min[k] - origin[k]) * inverse[k];
+        t1 = (node->max[k] - origin[k]) * inverse[k];
+        if (t0 > t1) {
+            GLfloat t = t0;
+            t0 = t1;
+            t1 = t;
+        }
+        if (t0 > tnear) tnear = t0;
+        if (t1 < tfar) tfar = t1;
+    }
+    return tnear <= tfar;
+}
+
+/* glmBVHTriangle: Moller-Trumbore ray/triangle test, both sides */
+static inline GLboolean glmBVHTriangle(const GLfloat* c, const GLfloat* origin, const GLfloat* direction,
+                                       GLfloat tmax, GLfloat* t, GLfloat* u, GLfloat* v){
+    const GLfloat* e1 = c + 3;
+    const GLfloat* e2 = c + 6;
+    GLfloat p[3], q[3], s[3], det, inv;
+    p[0] = direction[1] * e2[2] - direction[2] * e2[1];
+    p[1] = direction[2] * e2[0] - direction[0] * e2[2];
+    p[2] = direction[0] * e2[1] - direction[1] * e2[0];
+    det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (det == 0.0)
+        return GL_FALSE;
+    inv = 1.0 / det;
+    s[0] = origin[0] - c[0];
+    s[1] = origin[1] - c[1];
+    s[2] = origin[2] - c[2];
+    *u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+    if (*u < 0.0 || *u > 1.0)
+        return GL_FALSE;
+    q[0] = s[1] * e1[2] - s[2] * e1[1];
+    q[1] = s[2] * e1[0] - s[0] * e1[2];
+    q[2] = s[0] * e1[1] - s[1] * e1[0];
+    *v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inv;
+    if (*v < 0.0 || *u + *v > 1.0)
+        return GL_FALSE;
+    *t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+    return *t > 0.0 && *t < tmax;
+}
+
+/* glmBVHTrace: walk the tree, near child first, for the closest hit
+ * (or with any set, the first one found) */
+static GLboolean glmBVHTrace(GLMbvh* bvh, GLfloat* origin, GLfloat* direction, GLfloat tmax,
+                             GLMhit* hit, GLboolean any){
+    const GLMbvhnode* node;
+    GLuint  stack[GLM_BVH_STACK];
+    GLuint  sp, i, j, end;
+    GLfloat inverse[3], t, u, v;
+    GLboolean found = GL_FALSE;
+    assert(bvh);
+    if (!bvh->numnodes)
+        return GL_FALSE;
+    for (i = 0; i < 3; i++)
+        inverse[i] = 1.0 / direction[i];
+    sp = 0;
+    i = 0;
+    for (;;) {
+        node = &bvh->nodes[i];
+        if (glmBVHBox(node, origin, inverse, tmax)) {
+            if (!node->count) {
+                assert(sp < GLM_BVH_STACK);
+                if (direction[node->axis] < 0.0) {
+                    stack[sp++] = i + 1;
+                    i = node->offset;
+                } else {
+                    stack[sp++] = node->offset;
+                    i++;
+                }
+                continue;
+            }
+            end = node->offset + node->count;
+            for (j = node->offset; j < end; j++) {
+                if (!glmBVHTriangle(&bvh->corners[9 * j], origin, direction, tmax, &t, &u, &v))
+                    continue;
+                found = GL_TRUE;
+                if (any)
+                    return GL_TRUE;
+                tmax = t;
+                hit->triangle = bvh->triangles[j];
+                hit->t = t;
+                hit->u = u;
+                hit->v = v;
+            }
+        }
+        if (!sp)
+            break;
+        i = stack[--sp];
+    }
+    return found;
+}
+
+/* glmIntersect: Finds the closest triangle a ray hits.  Returns
+ * GL_FALSE if it hits none.
+ *
+ * bvh       - BVH from glmBVH()
+ * origin    - start of the ray
+ * direction - direction of the ray (distances are in its lengths)
+ * tmax      - how far along the ray to look (FLT_MAX for all the way)
+ * hit       - receives the triangle, distance and barycentric coords
+ */
+GLboolean glmIntersect(GLMbvh* bvh, GLfloat* origin, GLfloat* direction, GLfloat tmax, GLMhit* hit){
+    assert(hit);
+    return glmBVHTrace(bvh, origin, direction, tmax, hit, GL_FALSE);
+}
+
+/* glmOccluded: Whether a ray hits any triangle at all before tmax,
+ * which is cheaper to answer than which one it hits first.
+ *
+ * bvh       - BVH from glmBVH()
+ * origin    - start of the ray
+ * direction - direction of the ray (distances are in its lengths)
+ * tmax      - how far along the ray to look
+ */
+GLboolean glmOccluded(GLMbvh* bvh, GLfloat* origin, GLfloat* direction, GLfloat tmax){
+    return glmBVHTrace(bvh, origin, direction, tmax, NULL, GL_TRUE);
+}
+
+/* glmDeleteBVH: Deletes a BVH.
+ *
+ * bvh - BVH from glmBVH()
+ */
+GLvoid glmDeleteBVH(GLMbvh* bvh){
+    assert(bvh);
+    free(bvh->nodes);
+    free(bvh->triangles);
+    free(bvh->corners);
+    free(bvh);
+}
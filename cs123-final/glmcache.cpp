@@ -0,0 +1,470 @@
+/*
+      glmcache.cpp
+
+      Binary mesh cache for GLM models.
+
+      A parsed model is written next to its .OBJ file as <name>.obj.glmc.
+      The cache is a header followed by the model's arrays, each laid out
+      exactly as GLMmodel keeps them in memory, so loading it is a single
+      mmap() plus pointer fix-ups: the vertex, normal, texcoord, facet
+      normal, triangle and group arrays of the model point straight into
+      the mapping.  The mapping is private and writable, so in-place
+      operations such as glmUnitize() or glmScale() still work (the
+      touched pages are copied on write and never reach the file).
+
+      The cache remembers the size, modification time and a 64-bit
+      FNV-1a hash of the .OBJ it was built from.  It is used as long as
+      size and time match; if only the time changed the .OBJ is hashed
+      and the cache is reused when the contents are the same.  It also
+      remembers the processing (such as GLM_VERTEX_CACHE) that was done
+      to the model before it was written, so that is only paid once too.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <GL/gl.h>
+#include "glm.h"
+
+#define GLM_CACHE_MAGIC   "GLMC"
+#define GLM_CACHE_VERSION 1
+#define GLM_CACHE_ALIGN   16
+
+/* GLMcacheheader: first bytes of a cache file.  Offsets are from the
+ * start of the file, 0 meaning a NULL array or string.
+ */
+typedef struct _GLMcacheheader {
+    char   magic[4];              /* GLM_CACHE_MAGIC */
+    GLuint version;               /* GLM_CACHE_VERSION */
+    GLuint trianglesize;          /* sizeof(GLMtriangle) of the writer */
+    GLuint flags;                 /* how the model was processed */
+
+    unsigned long long srcsize;   /* size of the .OBJ */
+    unsigned long long srcmtime;  /* modification time of the .OBJ */
+    unsigned long long srchash;   /* FNV-1a hash of the .OBJ */
+    unsigned long long size;      /* size of the cache file */
+
+    GLuint numvertices;
+    GLuint numnormals;
+    GLuint numtexcoords;
+    GLuint numfacetnorms;
+    GLuint numtriangles;
+    GLuint nummaterials;
+    GLuint numgroups;
+    GLuint numtextures;
+
+    unsigned long long mtllibname;
+    unsigned long long vertices;   /* GLfloat[3 * (numvertices + 1)] */
+    unsigned long long normals;    /* GLfloat[3 * (numnormals + 1)] */
+    unsigned long long texcoords;  /* GLfloat[2 * (numtexcoords + 1)] */
+    unsigned long long facetnorms; /* GLfloat[3 * (numfacetnorms + 1)] */
+    unsigned long long triangles;  /* GLMtriangle[numtriangles] */
+    unsigned long long materials;  /* GLMcachematerial[nummaterials] */
+    unsigned long long groups;     /* GLMcachegroup[numgroups] */
+    unsigned long long textures;   /* unsigned long long[numtextures] */
+} GLMcacheheader;
+
+/* GLMcachegroup: a group as stored in the cache, in list order */
+typedef struct _GLMcachegroup {
+    unsigned long long name;
+    unsigned long long triangles;  /* GLuint[numtriangles] */
+    GLuint numtriangles;
+    GLuint material;
+} GLMcachegroup;
+
+/* GLMcachematerial: a material as stored in the cache */
+typedef struct _GLMcachematerial {
+    unsigned long long name;
+    GLfloat diffuse[4];
+    GLfloat ambient[4];
+    GLfloat specular[4];
+    GLfloat emmissive[4];
+    GLfloat shininess;
+    GLuint textureid;
+    GLuint bumpid;
+    GLuint pad;
+} GLMcachematerial;
+
+/* GLMcachewriter: running state while a cache file is written */
+typedef struct _GLMcachewriter {
+    FILE* file;
+    unsigned long long offset;
+    GLboolean failed;
+} GLMcachewriter;
+
+
+/* glmHashFile: 64-bit FNV-1a hash of a whole file.  Returns 0 if the
+ * file can't be read.
+ */
+static unsigned long long glmHashFile(char* filename){
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned char* data;
+    struct stat st;
+    size_t i;
+    int fd;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return hash;
+    }
+    data = (unsigned char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    for (i = 0; i < (size_t)st.st_size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    munmap(data, st.st_size);
+    return hash;
+}
+
+/* glmCacheName: return the name of the cache file for a model file
+ *
+ * NOTE: the return value should be free'd.
+ */
+static char* glmCacheName(char* filename){
+    char* name;
+    name = (char*)malloc(strlen(filename) + strlen(".glmc") + 1);
+    strcpy(name, filename);
+    strcat(name, ".glmc");
+    return name;
+}
+
+/* glmCacheWrite: append bytes to the cache file, padded so that the
+ * next section starts aligned.  Returns the offset the bytes were
+ * written at, or 0 for a NULL array.
+ */
+static unsigned long long glmCacheWrite(GLMcachewriter* writer, const GLvoid* data, size_t size){
+    static const char zeros[GLM_CACHE_ALIGN] = { 0 };
+    unsigned long long offset;
+    size_t pad;
+    if (!data)
+        return 0;
+    offset = writer->offset;
+    if (size && fwrite(data, size, 1, writer->file) != 1)
+        writer->failed = GL_TRUE;
+    writer->offset += size;
+    pad = (GLM_CACHE_ALIGN - writer->offset % GLM_CACHE_ALIGN) % GLM_CACHE_ALIGN;
+    if (pad && fwrite(zeros, pad, 1, writer->file) != 1)
+        writer->failed = GL_TRUE;
+    writer->offset += pad;
+    return offset;
+}
+
+/* glmCacheString: append a string (with its terminator) to the cache */
+static unsigned long long glmCacheString(GLMcachewriter* writer, const char* s){
+    if (!s)
+        return 0;
+    return glmCacheWrite(writer, s, strlen(s) + 1);
+}
+
+/* glmCachePointer: turn a cache offset back into a pointer */
+static GLvoid* glmCachePointer(char* data, unsigned long long offset){
+    return offset ? data + offset : NULL;
+}
+
+/* glmCacheCurrent: true if a cache built from a source file with the
+ * given size and time can be used for the source as it is now.  A
+ * cache whose only difference is the time is checked against the hash
+ * of the source and, if still good, gets its time brought up to date.
+ */
+static GLboolean glmCacheCurrent(GLMcacheheader* header, char* cachename, char* filename,
+                                 struct stat* st, unsigned long long* hash){
+    unsigned long long mtime;
+    int fd;
+    mtime = (unsigned long long)st->st_mtime;
+    if (header->srcsize != (unsigned long long)st->st_size)
+        return GL_FALSE;
+    if (header->srcmtime == mtime)
+        return GL_TRUE;
+    *hash = glmHashFile(filename);
+    if (header->srchash != *hash)
+        return GL_FALSE;
+    /* same contents, just touched: remember the new time */
+    fd = open(cachename, O_WRONLY);
+    if (fd >= 0) {
+        if (pwrite(fd, &mtime, sizeof(mtime), offsetof(GLMcacheheader, srcmtime)) != sizeof(mtime))
+            fprintf(stderr, "glmReadOBJCached(): can't update cache file \"%s\".\n", cachename);
+        close(fd);
+    }
+    header->srcmtime = mtime;
+    return GL_TRUE;
+}
+
+/* glmLoadCache: map a cache file and build a model on top of it.
+ * Returns NULL if there is no usable cache for the source file.
+ */
+static GLMmodel* glmLoadCache(char* cachename, char* filename, GLuint flags, struct stat* st,
+                              unsigned long long* hash){
+    GLMcacheheader* header;
+    GLMcachegroup* groups;
+    GLMcachematerial* materials;
+    unsigned long long* textures;
+    GLMmodel* model;
+    GLMgroup* group;
+    GLMgroup** tail;
+    struct stat cst;
+    char* data;
+    GLuint i;
+    int fd;
+    fd = open(cachename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &cst) < 0 || (size_t)cst.st_size < sizeof(GLMcacheheader)) {
+        close(fd);
+        return NULL;
+    }
+    data = (char*)mmap(NULL, cst.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    header = (GLMcacheheader*)data;
+    if (memcmp(header->magic, GLM_CACHE_MAGIC, 4) ||
+        header->version != GLM_CACHE_VERSION ||
+        header->trianglesize != sizeof(GLMtriangle) ||
+        header->size != (unsigned long long)cst.st_size ||
+        header->flags != flags ||
+        !glmCacheCurrent(header, cachename, filename, st, hash)) {
+        munmap(data, cst.st_size);
+        return NULL;
+    }
+
+    /* allocate a new model whose arrays live in the mapping */
+    model = (GLMmodel*)malloc(sizeof(GLMmodel));
+    model->arena         = NULL;
+    model->pathname      = glmStrdup(model, filename);
+    model->mtllibname    = (char*)glmCachePointer(data, header->mtllibname);
+    model->numvertices   = header->numvertices;
+    model->vertices      = (GLfloat*)glmCachePointer(data, header->vertices);
+    model->colors        = NULL;
+    model->numnormals    = header->numnormals;
+    model->normals       = (GLfloat*)glmCachePointer(data, header->normals);
+    model->numtexcoords  = header->numtexcoords;
+    model->texcoords     = (GLfloat*)glmCachePointer(data, header->texcoords);
+    model->numfacetnorms = header->numfacetnorms;
+    model->facetnorms    = (GLfloat*)glmCachePointer(data, header->facetnorms);
+    model->numtriangles  = header->numtriangles;
+    model->triangles     = (GLMtriangle*)glmCachePointer(data, header->triangles);
+    model->nummaterials  = header->nummaterials;
+    model->materials     = NULL;
+    model->numtextures   = 0;
+    model->textures      = NULL;
+    model->numgroups     = header->numgroups;
+    model->groups        = NULL;
+    model->position[0]   = 0.0;
+    model->position[1]   = 0.0;
+    model->position[2]   = 0.0;
+    model->mapping       = data;
+    model->mappingsize   = cst.st_size;
+
+    /* materials are small and get their own array */
+    materials = (GLMcachematerial*)glmCachePointer(data, header->materials);
+    if (materials) {
+        model->materials = (GLMmaterial*)glmAlloc(model, sizeof(GLMmaterial) * model->nummaterials);
+        for (i = 0; i < model->nummaterials; i++) {
+            model->materials[i].name = (char*)glmCachePointer(data, materials[i].name);
+            memcpy(model->materials[i].diffuse, materials[i].diffuse, sizeof(GLfloat) * 4);
+            memcpy(model->materials[i].ambient, materials[i].ambient, sizeof(GLfloat) * 4);
+            memcpy(model->materials[i].specular, materials[i].specular, sizeof(GLfloat) * 4);
+            memcpy(model->materials[i].emmissive, materials[i].emmissive, sizeof(GLfloat) * 4);
+            model->materials[i].shininess = materials[i].shininess;
+            model->materials[i].textureid = materials[i].textureid;
+            model->materials[i].bumpid    = materials[i].bumpid;
+        }
+    }
+
+    /* rebuild the group list in its original order */
+    groups = (GLMcachegroup*)glmCachePointer(data, header->groups);
+    tail = &model->groups;
+    for (i = 0; i < model->numgroups; i++) {
+        group = (GLMgroup*)glmAlloc(model, sizeof(GLMgroup));
+        group->name         = (char*)glmCachePointer(data, groups[i].name);
+        group->numtriangles = groups[i].numtriangles;
+        group->triangles    = (GLuint*)glmCachePointer(data, groups[i].triangles);
+        group->material     = groups[i].material;
+        group->next         = NULL;
+        *tail = group;
+        tail = &group->next;
+    }
+
+    /* textures are GL objects, so add them again in the same order
+       (materials refer to them by index) for glmLoadTextures() */
+    textures = (unsigned long long*)glmCachePointer(data, header->textures);
+    for (i = 0; i < header->numtextures; i++)
+        glmFindOrAddTexture(model, (char*)glmCachePointer(data, textures[i]));
+
+    return model;
+}
+
+/* glmWriteCache: Writes a model to a binary cache file that
+ * glmReadOBJCached() can map.  Returns GL_FALSE if the file couldn't be
+ * written.
+ *
+ * model     - initialized GLMmodel structure
+ * cachename - name of the cache file to write
+ * flags     - processing that was applied to the model
+ * srcsize, srcmtime, srchash - identity of the .OBJ the model came from
+ */
+GLboolean glmWriteCache(GLMmodel* model, char* cachename, GLuint flags, unsigned long long srcsize,
+                        unsigned long long srcmtime, unsigned long long srchash){
+    GLMcacheheader header;
+    GLMcachewriter writer;
+    GLMcachegroup* groups;
+    GLMcachematerial* materials;
+    unsigned long long* textures;
+    GLMgroup* group;
+    char* tmpname;
+    GLuint i;
+    assert(model);
+
+    /* write to a temporary file and move it in place when complete, so
+       a reader never sees half a cache */
+    tmpname = (char*)malloc(strlen(cachename) + strlen(".tmp") + 1);
+    strcpy(tmpname, cachename);
+    strcat(tmpname, ".tmp");
+    writer.file = fopen(tmpname, "wb");
+    if (!writer.file) {
+        free(tmpname);
+        return GL_FALSE;
+    }
+    writer.offset = 0;
+    writer.failed = GL_FALSE;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GLM_CACHE_MAGIC, 4);
+    header.version       = GLM_CACHE_VERSION;
+    header.trianglesize  = sizeof(GLMtriangle);
+    header.flags         = flags;
+    header.srcsize       = srcsize;
+    header.srcmtime      = srcmtime;
+    header.srchash       = srchash;
+    header.numvertices   = model->numvertices;
+    header.numnormals    = model->numnormals;
+    header.numtexcoords  = model->numtexcoords;
+    header.numfacetnorms = model->numfacetnorms;
+    header.numtriangles  = model->numtriangles;
+    header.nummaterials  = model->materials ? model->nummaterials : 0;
+    header.numgroups     = model->numgroups;
+    header.numtextures   = model->numtextures;
+    /* placeholder, rewritten once all the offsets are known */
+    glmCacheWrite(&writer, &header, sizeof(header));
+
+    header.vertices   = glmCacheWrite(&writer, model->vertices,
+                                      sizeof(GLfloat) * 3 * (model->numvertices + 1));
+    header.normals    = glmCacheWrite(&writer, model->normals,
+                                      sizeof(GLfloat) * 3 * (model->numnormals + 1));
+    header.texcoords  = glmCacheWrite(&writer, model->texcoords,
+                                      sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+    header.facetnorms = glmCacheWrite(&writer, model->facetnorms,
+                                      sizeof(GLfloat) * 3 * (model->numfacetnorms + 1));
+    header.triangles  = glmCacheWrite(&writer, model->triangles,
+                                      sizeof(GLMtriangle) * model->numtriangles);
+    header.mtllibname = glmCacheString(&writer, model->mtllibname);
+
+    materials = (GLMcachematerial*)calloc(header.nummaterials + 1, sizeof(GLMcachematerial));
+    for (i = 0; i < header.nummaterials; i++) {
+        materials[i].name = glmCacheString(&writer, model->materials[i].name);
+        memcpy(materials[i].diffuse, model->materials[i].diffuse, sizeof(GLfloat) * 4);
+        memcpy(materials[i].ambient, model->materials[i].ambient, sizeof(GLfloat) * 4);
+        memcpy(materials[i].specular, model->materials[i].specular, sizeof(GLfloat) * 4);
+        memcpy(materials[i].emmissive, model->materials[i].emmissive, sizeof(GLfloat) * 4);
+        materials[i].shininess = model->materials[i].shininess;
+        materials[i].textureid = model->materials[i].textureid;
+        materials[i].bumpid    = model->materials[i].bumpid;
+    }
+    if (header.nummaterials)
+        header.materials = glmCacheWrite(&writer, materials,
+                                         sizeof(GLMcachematerial) * header.nummaterials);
+    free(materials);
+
+    groups = (GLMcachegroup*)calloc(model->numgroups + 1, sizeof(GLMcachegroup));
+    for (group = model->groups, i = 0; group && i < model->numgroups; group = group->next, i++) {
+        groups[i].name         = glmCacheString(&writer, group->name);
+        groups[i].triangles    = glmCacheWrite(&writer, group->triangles,
+                                               sizeof(GLuint) * group->numtriangles);
+        groups[i].numtriangles = group->numtriangles;
+        groups[i].material     = group->material;
+    }
+    header.groups = glmCacheWrite(&writer, groups, sizeof(GLMcachegroup) * model->numgroups);
+    free(groups);
+
+    textures = (unsigned long long*)calloc(model->numtextures + 1, sizeof(unsigned long long));
+    for (i = 0; i < model->numtextures; i++)
+        textures[i] = glmCacheString(&writer, model->textures[i].name);
+    header.textures = glmCacheWrite(&writer, textures,
+                                    sizeof(unsigned long long) * model->numtextures);
+    free(textures);
+
+    header.size = writer.offset;
+    if (fseek(writer.file, 0, SEEK_SET) ||
+        fwrite(&header, sizeof(header), 1, writer.file) != 1)
+        writer.failed = GL_TRUE;
+    if (fclose(writer.file))
+        writer.failed = GL_TRUE;
+    if (writer.failed || rename(tmpname, cachename)) {
+        unlink(tmpname);
+        free(tmpname);
+        return GL_FALSE;
+    }
+    free(tmpname);
+    return GL_TRUE;
+}
+
+/* glmReadOBJCached: Reads a model through a binary cache kept next to
+ * the .OBJ file (filename + ".glmc").  If the cache is up to date with
+ * the .OBJ and was built with the same flags it is mapped and the
+ * model's arrays point straight into it; otherwise the .OBJ is parsed
+ * with glmReadOBJDeferred(), processed as the flags ask and the cache
+ * is (re)written.
+ *
+ * filename   - name of the file containing the Wavefront .OBJ format data.
+ * numthreads - number of threads to parse on if the cache is stale
+ * flags      - a bitwise OR of the processing to apply
+ *              GLM_VERTEX_CACHE - reorder for the vertex cache
+ *              GLM_MESHLETS     - reorder into meshlets (and for the
+ *                                 vertex cache within them)
+ *              GLM_DEFER_TEXTURES - don't load the textures (to read
+ *                                 on a thread without a GL context)
+ */
+GLMmodel* glmReadOBJCached(char* filename, GLuint numthreads, GLuint flags, mycallback *call){
+    GLMmodel* model;
+    struct stat st;
+    unsigned long long hash;
+    char* cachename;
+    GLuint processing;
+    /* options that aren't processing aren't part of the cache */
+    processing = flags & ~GLM_DEFER_TEXTURES;
+    if (stat(filename, &st) < 0) {
+        fprintf(stderr, "glmReadOBJ() failed: can't open data file \"%s\".\n",
+                filename);
+        exit(1);
+    }
+    cachename = glmCacheName(filename);
+    hash = 0;
+    model = glmLoadCache(cachename, filename, processing, &st, &hash);
+    if (!model) {
+        model = glmReadOBJDeferred(filename, numthreads, call);
+        if (flags & GLM_MESHLETS)
+            glmMeshletOrder(model, GLM_MESHLET_SIZE);
+        else if (flags & GLM_VERTEX_CACHE)
+            glmVertexCache(model);
+        if (!hash)
+            hash = glmHashFile(filename);
+        if (!glmWriteCache(model, cachename, processing, st.st_size, st.st_mtime, hash))
+            fprintf(stderr, "glmReadOBJCached(): can't write cache file \"%s\".\n",
+                    cachename);
+    }
+    free(cachename);
+    if (!(flags & GLM_DEFER_TEXTURES))
+        glmLoadTextures(model, call);
+    return model;
+}
@@ -0,0 +1,370 @@
+/*
+      glmdeform.cpp
+
+      Models whose vertices move every frame (wobbles, morphs).
+
+      glmDeformable() gives every vertex of a model one normal, averaged
+      from the facets around it, and works out which triangles each
+      vertex is part of.  glmDeform() then moves the vertices on all
+      threads and recomputes only what the moved ones touch: the facet
+      normals of their triangles, and the vertex normals around those.
+      Past the move itself, the work is proportional to the number of
+      vertices that moved, not to the size of the model.
+      glmDrawDeformable() uploads the run of vertices that changed into a
+      dynamic vertex buffer and draws it.  The model itself is left
+      alone.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "glm.h"
+
+#define T(x) (model->triangles[(x)])
+
+#define GLM_DEFORM_CHUNK 4096         /* vertices or triangles per parallel item */
+
+/* GLMdeformchunk: what one parallel item of glmDeform() changed */
+typedef struct _GLMdeformchunk {
+    GLuint  moved;                    /* vertices moved, listed from vertexlist[chunk * CHUNK] */
+    GLuint  normals;                  /* vertex normals recomputed */
+    GLuint  first, last;              /* range of vertices that changed */
+} GLMdeformchunk;
+
+/* GLMdeformpass: state of a glmDeform() call */
+typedef struct _GLMdeformpass {
+    GLMdeform*      deform;
+    GLvoid        (*move)(const GLfloat*, const GLfloat*, GLfloat*, GLvoid*);
+    GLvoid*         data;
+    GLMdeformchunk* chunks;
+    GLuint          numchanged;       /* triangles in trianglelist */
+    GLuint          numstale;         /* vertices in vertexlist, after the facet pass */
+} GLMdeformpass;
+
+/* glmDeformFacet: the normal of a triangle, scaled by twice its area
+ * so that summing them weights the big facets around a vertex more
+ */
+static inline GLvoid glmDeformFacet(const GLfloat* vertices, const GLuint* v, GLfloat* n){
+    const GLfloat* a = &vertices[3 * v[0]];
+    const GLfloat* b = &vertices[3 * v[1]];
+    const GLfloat* c = &vertices[3 * v[2]];
+    GLfloat u[3], w[3];
+    u[0] = b[0] - a[0]; u[1] = b[1] - a[1]; u[2] = b[2] - a[2];
+    w[0] = c[0] - a[0]; w[1] = c[1] - a[1]; w[2] = c[2] - a[2];
+    n[0] = u[1] * w[2] - u[2] * w[1];
+    n[1] = u[2] * w[0] - u[0] * w[2];
+    n[2] = u[0] * w[1] - u[1] * w[0];
+}
+
+/* glmDeformNormal: the normal of a vertex, from the facets around it */
+static inline GLvoid glmDeformNormal(GLMdeform* deform, GLuint v){
+    GLfloat* n = &deform->normals[3 * v];
+    GLfloat* f;
+    GLfloat  l;
+    GLuint   i;
+    n[0] = n[1] = n[2] = 0;
+    for (i = deform->offsets[v]; i < deform->offsets[v + 1]; i++) {
+        f = &deform->facetnorms[3 * deform->adjacency[i]];
+        n[0] += f[0];
+        n[1] += f[1];
+        n[2] += f[2];
+    }
+    l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (l > 0) {
+        n[0] /= l;
+        n[1] /= l;
+        n[2] /= l;
+    }
+}
+
+/* glmDeformable: Gets a model ready to be deformed.  The vertices start
+ * out where the model has them.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLMdeform* glmDeformable(GLMmodel* model){
+    GLMdeform* deform;
+    GLuint*    fill;
+    GLuint     i, j, v;
+    size_t     size;
+    assert(model);
+    assert(model->vertices);
+
+    deform = (GLMdeform*)calloc(1, sizeof(GLMdeform));
+    deform->numvertices  = model->numvertices;
+    deform->numtriangles = model->numtriangles;
+    size = sizeof(GLfloat) * 3 * (model->numvertices + 1);
+    deform->rest        = (GLfloat*)malloc(size);
+    deform->vertices    = (GLfloat*)malloc(size);
+    deform->restnormals = (GLfloat*)malloc(size);
+    deform->normals     = (GLfloat*)malloc(size);
+    deform->facetnorms  = (GLfloat*)malloc(sizeof(GLfloat) * 3 * model->numtriangles);
+    deform->indices     = (GLuint*)malloc(sizeof(GLuint) * 3 * model->numtriangles);
+    deform->moved       = (GLubyte*)calloc(model->numvertices + 1, 1);
+    deform->facets      = (GLubyte*)calloc(model->numtriangles, 1);
+    deform->stale       = (GLubyte*)calloc(model->numvertices + 1, 1);
+    deform->vertexlist  = (GLuint*)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    deform->trianglelist = (GLuint*)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    memcpy(deform->rest, model->vertices, size);
+    memcpy(deform->vertices, model->vertices, size);
+
+    /* the triangles around each vertex, counted and then filled in */
+    deform->offsets = (GLuint*)calloc(model->numvertices + 2, sizeof(GLuint));
+    for (i = 0; i < model->numtriangles; i++) {
+        for (j = 0; j < 3; j++) {
+            v = T(i).vindices[j];
+            deform->indices[3 * i + j] = v;
+            deform->offsets[v + 1]++;
+        }
+    }
+    for (v = 0; v <= model->numvertices; v++)
+        deform->offsets[v + 1] += deform->offsets[v];
+    deform->adjacency = (GLuint*)malloc(sizeof(GLuint) * (3 * model->numtriangles + 1));
+    fill = (GLuint*)malloc(sizeof(GLuint) * (model->numvertices + 1));
+    memcpy(fill, deform->offsets, sizeof(GLuint) * (model->numvertices + 1));
+    for (i = 0; i < model->numtriangles; i++)
+        for (j = 0; j < 3; j++)
+            deform->adjacency[fill[deform->indices[3 * i + j]]++] = i;
+    free(fill);
+
+    for (i = 0; i < model->numtriangles; i++)
+        glmDeformFacet(deform->vertices, &deform->indices[3 * i], &deform->facetnorms[3 * i]);
+    memset(deform->normals, 0, sizeof(GLfloat) * 3);
+    for (v = 1; v <= model->numvertices; v++)
+        glmDeformNormal(deform, v);
+    memcpy(deform->restnormals, deform->normals, size);
+
+    /* everything goes up with the first draw */
+    deform->first = 0;
+    deform->last  = model->numvertices;
+    return deform;
+}
+
+/* glmDeformMoveWorker: glmParallel() body that moves a chunk of
+ * vertices, and lists the ones that moved in the chunk's part of
+ * vertexlist
+ */
+static GLvoid glmDeformMoveWorker(GLuint chunk, GLvoid* data){
+    GLMdeformpass*  pass = (GLMdeformpass*)data;
+    GLMdeform*      deform = pass->deform;
+    GLMdeformchunk* c = &pass->chunks[chunk];
+    GLfloat         p[3];
+    GLfloat*        q;
+    GLuint*         list = &deform->vertexlist[chunk * GLM_DEFORM_CHUNK];
+    GLuint          v, end;
+    v = chunk * GLM_DEFORM_CHUNK + 1;
+    end = v + GLM_DEFORM_CHUNK <= deform->numvertices + 1 ? v + GLM_DEFORM_CHUNK : deform->numvertices + 1;
+    c->moved = 0;
+    for (; v < end; v++) {
+        q = &deform->vertices[3 * v];
+        p[0] = q[0];
+        p[1] = q[1];
+        p[2] = q[2];
+        pass->move(&deform->rest[3 * v], &deform->restnormals[3 * v], p, pass->data);
+        deform->moved[v] = p[0] != q[0] || p[1] != q[1] || p[2] != q[2];
+        if (!deform->moved[v])
+            continue;
+        q[0] = p[0];
+        q[1] = p[1];
+        q[2] = p[2];
+        list[c->moved++] = v;
+    }
+}
+
+/* glmDeformFacetWorker: glmParallel() body that recomputes the facet
+ * normals of the triangles around the vertices a chunk moved.  The
+ * first to reach a triangle claims it, recomputes it and lists it.
+ */
+static GLvoid glmDeformFacetWorker(GLuint chunk, GLvoid* data){
+    GLMdeformpass* pass = (GLMdeformpass*)data;
+    GLMdeform*     deform = pass->deform;
+    GLuint*        list = &deform->vertexlist[chunk * GLM_DEFORM_CHUNK];
+    GLuint         k, i, v, t;
+    for (k = 0; k < pass->chunks[chunk].moved; k++) {
+        v = list[k];
+        for (i = deform->offsets[v]; i < deform->offsets[v + 1]; i++) {
+            t = deform->adjacency[i];
+            if (__sync_lock_test_and_set(&deform->facets[t], 1))
+                continue;
+            glmDeformFacet(deform->vertices, &deform->indices[3 * t], &deform->facetnorms[3 * t]);
+            deform->trianglelist[__sync_fetch_and_add(&pass->numchanged, 1)] = t;
+        }
+    }
+}
+
+/* glmDeformStaleWorker: glmParallel() body that lists the vertices of a
+ * chunk of the changed triangles, each once, as needing a new normal
+ */
+static GLvoid glmDeformStaleWorker(GLuint chunk, GLvoid* data){
+    GLMdeformpass* pass = (GLMdeformpass*)data;
+    GLMdeform*     deform = pass->deform;
+    GLuint         i, j, v, t, end;
+    i = chunk * GLM_DEFORM_CHUNK;
+    end = i + GLM_DEFORM_CHUNK <= pass->numchanged ? i + GLM_DEFORM_CHUNK : pass->numchanged;
+    for (; i < end; i++) {
+        t = deform->trianglelist[i];
+        deform->facets[t] = 0;
+        for (j = 0; j < 3; j++) {
+            v = deform->indices[3 * t + j];
+            if (!__sync_lock_test_and_set(&deform->stale[v], 1))
+                deform->vertexlist[__sync_fetch_and_add(&pass->numstale, 1)] = v;
+        }
+    }
+}
+
+/* glmDeformNormalWorker: glmParallel() body that recomputes the normals
+ * of a chunk of the stale vertices
+ */
+static GLvoid glmDeformNormalWorker(GLuint chunk, GLvoid* data){
+    GLMdeformpass*  pass = (GLMdeformpass*)data;
+    GLMdeform*      deform = pass->deform;
+    GLMdeformchunk* c = &pass->chunks[chunk];
+    GLuint          i, v, end;
+    i = chunk * GLM_DEFORM_CHUNK;
+    end = i + GLM_DEFORM_CHUNK <= pass->numstale ? i + GLM_DEFORM_CHUNK : pass->numstale;
+    c->normals = 0;
+    c->first = ~0u;
+    c->last = 0;
+    for (; i < end; i++) {
+        v = deform->vertexlist[i];
+        deform->stale[v] = 0;
+        glmDeformNormal(deform, v);
+        c->normals++;
+        if (v < c->first)
+            c->first = v;
+        if (v > c->last)
+            c->last = v;
+    }
+}
+
+/* glmDeform: Moves the vertices of a deformable model, calling move()
+ * for every vertex on all threads (so it must be safe to call that
+ * way), and updates the normals around the ones that moved.  Returns
+ * the number of vertices that moved.
+ *
+ * deform - deformable model from glmDeformable()
+ * move   - called with the rest position and rest normal of a vertex
+ *          and its current position, which it sets to the new one
+ * data   - passed on to move()
+ */
+GLuint glmDeform(GLMdeform* deform, GLvoid (*move)(const GLfloat* rest, const GLfloat* normal,
+                                                   GLfloat* position, GLvoid* data), GLvoid* data){
+    GLMdeformpass pass;
+    GLuint        numchunks, i;
+    assert(deform);
+    assert(move);
+
+    numchunks = (deform->numvertices + GLM_DEFORM_CHUNK - 1) / GLM_DEFORM_CHUNK;
+    pass.deform = deform;
+    pass.move = move;
+    pass.data = data;
+    pass.chunks = (GLMdeformchunk*)malloc(sizeof(GLMdeformchunk) * (numchunks + 1));
+    pass.numchanged = 0;
+    pass.numstale = 0;
+    glmParallel(numchunks, glmDeformMoveWorker, &pass);
+    deform->nummoved = 0;
+    for (i = 0; i < numchunks; i++)
+        deform->nummoved += pass.chunks[i].moved;
+
+    deform->numnormals = 0;
+    if (deform->nummoved) {
+        /* the moved vertices' triangles, then those triangles' vertices
+           (which reuse vertexlist: the moved ones are done with), then
+           their normals */
+        glmParallel(numchunks, glmDeformFacetWorker, &pass);
+        glmParallel((pass.numchanged + GLM_DEFORM_CHUNK - 1) / GLM_DEFORM_CHUNK, glmDeformStaleWorker, &pass);
+        numchunks = (pass.numstale + GLM_DEFORM_CHUNK - 1) / GLM_DEFORM_CHUNK;
+        glmParallel(numchunks, glmDeformNormalWorker, &pass);
+        /* a vertex that moved is on a triangle that changed, so the
+           normals cover everything there is to upload */
+        for (i = 0; i < numchunks; i++) {
+            deform->numnormals += pass.chunks[i].normals;
+            if (!pass.chunks[i].normals)
+                continue;
+            if (deform->first > deform->last || pass.chunks[i].first < deform->first)
+                deform->first = pass.chunks[i].first;
+            if (deform->first > deform->last || pass.chunks[i].last > deform->last)
+                deform->last = pass.chunks[i].last;
+        }
+    }
+    free(pass.chunks);
+    return deform->nummoved;
+}
+
+/* glmDrawDeformable: Uploads the vertices that changed since the last
+ * draw and renders the deformable model.
+ *
+ * deform - deformable model from glmDeformable()
+ * mode   - GLM_NONE or GLM_SMOOTH (per vertex normals)
+ */
+GLvoid glmDrawDeformable(GLMdeform* deform, GLuint mode){
+    size_t normals, first, size;
+    assert(deform);
+    normals = sizeof(GLfloat) * 3 * (deform->numvertices + 1);
+
+    if (!deform->vbo) {
+        glGenBuffers(1, &deform->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, deform->vbo);
+        glBufferData(GL_ARRAY_BUFFER, 2 * normals, NULL, GL_DYNAMIC_DRAW);
+        glGenBuffers(1, &deform->ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, deform->ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * deform->numtriangles,
+                     deform->indices, GL_STATIC_DRAW);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, deform->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, deform->ibo);
+    }
+    if (deform->first <= deform->last) {
+        first = sizeof(GLfloat) * 3 * deform->first;
+        size = sizeof(GLfloat) * 3 * (deform->last - deform->first + 1);
+        glBufferSubData(GL_ARRAY_BUFFER, first, size, &deform->vertices[3 * deform->first]);
+        glBufferSubData(GL_ARRAY_BUFFER, normals + first, size, &deform->normals[3 * deform->first]);
+        deform->first = ~0u;
+        deform->last = 0;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    if (mode & GLM_SMOOTH) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, (GLubyte*)NULL + normals);
+    }
+    glDrawElements(GL_TRIANGLES, 3 * deform->numtriangles, GL_UNSIGNED_INT, NULL);
+    if (mode & GLM_SMOOTH)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmDeleteDeformable: Deletes a deformable model (not the model it
+ * was made from).
+ *
+ * deform - deformable model from glmDeformable()
+ */
+GLvoid glmDeleteDeformable(GLMdeform* deform){
+    assert(deform);
+    if (deform->vbo) {
+        glDeleteBuffers(1, &deform->vbo);
+        glDeleteBuffers(1, &deform->ibo);
+    }
+    free(deform->rest);
+    free(deform->vertices);
+    free(deform->restnormals);
+    free(deform->normals);
+    free(deform->facetnorms);
+    free(deform->indices);
+    free(deform->offsets);
+    free(deform->adjacency);
+    free(deform->moved);
+    free(deform->facets);
+    free(deform->stale);
+    free(deform->vertexlist);
+    free(deform->trianglelist);
+    free(deform);
+}
@@ -0,0 +1,785 @@
+/*
+      glmmesh.cpp
+
+      Vertex/index buffer meshes for GLM models.
+
+      glmDraw() sends every corner of every triangle through immediate
+      mode, and glmList() only records that.  A GLMmesh instead stores
+      each distinct (vertex, normal, texcoord) combination of a group
+      once in an interleaved vertex buffer and draws the group with
+      glDrawElements() out of an index buffer.  Groups with at most 65536
+      distinct vertices get 16-bit indices.
+
+      glmMeshlets() cuts the groups of a mesh into meshlets of a few dozen
+      triangles with a bounding sphere and a normal cone each, and
+      glmDrawMeshlets() skips the meshlets that are out of view or face
+      away from the eye (see Zeux's meshoptimizer for the cone test).
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "glm.h"
+
+#define T(x) (model->triangles[(x)])
+
+/* GLMcorner: the attributes of one distinct mesh vertex */
+typedef struct _GLMcorner {
+    GLuint v, n, t;
+} GLMcorner;
+
+/* glmCornerSlot: find the slot of a corner in the dedup table, or the
+ * empty slot it would go into.  Slots hold corner index + 1.
+ */
+static inline GLuint glmCornerSlot(GLuint* table, GLuint mask, GLMcorner* corners,
+                                   GLuint v, GLuint n, GLuint t){
+    GLuint slot;
+    GLMcorner* c;
+    slot = (v * 73856093u ^ n * 19349663u ^ t * 83492791u);
+    slot = (slot ^ (slot >> 15)) & mask;
+    while (table[slot]) {
+        c = &corners[table[slot] - 1];
+        if (c->v == v && c->n == n && c->t == t)
+            break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/* glmHalf: round a float to the nearest half float */
+static GLushort glmHalf(GLfloat f){
+    union { GLfloat f; GLuint u; } bits;
+    GLuint sign, exponent, mantissa;
+    bits.f = f;
+    sign = (bits.u >> 16) & 0x8000;
+    exponent = (bits.u >> 23) & 0xff;
+    mantissa = bits.u & 0x7fffff;
+    if (exponent == 0xff)               /* inf and nan */
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent > 142)                 /* too big: inf */
+        return sign | 0x7c00;
+    if (exponent < 102)                 /* too small: zero */
+        return sign;
+    if (exponent < 113) {               /* subnormal */
+        mantissa |= 0x800000;
+        mantissa = (mantissa + (1u << (125 - exponent)) - 1 + ((mantissa >> (126 - exponent)) & 1))
+                   >> (126 - exponent);
+        return sign | mantissa;
+    }
+    /* round to nearest even; a carry out of the mantissa bumps the exponent */
+    bits.u = ((exponent - 112) << 23 | mantissa) + 0xfff + ((mantissa >> 13) & 1);
+    if (bits.u >= 31u << 23)
+        return sign | 0x7c00;
+    return sign | (bits.u >> 13);
+}
+
+/* glmOctahedral: fold a unit vector onto the octahedron |x|+|y|+|z| = 1,
+ * unfold that into the square [-1,1]^2 and store it as two shorts
+ */
+static GLvoid glmOctahedral(const GLfloat* n, GLshort* e){
+    GLfloat x, y, l, t;
+    l = fabs(n[0]) + fabs(n[1]) + fabs(n[2]);
+    if (l == 0) {
+        e[0] = e[1] = 0;
+        return;
+    }
+    x = n[0] / l;
+    y = n[1] / l;
+    if (n[2] < 0) {
+        t = x;
+        x = (1 - fabs(y)) * (t >= 0 ? 1 : -1);
+        y = (1 - fabs(t)) * (y >= 0 ? 1 : -1);
+    }
+    e[0] = (GLshort)floor(x * 32767 + .5f);
+    e[1] = (GLshort)floor(y * 32767 + .5f);
+}
+
+/* glmMesh: Builds vertex and index buffers for the model in the current
+ * OpenGL context.
+ *
+ * model    - initialized GLMmodel structure
+ * mode     - a bitwise OR of the attributes to put in the buffer.
+ *            GLM_NONE    -  only vertices
+ *            GLM_FLAT    -  facet normals
+ *            GLM_SMOOTH  -  vertex normals
+ *            GLM_TEXTURE -  texture coords
+ *            GLM_FLAT and GLM_SMOOTH should not both be specified.
+ */
+GLMmesh* glmMesh(GLMmodel* model, GLuint mode){
+    GLMmesh*      mesh;
+    GLMmeshgroup* meshgroup;
+    GLMgroup*     group;
+    GLMtriangle*  triangle;
+    GLMcorner*    corners;
+    GLuint*       table;
+    GLuint*       indices;
+    GLfloat*      vertices;
+    GLfloat*      dst;
+    GLshort*      packed;
+    GLfloat*      normal;
+    GLfloat       min[3], max[3];
+    GLubyte*      ibo;
+    GLuint        maxtriangles, mask, slot, numcorners, numindices, size;
+    GLuint        i, j, k, n, t;
+    assert(model);
+    assert(model->vertices);
+
+    /* do a bit of warning */
+    if (mode & GLM_FLAT && !model->facetnorms) {
+        printf("glmMesh() warning: flat mode requested "
+               "with no facet normals defined.\n");
+        mode &= ~GLM_FLAT;
+    }
+    if (mode & GLM_SMOOTH && !model->normals) {
+        printf("glmMesh() warning: smooth mode requested "
+               "with no normals defined.\n");
+        mode &= ~GLM_SMOOTH;
+    }
+    if (mode & GLM_TEXTURE && !model->texcoords) {
+        printf("glmMesh() warning: texture mode requested "
+               "with no texture coordinates defined.\n");
+        mode &= ~GLM_TEXTURE;
+    }
+    if (mode & GLM_FLAT && mode & GLM_SMOOTH) {
+        printf("glmMesh() warning: flat mode requested "
+               "and smooth mode requested (using smooth).\n");
+        mode &= ~GLM_FLAT;
+    }
+    mode &= GLM_FLAT | GLM_SMOOTH | GLM_TEXTURE | GLM_QUANTIZE;
+
+    mesh = (GLMmesh*)malloc(sizeof(GLMmesh));
+    mesh->mode           = mode;
+    mesh->normaloffset   = 0;
+    mesh->texcoordoffset = 0;
+    if (mode & GLM_QUANTIZE) {
+        /* shorts x, y, z and one of padding; shorts for the folded
+           normal; half floats for the texcoord */
+        mesh->stride = sizeof(GLshort) * 4;
+        if (mode & (GLM_FLAT | GLM_SMOOTH)) {
+            mesh->normaloffset = mesh->stride;
+            mesh->stride += sizeof(GLshort) * 2;
+        }
+        if (mode & GLM_TEXTURE) {
+            mesh->texcoordoffset = mesh->stride;
+            mesh->stride += sizeof(GLushort) * 2;
+        }
+    } else {
+        mesh->stride = sizeof(GLfloat) * 3;
+        if (mode & (GLM_FLAT | GLM_SMOOTH)) {
+            mesh->normaloffset = mesh->stride;
+            mesh->stride += sizeof(GLfloat) * 3;
+        }
+        if (mode & GLM_TEXTURE) {
+            mesh->texcoordoffset = mesh->stride;
+            mesh->stride += sizeof(GLfloat) * 2;
+        }
+    }
+    for (i = 0; i < 3; i++) {
+        mesh->scale[i] = 1;
+        mesh->bias[i] = 0;
+    }
+    mesh->attributes[0] = mesh->attributes[1] = mesh->attributes[2] = -1;
+    mesh->numgroups = 0;
+    mesh->groups = (GLMmeshgroup*)malloc(sizeof(GLMmeshgroup) * (model->numgroups + 1));
+    mesh->nummeshlets = 0;
+    mesh->meshlets = NULL;
+
+    /* the dedup table is allocated for the biggest group and reused */
+    maxtriangles = 0;
+    numindices = 0;
+    for (group = model->groups; group; group = group->next) {
+        if (group->numtriangles > maxtriangles)
+            maxtriangles = group->numtriangles;
+        numindices += group->numtriangles * 3;
+    }
+    for (mask = 63; mask < maxtriangles * 6; mask = mask * 2 + 1)
+        ;
+    table   = (GLuint*)malloc(sizeof(GLuint) * (mask + 1));
+    corners = (GLMcorner*)malloc(sizeof(GLMcorner) * (numindices + 1));
+    indices = (GLuint*)malloc(sizeof(GLuint) * (numindices + 1));
+
+    /* give every group its own run of distinct corners */
+    numcorners = 0;
+    numindices = 0;
+    for (group = model->groups; group; group = group->next) {
+        if (!group->numtriangles)
+            continue;
+        meshgroup = &mesh->groups[mesh->numgroups++];
+        meshgroup->group      = group;
+        meshgroup->material   = group->material;
+        meshgroup->basevertex = numcorners;
+        meshgroup->first      = numindices;
+        meshgroup->count      = group->numtriangles * 3;
+        /* keep the table at most half full */
+        for (mask = 63; mask < group->numtriangles * 6; mask = mask * 2 + 1)
+            ;
+        memset(table, 0, sizeof(GLuint) * (mask + 1));
+        for (i = 0; i < group->numtriangles; i++) {
+            triangle = &T(group->triangles[i]);
+            for (j = 0; j < 3; j++) {
+                n = mode & GLM_SMOOTH ? triangle->nindices[j] :
+                    mode & GLM_FLAT ? triangle->findex : 0;
+                t = mode & GLM_TEXTURE ? triangle->tindices[j] : 0;
+                slot = glmCornerSlot(table, mask, corners + meshgroup->basevertex,
+                                     triangle->vindices[j], n, t);
+                if (!table[slot]) {
+                    corners[numcorners].v = triangle->vindices[j];
+                    corners[numcorners].n = n;
+                    corners[numcorners].t = t;
+                    numcorners++;
+                    table[slot] = numcorners - meshgroup->basevertex;
+                }
+                indices[numindices++] = table[slot] - 1;
+            }
+        }
+        meshgroup->numvertices = numcorners - meshgroup->basevertex;
+        meshgroup->type = meshgroup->numvertices <= 65536 ?
+                          GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+    free(table);
+    mesh->numvertices = numcorners;
+    mesh->numindices  = numindices;
+
+    /* interleave the attributes */
+    vertices = (GLfloat*)malloc(mesh->stride * (numcorners + 1));
+    dst = vertices;
+    for (i = 0; mode & GLM_QUANTIZE && i < numcorners; i++) {
+        for (k = 0; k < 3; k++) {
+            if (!i || model->vertices[3 * corners[i].v + k] < min[k])
+                min[k] = model->vertices[3 * corners[i].v + k];
+            if (!i || model->vertices[3 * corners[i].v + k] > max[k])
+                max[k] = model->vertices[3 * corners[i].v + k];
+        }
+    }
+    for (k = 0; mode & GLM_QUANTIZE && numcorners && k < 3; k++) {
+        mesh->bias[k]  = (max[k] + min[k]) / 2;
+        mesh->scale[k] = max[k] > min[k] ? (max[k] - min[k]) / 2 / 32767 : 1;
+    }
+    for (i = 0; mode & GLM_QUANTIZE && i < numcorners; i++) {
+        packed = (GLshort*)((GLubyte*)vertices + (size_t)i * mesh->stride);
+        for (k = 0; k < 3; k++)
+            packed[k] = (GLshort)floor((model->vertices[3 * corners[i].v + k] - mesh->bias[k]) /
+                                       mesh->scale[k] + .5f);
+        packed[3] = 0;
+        packed += 4;
+        if (mode & (GLM_FLAT | GLM_SMOOTH)) {
+            normal = mode & GLM_SMOOTH ? &model->normals[3 * corners[i].n] :
+                                         &model->facetnorms[3 * corners[i].n];
+            glmOctahedral(normal, packed);
+            packed += 2;
+        }
+        if (mode & GLM_TEXTURE) {
+            packed[0] = (GLshort)glmHalf(model->texcoords[2 * corners[i].t + 0]);
+            packed[1] = (GLshort)glmHalf(model->texcoords[2 * corners[i].t + 1]);
+        }
+    }
+    for (i = 0; !(mode & GLM_QUANTIZE) && i < numcorners; i++) {
+        memcpy(dst, &model->vertices[3 * corners[i].v], sizeof(GLfloat) * 3);
+        dst += 3;
+        if (mode & GLM_SMOOTH) {
+            memcpy(dst, &model->normals[3 * corners[i].n], sizeof(GLfloat) * 3);
+            dst += 3;
+        } else if (mode & GLM_FLAT) {
+            memcpy(dst, &model->facetnorms[3 * corners[i].n], sizeof(GLfloat) * 3);
+            dst += 3;
+        }
+        if (mode & GLM_TEXTURE) {
+            memcpy(dst, &model->texcoords[2 * corners[i].t], sizeof(GLfloat) * 2);
+            dst += 2;
+        }
+    }
+    free(corners);
+
+    /* pack the indices, 16 bits wide where they fit */
+    size = 0;
+    for (i = 0; i < mesh->numgroups; i++)
+        size += mesh->groups[i].count *
+                (mesh->groups[i].type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)) + 4;
+    ibo = (GLubyte*)malloc(size + 1);
+    size = 0;
+    for (i = 0; i < mesh->numgroups; i++) {
+        meshgroup = &mesh->groups[i];
+        k = meshgroup->first;
+        if (meshgroup->type == GL_UNSIGNED_SHORT) {
+            meshgroup->first = size;
+            for (j = 0; j < meshgroup->count; j++)
+                ((GLushort*)(ibo + size))[j] = (GLushort)indices[k + j];
+            size += meshgroup->count * sizeof(GLushort);
+        } else {
+            /* keep 32-bit indices aligned */
+            size = (size + 3) & ~3u;
+            meshgroup->first = size;
+            memcpy(ibo + size, &indices[k], meshgroup->count * sizeof(GLuint));
+            size += meshgroup->count * sizeof(GLuint);
+        }
+    }
+    free(indices);
+
+    /* hand everything to GL */
+    glGenBuffers(1, &mesh->vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh->stride * numcorners, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenBuffers(1, &mesh->ibo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, ibo, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    free(vertices);
+    free(ibo);
+    return mesh;
+}
+
+/* glmMeshAttributes: Makes glmDrawMesh() feed the mesh through generic
+ * vertex attributes instead of the fixed function arrays.
+ */
+GLvoid glmMeshAttributes(GLMmesh* mesh, GLint position, GLint normal, GLint texcoord){
+    assert(mesh);
+    mesh->attributes[0] = position;
+    mesh->attributes[1] = mesh->normaloffset ? normal : -1;
+    mesh->attributes[2] = mesh->texcoordoffset ? texcoord : -1;
+}
+
+/* glmMeshPointers: point the vertex arrays at the vertices of a group */
+static GLvoid glmMeshPointers(GLMmesh* mesh, GLuint basevertex){
+    GLubyte* base = (GLubyte*)NULL + (size_t)basevertex * mesh->stride;
+    if (mesh->mode & GLM_QUANTIZE) {
+        /* not normalized: the shader scales the shorts itself, so it
+           doesn't depend on how the GL maps them to [-1,1] */
+        assert(mesh->attributes[0] >= 0);
+        glVertexAttribPointer(mesh->attributes[0], 3, GL_SHORT, GL_FALSE, mesh->stride, base);
+        if (mesh->attributes[1] >= 0)
+            glVertexAttribPointer(mesh->attributes[1], 2, GL_SHORT, GL_FALSE, mesh->stride,
+                                  base + mesh->normaloffset);
+        if (mesh->attributes[2] >= 0)
+            glVertexAttribPointer(mesh->attributes[2], 2, GL_HALF_FLOAT, GL_FALSE, mesh->stride,
+                                  base + mesh->texcoordoffset);
+    } else if (mesh->attributes[0] >= 0) {
+        glVertexAttribPointer(mesh->attributes[0], 3, GL_FLOAT, GL_FALSE, mesh->stride, base);
+        if (mesh->attributes[1] >= 0)
+            glVertexAttribPointer(mesh->attributes[1], 3, GL_FLOAT, GL_FALSE, mesh->stride,
+                                  base + mesh->normaloffset);
+        if (mesh->attributes[2] >= 0)
+            glVertexAttribPointer(mesh->attributes[2], 2, GL_FLOAT, GL_FALSE, mesh->stride,
+                                  base + mesh->texcoordoffset);
+    } else {
+        glVertexPointer(3, GL_FLOAT, mesh->stride, base);
+        if (mesh->normaloffset)
+            glNormalPointer(GL_FLOAT, mesh->stride, base + mesh->normaloffset);
+        if (mesh->texcoordoffset)
+            glTexCoordPointer(2, GL_FLOAT, mesh->stride, base + mesh->texcoordoffset);
+    }
+}
+
+/* glmMeshArrays: enable or disable the vertex arrays a mesh uses */
+static GLvoid glmMeshArrays(GLMmesh* mesh, GLboolean enable){
+    GLuint i;
+    if (mesh->attributes[0] >= 0) {
+        for (i = 0; i < 3; i++) {
+            if (mesh->attributes[i] < 0)
+                continue;
+            if (enable)
+                glEnableVertexAttribArray(mesh->attributes[i]);
+            else
+                glDisableVertexAttribArray(mesh->attributes[i]);
+        }
+    } else if (enable) {
+        glEnableClientState(GL_VERTEX_ARRAY);
+        if (mesh->normaloffset)
+            glEnableClientState(GL_NORMAL_ARRAY);
+        if (mesh->texcoordoffset)
+            glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    } else {
+        glDisableClientState(GL_VERTEX_ARRAY);
+        if (mesh->normaloffset)
+            glDisableClientState(GL_NORMAL_ARRAY);
+        if (mesh->texcoordoffset)
+            glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+}
+
+/* glmMeshDraw: draw the groups of a mesh, and if visible is not NULL
+ * only the runs of meshlets it flags, or if instances is not 0 that many
+ * instances of every group
+ */
+static GLvoid glmMeshDraw(GLMmodel* model, GLMmesh* mesh, GLuint mode, GLubyte* visible,
+                          GLsizei instances){
+    GLMmeshgroup* meshgroup;
+    GLMmaterial*  material;
+    GLuint        i, j, m, end, first, count;
+    if (!model->materials)
+        mode &= ~(GLM_COLOR | GLM_MATERIAL | GLM_TEXTURE);
+    if (mode & GLM_COLOR && mode & GLM_MATERIAL)
+        mode &= ~GLM_COLOR;
+    if (!mesh->texcoordoffset)
+        mode &= ~GLM_TEXTURE;
+    if (mode & GLM_COLOR)
+        glEnable(GL_COLOR_MATERIAL);
+    else if (mode & GLM_MATERIAL)
+        glDisable(GL_COLOR_MATERIAL);
+    if (mode & GLM_TEXTURE) {
+        glEnable(GL_TEXTURE_2D);
+        glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+    glmMeshArrays(mesh, GL_TRUE);
+    m = end = 0;
+    for (i = 0; i < mesh->numgroups; i++) {
+        meshgroup = &mesh->groups[i];
+        if (visible) {
+            /* skip groups with nothing to draw */
+            for (end = m; end < mesh->nummeshlets && mesh->meshlets[end].group == i; end++)
+                ;
+            for (j = m; j < end && !visible[j]; j++)
+                ;
+            if (j == end) {
+                m = end;
+                continue;
+            }
+        }
+        if (mode & (GLM_MATERIAL | GLM_COLOR | GLM_TEXTURE)) {
+            material = &model->materials[meshgroup->material];
+            if (mode & GLM_MATERIAL) {
+                glMaterialfv(GL_FRONT_AND_BACK, GL_AMBIENT, material->ambient);
+                glMaterialfv(GL_FRONT_AND_BACK, GL_DIFFUSE, material->diffuse);
+                glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, material->specular);
+                glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, material->shininess);
+            }
+            if (mode & GLM_TEXTURE) {
+                if (material->textureid == (GLuint)-1)
+                    glBindTexture(GL_TEXTURE_2D, 0);
+                else
+                    glBindTexture(GL_TEXTURE_2D, model->textures[material->textureid].id);
+            }
+            if (mode & GLM_COLOR)
+                glColor3fv(material->diffuse);
+        }
+        glmMeshPointers(mesh, meshgroup->basevertex);
+        if (instances) {
+            glDrawElementsInstanced(GL_TRIANGLES, meshgroup->count, meshgroup->type,
+                                    (GLubyte*)NULL + meshgroup->first, instances);
+            continue;
+        }
+        if (!visible) {
+            glDrawElements(GL_TRIANGLES, meshgroup->count, meshgroup->type,
+                           (GLubyte*)NULL + meshgroup->first);
+            continue;
+        }
+        /* neighbouring meshlets are neighbours in the index buffer too,
+        so every run of visible ones is a single draw */
+        for (j = m; j < end; ) {
+            if (!visible[j]) {
+                j++;
+                continue;
+            }
+            first = mesh->meshlets[j].first;
+            count = 0;
+            for (; j < end && visible[j]; j++)
+                count += mesh->meshlets[j].count;
+            glDrawElements(GL_TRIANGLES, count, meshgroup->type, (GLubyte*)NULL + first);
+        }
+        m = end;
+    }
+    glmMeshArrays(mesh, GL_FALSE);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmDrawMesh: Renders a mesh built by glmMesh() with glDrawElements().
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * mode     - a bitwise OR of values describing what is to be rendered.
+ *            GLM_TEXTURE  -  bind the textures of the materials
+ *            GLM_COLOR    -  render with colors (color material)
+ *            GLM_MATERIAL -  render with materials
+ */
+GLvoid glmDrawMesh(GLMmodel* model, GLMmesh* mesh, GLuint mode){
+    assert(model);
+    assert(mesh);
+    glmMeshDraw(model, mesh, mode, NULL, 0);
+}
+
+/* glmDrawMeshInstanced: Renders count instances of a mesh built by
+ * glmMesh() with one glDrawElementsInstanced() per group.  Where each
+ * instance goes is up to the bound shader, from gl_InstanceID or from
+ * vertex attributes the caller has set up with glVertexAttribDivisor().
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * mode     - as for glmDrawMesh()
+ * count    - number of instances
+ */
+GLvoid glmDrawMeshInstanced(GLMmodel* model, GLMmesh* mesh, GLuint mode, GLsizei count){
+    assert(model);
+    assert(mesh);
+    if (count > 0)
+        glmMeshDraw(model, mesh, mode, NULL, count);
+}
+
+/* glmMeshletNormal: (unnormalized) normal of the triangle p[0] p[1] p[2] */
+static GLvoid glmMeshletNormal(GLfloat** p, GLfloat* n){
+    GLfloat u[3], v[3];
+    GLuint  k;
+    for (k = 0; k < 3; k++) {
+        u[k] = p[1][k] - p[0][k];
+        v[k] = p[2][k] - p[0][k];
+    }
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+/* glmMeshlets: Splits every group of a mesh into meshlets of size
+ * triangles and works out their bounding spheres and normal cones.
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh()
+ * size     - number of triangles per meshlet
+ */
+GLvoid glmMeshlets(GLMmodel* model, GLMmesh* mesh, GLuint size){
+    GLMmeshgroup* meshgroup;
+    GLMmeshlet*   meshlet;
+    GLMgroup*     group;
+    GLfloat*      p[3];
+    GLfloat       min[3], max[3], normal[3], u[3];
+    GLfloat       l, d, mindot;
+    GLuint        indexsize, numtriangles, i, j, k, t, c;
+    assert(model);
+    assert(mesh);
+    assert(size > 0);
+
+    free(mesh->meshlets);
+    mesh->nummeshlets = 0;
+    for (i = 0; i < mesh->numgroups; i++)
+        mesh->nummeshlets += (mesh->groups[i].group->numtriangles + size - 1) / size;
+    mesh->meshlets = (GLMmeshlet*)malloc(sizeof(GLMmeshlet) * (mesh->nummeshlets + 1));
+    meshlet = mesh->meshlets;
+    for (i = 0; i < mesh->numgroups; i++) {
+        meshgroup = &mesh->groups[i];
+        group = meshgroup->group;
+        indexsize = meshgroup->type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        for (j = 0; j < group->numtriangles; j += size, meshlet++) {
+            numtriangles = group->numtriangles - j < size ? group->numtriangles - j : size;
+            meshlet->group = i;
+            meshlet->first = meshgroup->first + 3 * j * indexsize;
+            meshlet->count = 3 * numtriangles;
+
+            /* the sphere around the bounding box, and the average of the
+            triangles' normals */
+            for (k = 0; k < 3; k++) {
+                min[k] = max[k] = model->vertices[3 * T(group->triangles[j]).vindices[0] + k];
+                meshlet->axis[k] = 0.0;
+            }
+            for (t = j; t < j + numtriangles; t++) {
+                for (c = 0; c < 3; c++) {
+                    p[c] = &model->vertices[3 * T(group->triangles[t]).vindices[c]];
+                    for (k = 0; k < 3; k++) {
+                        if (p[c][k] < min[k])
+                            min[k] = p[c][k];
+                        if (p[c][k] > max[k])
+                            max[k] = p[c][k];
+                    }
+                }
+                glmMeshletNormal(p, normal);
+                l = glmDot(normal, normal);
+                if (l > 0.0) {
+                    l = sqrt(l);
+                    for (k = 0; k < 3; k++)
+                        meshlet->axis[k] += normal[k] / l;
+                }
+            }
+            meshlet->radius = 0.0;
+            for (k = 0; k < 3; k++)
+                meshlet->center[k] = (min[k] + max[k]) / 2.0;
+            for (t = j; t < j + numtriangles; t++) {
+                for (c = 0; c < 3; c++) {
+                    for (k = 0; k < 3; k++)
+                        u[k] = model->vertices[3 * T(group->triangles[t]).vindices[c] + k] -
+                               meshlet->center[k];
+                    d = glmDot(u, u);
+                    if (d > meshlet->radius)
+                        meshlet->radius = d;
+                }
+            }
+            meshlet->radius = sqrt(meshlet->radius);
+
+            /* the cone is only good for something if all the triangles
+            face the same side of a plane */
+            l = glmDot(meshlet->axis, meshlet->axis);
+            mindot = -1.0;
+            if (l > 0.0) {
+                l = sqrt(l);
+                for (k = 0; k < 3; k++)
+                    meshlet->axis[k] /= l;
+                mindot = 1.0;
+                for (t = j; t < j + numtriangles; t++) {
+                    for (c = 0; c < 3; c++)
+                        p[c] = &model->vertices[3 * T(group->triangles[t]).vindices[c]];
+                    glmMeshletNormal(p, normal);
+                    l = glmDot(normal, normal);
+                    if (l > 0.0) {
+                        d = glmDot(normal, meshlet->axis) / sqrt(l);
+                        if (d < mindot)
+                            mindot = d;
+                    }
+                }
+            }
+            meshlet->cutoff = mindot > 0.0 ? sqrt(1.0 - mindot * mindot) : 1.0;
+        }
+    }
+}
+
+/* glmDet3: determinant of the 3x3 matrix with columns a, b and c */
+static GLfloat glmDet3(GLfloat* a, GLfloat* b, GLfloat* c){
+    return a[0] * (b[1] * c[2] - b[2] * c[1]) -
+           b[0] * (a[1] * c[2] - a[2] * c[1]) +
+           c[0] * (a[1] * b[2] - a[2] * b[1]);
+}
+
+/* glmClipRows: the rows of the current object to clip space matrix */
+static GLvoid glmClipRows(GLfloat rows[4][4]){
+    GLfloat projection[16], modelview[16], m[16];
+    GLuint  i, j, k;
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++) {
+            m[4 * i + j] = 0.0;
+            for (k = 0; k < 4; k++)
+                m[4 * i + j] += projection[4 * k + j] * modelview[4 * i + k];
+        }
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++)
+            rows[i][j] = m[4 * j + i];
+}
+
+/* glmFrustumPlanes: the frustum planes are sums and differences of the
+ * rows of the clip matrix (Gribb and Hartmann), pointing inwards */
+static GLvoid glmFrustumPlanes(GLfloat rows[4][4], GLfloat planes[6][4]){
+    GLfloat l;
+    GLuint  i, j;
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 4; j++) {
+            planes[2 * i + 0][j] = rows[3][j] + rows[i][j];
+            planes[2 * i + 1][j] = rows[3][j] - rows[i][j];
+        }
+    for (i = 0; i < 6; i++) {
+        l = sqrt(planes[i][0] * planes[i][0] + planes[i][1] * planes[i][1] +
+                 planes[i][2] * planes[i][2]);
+        if (l > 0.0)
+            for (j = 0; j < 4; j++)
+                planes[i][j] /= l;
+    }
+}
+
+/* glmFrustum: Object space planes of the current view frustum, from the
+ * projection and modelview matrices.
+ *
+ * planes - will contain the left, right, bottom, top, near and far
+ *          planes (a, b, c, d with ax + by + cz + d >= 0 inside and
+ *          (a, b, c) of unit length) on return
+ */
+GLvoid glmFrustum(GLfloat planes[6][4]){
+    GLfloat rows[4][4];
+    glmClipRows(rows);
+    glmFrustumPlanes(rows, planes);
+}
+
+/* glmDrawMeshlets: Renders a mesh like glmDrawMesh(), leaving out the
+ * meshlets that are outside the view frustum of the current projection
+ * and modelview matrices, or (with back faces culled) face away from
+ * the eye.
+ *
+ * model    - the GLMmodel structure the mesh was built from
+ * mesh     - mesh returned by glmMesh(), with glmMeshlets()
+ * mode     - as for glmDrawMesh()
+ * drawn    - if not NULL, the number of meshlets drawn is added to it
+ * culled   - if not NULL, the number of meshlets culled is added to it
+ */
+GLvoid glmDrawMeshlets(GLMmodel* model, GLMmesh* mesh, GLuint mode, GLuint* drawn, GLuint* culled){
+    GLMmeshlet* meshlet;
+    GLubyte*    visible;
+    GLfloat     rows[4][4], planes[6][4];
+    GLfloat     cols[4][3], eye[4], d[3];
+    GLfloat     side;
+    GLint       cullface, frontface;
+    GLuint      numdrawn, i, j, k;
+    GLboolean   cone;
+    assert(model);
+    assert(mesh);
+    if (!mesh->nummeshlets) {
+        glmMeshDraw(model, mesh, mode, NULL, 0);
+        return;
+    }
+
+    glmClipRows(rows);
+    glmFrustumPlanes(rows, planes);
+
+    /* the eye is where clip x, y and w are all 0; no cone culling with a
+    parallel projection or if back faces aren't culled */
+    for (j = 0; j < 4; j++) {
+        cols[j][0] = rows[0][j];
+        cols[j][1] = rows[1][j];
+        cols[j][2] = rows[3][j];
+    }
+    for (i = 0; i < 4; i++)
+        eye[i] = (i & 1 ? -1.0 : 1.0) * glmDet3(cols[i == 0 ? 1 : 0],
+                                                 cols[i <= 1 ? 2 : 1],
+                                                 cols[i <= 2 ? 3 : 2]);
+    glGetIntegerv(GL_CULL_FACE_MODE, &cullface);
+    glGetIntegerv(GL_FRONT_FACE, &frontface);
+    cone = glIsEnabled(GL_CULL_FACE) && cullface == GL_BACK && fabs(eye[3]) > 1e-12;
+    if (cone)
+        for (i = 0; i < 3; i++)
+            eye[i] /= eye[3];
+    /* a transform that mirrors (or clockwise front faces) turns back
+    faces to the front */
+    side = glmDet3(rows[0], rows[1], rows[2]) < 0.0 ? 1.0 : -1.0;
+    if (frontface == GL_CW)
+        side = -side;
+
+    visible = (GLubyte*)malloc(mesh->nummeshlets);
+    numdrawn = 0;
+    for (i = 0; i < mesh->nummeshlets; i++) {
+        meshlet = &mesh->meshlets[i];
+        visible[i] = 1;
+        for (j = 0; j < 6 && visible[i]; j++)
+            if (planes[j][0] * meshlet->center[0] + planes[j][1] * meshlet->center[1] +
+                planes[j][2] * meshlet->center[2] + planes[j][3] < -meshlet->radius)
+                visible[i] = 0;
+        if (visible[i] && cone) {
+            for (k = 0; k < 3; k++)
+                d[k] = meshlet->center[k] - eye[k];
+            if (side * glmDot(d, meshlet->axis) >=
+                meshlet->cutoff * sqrt(glmDot(d, d)) + meshlet->radius)
+                visible[i] = 0;
+        }
+        numdrawn += visible[i];
+    }
+    glmMeshDraw(model, mesh, mode, visible, 0);
+    free(visible);
+    if (drawn)
+        *drawn += numdrawn;
+    if (culled)
+        *culled += mesh->nummeshlets - numdrawn;
+}
+
+/* glmDeleteMesh: Deletes a mesh and its buffers.
+ *
+ * mesh     - mesh returned by glmMesh()
+ */
+GLvoid glmDeleteMesh(GLMmesh* mesh){
+    assert(mesh);
+    glDeleteBuffers(1, &mesh->vbo);
+    glDeleteBuffers(1, &mesh->ibo);
+    free(mesh->groups);
+    free(mesh->meshlets);
+    free(mesh);
+}
@@ -0,0 +1,590 @@
+/*
+      glmopt.cpp
+
+      Triangle and vertex order optimization for GLM models.
+
+      glmVertexCache() reorders the triangles of every group so that the
+      GPU's post-transform vertex cache gets reused (Tom Forsyth's "Linear
+      speed vertex cache optimisation"), then renumbers vertices, normals,
+      texcoords and facet normals in the order the triangles first use
+      them and lays the triangles array out in drawing order, so vertex
+      fetches walk memory front to back as well.
+
+      glmMeshletOrder() does the same within clusters of triangles that
+      hang together, for meshlets that can be culled on their own.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "glm.h"
+
+#define T(x) (model->triangles[(x)])
+
+/* size of the cache the triangle scores are tuned for */
+#define GLM_FORSYTH_CACHE 32
+
+/* how much a shared vertex counts for against facing the same way when
+ * a cluster is grown (a triangle's normal counts for -1 to 1)
+ */
+#define GLM_CLUSTER_SHARED 0.25
+
+/* GLMforsyth: working state of the reordering of one group */
+typedef struct _GLMforsyth {
+    GLuint   numvertices;         /* vertices used by the group */
+    GLuint*  vertices;            /* local vertex of each corner */
+    GLuint*  offsets;             /* vertex -> first triangle in triangles */
+    GLuint*  remaining;           /* triangles not yet drawn per vertex */
+    GLuint*  triangles;           /* triangles around each vertex */
+    GLint*   position;            /* position in the cache, -1 = not in it */
+    GLfloat* vscore;              /* score of each vertex */
+    GLfloat* tscore;              /* score of each triangle */
+    GLubyte* added;               /* triangle was drawn */
+} GLMforsyth;
+
+/* glmForsythScore: score of a vertex given its position in the cache
+ * and the number of triangles still to be drawn that use it.
+ */
+static GLfloat glmForsythScore(GLint position, GLuint remaining){
+    GLfloat score;
+    if (remaining == 0)
+        return -1.0;
+    score = 0.0;
+    if (position >= 0) {
+        /* the last triangle's vertices get a fixed score, so it doesn't
+        matter which of them the next triangle shares */
+        if (position < 3)
+            score = 0.75;
+        else
+            score = pow(1.0 - (position - 3) / (GLfloat)(GLM_FORSYTH_CACHE - 3), 1.5);
+    }
+    /* favour vertices with few triangles left, to finish them off */
+    score += 2.0 * pow((GLfloat)remaining, -0.5);
+    return score;
+}
+
+/* glmForsythGroup: reorder the triangles of a group for the vertex
+ * cache.  The corners of the group have already been numbered locally
+ * in f->vertices.
+ */
+static GLvoid glmForsythGroup(GLMforsyth* f, GLuint* order, GLuint numtriangles){
+    GLint    cache[GLM_FORSYTH_CACHE + 3];
+    GLint    next[GLM_FORSYTH_CACHE + 3];
+    GLuint   size, newsize, drawn, cursor, best, t, v, k, i, j;
+    GLuint*  sorted;
+    GLfloat  score;
+
+    /* triangles around each vertex */
+    memset(f->offsets, 0, sizeof(GLuint) * (f->numvertices + 1));
+    for (i = 0; i < numtriangles * 3; i++)
+        f->offsets[f->vertices[i] + 1]++;
+    for (v = 0; v < f->numvertices; v++)
+        f->offsets[v + 1] += f->offsets[v];
+    for (v = 0; v < f->numvertices; v++)
+        f->remaining[v] = 0;
+    for (i = 0; i < numtriangles * 3; i++) {
+        v = f->vertices[i];
+        f->triangles[f->offsets[v] + f->remaining[v]++] = i / 3;
+    }
+    for (v = 0; v < f->numvertices; v++) {
+        f->position[v] = -1;
+        f->vscore[v] = glmForsythScore(-1, f->remaining[v]);
+    }
+    for (t = 0; t < numtriangles; t++) {
+        f->added[t] = 0;
+        f->tscore[t] = f->vscore[f->vertices[3 * t + 0]] +
+                       f->vscore[f->vertices[3 * t + 1]] +
+                       f->vscore[f->vertices[3 * t + 2]];
+    }
+
+    sorted = (GLuint*)malloc(sizeof(GLuint) * (numtriangles + 1));
+    size = 0;
+    cursor = 0;
+    best = (GLuint)-1;
+    for (drawn = 0; drawn < numtriangles; drawn++) {
+        if (best == (GLuint)-1) {
+            /* nothing in the cache leads anywhere, start over with the
+            next triangle that hasn't been drawn */
+            while (f->added[cursor])
+                cursor++;
+            best = cursor;
+        }
+        sorted[drawn] = order[best];
+        f->added[best] = 1;
+
+        /* the triangle's vertices go to the front of the cache, the rest
+        moves back */
+        newsize = 0;
+        for (k = 0; k < 3; k++) {
+            v = f->vertices[3 * best + k];
+            next[newsize++] = v;
+            /* take the triangle off the vertex's list */
+            for (j = f->offsets[v]; f->triangles[j] != best; j++)
+                ;
+            f->triangles[j] = f->triangles[f->offsets[v] + --f->remaining[v]];
+        }
+        for (i = 0; i < size; i++) {
+            v = cache[i];
+            if (v != f->vertices[3 * best + 0] &&
+                v != f->vertices[3 * best + 1] &&
+                v != f->vertices[3 * best + 2])
+                next[newsize++] = v;
+        }
+
+        /* rescore whatever is in (or just fell out of) the cache and the
+        triangles around it, remembering the best triangle to draw next */
+        best = (GLuint)-1;
+        score = -1.0;
+        for (i = 0; i < newsize; i++) {
+            v = next[i];
+            f->position[v] = i < GLM_FORSYTH_CACHE ? (GLint)i : -1;
+            f->vscore[v] = glmForsythScore(f->position[v], f->remaining[v]);
+        }
+        for (i = 0; i < newsize; i++) {
+            v = next[i];
+            for (j = f->offsets[v]; j < f->offsets[v] + f->remaining[v]; j++) {
+                t = f->triangles[j];
+                f->tscore[t] = f->vscore[f->vertices[3 * t + 0]] +
+                               f->vscore[f->vertices[3 * t + 1]] +
+                               f->vscore[f->vertices[3 * t + 2]];
+                if (f->tscore[t] > score) {
+                    score = f->tscore[t];
+                    best = t;
+                }
+            }
+        }
+        size = newsize < GLM_FORSYTH_CACHE ? newsize : GLM_FORSYTH_CACHE;
+        memcpy(cache, next, sizeof(GLint) * size);
+    }
+    memcpy(order, sorted, sizeof(GLuint) * numtriangles);
+    free(sorted);
+}
+
+/* glmFirstUse: new number of an index, handing out the next number the
+ * first time an index is seen.  0 ("none") and out of range indices are
+ * left alone.
+ */
+static inline GLuint glmFirstUse(GLuint* map, GLuint* used, GLuint count, GLuint index){
+    if (index == 0 || index > count)
+        return index;
+    if (!map[index])
+        map[index] = ++*used;
+    return map[index];
+}
+
+/* glmRenumber: renumber the entries of a 1-based array in the order
+ * they are first used.  map[i] must be 0 for unused entries and the new
+ * number for used ones; unused entries go at the end.
+ */
+static GLfloat* glmRenumber(GLMmodel* model, GLfloat* array, GLuint count, GLuint size,
+                            GLuint* map, GLuint used){
+    GLfloat* renumbered;
+    GLuint i;
+    renumbered = (GLfloat*)malloc(sizeof(GLfloat) * size * (count + 1));
+    memcpy(renumbered, array, sizeof(GLfloat) * size);
+    for (i = 1; i <= count; i++) {
+        if (!map[i])
+            map[i] = ++used;
+        memcpy(&renumbered[size * map[i]], &array[size * i], sizeof(GLfloat) * size);
+    }
+    glmFree(model, array);
+    return renumbered;
+}
+
+/* glmForsythAlloc: allocate the work arrays for groups of up to
+ * maxtriangles triangles
+ */
+static GLvoid glmForsythAlloc(GLMforsyth* f, GLuint maxtriangles){
+    f->vertices  = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 1));
+    f->offsets   = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 2));
+    f->remaining = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 1));
+    f->triangles = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 1));
+    f->position  = (GLint*)malloc(sizeof(GLint) * (3 * maxtriangles + 1));
+    f->vscore    = (GLfloat*)malloc(sizeof(GLfloat) * (3 * maxtriangles + 1));
+    f->tscore    = (GLfloat*)malloc(sizeof(GLfloat) * (maxtriangles + 1));
+    f->added     = (GLubyte*)malloc(maxtriangles + 1);
+}
+
+/* glmForsythFree: free the work arrays */
+static GLvoid glmForsythFree(GLMforsyth* f){
+    free(f->vertices);
+    free(f->offsets);
+    free(f->remaining);
+    free(f->triangles);
+    free(f->position);
+    free(f->vscore);
+    free(f->tscore);
+    free(f->added);
+}
+
+/* glmForsythTriangles: reorder a list of triangles of the model for the
+ * vertex cache, with their vertices numbered locally so the work
+ * arrays only need to be as big as the list.  local must be all 0 (and
+ * is left that way).
+ */
+static GLvoid glmForsythTriangles(GLMmodel* model, GLMforsyth* f, GLuint* local,
+                                  GLuint* triangles, GLuint numtriangles){
+    GLuint i, k, n;
+    f->numvertices = 0;
+    for (i = 0; i < numtriangles; i++) {
+        for (k = 0; k < 3; k++) {
+            n = T(triangles[i]).vindices[k];
+            if (!local[n])
+                local[n] = ++f->numvertices;
+            f->vertices[3 * i + k] = local[n] - 1;
+        }
+    }
+    glmForsythGroup(f, triangles, numtriangles);
+    for (i = 0; i < numtriangles; i++)
+        for (k = 0; k < 3; k++)
+            local[T(triangles[i]).vindices[k]] = 0;
+}
+
+/* glmLayout: lay the triangles out in the order the groups draw them
+ * and number everything they point at by first use
+ */
+static GLvoid glmLayout(GLMmodel* model){
+    GLMgroup*    group;
+    GLMtriangle* triangles;
+    GLuint*      vmap;
+    GLuint*      nmap;
+    GLuint*      tmap;
+    GLuint*      fmap;
+    GLuint*      tri;
+    GLuint       numv, numn, numt, numf, n, i, k;
+
+    vmap = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    nmap = (GLuint*)calloc(model->numnormals + 1, sizeof(GLuint));
+    tmap = (GLuint*)calloc(model->numtexcoords + 1, sizeof(GLuint));
+    fmap = (GLuint*)calloc(model->numfacetnorms + 1, sizeof(GLuint));
+    triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) * (model->numtriangles + 1));
+    tri = (GLuint*)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    for (i = 0; i < model->numtriangles; i++)
+        tri[i] = (GLuint)-1;
+    numv = numn = numt = numf = 0;
+    n = 0;
+    for (group = model->groups; group; group = group->next) {
+        for (i = 0; i < group->numtriangles; i++) {
+            /* a triangle in more than one group keeps its first place */
+            if (tri[group->triangles[i]] == (GLuint)-1) {
+                tri[group->triangles[i]] = n;
+                triangles[n++] = T(group->triangles[i]);
+            }
+            group->triangles[i] = tri[group->triangles[i]];
+        }
+    }
+    /* triangles that aren't in any group go last */
+    for (i = 0; i < model->numtriangles; i++)
+        if (tri[i] == (GLuint)-1)
+            triangles[n++] = T(i);
+    free(tri);
+    for (i = 0; i < model->numtriangles; i++) {
+        for (k = 0; k < 3; k++) {
+            triangles[i].vindices[k] = glmFirstUse(vmap, &numv, model->numvertices,
+                                                   triangles[i].vindices[k]);
+            if (model->normals)
+                triangles[i].nindices[k] = glmFirstUse(nmap, &numn, model->numnormals,
+                                                       triangles[i].nindices[k]);
+            if (model->texcoords)
+                triangles[i].tindices[k] = glmFirstUse(tmap, &numt, model->numtexcoords,
+                                                       triangles[i].tindices[k]);
+        }
+        if (model->facetnorms)
+            triangles[i].findex = glmFirstUse(fmap, &numf, model->numfacetnorms,
+                                              triangles[i].findex);
+    }
+    glmFree(model, model->triangles);
+    model->triangles = triangles;
+
+    model->vertices = glmRenumber(model, model->vertices, model->numvertices, 3, vmap, numv);
+    if (model->colors)          /* a vertex color is the size of one GLfloat */
+        model->colors = (GLubyte*)glmRenumber(model, (GLfloat*)model->colors, model->numvertices, 1, vmap, numv);
+    if (model->normals)
+        model->normals = glmRenumber(model, model->normals, model->numnormals, 3, nmap, numn);
+    if (model->texcoords)
+        model->texcoords = glmRenumber(model, model->texcoords, model->numtexcoords, 2, tmap, numt);
+    if (model->facetnorms)
+        model->facetnorms = glmRenumber(model, model->facetnorms, model->numfacetnorms, 3, fmap, numf);
+    free(vmap);
+    free(nmap);
+    free(tmap);
+    free(fmap);
+}
+
+/* glmVertexCache: Reorders the triangles of each group of a model for
+ * the post-transform vertex cache, then renumbers vertices, normals,
+ * texcoords and facet normals in the order the triangles use them and
+ * stores the triangles in drawing order.  Drawing the model gives the
+ * same picture as before.
+ *
+ * model - initialized GLMmodel structure
+ */
+GLvoid glmVertexCache(GLMmodel* model){
+    GLMforsyth f;
+    GLMgroup*  group;
+    GLuint*    local;
+    GLuint     maxtriangles;
+    assert(model);
+
+    maxtriangles = 0;
+    for (group = model->groups; group; group = group->next)
+        if (group->numtriangles > maxtriangles)
+            maxtriangles = group->numtriangles;
+    glmForsythAlloc(&f, maxtriangles);
+    local = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    for (group = model->groups; group; group = group->next)
+        glmForsythTriangles(model, &f, local, group->triangles, group->numtriangles);
+    free(local);
+    glmForsythFree(&f);
+    glmLayout(model);
+}
+
+/* glmTriangleNormal: unit normal of a triangle (0 if it has no area) */
+static GLvoid glmTriangleNormal(GLMmodel* model, GLuint t, GLfloat* n){
+    GLfloat* p0 = &model->vertices[3 * T(t).vindices[0]];
+    GLfloat* p1 = &model->vertices[3 * T(t).vindices[1]];
+    GLfloat* p2 = &model->vertices[3 * T(t).vindices[2]];
+    GLfloat  u[3], v[3], l;
+    GLuint   k;
+    for (k = 0; k < 3; k++) {
+        u[k] = p1[k] - p0[k];
+        v[k] = p2[k] - p0[k];
+    }
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+    l = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (l > 0.0)
+        for (k = 0; k < 3; k++)
+            n[k] /= l;
+}
+
+/* glmClusterGroup: split the triangles of a group into clusters of size
+ * triangles that hang together.  Each cluster grows from a seed over
+ * triangles sharing a vertex with it; seeds are taken from the
+ * triangles left over around the clusters built last, so neighbouring
+ * clusters stay close together as well.
+ */
+static GLvoid glmClusterGroup(GLMmodel* model, GLMgroup* group, GLuint size,
+                              GLuint* local, GLuint* offsets, GLuint* around,
+                              GLuint* queue, GLuint* frontier, GLuint* stamp,
+                              GLubyte* state, GLfloat* normals, GLuint* inside){
+    GLuint* sorted;
+    GLuint  numvertices, numfrontier, cluster, count, cursor, head, tail;
+    GLuint  seed, best, t, u, v, i, j, k;
+    GLfloat axis[3], score, d, l;
+
+    /* triangles around each vertex, by position in the group */
+    numvertices = 0;
+    for (i = 0; i < group->numtriangles; i++)
+        for (k = 0; k < 3; k++)
+            if (!local[T(group->triangles[i]).vindices[k]])
+                local[T(group->triangles[i]).vindices[k]] = ++numvertices;
+    memset(offsets, 0, sizeof(GLuint) * (numvertices + 2));
+    for (i = 0; i < group->numtriangles; i++)
+        for (k = 0; k < 3; k++)
+            offsets[local[T(group->triangles[i]).vindices[k]] + 1]++;
+    for (v = 1; v <= numvertices; v++)
+        offsets[v + 1] += offsets[v];
+    for (i = 0; i < group->numtriangles; i++)
+        for (k = 0; k < 3; k++)
+            around[offsets[local[T(group->triangles[i]).vindices[k]]]++] = i;
+    /* offsets[v] now is where v's list ends and offsets[v - 1] where it starts */
+    for (i = 0; i < group->numtriangles; i++)
+        glmTriangleNormal(model, group->triangles[i], &normals[3 * i]);
+    for (i = 0; i < group->numtriangles; i++) {
+        state[i] = 0;
+        stamp[i] = 0;
+    }
+    for (v = 0; v <= numvertices; v++)
+        inside[v] = 0;
+
+    sorted = (GLuint*)malloc(sizeof(GLuint) * (group->numtriangles + 1));
+    numfrontier = 0;
+    cursor = 0;
+    count = 0;
+    cluster = 1;
+    head = tail = 0;
+    while (count < group->numtriangles) {
+        if (head == tail) {
+            /* start (or carry on with) a cluster somewhere new */
+            seed = (GLuint)-1;
+            while (numfrontier && seed == (GLuint)-1) {
+                seed = frontier[--numfrontier];
+                state[seed] &= ~2;
+                if (state[seed] & 1)
+                    seed = (GLuint)-1;
+            }
+            if (seed == (GLuint)-1) {
+                while (state[cursor] & 1)
+                    cursor++;
+                seed = cursor;
+            }
+            stamp[seed] = cluster;
+            queue[tail++] = seed;
+        }
+        /* take the waiting triangle that faces most like the cluster
+        so far, so its normals stay in a narrow cone, favouring those
+        that share vertices with it so it stays compact */
+        best = head;
+        if (count % size) {
+            score = -2.0;
+            l = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            for (j = head; j < tail; j++) {
+                u = queue[j];
+                d = normals[3 * u + 0] * axis[0] + normals[3 * u + 1] * axis[1] +
+                    normals[3 * u + 2] * axis[2];
+                if (l > 0.0)
+                    d /= l;
+                for (k = 0; k < 3; k++)
+                    if (inside[local[T(group->triangles[u]).vindices[k]]] == cluster)
+                        d += GLM_CLUSTER_SHARED;
+                if (d > score) {
+                    score = d;
+                    best = j;
+                }
+            }
+        } else
+            axis[0] = axis[1] = axis[2] = 0.0;
+        t = queue[best];
+        queue[best] = queue[head++];
+        state[t] |= 1;
+        sorted[count++] = group->triangles[t];
+        for (k = 0; k < 3; k++) {
+            axis[k] += normals[3 * t + k];
+            inside[local[T(group->triangles[t]).vindices[k]]] = cluster;
+        }
+        for (k = 0; k < 3; k++) {
+            v = local[T(group->triangles[t]).vindices[k]];
+            for (j = offsets[v - 1]; j < offsets[v]; j++) {
+                u = around[j];
+                if (!(state[u] & 1) && stamp[u] != cluster) {
+                    stamp[u] = cluster;
+                    queue[tail++] = u;
+                }
+            }
+        }
+        if (count % size == 0) {
+            /* the cluster is full: what it didn't get to seeds the next */
+            for (; head < tail; head++) {
+                u = queue[head];
+                if (!(state[u] & 3)) {
+                    state[u] |= 2;
+                    frontier[numfrontier++] = u;
+                }
+            }
+            head = tail = 0;
+            cluster++;
+        }
+    }
+    memcpy(group->triangles, sorted, sizeof(GLuint) * group->numtriangles);
+    free(sorted);
+    for (i = 0; i < group->numtriangles; i++)
+        for (k = 0; k < 3; k++)
+            local[T(group->triangles[i]).vindices[k]] = 0;
+}
+
+/* glmMeshletOrder: Like glmVertexCache(), but first splits every group
+ * into clusters of size triangles that hang together, so that each run
+ * of size triangles of a group (what glmMeshlets() makes a meshlet of)
+ * covers a small patch of the surface.  Triangles are reordered for the
+ * vertex cache within each cluster.
+ *
+ * model - initialized GLMmodel structure
+ * size  - number of triangles per cluster
+ */
+GLvoid glmMeshletOrder(GLMmodel* model, GLuint size){
+    GLMforsyth f;
+    GLMgroup*  group;
+    GLuint*    local;
+    GLuint*    offsets;
+    GLuint*    around;
+    GLuint*    queue;
+    GLuint*    frontier;
+    GLuint*    stamp;
+    GLubyte*   state;
+    GLfloat*   normals;
+    GLuint*    inside;
+    GLuint     maxtriangles, i;
+    assert(model);
+    assert(size > 0);
+
+    maxtriangles = 0;
+    for (group = model->groups; group; group = group->next)
+        if (group->numtriangles > maxtriangles)
+            maxtriangles = group->numtriangles;
+    local    = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    offsets  = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 2));
+    around   = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 1));
+    queue    = (GLuint*)malloc(sizeof(GLuint) * (maxtriangles + 1));
+    frontier = (GLuint*)malloc(sizeof(GLuint) * (maxtriangles + 1));
+    stamp    = (GLuint*)malloc(sizeof(GLuint) * (maxtriangles + 1));
+    state    = (GLubyte*)malloc(maxtriangles + 1);
+    normals  = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (maxtriangles + 1));
+    inside   = (GLuint*)malloc(sizeof(GLuint) * (3 * maxtriangles + 1));
+    for (group = model->groups; group; group = group->next)
+        glmClusterGroup(model, group, size, local, offsets, around, queue, frontier,
+                        stamp, state, normals, inside);
+    free(offsets);
+    free(around);
+    free(queue);
+    free(frontier);
+    free(stamp);
+    free(state);
+    free(normals);
+    free(inside);
+
+    glmForsythAlloc(&f, size);
+    for (group = model->groups; group; group = group->next)
+        for (i = 0; i < group->numtriangles; i += size)
+            glmForsythTriangles(model, &f, local, group->triangles + i,
+                                group->numtriangles - i < size ? group->numtriangles - i : size);
+    glmForsythFree(&f);
+    free(local);
+    glmLayout(model);
+}
+
+/* glmVertexCacheStats: Simulates a FIFO post-transform vertex cache
+ * while the groups of a model are drawn.
+ *
+ * model     - initialized GLMmodel structure
+ * cachesize - number of vertices the cache holds
+ * acmr      - will contain the average cache miss ratio (vertices
+ *             transformed per triangle, 0.5 - 3.0) on return
+ * atvr      - will contain the average transformed vertex ratio
+ *             (vertices transformed per vertex used, 1.0 is perfect)
+ */
+GLvoid glmVertexCacheStats(GLMmodel* model, GLuint cachesize, GLfloat* acmr, GLfloat* atvr){
+    GLMgroup* group;
+    GLuint*   stamp;
+    GLubyte*  used;
+    GLuint    misses, numtriangles, numused, v, i, k;
+    assert(model);
+    /* a vertex is in the cache if it missed less than cachesize misses ago */
+    stamp = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    used  = (GLubyte*)calloc(model->numvertices + 1, 1);
+    misses = numtriangles = numused = 0;
+    for (group = model->groups; group; group = group->next) {
+        for (i = 0; i < group->numtriangles; i++) {
+            for (k = 0; k < 3; k++) {
+                v = T(group->triangles[i]).vindices[k];
+                if (!stamp[v] || misses - stamp[v] + 1 > cachesize) {
+                    misses++;
+                    stamp[v] = misses;
+                }
+                if (!used[v]) {
+                    used[v] = 1;
+                    numused++;
+                }
+            }
+        }
+        numtriangles += group->numtriangles;
+    }
+    *acmr = numtriangles ? misses / (GLfloat)numtriangles : 0.0;
+    *atvr = numused ? misses / (GLfloat)numused : 0.0;
+    free(stamp);
+    free(used);
+}
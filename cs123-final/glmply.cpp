@@ -0,0 +1,676 @@
+/*
+      glmply.cpp
+
+      Stanford .PLY reader for GLM models.
+
+      A PLY file is a text header listing the elements of the file
+      (vertices, faces and whatever else the scanner wrote) with their
+      properties, followed by the elements themselves in that order,
+      either as text or as binary in either byte order.  The reader maps
+      the file and decodes the vertex and face blocks straight into the
+      model's arrays.  In a binary file every vertex has the same size,
+      so the vertex block is cut into runs that are decoded on
+      glmParallel() threads; the face block is walked once to count the
+      triangles and, when every face is a triangle (the usual case), is
+      decoded in parallel runs as well.  ASCII files are first converted
+      to binary in memory, so they share the same decoding.
+
+      Vertex colors go into model->colors, vertex normals (if the file
+      has them) into model->normals, and all the triangles into a single
+      "default" group.  Polygons are split into fans.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <GL/gl.h>
+#include "glm.h"
+
+/* vertices or faces decoded per glmParallel() call */
+#define GLM_PLY_CHUNK 16384
+
+/* limits on what the header can declare */
+#define GLM_PLY_MAX_ELEMENTS   16
+#define GLM_PLY_MAX_PROPERTIES 32
+
+/* formats */
+#define GLM_PLY_ASCII  0
+#define GLM_PLY_LITTLE 1
+#define GLM_PLY_BIG    2
+
+/* property types, and the count type of properties that aren't lists */
+#define GLM_PLY_CHAR   0
+#define GLM_PLY_UCHAR  1
+#define GLM_PLY_SHORT  2
+#define GLM_PLY_USHORT 3
+#define GLM_PLY_INT    4
+#define GLM_PLY_UINT   5
+#define GLM_PLY_FLOAT  6
+#define GLM_PLY_DOUBLE 7
+#define GLM_PLY_NONE   8
+
+static const char* glmPlyTypeNames[][2] = {
+    { "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+    { "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+};
+static const GLuint glmPlyTypeSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+/* vertex properties the model keeps, and their names in the file */
+#define GLM_PLY_ROLES 10
+static const char* glmPlyRoleNames[GLM_PLY_ROLES] = {
+    "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue", "alpha"
+};
+
+/* GLMplyproperty: one property of an element */
+typedef struct _GLMplyproperty {
+    char   name[32];
+    GLuint type;                  /* GLM_PLY_CHAR ... GLM_PLY_DOUBLE */
+    GLuint counttype;             /* type of a list's length, GLM_PLY_NONE if not a list */
+    GLuint offset;                /* byte offset in a fixed size element */
+} GLMplyproperty;
+
+/* GLMplyelement: one element of the header and where it is in the body */
+typedef struct _GLMplyelement {
+    char   name[32];
+    GLuint count;                 /* number of elements in the file */
+    GLuint size;                  /* bytes per element, 0 if it has lists */
+    GLuint numproperties;
+    GLMplyproperty properties[GLM_PLY_MAX_PROPERTIES];
+} GLMplyelement;
+
+/* GLMply: the header of a file and what the reader found in the body */
+typedef struct _GLMply {
+    GLuint    format;             /* GLM_PLY_ASCII, _LITTLE or _BIG */
+    GLboolean swap;               /* binary data is in the other byte order */
+    GLuint    numelements;
+    GLMplyelement elements[GLM_PLY_MAX_ELEMENTS];
+
+    GLMplyelement* vertex;        /* the "vertex" element */
+    const char* vertices;         /* start of the vertex block */
+    GLint     roles[GLM_PLY_ROLES]; /* property of each role, -1 if absent */
+
+    GLMplyelement* face;          /* the "face" element, or NULL */
+    const char* faces;            /* start of the face block */
+    GLint     indices;            /* the vertex index list of a face */
+    GLuint    stride;             /* bytes per face if all are alike, else 0 */
+    GLuint    listoffset;         /* offset of the first index if they are */
+    GLuint    badindex;           /* set if a face refers to a vertex that isn't there */
+
+    GLMmodel* model;
+} GLMply;
+
+/* glmPlyType: the type with the given name, GLM_PLY_NONE if unknown */
+static GLuint glmPlyType(const char* name){
+    GLuint i;
+    for (i = 0; i < GLM_PLY_NONE; i++)
+        if (!strcmp(name, glmPlyTypeNames[i][0]) || !strcmp(name, glmPlyTypeNames[i][1]))
+            return i;
+    return GLM_PLY_NONE;
+}
+
+/* glmPlyHeader: parse the header.  Returns the offset of the body, or
+ * 0 if the header isn't one the reader understands.
+ */
+static size_t glmPlyHeader(const char* data, size_t size, GLMply* ply){
+    const char* p;
+    const char* end;
+    const char* eol;
+    char    line[256], word[32], type[32], counttype[32], name[32];
+    GLMplyelement* element;
+    GLMplyproperty* property;
+    GLuint  count;
+    size_t  length;
+    p = data;
+    end = data + size;
+    element = NULL;
+    word[0] = '\0';
+    ply->format = GLM_PLY_NONE;
+    ply->numelements = 0;
+    while (p < end) {
+        eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol)
+            return 0;
+        length = eol - p < (long)sizeof(line) - 1 ? eol - p : sizeof(line) - 1;
+        memcpy(line, p, length);
+        line[length] = '\0';
+        if (length && line[length - 1] == '\r')
+            line[length - 1] = '\0';
+        p = eol + 1;
+        if (sscanf(line, "%31s", word) != 1)
+            continue;
+        if (!strcmp(word, "ply") || !strcmp(word, "comment") || !strcmp(word, "obj_info")) {
+            continue;
+        } else if (!strcmp(word, "format")) {
+            sscanf(line, "%*s %31s", type);
+            if (!strcmp(type, "ascii"))
+                ply->format = GLM_PLY_ASCII;
+            else if (!strcmp(type, "binary_little_endian"))
+                ply->format = GLM_PLY_LITTLE;
+            else if (!strcmp(type, "binary_big_endian"))
+                ply->format = GLM_PLY_BIG;
+        } else if (!strcmp(word, "element")) {
+            if (ply->numelements == GLM_PLY_MAX_ELEMENTS ||
+                sscanf(line, "%*s %31s %u", name, &count) != 2)
+                return 0;
+            element = &ply->elements[ply->numelements++];
+            strcpy(element->name, name);
+            element->count = count;
+            element->size = 0;
+            element->numproperties = 0;
+        } else if (!strcmp(word, "property")) {
+            if (!element || element->numproperties == GLM_PLY_MAX_PROPERTIES)
+                return 0;
+            property = &element->properties[element->numproperties++];
+            if (sscanf(line, "%*s %31s", type) == 1 && !strcmp(type, "list")) {
+                if (sscanf(line, "%*s %*s %31s %31s %31s", counttype, type, name) != 3)
+                    return 0;
+                property->counttype = glmPlyType(counttype);
+                if (property->counttype == GLM_PLY_NONE || property->counttype >= GLM_PLY_FLOAT)
+                    return 0;
+            } else {
+                if (sscanf(line, "%*s %31s %31s", type, name) != 2)
+                    return 0;
+                property->counttype = GLM_PLY_NONE;
+            }
+            property->type = glmPlyType(type);
+            if (property->type == GLM_PLY_NONE)
+                return 0;
+            strcpy(property->name, name);
+        } else if (!strcmp(word, "end_header")) {
+            break;
+        } else {
+            return 0;
+        }
+    }
+    if (strcmp(word, "end_header"))
+        return 0;
+    if (ply->format == GLM_PLY_NONE || strncmp(data, "ply", 3))
+        return 0;
+    return p - data;
+}
+
+/* glmPlyLayout: work out the property offsets and size of the elements
+ * that have no lists, and find the vertex and face elements
+ */
+static GLvoid glmPlyLayout(GLMply* ply){
+    GLMplyelement* element;
+    GLMplyproperty* property;
+    GLuint i, j, k, offset;
+    ply->vertex = ply->face = NULL;
+    for (i = 0; i < ply->numelements; i++) {
+        element = &ply->elements[i];
+        offset = 0;
+        for (j = 0; j < element->numproperties; j++) {
+            property = &element->properties[j];
+            property->offset = offset;
+            if (property->counttype != GLM_PLY_NONE)
+                offset = ~0u;
+            if (offset != ~0u)
+                offset += glmPlyTypeSizes[property->type];
+        }
+        element->size = offset == ~0u ? 0 : offset;
+        if (!strcmp(element->name, "vertex") && !ply->vertex)
+            ply->vertex = element;
+        else if (!strcmp(element->name, "face") && !ply->face)
+            ply->face = element;
+    }
+    for (k = 0; k < GLM_PLY_ROLES; k++)
+        ply->roles[k] = -1;
+    if (ply->vertex)
+        for (j = 0; j < ply->vertex->numproperties; j++)
+            for (k = 0; k < GLM_PLY_ROLES; k++)
+                if (!strcmp(ply->vertex->properties[j].name, glmPlyRoleNames[k]) &&
+                    ply->vertex->properties[j].counttype == GLM_PLY_NONE)
+                    ply->roles[k] = j;
+    ply->indices = -1;
+    if (ply->face)
+        for (j = 0; j < ply->face->numproperties; j++)
+            if ((!strcmp(ply->face->properties[j].name, "vertex_indices") ||
+                 !strcmp(ply->face->properties[j].name, "vertex_index")) &&
+                ply->face->properties[j].counttype != GLM_PLY_NONE)
+                ply->indices = j;
+}
+
+/* glmPlyValue: read one binary value of the given type */
+static inline double glmPlyValue(const char* p, GLuint type, GLboolean swap){
+    union {
+        char           b[8];
+        signed char    c;
+        unsigned char  uc;
+        short          s;
+        unsigned short us;
+        int            i;
+        unsigned int   ui;
+        float          f;
+        double         d;
+    } v;
+    GLuint i, size;
+    size = glmPlyTypeSizes[type];
+    if (swap)
+        for (i = 0; i < size; i++)
+            v.b[i] = p[size - 1 - i];
+    else
+        memcpy(v.b, p, size);
+    switch (type) {
+    case GLM_PLY_CHAR:   return v.c;
+    case GLM_PLY_UCHAR:  return v.uc;
+    case GLM_PLY_SHORT:  return v.s;
+    case GLM_PLY_USHORT: return v.us;
+    case GLM_PLY_INT:    return v.i;
+    case GLM_PLY_UINT:   return v.ui;
+    case GLM_PLY_FLOAT:  return v.f;
+    default:             return v.d;
+    }
+}
+
+/* glmPlyPut: write one value in the host byte order, returns the end */
+static inline char* glmPlyPut(char* p, GLuint type, double value){
+    union {
+        char           b[8];
+        signed char    c;
+        unsigned char  uc;
+        short          s;
+        unsigned short us;
+        int            i;
+        unsigned int   ui;
+        float          f;
+        double         d;
+    } v;
+    switch (type) {
+    case GLM_PLY_CHAR:   v.c  = (signed char)value;    break;
+    case GLM_PLY_UCHAR:  v.uc = (unsigned char)value;  break;
+    case GLM_PLY_SHORT:  v.s  = (short)value;          break;
+    case GLM_PLY_USHORT: v.us = (unsigned short)value; break;
+    case GLM_PLY_INT:    v.i  = (int)value;            break;
+    case GLM_PLY_UINT:   v.ui = (unsigned int)value;   break;
+    case GLM_PLY_FLOAT:  v.f  = (float)value;          break;
+    default:             v.d  = value;                 break;
+    }
+    memcpy(p, v.b, glmPlyTypeSizes[type]);
+    return p + glmPlyTypeSizes[type];
+}
+
+/* glmPlyElementEnd: the end of the binary element at p, or NULL if it
+ * runs past end.  If list is not NULL it gets the start of property
+ * index (a list) and count its length.
+ */
+static const char* glmPlyElementEnd(const GLMplyelement* element, const char* p, const char* end,
+                                    GLboolean swap, GLint index, const char** list, GLuint* count){
+    const GLMplyproperty* property;
+    GLuint i, n, size;
+    if (element->size)
+        return (size_t)(end - p) >= element->size ? p + element->size : NULL;
+    for (i = 0; i < element->numproperties; i++) {
+        property = &element->properties[i];
+        n = 1;
+        if (property->counttype != GLM_PLY_NONE) {
+            size = glmPlyTypeSizes[property->counttype];
+            if ((size_t)(end - p) < size)
+                return NULL;
+            n = (GLuint)glmPlyValue(p, property->counttype, swap);
+            p += size;
+            if ((GLint)i == index) {
+                *list = p;
+                *count = n;
+            }
+        }
+        size = glmPlyTypeSizes[property->type];
+        if ((size_t)(end - p) / size < n)
+            return NULL;
+        p += (size_t)n * size;
+    }
+    return p;
+}
+
+/* glmPlyBinary: convert the body of an ASCII file to binary in the host
+ * byte order, so that it can be decoded like a binary file.  Returns
+ * NULL if the body is short or malformed.
+ */
+static char* glmPlyBinary(const char* body, size_t length, GLMply* ply, size_t* size){
+    const GLMplyelement* element;
+    const GLMplyproperty* property;
+    char*   text;
+    char*   p;
+    char*   q;
+    char*   binary;
+    char*   grown;
+    size_t  used, capacity;
+    double  value;
+    GLuint  i, j, k, n;
+    text = (char*)malloc(length + 1);
+    memcpy(text, body, length);
+    text[length] = '\0';
+    capacity = length + 64;
+    binary = (char*)malloc(capacity);
+    used = 0;
+    p = text;
+    for (i = 0; i < ply->numelements; i++) {
+        element = &ply->elements[i];
+        for (j = 0; j < element->count; j++) {
+            for (k = 0; k < element->numproperties; k++) {
+                property = &element->properties[k];
+                n = 1;
+                if (capacity - used < 8) {
+                    if (!(grown = (char*)realloc(binary, 2 * capacity)))
+                        goto malformed;
+                    binary = grown;
+                    capacity *= 2;
+                }
+                if (property->counttype != GLM_PLY_NONE) {
+                    value = strtod(p, &q);
+                    if (q == p)
+                        goto malformed;
+                    p = q;
+                    /* every value takes at least two characters of text */
+                    if (!(value >= 0.0 && value <= (double)(length - (p - text)) / 2))
+                        goto malformed;
+                    n = (GLuint)value;
+                    used = glmPlyPut(binary + used, property->counttype, value) - binary;
+                }
+                if (capacity - used < (size_t)n * 8) {
+                    if (!(grown = (char*)realloc(binary, 2 * capacity + (size_t)n * 8)))
+                        goto malformed;
+                    binary = grown;
+                    capacity = 2 * capacity + (size_t)n * 8;
+                }
+                while (n--) {
+                    value = strtod(p, &q);
+                    if (q == p)
+                        goto malformed;
+                    p = q;
+                    used = glmPlyPut(binary + used, property->type, value) - binary;
+                }
+            }
+        }
+    }
+    free(text);
+    *size = used;
+    return binary;
+
+  malformed:
+    free(text);
+    free(binary);
+    return NULL;
+}
+
+/* glmPlyColor: a color component as a byte */
+static inline GLubyte glmPlyColor(double value, GLuint type){
+    if (type == GLM_PLY_FLOAT || type == GLM_PLY_DOUBLE)
+        value *= 255.0;
+    else if (type == GLM_PLY_SHORT || type == GLM_PLY_USHORT)
+        value /= 257.0;
+    else if (type == GLM_PLY_INT || type == GLM_PLY_UINT)
+        value /= 16843009.0;
+    return value <= 0.0 ? 0 : value >= 255.0 ? 255 : (GLubyte)(value + 0.5);
+}
+
+/* glmPlyVertices: decode one run of vertices into the model */
+static GLvoid glmPlyVertices(GLuint chunk, GLvoid* data){
+    GLMply*   ply = (GLMply*)data;
+    GLMmodel* model = ply->model;
+    const GLMplyproperty* properties = ply->vertex->properties;
+    const char* p;
+    GLuint    i, k, first, last, size;
+    GLint     r;
+    first = chunk * GLM_PLY_CHUNK;
+    last = first + GLM_PLY_CHUNK < ply->vertex->count ? first + GLM_PLY_CHUNK : ply->vertex->count;
+    size = ply->vertex->size;
+    for (i = first; i < last; i++) {
+        p = ply->vertices + (size_t)i * size;
+        for (k = 0; k < 3; k++) {
+            r = ply->roles[k];
+            model->vertices[3 * (i + 1) + k] = r < 0 ? 0.0f :
+                (GLfloat)glmPlyValue(p + properties[r].offset, properties[r].type, ply->swap);
+        }
+        if (model->normals)
+            for (k = 0; k < 3; k++) {
+                r = ply->roles[3 + k];
+                model->normals[3 * (i + 1) + k] = r < 0 ? 0.0f :
+                    (GLfloat)glmPlyValue(p + properties[r].offset, properties[r].type, ply->swap);
+            }
+        if (model->colors)
+            for (k = 0; k < 4; k++) {
+                r = ply->roles[6 + k];
+                model->colors[4 * (i + 1) + k] = r < 0 ? 255 :
+                    glmPlyColor(glmPlyValue(p + properties[r].offset, properties[r].type, ply->swap),
+                                properties[r].type);
+            }
+    }
+}
+
+/* glmPlyIndex: read one vertex index of a face and make it 1-based.
+ * An index that isn't one of the file's vertices (negative, too big,
+ * or not a number at all) flags the file as bad and reads as 0.
+ */
+static inline GLuint glmPlyIndex(GLMply* ply, const char* p, GLuint type){
+    double index = glmPlyValue(p, type, ply->swap);
+    if (!(index >= 0 && index < ply->vertex->count)) {
+        __sync_fetch_and_or(&ply->badindex, 1);
+        return 0;
+    }
+    return (GLuint)index + 1;
+}
+
+/* glmPlyFan: add the triangles of a face of count corners, starting at
+ * triangle t.  Returns the number of triangles added.
+ */
+static inline GLuint glmPlyFan(GLMply* ply, GLuint t, const char* list, GLuint count){
+    GLMmodel*    model = ply->model;
+    GLMtriangle* triangle;
+    GLuint       type, size, i, first, previous, v;
+    type = ply->face->properties[ply->indices].type;
+    size = glmPlyTypeSizes[type];
+    if (count < 3)
+        return 0;
+    first = glmPlyIndex(ply, list, type);
+    previous = glmPlyIndex(ply, list + size, type);
+    for (i = 2; i < count; i++) {
+        v = glmPlyIndex(ply, list + i * size, type);
+        triangle = &model->triangles[t++];
+        memset(triangle, 0, sizeof(GLMtriangle));
+        triangle->vindices[0] = first;
+        triangle->vindices[1] = previous;
+        triangle->vindices[2] = v;
+        if (model->normals)
+            memcpy(triangle->nindices, triangle->vindices, sizeof(triangle->nindices));
+        previous = v;
+    }
+    return count - 2;
+}
+
+/* glmPlyTriangles: decode one run of faces that are all triangles */
+static GLvoid glmPlyTriangles(GLuint chunk, GLvoid* data){
+    GLMply* ply = (GLMply*)data;
+    GLuint  i, first, last;
+    first = chunk * GLM_PLY_CHUNK;
+    last = first + GLM_PLY_CHUNK < ply->face->count ? first + GLM_PLY_CHUNK : ply->face->count;
+    for (i = first; i < last; i++)
+        glmPlyFan(ply, i, ply->faces + (size_t)i * ply->stride + ply->listoffset, 3);
+}
+
+/* glmReadPLY: Reads a model from a Stanford .PLY file.
+ *
+ * filename - name of the file containing the .PLY data.
+ */
+GLMmodel* glmReadPLY(char* filename, mycallback *call){
+    GLMply    ply;
+    GLMmodel* model;
+    GLMgroup* group;
+    GLMplyelement* element;
+    struct stat st;
+    const char* p;
+    const char* q;
+    const char* end;
+    const char* list;
+    char*   data;
+    char*   binary;
+    size_t  header, size;
+    GLuint  numtriangles, count, i, t, one;
+    GLboolean little, uniform;
+    int     fd;
+
+    /* map the file */
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "glmReadPLY() failed: can't open data file \"%s\".\n", filename);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        fprintf(stderr, "glmReadPLY() failed: can't read data file \"%s\".\n", filename);
+        return NULL;
+    }
+    data = (char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "glmReadPLY() failed: can't read data file \"%s\".\n", filename);
+        return NULL;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    binary = NULL;
+
+    header = glmPlyHeader(data, st.st_size, &ply);
+    if (!header) {
+        fprintf(stderr, "glmReadPLY() failed: \"%s\" has no PLY header I can read.\n", filename);
+        goto failed;
+    }
+    glmPlyLayout(&ply);
+    if (!ply.vertex || !ply.vertex->size || ply.roles[0] < 0) {
+        fprintf(stderr, "glmReadPLY() failed: \"%s\" has no vertex positions.\n", filename);
+        goto failed;
+    }
+    if (call) {
+        call->loadcallback(call->start, call->text ? call->text : (char*)"Loading...");
+    }
+
+    /* the body, in binary */
+    one = 1;
+    little = *(char*)&one;
+    if (ply.format == GLM_PLY_ASCII) {
+        binary = glmPlyBinary(data + header, st.st_size - header, &ply, &size);
+        if (!binary) {
+            fprintf(stderr, "glmReadPLY() failed: \"%s\" is short or malformed.\n", filename);
+            goto failed;
+        }
+        p = binary;
+        end = binary + size;
+        ply.swap = GL_FALSE;
+    } else {
+        p = data + header;
+        end = data + st.st_size;
+        ply.swap = little != (ply.format == GLM_PLY_LITTLE);
+    }
+
+    /* find the vertex and face blocks, counting the triangles */
+    numtriangles = 0;
+    ply.stride = 0;
+    ply.badindex = 0;
+    for (i = 0; i < ply.numelements && p; i++) {
+        element = &ply.elements[i];
+        if (element == ply.vertex) {
+            ply.vertices = p;
+            p = (size_t)(end - p) / element->size >= element->count ?
+                p + (size_t)element->size * element->count : NULL;
+        } else if (element == ply.face && ply.indices >= 0) {
+            ply.faces = p;
+            uniform = element->count > 0;
+            for (count = 0; count < element->count && p; count++) {
+                q = glmPlyElementEnd(element, p, end, ply.swap, ply.indices, &list, &t);
+                if (!q) {
+                    p = NULL;
+                    break;
+                }
+                if (t >= 3)
+                    numtriangles += t - 2;
+                if (count == 0) {
+                    ply.stride = q - p;
+                    ply.listoffset = list - p;
+                }
+                if (t != 3 || (GLuint)(q - p) != ply.stride || (GLuint)(list - p) != ply.listoffset)
+                    uniform = GL_FALSE;
+                p = q;
+            }
+            if (!uniform)
+                ply.stride = 0;
+        } else {
+            for (count = 0; count < element->count && p; count++)
+                p = glmPlyElementEnd(element, p, end, ply.swap, -1, NULL, NULL);
+        }
+    }
+    if (!p) {
+        fprintf(stderr, "glmReadPLY() failed: \"%s\" is short or malformed.\n", filename);
+        goto failed;
+    }
+
+    /* allocate a new model */
+    model = (GLMmodel*)calloc(1, sizeof(GLMmodel));
+    model->numvertices   = ply.vertex->count;
+    model->numtriangles  = numtriangles;
+    size = sizeof(GLfloat) * 3 * (model->numvertices + 1);
+    glmReserve(model, 2 * size + sizeof(GLubyte) * 4 * (model->numvertices + 1) +
+               (sizeof(GLMtriangle) + sizeof(GLuint)) * (numtriangles + 1) + strlen(filename) + 1024);
+    model->pathname      = glmStrdup(model, filename);
+    model->vertices = (GLfloat*)glmAlloc(model, size);
+    memset(model->vertices, 0, sizeof(GLfloat) * 3);
+    if (ply.roles[3] >= 0) {
+        model->numnormals = model->numvertices;
+        model->normals = (GLfloat*)glmAlloc(model, size);
+        memset(model->normals, 0, sizeof(GLfloat) * 3);
+    }
+    if (ply.roles[6] >= 0 || ply.roles[7] >= 0 || ply.roles[8] >= 0) {
+        model->colors = (GLubyte*)glmAlloc(model, sizeof(GLubyte) * 4 * (model->numvertices + 1));
+        memset(model->colors, 0, sizeof(GLubyte) * 4);
+    }
+    if (numtriangles)
+        model->triangles = (GLMtriangle*)glmAlloc(model, sizeof(GLMtriangle) * numtriangles);
+    ply.model = model;
+
+    /* decode the vertices, then the faces */
+    glmParallel((ply.vertex->count + GLM_PLY_CHUNK - 1) / GLM_PLY_CHUNK, glmPlyVertices, &ply);
+    if (call)
+        call->loadcallback((call->start + call->end) / 2, call->text ? call->text : (char*)"Loading...");
+    if (ply.stride) {
+        glmParallel((ply.face->count + GLM_PLY_CHUNK - 1) / GLM_PLY_CHUNK, glmPlyTriangles, &ply);
+    } else if (numtriangles) {
+        p = ply.faces;
+        t = 0;
+        for (i = 0; i < ply.face->count; i++) {
+            p = glmPlyElementEnd(ply.face, p, end, ply.swap, ply.indices, &list, &count);
+            t += glmPlyFan(&ply, t, list, count);
+        }
+    }
+    if (ply.badindex) {
+        fprintf(stderr, "glmReadPLY() failed: \"%s\" has faces with vertex indices out of range.\n",
+                filename);
+        glmDelete(model);
+        goto failed;
+    }
+
+    /* everything goes in one group */
+    group = (GLMgroup*)glmAlloc(model, sizeof(GLMgroup));
+    group->name         = glmStrdup(model, "default");
+    group->numtriangles = numtriangles;
+    group->triangles    = (GLuint*)glmAlloc(model, sizeof(GLuint) * (numtriangles + 1));
+    group->material     = 0;
+    group->next         = NULL;
+    for (i = 0; i < numtriangles; i++)
+        group->triangles[i] = i;
+    model->groups = group;
+    model->numgroups = 1;
+
+    free(binary);
+    munmap(data, st.st_size);
+    if (call)
+        call->loadcallback(call->end, call->text ? call->text : (char*)"Loading...");
+    return model;
+
+  failed:
+    free(binary);
+    munmap(data, st.st_size);
+    return NULL;
+}
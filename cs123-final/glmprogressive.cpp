@@ -0,0 +1,368 @@
+/*
+      glmprogressive.cpp
+
+      Streaming and drawing of progressive meshes (see glmProgressive()).
+
+      A progressive mesh is written next to its .OBJ as <name>.obj.glmp:
+      a header, the base mesh, and then the vertex splits one after the
+      other, each followed by the vertex it brings in, the triangles it
+      brings back and the corners it moves.  Reading the base mesh is
+      enough to draw something; the splits can then be streamed in on a
+      loader thread while the drawing thread applies the ones that are
+      in to its buffers a few at a time.
+
+      The buffers are sized for the full mesh up front.  A split only
+      appends to them, plus one position and a few indices rewritten in
+      place, so refining never reallocates or reuploads anything.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "glm.h"
+
+#define GLM_PROGRESSIVE_MAGIC   "GLMP"
+#define GLM_PROGRESSIVE_VERSION 1
+
+/* GLMprogressiveheader: first bytes of a .glmp file */
+typedef struct _GLMprogressiveheader {
+    char   magic[4];              /* GLM_PROGRESSIVE_MAGIC */
+    GLuint version;               /* GLM_PROGRESSIVE_VERSION */
+    unsigned long long srcsize;   /* size of the .OBJ */
+    unsigned long long srcmtime;  /* modification time of the .OBJ */
+    GLuint numvertices;
+    GLuint numtriangles;
+    GLuint numsplits;
+    GLuint numcorners;
+    GLuint basevertices;
+    GLuint basetriangles;
+} GLMprogressiveheader;
+
+/* glmProgressiveName: return the name of the progressive mesh file for
+ * a model file
+ *
+ * NOTE: the return value should be free'd.
+ */
+static char* glmProgressiveName(char* filename, const char* suffix){
+    char* name;
+    name = (char*)malloc(strlen(filename) + strlen(suffix) + 1);
+    strcpy(name, filename);
+    strcat(name, suffix);
+    return name;
+}
+
+/* glmProgressiveInRange: whether all count values are in [lo, hi) */
+static GLboolean glmProgressiveInRange(GLuint* values, GLuint count, GLuint lo, GLuint hi){
+    GLuint i;
+    for (i = 0; i < count; i++)
+        if (values[i] < lo || values[i] >= hi)
+            return GL_FALSE;
+    return GL_TRUE;
+}
+
+/* glmWriteProgressive: Writes a progressive mesh next to its .OBJ.
+ * The file is written under a temporary name and renamed into place, so
+ * a reader never sees half of it.
+ *
+ * pm       - progressive mesh from glmProgressive()
+ * filename - name of the .OBJ file
+ */
+GLboolean glmWriteProgressive(GLMprogressive* pm, char* filename){
+    GLMprogressiveheader header;
+    GLMvsplit* split;
+    struct stat st;
+    FILE*  file;
+    char*  name;
+    char*  tmpname;
+    GLuint i, vertex, triangle, corner;
+    GLboolean ok;
+    assert(pm);
+    if (stat(filename, &st) < 0)
+        return GL_FALSE;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GLM_PROGRESSIVE_MAGIC, 4);
+    header.version       = GLM_PROGRESSIVE_VERSION;
+    header.srcsize       = st.st_size;
+    header.srcmtime      = st.st_mtime;
+    header.numvertices   = pm->numvertices;
+    header.numtriangles  = pm->numtriangles;
+    header.numsplits     = pm->numsplits;
+    header.numcorners    = pm->numcorners;
+    header.basevertices  = pm->basevertices;
+    header.basetriangles = pm->basetriangles;
+
+    name = glmProgressiveName(filename, ".glmp");
+    tmpname = glmProgressiveName(filename, ".glmp.tmp");
+    file = fopen(tmpname, "wb");
+    if (!file) {
+        fprintf(stderr, "glmWriteProgressive() failed: can't open file \"%s\" to write.\n",
+                tmpname);
+        free(name);
+        free(tmpname);
+        return GL_FALSE;
+    }
+    ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = ok && fwrite(pm->vertices, sizeof(GLfloat) * 3, pm->basevertices + 1, file) == pm->basevertices + 1;
+    ok = ok && fwrite(pm->normals, sizeof(GLfloat) * 3, pm->basevertices + 1, file) == pm->basevertices + 1;
+    ok = ok && fwrite(pm->indices, sizeof(GLuint) * 3, pm->basetriangles, file) == pm->basetriangles;
+    vertex = pm->basevertices + 1;
+    triangle = pm->basetriangles;
+    corner = 0;
+    for (i = 0; ok && i < pm->numsplits; i++, vertex++) {
+        split = &pm->splits[i];
+        ok = fwrite(split, sizeof(GLMvsplit), 1, file) == 1 &&
+             fwrite(&pm->vertices[3 * vertex], sizeof(GLfloat), 3, file) == 3 &&
+             fwrite(&pm->normals[3 * vertex], sizeof(GLfloat), 3, file) == 3 &&
+             fwrite(&pm->indices[3 * triangle], sizeof(GLuint) * 3, split->numtriangles, file) ==
+                 split->numtriangles &&
+             fwrite(&pm->corners[corner], sizeof(GLuint), split->numcorners, file) ==
+                 split->numcorners;
+        triangle += split->numtriangles;
+        corner += split->numcorners;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (ok)
+        ok = rename(tmpname, name) == 0;
+    if (!ok) {
+        fprintf(stderr, "glmWriteProgressive() failed: can't write \"%s\".\n", name);
+        remove(tmpname);
+    }
+    free(name);
+    free(tmpname);
+    return ok;
+}
+
+/* glmReadProgressive: Opens the progressive mesh of an .OBJ and reads
+ * its base mesh.  The arrays are allocated for the whole mesh, and the
+ * file stays open for glmStreamProgressive().
+ *
+ * filename - name of the .OBJ file
+ */
+GLMprogressive* glmReadProgressive(char* filename){
+    GLMprogressiveheader header;
+    GLMprogressive* pm;
+    struct stat st;
+    FILE* file;
+    char* name;
+    if (stat(filename, &st) < 0)
+        return NULL;
+    name = glmProgressiveName(filename, ".glmp");
+    file = fopen(name, "rb");
+    free(name);
+    if (!file)
+        return NULL;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, GLM_PROGRESSIVE_MAGIC, 4) ||
+        header.version != GLM_PROGRESSIVE_VERSION ||
+        header.srcsize != (unsigned long long)st.st_size ||
+        header.srcmtime != (unsigned long long)st.st_mtime ||
+        header.basevertices > header.numvertices ||
+        header.basetriangles > header.numtriangles) {
+        fclose(file);
+        return NULL;
+    }
+
+    pm = (GLMprogressive*)calloc(1, sizeof(GLMprogressive));
+    pm->numvertices   = header.numvertices;
+    pm->numtriangles  = header.numtriangles;
+    pm->numsplits     = header.numsplits;
+    pm->numcorners    = header.numcorners;
+    pm->basevertices  = header.basevertices;
+    pm->basetriangles = header.basetriangles;
+    pm->vertices = (GLfloat*)calloc(3 * (pm->numvertices + 1), sizeof(GLfloat));
+    pm->normals  = (GLfloat*)calloc(3 * (pm->numvertices + 1), sizeof(GLfloat));
+    pm->indices  = (GLuint*)malloc(sizeof(GLuint) * 3 * (pm->numtriangles + 1));
+    pm->splits   = (GLMvsplit*)malloc(sizeof(GLMvsplit) * (pm->numsplits + 1));
+    pm->corners  = (GLuint*)malloc(sizeof(GLuint) * (pm->numcorners + 1));
+    if (fread(pm->vertices, sizeof(GLfloat) * 3, pm->basevertices + 1, file) != pm->basevertices + 1 ||
+        fread(pm->normals, sizeof(GLfloat) * 3, pm->basevertices + 1, file) != pm->basevertices + 1 ||
+        fread(pm->indices, sizeof(GLuint) * 3, pm->basetriangles, file) != pm->basetriangles ||
+        !glmProgressiveInRange(pm->indices, 3 * pm->basetriangles, 1, pm->basevertices + 1)) {
+        fclose(file);
+        glmDeleteProgressive(pm);
+        return NULL;
+    }
+    pm->loadedtriangles = pm->basetriangles;
+    pm->file = pm->numsplits ? file : NULL;
+    if (!pm->file)
+        fclose(file);
+    return pm;
+}
+
+/* glmStreamProgressive: Reads up to count more splits.  Everything a
+ * split needs is in place before numloaded counts it, so the drawing
+ * thread can use any split below numloaded.  The indices of a split
+ * are checked as they come in: its triangles may only use the vertices
+ * up to the one it brings in, and its corners only the triangles
+ * already there.  A short or damaged file just ends the stream early.
+ *
+ * pm    - progressive mesh from glmReadProgressive()
+ * count - most splits to read
+ */
+GLuint glmStreamProgressive(GLMprogressive* pm, GLuint count){
+    GLMvsplit* split;
+    GLuint i, vertex, end;
+    GLboolean ok;
+    assert(pm);
+    if (!pm->file)
+        return 0;
+    end = pm->numloaded + count < pm->numsplits ? pm->numloaded + count : pm->numsplits;
+    ok = GL_TRUE;
+    for (i = pm->numloaded; i < end; i++) {
+        split = &pm->splits[i];
+        vertex = pm->basevertices + 1 + i;
+        ok = fread(split, sizeof(GLMvsplit), 1, pm->file) == 1 &&
+             split->vertex > 0 && split->vertex < vertex &&
+             pm->loadedtriangles + split->numtriangles <= pm->numtriangles &&
+             pm->loadedcorners + split->numcorners <= pm->numcorners &&
+             fread(&pm->vertices[3 * vertex], sizeof(GLfloat), 3, pm->file) == 3 &&
+             fread(&pm->normals[3 * vertex], sizeof(GLfloat), 3, pm->file) == 3 &&
+             fread(&pm->indices[3 * pm->loadedtriangles], sizeof(GLuint) * 3, split->numtriangles,
+                   pm->file) == split->numtriangles &&
+             glmProgressiveInRange(&pm->indices[3 * pm->loadedtriangles], 3 * split->numtriangles,
+                                   1, vertex + 1) &&
+             fread(&pm->corners[pm->loadedcorners], sizeof(GLuint), split->numcorners,
+                   pm->file) == split->numcorners &&
+             glmProgressiveInRange(&pm->corners[pm->loadedcorners], split->numcorners,
+                                   0, 3 * pm->loadedtriangles);
+        if (!ok)
+            break;
+        pm->loadedtriangles += split->numtriangles;
+        pm->loadedcorners += split->numcorners;
+    }
+    count = i - pm->numloaded;
+    /* publish the splits only after their data */
+    __sync_synchronize();
+    pm->numloaded = i;
+    if (!ok || i == pm->numsplits) {
+        if (!ok)
+            fprintf(stderr, "glmStreamProgressive(): file is short or damaged after %u of %u splits.\n",
+                    i, pm->numsplits);
+        fclose(pm->file);
+        pm->file = NULL;
+    }
+    return count;
+}
+
+/* glmRefineProgressive: Applies up to count loaded splits to the
+ * buffers.  The vertices and triangles the splits bring in are one
+ * range each; the moved positions and corners are written one by one
+ * afterwards, since a split can move what an earlier one of the same
+ * batch brought in.
+ *
+ * pm    - progressive mesh
+ * count - most splits to apply
+ */
+GLuint glmRefineProgressive(GLMprogressive* pm, GLuint count){
+    GLMvsplit* split;
+    GLuint loaded, end, i, j, vertex, numtriangles;
+    size_t normals;
+    assert(pm);
+    loaded = pm->numloaded;
+    __sync_synchronize();
+    normals = sizeof(GLfloat) * 3 * (pm->numvertices + 1);
+
+    if (!pm->vbo) {
+        glGenBuffers(1, &pm->vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, pm->vbo);
+        glBufferData(GL_ARRAY_BUFFER, 2 * normals, NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(GLfloat) * 3 * (pm->basevertices + 1),
+                        pm->vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, normals, sizeof(GLfloat) * 3 * (pm->basevertices + 1),
+                        pm->normals);
+        glGenBuffers(1, &pm->ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * pm->numtriangles, NULL,
+                     GL_STATIC_DRAW);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(GLuint) * 3 * pm->basetriangles,
+                        pm->indices);
+        pm->numdrawn = pm->basetriangles;
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, pm->vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo);
+    }
+
+    end = pm->numapplied + count < loaded ? pm->numapplied + count : loaded;
+    if (end > pm->numapplied) {
+        /* the new vertices and triangles */
+        vertex = pm->basevertices + 1 + pm->numapplied;
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * vertex,
+                        sizeof(GLfloat) * 3 * (end - pm->numapplied), &pm->vertices[3 * vertex]);
+        glBufferSubData(GL_ARRAY_BUFFER, normals + sizeof(GLfloat) * 3 * vertex,
+                        sizeof(GLfloat) * 3 * (end - pm->numapplied), &pm->normals[3 * vertex]);
+        numtriangles = 0;
+        for (i = pm->numapplied; i < end; i++)
+            numtriangles += pm->splits[i].numtriangles;
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * 3 * pm->numdrawn,
+                        sizeof(GLuint) * 3 * numtriangles, &pm->indices[3 * pm->numdrawn]);
+        pm->numdrawn += numtriangles;
+
+        /* and what the splits move */
+        for (i = pm->numapplied; i < end; i++, vertex++) {
+            split = &pm->splits[i];
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 3 * split->vertex,
+                            sizeof(GLfloat) * 3, split->position);
+            for (j = 0; j < split->numcorners; j++)
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER,
+                                sizeof(GLuint) * pm->corners[pm->nextcorner + j],
+                                sizeof(GLuint), &vertex);
+            pm->nextcorner += split->numcorners;
+        }
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    count = end > pm->numapplied ? end - pm->numapplied : 0;
+    pm->numapplied += count;
+    return count;
+}
+
+/* glmDrawProgressive: Renders a progressive mesh as far as it has been
+ * refined (nothing before the first glmRefineProgressive()).
+ *
+ * pm   - progressive mesh
+ * mode - GLM_NONE or GLM_SMOOTH
+ */
+GLvoid glmDrawProgressive(GLMprogressive* pm, GLuint mode){
+    assert(pm);
+    if (!pm->vbo)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, pm->vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pm->ibo);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, NULL);
+    if (mode & GLM_SMOOTH) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_FLOAT, 0, (GLubyte*)NULL + sizeof(GLfloat) * 3 * (pm->numvertices + 1));
+    }
+    glDrawElements(GL_TRIANGLES, 3 * pm->numdrawn, GL_UNSIGNED_INT, NULL);
+    if (mode & GLM_SMOOTH)
+        glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/* glmDeleteProgressive: Deletes a progressive mesh.
+ *
+ * pm - progressive mesh
+ */
+GLvoid glmDeleteProgressive(GLMprogressive* pm){
+    assert(pm);
+    if (pm->file)
+        fclose(pm->file);
+    if (pm->vbo) {
+        glDeleteBuffers(1, &pm->vbo);
+        glDeleteBuffers(1, &pm->ibo);
+    }
+    free(pm->vertices);
+    free(pm->normals);
+    free(pm->indices);
+    free(pm->splits);
+    free(pm->corners);
+    free(pm);
+}
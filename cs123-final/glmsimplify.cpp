@@ -0,0 +1,783 @@
+/*
+      glmsimplify.cpp
+
+      Quadric error metric simplification of GLM models (Garland and
+      Heckbert, "Surface Simplification Using Quadric Error Metrics").
+
+      Every vertex carries the sum of the squared distances to the planes
+      of its triangles.  Edges are collapsed cheapest first, the merged
+      vertex going where the summed quadric is smallest, until the model
+      is down to the requested number of triangles.  Edges on an open
+      border get extra planes at right angles to the border so the
+      outline survives, and collapses that would fold a triangle over
+      are skipped.
+
+      glmProgressive() runs the same collapses all the way down to a
+      coarse base mesh and logs each one, so that they can be undone as
+      vertex splits (Hoppe, "Progressive Meshes").
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <GL/gl.h>
+#include "glm.h"
+
+#define T(x) (model->triangles[(x)])
+
+/* weight of the planes that hold open borders in place */
+#define GLM_BORDER_WEIGHT 1000.0
+
+/* GLMquadric: symmetric 4x4 matrix of a quadric error, upper triangle
+ * (aa ab ac ad bb bc bd cc cd dd).
+ */
+typedef struct _GLMquadric {
+    double q[10];
+} GLMquadric;
+
+/* GLMcollapse: a candidate edge collapse in the heap */
+typedef struct _GLMcollapse {
+    double  cost;                 /* error the collapse introduces */
+    GLuint  u, v;                 /* v is merged into u */
+    GLuint  ustamp, vstamp;       /* versions of u and v it was priced at */
+    GLfloat target[3];            /* where the merged vertex goes */
+} GLMcollapse;
+
+/* GLMsimplify: working state of a simplification */
+typedef struct _GLMsimplify {
+    GLMmodel*    model;
+    GLuint       numvertices;
+    GLdouble*    positions;       /* current position of each vertex */
+    GLMquadric*  quadrics;        /* quadric of each vertex */
+    GLuint*      stamps;          /* bumped whenever a vertex changes */
+    GLubyte*     alive;           /* vertex still exists */
+    GLuint**     lists;           /* triangles around each vertex */
+    GLuint*      counts;          /* length of each list */
+    GLubyte*     owned;           /* list was malloc()'d on its own */
+    GLuint*      pool;            /* the initial lists */
+    GLuint*      corners;         /* vertices of each triangle */
+    GLubyte*     dead;            /* triangle collapsed away */
+    GLuint       numalive;        /* triangles left */
+    GLuint*      marks;           /* scratch marks, per vertex */
+    GLuint       mark;
+    GLMcollapse* heap;
+    GLuint       heapsize, heapcap;
+    GLvoid     (*record)(struct _GLMsimplify*, GLuint, GLuint); /* called before every collapse */
+    GLvoid*      data;
+} GLMsimplify;
+
+/* glmQuadricPlane: add the quadric of the plane ax + by + cz + d = 0 */
+static GLvoid glmQuadricPlane(GLMquadric* Q, double a, double b, double c, double d, double w){
+    Q->q[0] += w * a * a; Q->q[1] += w * a * b; Q->q[2] += w * a * c; Q->q[3] += w * a * d;
+    Q->q[4] += w * b * b; Q->q[5] += w * b * c; Q->q[6] += w * b * d;
+    Q->q[7] += w * c * c; Q->q[8] += w * c * d;
+    Q->q[9] += w * d * d;
+}
+
+/* glmQuadricError: error of a point under a quadric */
+static double glmQuadricError(const GLMquadric* Q, double x, double y, double z){
+    const double* q = Q->q;
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x +
+           q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+           q[7] * z * z + 2 * q[8] * z +
+           q[9];
+}
+
+/* glmHeapPush: add a candidate collapse to the heap */
+static GLvoid glmHeapPush(GLMsimplify* s, GLMcollapse* c){
+    GLuint i, parent;
+    if (s->heapsize == s->heapcap) {
+        s->heapcap = s->heapcap ? s->heapcap * 2 : 1024;
+        s->heap = (GLMcollapse*)realloc(s->heap, sizeof(GLMcollapse) * s->heapcap);
+    }
+    i = s->heapsize++;
+    while (i > 0) {
+        parent = (i - 1) / 2;
+        if (s->heap[parent].cost <= c->cost)
+            break;
+        s->heap[i] = s->heap[parent];
+        i = parent;
+    }
+    s->heap[i] = *c;
+}
+
+/* glmHeapPop: take the cheapest collapse off the heap */
+static GLvoid glmHeapPop(GLMsimplify* s, GLMcollapse* c){
+    GLMcollapse last;
+    GLuint i, child;
+    *c = s->heap[0];
+    last = s->heap[--s->heapsize];
+    i = 0;
+    while ((child = 2 * i + 1) < s->heapsize) {
+        if (child + 1 < s->heapsize && s->heap[child + 1].cost < s->heap[child].cost)
+            child++;
+        if (last.cost <= s->heap[child].cost)
+            break;
+        s->heap[i] = s->heap[child];
+        i = child;
+    }
+    s->heap[i] = last;
+}
+
+/* glmPriceCollapse: work out where merging v into u should put the
+ * vertex and what it costs, and queue the collapse.
+ */
+static GLvoid glmPriceCollapse(GLMsimplify* s, GLuint u, GLuint v){
+    GLMcollapse c;
+    GLMquadric  Q;
+    double*     q;
+    double      det, x, y, z, e, best;
+    double*     pu;
+    double*     pv;
+    GLuint      i;
+    for (i = 0; i < 10; i++)
+        Q.q[i] = s->quadrics[u].q[i] + s->quadrics[v].q[i];
+    q = Q.q;
+    pu = &s->positions[3 * u];
+    pv = &s->positions[3 * v];
+
+    /* the best place minimizes the error: solve the 3x3 system */
+    det = q[0] * (q[4] * q[7] - q[5] * q[5]) -
+          q[1] * (q[1] * q[7] - q[5] * q[2]) +
+          q[2] * (q[1] * q[5] - q[4] * q[2]);
+    if (fabs(det) > 1e-12) {
+        x = -(q[3] * (q[4] * q[7] - q[5] * q[5]) -
+              q[1] * (q[6] * q[7] - q[5] * q[8]) +
+              q[2] * (q[6] * q[5] - q[4] * q[8])) / det;
+        y = -(q[0] * (q[6] * q[7] - q[8] * q[5]) -
+              q[3] * (q[1] * q[7] - q[5] * q[2]) +
+              q[2] * (q[1] * q[8] - q[6] * q[2])) / det;
+        z = -(q[0] * (q[4] * q[8] - q[5] * q[6]) -
+              q[1] * (q[1] * q[8] - q[6] * q[2]) +
+              q[3] * (q[1] * q[5] - q[4] * q[2])) / det;
+        best = glmQuadricError(&Q, x, y, z);
+    } else {
+        /* flat or straight: settle for an end or the middle */
+        x = pu[0]; y = pu[1]; z = pu[2];
+        best = glmQuadricError(&Q, x, y, z);
+        e = glmQuadricError(&Q, pv[0], pv[1], pv[2]);
+        if (e < best) {
+            best = e;
+            x = pv[0]; y = pv[1]; z = pv[2];
+        }
+        e = glmQuadricError(&Q, (pu[0] + pv[0]) / 2, (pu[1] + pv[1]) / 2, (pu[2] + pv[2]) / 2);
+        if (e < best) {
+            best = e;
+            x = (pu[0] + pv[0]) / 2; y = (pu[1] + pv[1]) / 2; z = (pu[2] + pv[2]) / 2;
+        }
+    }
+    c.cost = best > 0 ? best : 0;
+    c.u = u;
+    c.v = v;
+    c.ustamp = s->stamps[u];
+    c.vstamp = s->stamps[v];
+    c.target[0] = x;
+    c.target[1] = y;
+    c.target[2] = z;
+    glmHeapPush(s, &c);
+}
+
+/* glmTriangleNormal: (unnormalized) normal of a triangle, with one of
+ * its vertices optionally moved somewhere else.
+ */
+static GLvoid glmTriangleNormal(GLMsimplify* s, GLuint t, GLuint moved, GLfloat* to, double* n){
+    double p[3][3], a[3], b[3];
+    GLuint k, v;
+    for (k = 0; k < 3; k++) {
+        v = s->corners[3 * t + k];
+        if (v == moved) {
+            p[k][0] = to[0]; p[k][1] = to[1]; p[k][2] = to[2];
+        } else {
+            p[k][0] = s->positions[3 * v + 0];
+            p[k][1] = s->positions[3 * v + 1];
+            p[k][2] = s->positions[3 * v + 2];
+        }
+    }
+    for (k = 0; k < 3; k++) {
+        a[k] = p[1][k] - p[0][k];
+        b[k] = p[2][k] - p[0][k];
+    }
+    n[0] = a[1] * b[2] - a[2] * b[1];
+    n[1] = a[2] * b[0] - a[0] * b[2];
+    n[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/* glmCollapseFlips: true if moving vertex w to target would turn one of
+ * its triangles (other than those on the edge u-v) upside down.
+ */
+static GLboolean glmCollapseFlips(GLMsimplify* s, GLuint w, GLuint u, GLuint v, GLfloat* target){
+    double before[3], after[3];
+    GLuint i, t;
+    for (i = 0; i < s->counts[w]; i++) {
+        t = s->lists[w][i];
+        if (s->dead[t])
+            continue;
+        if ((s->corners[3 * t + 0] == u || s->corners[3 * t + 1] == u || s->corners[3 * t + 2] == u) &&
+            (s->corners[3 * t + 0] == v || s->corners[3 * t + 1] == v || s->corners[3 * t + 2] == v))
+            continue;
+        glmTriangleNormal(s, t, (GLuint)-1, NULL, before);
+        glmTriangleNormal(s, t, w, target, after);
+        if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0)
+            return GL_TRUE;
+    }
+    return GL_FALSE;
+}
+
+/* glmCollapse: merge v into u at target */
+static GLvoid glmCollapse(GLMsimplify* s, GLuint u, GLuint v, GLfloat* target){
+    GLuint* list;
+    GLuint  count, i, k, t, w;
+    if (s->record)
+        s->record(s, u, v);
+    list = (GLuint*)malloc(sizeof(GLuint) * (s->counts[u] + s->counts[v] + 1));
+    count = 0;
+    /* triangles on the edge go away, the others of v now use u */
+    for (i = 0; i < s->counts[v]; i++) {
+        t = s->lists[v][i];
+        if (s->dead[t])
+            continue;
+        if (s->corners[3 * t + 0] == u || s->corners[3 * t + 1] == u || s->corners[3 * t + 2] == u) {
+            s->dead[t] = 1;
+            s->numalive--;
+            continue;
+        }
+        for (k = 0; k < 3; k++)
+            if (s->corners[3 * t + k] == v)
+                s->corners[3 * t + k] = u;
+        list[count++] = t;
+    }
+    for (i = 0; i < s->counts[u]; i++) {
+        t = s->lists[u][i];
+        if (!s->dead[t])
+            list[count++] = t;
+    }
+    if (s->owned[u])
+        free(s->lists[u]);
+    if (s->owned[v])
+        free(s->lists[v]);
+    s->lists[u] = list;
+    s->counts[u] = count;
+    s->owned[u] = 1;
+    s->lists[v] = NULL;
+    s->counts[v] = 0;
+    s->owned[v] = 0;
+    s->alive[v] = 0;
+
+    s->positions[3 * u + 0] = target[0];
+    s->positions[3 * u + 1] = target[1];
+    s->positions[3 * u + 2] = target[2];
+    for (k = 0; k < 10; k++)
+        s->quadrics[u].q[k] += s->quadrics[v].q[k];
+    s->stamps[u]++;
+
+    /* every edge out of u has a new price */
+    s->mark++;
+    s->marks[u] = s->mark;
+    for (i = 0; i < count; i++) {
+        t = list[i];
+        for (k = 0; k < 3; k++) {
+            w = s->corners[3 * t + k];
+            if (s->marks[w] != s->mark) {
+                s->marks[w] = s->mark;
+                glmPriceCollapse(s, u, w);
+            }
+        }
+    }
+}
+
+/* glmCompareEdges: qsort() order of packed edges */
+static int glmCompareEdges(const void* a, const void* b){
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+/* glmSimplifyInit: build quadrics, vertex lists and the initial heap */
+static GLvoid glmSimplifyInit(GLMsimplify* s, GLMmodel* model){
+    unsigned long long* edges;
+    GLuint numedges, i, j, k, t, a, b, c, n;
+    double p[3][3], e1[3], e2[3], nrm[3], len, d, ex[3], bn[3];
+    memset(s, 0, sizeof(GLMsimplify));
+    s->model = model;
+    s->numvertices = model->numvertices;
+    s->positions = (GLdouble*)malloc(sizeof(GLdouble) * 3 * (model->numvertices + 1));
+    for (i = 0; i <= 3 * model->numvertices + 2; i++)
+        s->positions[i] = model->vertices[i];
+    s->quadrics = (GLMquadric*)calloc(model->numvertices + 1, sizeof(GLMquadric));
+    s->stamps   = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    s->alive    = (GLubyte*)malloc(model->numvertices + 1);
+    s->lists    = (GLuint**)malloc(sizeof(GLuint*) * (model->numvertices + 1));
+    s->counts   = (GLuint*)calloc(model->numvertices + 2, sizeof(GLuint));
+    s->owned    = (GLubyte*)calloc(model->numvertices + 1, 1);
+    s->marks    = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    s->corners  = (GLuint*)malloc(sizeof(GLuint) * 3 * (model->numtriangles + 1));
+    s->dead     = (GLubyte*)calloc(model->numtriangles + 1, 1);
+    s->pool     = (GLuint*)malloc(sizeof(GLuint) * 3 * (model->numtriangles + 1));
+    memset(s->alive, 1, model->numvertices + 1);
+
+    /* triangles, their planes and the vertex lists */
+    s->numalive = model->numtriangles;
+    for (t = 0; t < model->numtriangles; t++) {
+        for (k = 0; k < 3; k++)
+            s->corners[3 * t + k] = T(t).vindices[k];
+        a = s->corners[3 * t + 0];
+        b = s->corners[3 * t + 1];
+        c = s->corners[3 * t + 2];
+        if (a == b || b == c || a == c) {
+            s->dead[t] = 1;
+            s->numalive--;
+            continue;
+        }
+        for (k = 0; k < 3; k++) {
+            s->counts[s->corners[3 * t + k]]++;
+            for (j = 0; j < 3; j++)
+                p[k][j] = s->positions[3 * s->corners[3 * t + k] + j];
+        }
+        for (j = 0; j < 3; j++) {
+            e1[j] = p[1][j] - p[0][j];
+            e2[j] = p[2][j] - p[0][j];
+        }
+        nrm[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        nrm[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        nrm[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        len = sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+        if (len == 0)
+            continue;
+        /* weigh each plane by the triangle's area */
+        for (j = 0; j < 3; j++)
+            nrm[j] /= len;
+        d = -(nrm[0] * p[0][0] + nrm[1] * p[0][1] + nrm[2] * p[0][2]);
+        for (k = 0; k < 3; k++)
+            glmQuadricPlane(&s->quadrics[s->corners[3 * t + k]], nrm[0], nrm[1], nrm[2], d, len / 2);
+    }
+    n = 0;
+    for (i = 1; i <= model->numvertices; i++) {
+        s->lists[i] = s->pool + n;
+        n += s->counts[i];
+        s->counts[i] = 0;
+    }
+    for (t = 0; t < model->numtriangles; t++)
+        if (!s->dead[t])
+            for (k = 0; k < 3; k++) {
+                i = s->corners[3 * t + k];
+                s->lists[i][s->counts[i]++] = t;
+            }
+
+    /* every edge once; an edge seen only once is on a border */
+    edges = (unsigned long long*)malloc(sizeof(unsigned long long) * 3 * (model->numtriangles + 1));
+    numedges = 0;
+    for (t = 0; t < model->numtriangles; t++) {
+        if (s->dead[t])
+            continue;
+        for (k = 0; k < 3; k++) {
+            a = s->corners[3 * t + k];
+            b = s->corners[3 * t + (k + 1) % 3];
+            edges[numedges++] = a < b ? (unsigned long long)a << 32 | b :
+                                        (unsigned long long)b << 32 | a;
+        }
+    }
+    qsort(edges, numedges, sizeof(unsigned long long), glmCompareEdges);
+    for (i = 0; i < numedges; i = j) {
+        for (j = i + 1; j < numedges && edges[j] == edges[i]; j++)
+            ;
+        a = (GLuint)(edges[i] >> 32);
+        b = (GLuint)(edges[i] & 0xffffffff);
+        if (j - i == 1) {
+            /* a plane through the border, at right angles to the
+            triangle it belongs to */
+            for (k = 0; k < s->counts[a]; k++) {
+                t = s->lists[a][k];
+                if (s->corners[3 * t + 0] == b || s->corners[3 * t + 1] == b ||
+                    s->corners[3 * t + 2] == b)
+                    break;
+            }
+            t = s->lists[a][k];
+            glmTriangleNormal(s, t, (GLuint)-1, NULL, nrm);
+            for (k = 0; k < 3; k++)
+                ex[k] = s->positions[3 * b + k] - s->positions[3 * a + k];
+            bn[0] = ex[1] * nrm[2] - ex[2] * nrm[1];
+            bn[1] = ex[2] * nrm[0] - ex[0] * nrm[2];
+            bn[2] = ex[0] * nrm[1] - ex[1] * nrm[0];
+            len = sqrt(bn[0] * bn[0] + bn[1] * bn[1] + bn[2] * bn[2]);
+            if (len > 0) {
+                for (k = 0; k < 3; k++)
+                    bn[k] /= len;
+                d = -(bn[0] * s->positions[3 * a + 0] + bn[1] * s->positions[3 * a + 1] +
+                      bn[2] * s->positions[3 * a + 2]);
+                len = ex[0] * ex[0] + ex[1] * ex[1] + ex[2] * ex[2];
+                glmQuadricPlane(&s->quadrics[a], bn[0], bn[1], bn[2], d, GLM_BORDER_WEIGHT * len);
+                glmQuadricPlane(&s->quadrics[b], bn[0], bn[1], bn[2], d, GLM_BORDER_WEIGHT * len);
+            }
+        }
+    }
+    for (i = 0; i < numedges; i = j) {
+        for (j = i + 1; j < numedges && edges[j] == edges[i]; j++)
+            ;
+        glmPriceCollapse(s, (GLuint)(edges[i] >> 32), (GLuint)(edges[i] & 0xffffffff));
+    }
+    free(edges);
+}
+
+/* glmSimplifyRun: collapse edges until at most target triangles are left
+ * (or nothing more can be collapsed).
+ */
+static GLvoid glmSimplifyRun(GLMsimplify* s, GLuint target){
+    GLMcollapse c;
+    while (s->numalive > target && s->heapsize) {
+        glmHeapPop(s, &c);
+        if (!s->alive[c.u] || !s->alive[c.v] ||
+            s->stamps[c.u] != c.ustamp || s->stamps[c.v] != c.vstamp)
+            continue;
+        if (glmCollapseFlips(s, c.u, c.u, c.v, c.target) ||
+            glmCollapseFlips(s, c.v, c.u, c.v, c.target))
+            continue;
+        glmCollapse(s, c.u, c.v, c.target);
+    }
+}
+
+/* glmSimplifyFree: release the working state */
+static GLvoid glmSimplifyFree(GLMsimplify* s){
+    GLuint i;
+    for (i = 1; i <= s->numvertices; i++)
+        if (s->owned[i])
+            free(s->lists[i]);
+    free(s->positions);
+    free(s->quadrics);
+    free(s->stamps);
+    free(s->alive);
+    free(s->lists);
+    free(s->counts);
+    free(s->owned);
+    free(s->marks);
+    free(s->corners);
+    free(s->dead);
+    free(s->pool);
+    free(s->heap);
+}
+
+/* glmSimplifyModel: build a model out of what is left of the original */
+static GLMmodel* glmSimplifyModel(GLMsimplify* s){
+    GLMmodel* model = s->model;
+    GLMmodel* simple;
+    GLMgroup* group;
+    GLMgroup* copy;
+    GLMgroup** tail;
+    GLuint*   map;
+    GLuint    i, k, n;
+
+    simple = (GLMmodel*)calloc(1, sizeof(GLMmodel));
+    simple->pathname = strdup(model->pathname);
+    if (model->mtllibname)
+        simple->mtllibname = strdup(model->mtllibname);
+    memcpy(simple->position, model->position, sizeof(GLfloat) * 3);
+
+    /* surviving vertices, renumbered */
+    map = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    n = 0;
+    for (i = 1; i <= model->numvertices; i++)
+        if (s->alive[i] && s->counts[i])
+            map[i] = ++n;
+    simple->numvertices = n;
+    simple->vertices = (GLfloat*)malloc(sizeof(GLfloat) * 3 * (n + 1));
+    memset(simple->vertices, 0, sizeof(GLfloat) * 3);
+    for (i = 1; i <= model->numvertices; i++)
+        if (map[i])
+            for (k = 0; k < 3; k++)
+                simple->vertices[3 * map[i] + k] = s->positions[3 * i + k];
+    if (model->colors) {
+        simple->colors = (GLubyte*)malloc(sizeof(GLubyte) * 4 * (n + 1));
+        memset(simple->colors, 0, sizeof(GLubyte) * 4);
+        for (i = 1; i <= model->numvertices; i++)
+            if (map[i])
+                memcpy(&simple->colors[4 * map[i]], &model->colors[4 * i], sizeof(GLubyte) * 4);
+    }
+
+    /* texcoords are kept as they were at each surviving corner */
+    if (model->texcoords) {
+        simple->numtexcoords = model->numtexcoords;
+        simple->texcoords = (GLfloat*)malloc(sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+        memcpy(simple->texcoords, model->texcoords, sizeof(GLfloat) * 2 * (model->numtexcoords + 1));
+    }
+
+    /* surviving triangles, in their old order */
+    simple->triangles = (GLMtriangle*)malloc(sizeof(GLMtriangle) * (s->numalive + 1));
+    n = 0;
+    for (i = 0; i < model->numtriangles; i++) {
+        if (s->dead[i]) {
+            s->corners[3 * i] = (GLuint)-1;
+            continue;
+        }
+        memset(&simple->triangles[n], 0, sizeof(GLMtriangle));
+        for (k = 0; k < 3; k++) {
+            simple->triangles[n].vindices[k] = map[s->corners[3 * i + k]];
+            if (model->texcoords)
+                simple->triangles[n].tindices[k] = T(i).tindices[k];
+        }
+        simple->triangles[n].visible = true;
+        s->corners[3 * i] = n++;
+    }
+    simple->numtriangles = n;
+    free(map);
+
+    /* the same groups, in the same order, with what's left of them */
+    tail = &simple->groups;
+    for (group = model->groups; group; group = group->next) {
+        copy = (GLMgroup*)malloc(sizeof(GLMgroup));
+        copy->name = strdup(group->name);
+        copy->material = group->material;
+        copy->numtriangles = 0;
+        copy->triangles = (GLuint*)malloc(sizeof(GLuint) * (group->numtriangles + 1));
+        for (i = 0; i < group->numtriangles; i++)
+            if (s->corners[3 * group->triangles[i]] != (GLuint)-1)
+                copy->triangles[copy->numtriangles++] = s->corners[3 * group->triangles[i]];
+        copy->next = NULL;
+        *tail = copy;
+        tail = &copy->next;
+        simple->numgroups++;
+    }
+    return simple;
+}
+
+/* glmSimplify: Simplifies a model by collapsing edges with a quadric
+ * error metric.  Returns a new model, to be glmDelete()'d, with the
+ * same groups and about ratio times the triangles.  Only positions,
+ * vertex colors and texcoords carry over; generate normals with glmFacetNormals() and
+ * glmVertexNormals().  Materials and textures stay with the original
+ * (the groups keep their material index), so draw the simplified
+ * model's mesh with glmDrawMesh(original, mesh, mode).
+ *
+ * model - initialized GLMmodel structure
+ * ratio - fraction of the triangles to keep (0.5 = half)
+ */
+GLMmodel* glmSimplify(GLMmodel* model, GLfloat ratio){
+    GLMsimplify s;
+    GLMmodel*   simple;
+    assert(model);
+    assert(model->vertices);
+    glmSimplifyInit(&s, model);
+    glmSimplifyRun(&s, (GLuint)(ratio * model->numtriangles));
+    simple = glmSimplifyModel(&s);
+    glmSimplifyFree(&s);
+    return simple;
+}
+
+/* GLMpmcollapse: one collapse of a progressive mesh build, as it was
+ * logged before it happened */
+typedef struct _GLMpmcollapse {
+    GLuint  u, v;                 /* v was merged into u */
+    GLfloat upos[3], vpos[3];     /* where they were */
+    GLuint  firstkilled;          /* triangles it removed, in killed[] */
+    GLuint  firstmoved;           /* corners it moved from v to u, in moved[] */
+} GLMpmcollapse;
+
+/* GLMpmlog: the collapses of a progressive mesh build */
+typedef struct _GLMpmlog {
+    GLuint         numcollapses, maxcollapses;
+    GLMpmcollapse* collapses;
+    GLuint         numkilled, maxkilled;
+    GLuint*        killed;        /* triangle, then its three vertices */
+    GLuint         nummoved, maxmoved;
+    GLuint*        moved;         /* 3 * triangle + corner */
+} GLMpmlog;
+
+/* glmLogGrow: make sure a log array has room for count more elements */
+static GLvoid* glmLogGrow(GLvoid* array, GLuint* capacity, GLuint count, size_t size){
+    if (count <= *capacity)
+        return array;
+    while (*capacity < count)
+        *capacity = *capacity ? *capacity * 2 : 1024;
+    return realloc(array, size * *capacity);
+}
+
+/* glmLogCollapse: glmCollapse() hook that logs what merging v into u
+ * is about to remove and rewire */
+static GLvoid glmLogCollapse(GLMsimplify* s, GLuint u, GLuint v){
+    GLMpmlog* log = (GLMpmlog*)s->data;
+    GLMpmcollapse* c;
+    GLuint i, k, t;
+    log->collapses = (GLMpmcollapse*)glmLogGrow(log->collapses, &log->maxcollapses,
+                                                log->numcollapses + 1, sizeof(GLMpmcollapse));
+    c = &log->collapses[log->numcollapses++];
+    c->u = u;
+    c->v = v;
+    for (k = 0; k < 3; k++) {
+        c->upos[k] = s->positions[3 * u + k];
+        c->vpos[k] = s->positions[3 * v + k];
+    }
+    c->firstkilled = log->numkilled;
+    c->firstmoved = log->nummoved;
+    for (i = 0; i < s->counts[v]; i++) {
+        t = s->lists[v][i];
+        if (s->dead[t])
+            continue;
+        if (s->corners[3 * t + 0] == u || s->corners[3 * t + 1] == u || s->corners[3 * t + 2] == u) {
+            log->killed = (GLuint*)glmLogGrow(log->killed, &log->maxkilled,
+                                              4 * (log->numkilled + 1), sizeof(GLuint));
+            log->killed[4 * log->numkilled + 0] = t;
+            for (k = 0; k < 3; k++)
+                log->killed[4 * log->numkilled + 1 + k] = s->corners[3 * t + k];
+            log->numkilled++;
+            continue;
+        }
+        for (k = 0; k < 3; k++) {
+            if (s->corners[3 * t + k] != v)
+                continue;
+            log->moved = (GLuint*)glmLogGrow(log->moved, &log->maxmoved,
+                                             log->nummoved + 1, sizeof(GLuint));
+            log->moved[log->nummoved++] = 3 * t + k;
+        }
+    }
+}
+
+/* glmProgressiveNormals: area weighted vertex normals of the full model,
+ * one per vertex, renumbered through map */
+static GLvoid glmProgressiveNormals(GLMmodel* model, GLuint* map, GLfloat* normals){
+    GLfloat* p[3];
+    GLfloat  a[3], b[3], n[3], len;
+    GLuint   i, j, k;
+    for (i = 0; i < model->numtriangles; i++) {
+        for (k = 0; k < 3; k++)
+            p[k] = &model->vertices[3 * T(i).vindices[k]];
+        for (k = 0; k < 3; k++) {
+            a[k] = p[1][k] - p[0][k];
+            b[k] = p[2][k] - p[0][k];
+        }
+        n[0] = a[1] * b[2] - a[2] * b[1];
+        n[1] = a[2] * b[0] - a[0] * b[2];
+        n[2] = a[0] * b[1] - a[1] * b[0];
+        for (k = 0; k < 3; k++) {
+            j = map[T(i).vindices[k]];
+            if (!j)
+                continue;
+            normals[3 * j + 0] += n[0];
+            normals[3 * j + 1] += n[1];
+            normals[3 * j + 2] += n[2];
+        }
+    }
+    for (i = 1; i < model->numvertices + 1; i++) {
+        j = map[i];
+        if (!j)
+            continue;
+        len = sqrt(normals[3 * j] * normals[3 * j] + normals[3 * j + 1] * normals[3 * j + 1] +
+                   normals[3 * j + 2] * normals[3 * j + 2]);
+        if (len > 0)
+            for (k = 0; k < 3; k++)
+                normals[3 * j + k] /= len;
+    }
+}
+
+/* glmProgressive: Builds a progressive mesh of a model: a base mesh
+ * with about ratio times the triangles, and the vertex splits that
+ * refine it back into the model.  Only positions carry over, plus one
+ * normal per vertex taken from the full model; groups, materials and
+ * texcoords are dropped.  Free it with glmDeleteProgressive().
+ *
+ * model - initialized GLMmodel structure
+ * ratio - fraction of the triangles in the base mesh (0.01 = 1%)
+ */
+GLMprogressive* glmProgressive(GLMmodel* model, GLfloat ratio){
+    GLMsimplify     s;
+    GLMpmlog        log;
+    GLMpmcollapse*  c;
+    GLMvsplit*      split;
+    GLMprogressive* pm;
+    GLubyte*        used;
+    GLuint*         vmap;
+    GLuint*         tmap;
+    GLuint          i, j, k, t, n, numkilled, nummoved;
+    assert(model);
+    assert(model->vertices);
+
+    glmSimplifyInit(&s, model);
+    used = (GLubyte*)malloc(model->numvertices + 1);
+    for (i = 0; i <= model->numvertices; i++)
+        used[i] = s.counts[i] > 0;
+    memset(&log, 0, sizeof(GLMpmlog));
+    s.record = glmLogCollapse;
+    s.data = &log;
+    glmSimplifyRun(&s, (GLuint)(ratio * model->numtriangles));
+
+    pm = (GLMprogressive*)calloc(1, sizeof(GLMprogressive));
+    pm->numsplits = log.numcollapses;
+    pm->numloaded = log.numcollapses;
+    pm->numcorners = log.nummoved;
+    pm->loadedcorners = log.nummoved;
+
+    /* the base mesh's vertices first, then one per split in the
+       reverse order of the collapses */
+    vmap = (GLuint*)calloc(model->numvertices + 1, sizeof(GLuint));
+    n = 0;
+    for (i = 1; i <= model->numvertices; i++)
+        if (s.alive[i] && used[i])
+            vmap[i] = ++n;
+    pm->basevertices = n;
+    for (i = log.numcollapses; i > 0; i--)
+        vmap[log.collapses[i - 1].v] = ++n;
+    pm->numvertices = n;
+
+    /* the same for the triangles: those that survived, then the ones
+       every split brings back */
+    tmap = (GLuint*)malloc(sizeof(GLuint) * (model->numtriangles + 1));
+    n = 0;
+    for (t = 0; t < model->numtriangles; t++)
+        if (!s.dead[t])
+            tmap[t] = n++;
+    pm->basetriangles = n;
+    for (i = log.numcollapses; i > 0; i--) {
+        c = &log.collapses[i - 1];
+        numkilled = (i < log.numcollapses ? log.collapses[i].firstkilled : log.numkilled) - c->firstkilled;
+        for (j = 0; j < numkilled; j++)
+            tmap[log.killed[4 * (c->firstkilled + j)]] = n++;
+    }
+    pm->numtriangles = n;
+    pm->loadedtriangles = n;
+
+    pm->vertices = (GLfloat*)calloc(3 * (pm->numvertices + 1), sizeof(GLfloat));
+    pm->normals = (GLfloat*)calloc(3 * (pm->numvertices + 1), sizeof(GLfloat));
+    pm->indices = (GLuint*)malloc(sizeof(GLuint) * 3 * (pm->numtriangles + 1));
+    pm->splits = (GLMvsplit*)malloc(sizeof(GLMvsplit) * (pm->numsplits + 1));
+    pm->corners = (GLuint*)malloc(sizeof(GLuint) * (pm->numcorners + 1));
+    for (i = 1; i <= model->numvertices; i++)
+        if (vmap[i] && vmap[i] <= pm->basevertices)
+            for (k = 0; k < 3; k++)
+                pm->vertices[3 * vmap[i] + k] = s.positions[3 * i + k];
+    for (t = 0; t < model->numtriangles; t++)
+        if (!s.dead[t])
+            for (k = 0; k < 3; k++)
+                pm->indices[3 * tmap[t] + k] = vmap[s.corners[3 * t + k]];
+    glmProgressiveNormals(model, vmap, pm->normals);
+
+    /* the splits undo the collapses last to first */
+    n = 0;
+    for (i = log.numcollapses; i > 0; i--) {
+        c = &log.collapses[i - 1];
+        split = &pm->splits[log.numcollapses - i];
+        numkilled = (i < log.numcollapses ? log.collapses[i].firstkilled : log.numkilled) - c->firstkilled;
+        nummoved = (i < log.numcollapses ? log.collapses[i].firstmoved : log.nummoved) - c->firstmoved;
+        split->vertex = vmap[c->u];
+        memcpy(split->position, c->upos, sizeof(GLfloat) * 3);
+        split->numtriangles = numkilled;
+        split->numcorners = nummoved;
+        memcpy(&pm->vertices[3 * vmap[c->v]], c->vpos, sizeof(GLfloat) * 3);
+        for (j = 0; j < numkilled; j++) {
+            t = log.killed[4 * (c->firstkilled + j)];
+            for (k = 0; k < 3; k++)
+                pm->indices[3 * tmap[t] + k] = vmap[log.killed[4 * (c->firstkilled + j) + 1 + k]];
+        }
+        for (j = 0; j < nummoved; j++) {
+            t = log.moved[c->firstmoved + j];
+            pm->corners[n++] = 3 * tmap[t / 3] + t % 3;
+        }
+    }
+
+    free(vmap);
+    free(tmap);
+    free(used);
+    free(log.collapses);
+    free(log.killed);
+    free(log.moved);
+    glmSimplifyFree(&s);
+    return pm;
+}
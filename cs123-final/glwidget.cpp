@@ -15,6 +15,7 @@
 #include <QFile>
 
 #include "particleemitter.h"
+#include "textureloader.h"
 
 GLWidget::GLWidget(QWidget *parent) :
     QGLWidget(QGLFormat(QGL::DoubleBuffer), parent) {
@@ -60,6 +61,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event) {
 
 void GLWidget::mousePressEvent(QMouseEvent *event) {
     mouse_pos_prev_.x = event->x(), mouse_pos_prev_.y = event->y();
+    draw_engine_->mouse_click_event(mouse_pos_prev_, width(), height());
 }
 
 void GLWidget::wheelEvent(QWheelEvent *event) {
@@ -92,7 +94,30 @@ void GLWidget::render_text() {
        prev_fps_ += draw_engine_->fps() * 0.05;
 
     } this->renderText(10.0, 20.0, "FPS: " + QString::number((int)(prev_fps_)), f);
-    this->renderText(10.0, 35.0, "S: Save screenshot", f);
+    if (draw_engine_->paged())
+        this->renderText(10.0, 35.0, "Bricks: " + QString::number(draw_engine_->bricks_drawn()) + " drawn, " +
+                         QString::number(draw_engine_->bricks_paged_in()) + " paged in", f);
+    else
+        this->renderText(10.0, 35.0, "Meshlets: " + QString::number(draw_engine_->meshlets_drawn()) + " drawn, " +
+                         QString::number(draw_engine_->meshlets_culled()) + " culled", f);
+    this->renderText(10.0, 50.0, "S: Save screenshot", f);
+    this->renderText(10.0, 65.0, QString("C: Turn meshlet culling ") +
+                     (draw_engine_->cull_meshlets() ? "off" : "on"), f);
+    this->renderText(10.0, 80.0, "N: Stress test (" + QString::number(draw_engine_->stress_dragons()) + " dragons)", f);
+    this->renderText(10.0, 95.0, QString("I: Draw them ") +
+                     (draw_engine_->stress_instanced() ? "one call each" : "instanced"), f);
+    if (draw_engine_->deforming())
+        this->renderText(10.0, 110.0, "W: Stop wobbling (" + QString::number(draw_engine_->deform_moved()) +
+                         " vertices moved, " + QString::number(draw_engine_->deform_normals()) + " normals in " +
+                         QString::number(draw_engine_->deform_time(), 'f', 2) + " ms)", f);
+    else
+        this->renderText(10.0, 110.0, "W: Wobble the dragon", f);
+    if (draw_engine_->picked_triangle() >= 0)
+        this->renderText(10.0, 125.0, "Picked triangle " + QString::number(draw_engine_->picked_triangle()) + " in " +
+                         QString::number(draw_engine_->pick_time(), 'f', 1) + " us", f);
+    if (draw_engine_->loading())
+        this->renderText(10.0, 140.0, ModelLoader::status() + " " +
+                         QString::number(ModelLoader::progress()) + "%", f);
 }
 
 /**
@@ -102,10 +127,18 @@ void GLWidget::render_text() {
   @TODO: Finish filling this in!
   **/
 GLuint GLWidget::loadTexture(const QFile &file) {
-    QImage image, texture;
     if(!file.exists()) return -1;
-    image.load(file.fileName());
-    texture = QGLWidget::convertToGLFormat(image);
+    TextureLoader loader;
+    GLuint textureID = loadTexture(loader, loader.add(file.fileName()));
+    loader.report();
+    return textureID;
+}
+
+/**
+  Makes a texture of an image the loader is decoding, once it is ready, so
+  that several can decode at once.
+  **/
+GLuint GLWidget::loadTexture(TextureLoader &loader, int index) {
     GLuint textureID;
     //Put your code here
 
@@ -115,7 +148,7 @@ GLuint GLWidget::loadTexture(const QFile &file) {
 
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, 3, texture.width(), texture.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE, texture.bits());
+    loader.upload(index, GL_TEXTURE_2D);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
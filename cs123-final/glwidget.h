@@ -9,6 +9,7 @@ class QTime;
 
 class QFile;
 class ParticleEmitter;
+class TextureLoader;
 
 class GLWidget : public QGLWidget {
     Q_OBJECT
@@ -16,6 +17,7 @@ public:
     GLWidget(QWidget *parent = 0);
     ~GLWidget();
     static GLuint loadTexture(const QFile &file);
+    static GLuint loadTexture(TextureLoader &loader, int index);
 protected:
     void initializeGL();
     void paintGL();
@@ -2,11 +2,22 @@
 #include <iostream>
 #include <qgl.h>
 #include <pty.h>
+#include <stdlib.h>
+#include <string.h>
 #include "mainwindow.h"
+#include "benchmark.h"
+#include "glm.h"
 using std::cout;
 using std::endl;
 
+/// most triangles per brick when a model is cut into bricks with --brick
+static const GLuint brick_triangles = 65536;
+
 int main(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "--bench"))
+        return run_benchmarks(argc - 2, argv + 2);
+    if (argc > 2 && !strcmp(argv[1], "--brick"))
+        return glmBrickOBJ(argv[2], argc > 3 ? atoi(argv[3]) : brick_triangles, NULL) ? 0 : 1;
     QApplication a(argc, argv);
     cout << "cs123 final project" << endl;
     MainWindow w;
@@ -0,0 +1,124 @@
+/**
+  Loads models off the drawing thread.
+**/
+
+#include "modelloader.h"
+#include <QMutex>
+#include <QMutexLocker>
+
+/// the glm progress callback has no user data, so the progress of the load
+/// that is running lives here
+static QMutex progress_mutex;
+static int progress_percent = 0;
+static QString progress_status;
+
+/// fraction of the triangles in the base mesh of the progressive mesh, and how
+/// many of its splits are read at a time
+static const float progressive_base = .01f;
+static const GLuint stream_batch = 4096;
+
+ModelLoader::ModelLoader(const QString &path, GLuint flags, const float *lod_ratios, int num_lods)
+    : model(NULL), num_lods(num_lods < MAX_LODS ? num_lods : MAX_LODS), bvh(NULL), path_(path.toLocal8Bit()), flags_(flags),
+      progressive_(NULL) {
+    for (int i = 0; i < MAX_LODS; ++i) {
+        lods[i] = NULL;
+        lod_ratios_[i] = i < this->num_lods ? lod_ratios[i] : 0.f;
+    }
+    report(0, (char *)"Waiting...");
+}
+
+/**
+  @paragraph Waits for the thread and frees whatever models weren't taken.
+**/
+ModelLoader::~ModelLoader() {
+    wait();
+    if (progressive_)
+        glmDeleteProgressive(progressive_);
+    if (model)
+        glmDelete(model);
+    for (int i = 0; i < MAX_LODS; ++i)
+        if (lods[i])
+            glmDelete(lods[i]);
+    if (bvh)
+        glmDeleteBVH(bvh);
+}
+
+int ModelLoader::progress() {
+    QMutexLocker locker(&progress_mutex);
+    return progress_percent;
+}
+
+QString ModelLoader::status() {
+    QMutexLocker locker(&progress_mutex);
+    return progress_status;
+}
+
+GLMprogressive *ModelLoader::take_progressive() {
+    QMutexLocker locker(&progress_mutex);
+    GLMprogressive *progressive = progressive_;
+    progressive_ = NULL;
+    return progressive;
+}
+
+/**
+  @paragraph Called by glm as the model is read (and by run() afterwards).
+
+  @param percent: how far along the load is (0-100)
+  @param text:    what it is doing
+**/
+void ModelLoader::report(int percent, char *text) {
+    QMutexLocker locker(&progress_mutex);
+    progress_percent = percent;
+    progress_status = QString::fromLocal8Bit(text).simplified();
+}
+
+/**
+  @paragraph Streams the progressive mesh if there is one, reads the model (80%
+  of the progress), simplifies it into its levels of detail and builds its BVH
+  (the rest).
+**/
+void ModelLoader::run() {
+    GLMprogressive *progressive = glmReadProgressive(path_.data());
+    if (progressive) {
+        progress_mutex.lock();
+        progressive_ = progressive;
+        progress_mutex.unlock();
+        report(0, (char *)"Streaming...");
+        while (glmStreamProgressive(progressive, stream_batch))
+            ;
+    }
+
+    mycallback call;
+    call.loadcallback = &ModelLoader::report;
+    call.start = 0;
+    call.end = 80;
+    call.text = (char *)"Loading models";
+    if (path_.toLower().endsWith(".ply"))
+        model = glmReadPLY(path_.data(), &call);
+    else
+        model = glmReadOBJCached(path_.data(), 0, flags_ | GLM_DEFER_TEXTURES, &call);
+    if (!model) {
+        report(100, (char *)"Failed to load model");
+        return;
+    }
+    glmUnitize(model);
+    for (int i = 0; i < num_lods; ++i) {
+        report(80 + 10 * i / num_lods, (char *)"Simplifying...");
+        lods[i] = glmSimplify(model, lod_ratios_[i]);
+        glmFacetNormals(lods[i]);
+        glmVertexNormals(lods[i], 90.f);
+        if (flags_ & GLM_MESHLETS)
+            glmMeshletOrder(lods[i], GLM_MESHLET_SIZE);
+        else if (flags_ & GLM_VERTEX_CACHE)
+            glmVertexCache(lods[i]);
+    }
+    report(90, (char *)"Building BVH...");
+    bvh = glmBVH(model);
+    if (!progressive) {
+        report(95, (char *)"Building progressive mesh...");
+        GLMprogressive *built = glmProgressive(model, progressive_base);
+        glmWriteProgressive(built, path_.data());
+        glmDeleteProgressive(built);
+    }
+    report(100, (char *)"Done");
+}
@@ -0,0 +1,54 @@
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+
+#include <QThread>
+#include <QString>
+#include <QByteArray>
+#include <qgl.h>
+#include "glm.h"
+
+#define MAX_LODS 4
+
+/**
+  Reads a model on a thread of its own so the window can draw (and take input)
+  while it loads.  Everything that doesn't need the OpenGL context happens here:
+  parsing (or mapping the .glmc cache), unitizing, simplifying into levels of
+  detail, and building a BVH for picking.  Once isFinished() the drawing thread takes the models and builds the
+  GL side (textures, meshes) itself.
+
+  If an earlier run left a progressive mesh next to the model, that is streamed
+  in first: take_progressive() hands it over as soon as its base mesh is in, and
+  the drawing thread refines it as the rest of it arrives.  Otherwise one is
+  built (and written) once the model is loaded, for next time.
+**/
+class ModelLoader : public QThread {
+public:
+    ModelLoader(const QString &path, GLuint flags, const float *lod_ratios, int num_lods);
+    ~ModelLoader();
+
+    //progress of the load (0-100) and what it's doing, safe to call from any thread
+    static int progress();
+    static QString status();
+
+    //the progressive mesh being streamed in, once its base mesh is read (NULL
+    //before that, or if there is none); the caller owns it but must not delete it
+    //before the thread has finished
+    GLMprogressive *take_progressive();
+
+    //results, valid once the thread has finished; whoever takes them sets them to NULL
+    GLMmodel *model; ///the model, unitized, textures not loaded yet (NULL if it couldn't be read)
+    GLMmodel *lods[MAX_LODS]; ///its levels of detail, with normals
+    int num_lods;
+    GLMbvh *bvh; ///BVH over the model's triangles, for picking
+
+protected:
+    void run();
+    static void report(int percent, char *text);
+
+    QByteArray path_;
+    GLuint flags_;
+    float lod_ratios_[MAX_LODS];
+    GLMprogressive *progressive_;
+};
+
+#endif // MODELLOADER_H
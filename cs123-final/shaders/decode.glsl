@@ -0,0 +1,41 @@
+// put in front of the vertex shaders by DrawEngine::add_vertex_shader: the
+// vertex position, normal and texcoord, from glmMesh(GLM_QUANTIZE) buffers
+// if QUANTIZED is defined (shorts spanning the mesh bounds, an octahedral
+// normal and half float texcoords, see glmMesh()), else from the fixed
+// function arrays
+#ifdef QUANTIZED
+attribute vec3 position;
+attribute vec2 octahedral;
+attribute vec2 texcoord;
+uniform vec3 decode_scale, decode_bias;
+vec4 vertex()
+{
+	return vec4(position * decode_scale + decode_bias, 1.0);
+}
+vec3 vertex_normal()
+{
+	vec2 e = octahedral / 32767.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.x += n.x >= 0.0 ? -t : t;
+	n.y += n.y >= 0.0 ? -t : t;
+	return normalize(n);
+}
+vec4 vertex_texcoord()
+{
+	return vec4(texcoord, 0.0, 1.0);
+}
+#else
+vec4 vertex()
+{
+	return gl_Vertex;
+}
+vec3 vertex_normal()
+{
+	return gl_Normal;
+}
+vec4 vertex_texcoord()
+{
+	return gl_MultiTexCoord0;
+}
+#endif
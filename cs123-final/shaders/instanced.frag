@@ -0,0 +1,11 @@
+uniform sampler2D Texture;
+uniform bool textured;
+varying vec4 tint;
+
+void main (void)
+{
+	if (textured)
+		gl_FragColor = tint * texture2D(Texture, gl_TexCoord[0].st);
+	else
+		gl_FragColor = tint;
+}
@@ -0,0 +1,10 @@
+// one instance of a mesh per offset/color pair, for glmDrawMeshInstanced()
+attribute vec4 offset; // position (xyz) and scale (w) of the instance
+attribute vec4 color;
+varying vec4 tint;
+void main()
+{
+	gl_Position = gl_ModelViewProjectionMatrix * vec4(vertex().xyz * offset.w + offset.xyz, 1.0);
+	gl_TexCoord[0] = vertex_texcoord();
+	tint = color;
+}
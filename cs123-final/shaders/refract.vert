@@ -2,12 +2,12 @@ varying vec3 normal, lightDir, r;
 const vec3 L = vec3(0.,0.,1.);
 void main()
 {	
-	gl_Position = ftransform();		
-	vec3 vVertex = vec3(gl_ModelViewMatrix * gl_Vertex);
+	gl_Position = gl_ModelViewProjectionMatrix * vertex();
+	vec3 vVertex = vec3(gl_ModelViewMatrix * vertex());
 	lightDir = vec3(L - vVertex);
 	vec4 eyeVec = gl_ProjectionMatrixInverse*vec4(0,0,-1,0);
 	
-	normal = normalize( gl_NormalMatrix * gl_Normal );
+	normal = normalize( gl_NormalMatrix * vertex_normal() );
 	vec3 I = normalize(vVertex - eyeVec.xyz); // Eye to vertex
   	r = refract(I,normal, 0.9);
 }
@@ -4,8 +4,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "targa.h"
 
+#if defined(__GNUC__) && defined(__SSE2__)
+#define TGA_SSE
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#endif // __GNUC__ && __SSE2__
+
 
 // define targa private constants
 
@@ -30,9 +40,16 @@
 static int handleTargaError(FILE *fh, int errorCode, const char *function,
 			    size_t line);
 
-static int ctoi(char value);
+static int readHeader(Targa *targa, unsigned char *data, int dataLength);
+
+static void swizzle32(unsigned char *src, unsigned char *dst, int count);
+
+static void swizzle24(unsigned char *src, unsigned char *dst, int count);
+
+static void fillPixel(unsigned char *dst, int count, unsigned char *rgba);
 
-static char *localStrndup(char *string, int length);
+static int decodeImage(Targa *targa, unsigned char *data, int dataLength,
+		       int offset, unsigned char *image);
 
 
 // define targa private macros
@@ -62,30 +79,356 @@ handleTargaError(fh, rc, __FUNCTION__, __LINE__)
     return -1;
 }
 
-static int ctoi(char value)
+static int readHeader(Targa *targa, unsigned char *data, int dataLength)
 {
-    return (int)((unsigned char)value);
+    short sNumber = 0;
+    int imageIdLength = 0;
+    int colorMap = 0;
+    int imageType = 0;
+    int bitLength = 0;
+    unsigned char *ptr = NULL;
+
+    ptr = data;
+
+    // determine image ID length
+
+    imageIdLength = (int)ptr[0];
+    ptr++;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+
+    // check for color map
+
+    colorMap = (int)ptr[0];
+    ptr++;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+    if(colorMap != TGA_COLOR_MAP_NONE) {
+        fprintf(stderr, "[%s():%i] error - unable to read TARGA color map "
+                "%i.\n", __FUNCTION__, __LINE__, colorMap);
+        return -1;
+    }
+
+    // obtain image type
+
+    imageType = (int)ptr[0];
+    ptr++;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+    if((imageType == TGA_IMAGE_TYPE_NONE) ||
+       (imageType == TGA_IMAGE_TYPE_CM) ||
+       (imageType == TGA_IMAGE_TYPE_RLE_CM)) {
+        fprintf(stderr, "[%s():%i] error - unsupported image type %i.\n",
+                __FUNCTION__, __LINE__, imageType);
+        return -1;
+    }
+
+    // skip 9 bytes (color-map information and x & y origins)
+
+    ptr += 9;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+
+    // obtain image width
+
+    memcpy((char *)&sNumber, ptr, sizeof(short));
+    ptr += sizeof(short);
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+    if(sNumber < 1) {
+        fprintf(stderr, "[%s():%i] error - invalid image width %i.\n",
+                __FUNCTION__, __LINE__, (int)sNumber);
+        return -1;
+    }
+
+    targa->width = (int)sNumber;
+
+    // obtain image height
+
+    memcpy((char *)&sNumber, ptr, sizeof(short));
+    ptr += sizeof(short);
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+    if(sNumber < 1) {
+        fprintf(stderr, "[%s():%i] error - invalid image height %i.\n",
+                __FUNCTION__, __LINE__, (int)sNumber);
+        return -1;
+    }
+
+    targa->height = (int)sNumber;
+
+    // determine pixel depth
+
+    bitLength = (int)ptr[0];
+    ptr++;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+    if((bitLength != 16) && (bitLength != 24) && (bitLength != 32)) {
+        fprintf(stderr, "[%s():%i] error - unknown pixel depth of %i-bits.\n",
+                __FUNCTION__, __LINE__, bitLength);
+        return -1;
+    }
+    if((bitLength == 16) &&
+       ((imageType != TGA_IMAGE_TYPE_BGR) &&
+        (imageType != TGA_IMAGE_TYPE_BW))) {
+        fprintf(stderr, "[%s():%i] error - unable to RLE-decode pixel depth "
+                "of %i-bits.\n", __FUNCTION__, __LINE__, bitLength);
+        return -1;
+    }
+
+    // skip 1 byte (image descriptor)
+
+    ptr++;
+    if((int)(ptr - data) > dataLength) {
+        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
+                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
+                dataLength);
+        return -1;
+    }
+
+    // skip the image ID
+
+    if(imageIdLength > 0) {
+        if(((int)(ptr - data) + imageIdLength) > dataLength) {
+            fprintf(stderr, "[%s():%i] error - detected data overrun at %i "
+                    "(image ID) by %i bytes.\n", __FUNCTION__, __LINE__,
+                    (int)(ptr - data),
+                    (((int)(ptr - data) + imageIdLength) - dataLength));
+            return -1;
+        }
+        ptr += imageIdLength;
+    }
+
+    targa->imageType = imageType;
+    targa->bitLength = bitLength;
+    targa->imageLength = (targa->width * targa->height * 4);
+
+    return (int)(ptr - data);
 }
 
-static char *localStrndup(char *string, int length)
+static void swizzle32(unsigned char *src, unsigned char *dst, int count)
 {
-    char *result = NULL;
+    int ii = 0;
 
-    if((string == NULL) || (length < 1)) {
-        fprintf(stderr, "[%s():%i] error - invalid or missing argument(s).\n",
-                __FUNCTION__, __LINE__);
-        return NULL;
+#if defined(TGA_SSE)
+    // swap the B and R bytes of four pixels at a time
+
+    __m128i ga = _mm_set1_epi32((int)0xff00ff00);
+    __m128i px, br;
+
+    for(; (ii + 4) <= count; ii += 4) {
+        px = _mm_loadu_si128((__m128i *)(src + (ii * 4)));
+        br = _mm_andnot_si128(ga, px);
+        br = _mm_or_si128(_mm_slli_epi32(br, 16), _mm_srli_epi32(br, 16));
+        _mm_storeu_si128((__m128i *)(dst + (ii * 4)),
+                         _mm_or_si128(_mm_and_si128(px, ga), br));
+    }
+    src += (ii * 4);
+    dst += (ii * 4);
+#endif // TGA_SSE
+
+    for(; ii < count; ii++, src += 4, dst += 4) {
+        dst[TGA_R] = src[2];
+        dst[TGA_G] = src[1];
+        dst[TGA_B] = src[0];
+        dst[TGA_A] = src[3];
+    }
+}
+
+#if defined(TGA_SSE)
+__attribute__((target("ssse3")))
+static int swizzle24Ssse3(unsigned char *src, unsigned char *dst, int count)
+{
+    int ii = 0;
+    __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1,
+                                    8, 7, 6, -1, 11, 10, 9, -1);
+    __m128i alpha = _mm_set1_epi32((int)0xff000000);
+    __m128i px;
+
+    // each load reads 16 bytes for 4 pixels, so stop short of the end
+
+    for(; (ii + 6) <= count; ii += 4) {
+        px = _mm_loadu_si128((__m128i *)(src + (ii * 3)));
+        px = _mm_or_si128(_mm_shuffle_epi8(px, shuffle), alpha);
+        _mm_storeu_si128((__m128i *)(dst + (ii * 4)), px);
+    }
+
+    return ii;
+}
+#endif // TGA_SSE
+
+static void swizzle24(unsigned char *src, unsigned char *dst, int count)
+{
+    int ii = 0;
+
+#if defined(TGA_SSE)
+    // initialized once, under the compiler's guard, so decoders on
+    // several threads can't race on it
+
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+
+    if(ssse3) {
+        ii = swizzle24Ssse3(src, dst, count);
+        src += (ii * 3);
+        dst += (ii * 4);
+    }
+#endif // TGA_SSE
+
+    for(; ii < count; ii++, src += 3, dst += 4) {
+        dst[TGA_R] = src[2];
+        dst[TGA_G] = src[1];
+        dst[TGA_B] = src[0];
+        dst[TGA_A] = 255;
+    }
+}
+
+static void fillPixel(unsigned char *dst, int count, unsigned char *rgba)
+{
+    int ii = 0;
+    unsigned int pixel = 0;
+
+    memcpy(&pixel, rgba, sizeof(pixel));
+
+#if defined(TGA_SSE)
+    __m128i px = _mm_set1_epi32((int)pixel);
+
+    for(; (ii + 4) <= count; ii += 4) {
+        _mm_storeu_si128((__m128i *)(dst + (ii * 4)), px);
+    }
+#endif // TGA_SSE
+
+    for(; ii < count; ii++) {
+        memcpy((dst + (ii * 4)), &pixel, sizeof(pixel));
+    }
+}
+
+static int decodeImage(Targa *targa, unsigned char *data, int dataLength,
+		       int offset, unsigned char *image)
+{
+    short sNumber = 0;
+    int ii = 0;
+    int count = 0;
+    int colorMode = 0;
+    int length = 0;
+    int rleId = 0;
+    unsigned char pixel[4];
+    unsigned char *ptr = (data + offset);
+    unsigned char *end = (data + dataLength);
+
+    length = (targa->width * targa->height);
+
+    if((targa->imageType == TGA_IMAGE_TYPE_BGR) ||
+       (targa->imageType == TGA_IMAGE_TYPE_BW)) {
+        if(targa->bitLength == 16) {
+            colorMode = 2;
+        }
+        else {
+            colorMode = (targa->bitLength / 8);
+        }
+        if(((int)(ptr - data) + (length * colorMode)) > dataLength) {
+            fprintf(stderr, "[%s():%i] error - detected data overrun at %i "
+                    "(image pixels) by %i bytes.\n", __FUNCTION__, __LINE__,
+                    (int)(ptr - data),
+                    (((int)(ptr - data) + (length * colorMode)) - dataLength));
+            return -1;
+        }
+        if(colorMode == 4) {
+            swizzle32(ptr, image, length);
+        }
+        else if(colorMode == 3) {
+            swizzle24(ptr, image, length);
+        }
+        else {
+            for(ii = 0; ii < length; ii++, ptr += 2, image += 4) {
+                memcpy((char *)&sNumber, ptr, sizeof(short));
+                image[TGA_R] = (unsigned char)((sNumber & 0x1f) << 3);
+                image[TGA_G] = (unsigned char)(((sNumber >> 5) & 0x1f) << 3);
+                image[TGA_B] = (unsigned char)(((sNumber >> 10) & 0x1f) << 3);
+                image[TGA_A] = 255;
+            }
+        }
+        return 0;
     }
 
-#if defined(_GNU_SOURCE)
-    result = strndup(string, length);
-#else // !_GNU_SOURCE
-    result = (char *)malloc(sizeof(char) * (length + 1));
-    memset(result, 0, (sizeof(char) * (length + 1)));
-    memcpy(result, string, length);
-#endif // _GNU_SOURCE
+    // RLE image: raw packets are swizzled in bulk, repeated ones filled
+
+    colorMode = (targa->bitLength / 8);
+    while(ii < length) {
+        if(ptr >= end) {
+            fprintf(stderr, "[%s():%i] error - detected data overrun with "
+                    "%i vs %i.\n", __FUNCTION__, __LINE__,
+                    (int)(ptr - data), dataLength);
+            return -1;
+        }
+        rleId = (int)ptr[0];
+        ptr++;
+
+        count = ((rleId & 0x7f) + 1);
+        if(count > (length - ii)) {
+            count = (length - ii);
+        }
+
+        if(rleId < 128) {
+            if((ptr + (count * colorMode)) > end) {
+                fprintf(stderr, "[%s():%i] error - detected data overrun "
+                        "with %i vs %i.\n", __FUNCTION__, __LINE__,
+                        (int)(ptr - data) + (count * colorMode), dataLength);
+                return -1;
+            }
+            if(colorMode == 4) {
+                swizzle32(ptr, (image + (ii * 4)), count);
+            }
+            else {
+                swizzle24(ptr, (image + (ii * 4)), count);
+            }
+            ptr += (count * colorMode);
+        }
+        else {
+            if((ptr + colorMode) > end) {
+                fprintf(stderr, "[%s():%i] error - detected data overrun "
+                        "with %i vs %i.\n", __FUNCTION__, __LINE__,
+                        (int)(ptr - data) + colorMode, dataLength);
+                return -1;
+            }
+            pixel[TGA_R] = ptr[2];
+            pixel[TGA_G] = ptr[1];
+            pixel[TGA_B] = ptr[0];
+            pixel[TGA_A] = ((colorMode == 3) ? 255 : ptr[3]);
+            fillPixel((image + (ii * 4)), count, pixel);
+            ptr += colorMode;
+        }
+        ii += count;
+    }
 
-    return result;
+    return 0;
 }
 
 
@@ -105,6 +448,8 @@ int targa_init(Targa *targa)
     targa->height = 0;
     targa->imageLength = 0;
     targa->image = NULL;
+    targa->mapping = NULL;
+    targa->mappingLength = 0;
 
     return 0;
 }
@@ -121,6 +466,10 @@ int targa_free(Targa *targa)
         free(targa->image);
     }
 
+    if(targa->mapping != NULL) {
+        munmap(targa->mapping, targa->mappingLength);
+    }
+
     memset((void *)targa, 0, sizeof(Targa));
 
     return 0;
@@ -224,19 +573,7 @@ int targa_loadFromFile(Targa *targa, char *filename)
 
 int targa_loadFromData(Targa *targa, unsigned char *data, int dataLength)
 {
-    short sNumber = 0;
-    int ii = 0;
-    int nn = 0;
-    int imageIdLength = 0;
-    int colorMap = 0;
-    int imageType = 0;
-    int bitLength = 0;
-    int colorMode = 0;
-    int length = 0;
-    int rleId = 0;
-    int pixel[4];
-    unsigned char *imageId = NULL;
-    unsigned char *ptr = NULL;
+    int offset = 0;
 
     if((targa == NULL) || (data == NULL) || (dataLength < 18)) {
         fprintf(stderr, "[%s():%i] error - invalid or missing argument(s).\n",
@@ -244,295 +581,100 @@ int targa_loadFromData(Targa *targa, unsigned char *data, int dataLength)
         return -1;
     }
 
-    ptr = data;
-
-    // determine image ID length
-
-    imageIdLength = (int)ptr[0];
-    ptr++;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
+    if((offset = readHeader(targa, data, dataLength)) < 0) {
         return -1;
     }
 
-    // check for color map
-
-    colorMap = (int)ptr[0];
-    ptr++;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
-        return -1;
-    }
-    if(colorMap != TGA_COLOR_MAP_NONE) {
-        fprintf(stderr, "[%s():%i] error - unable to read TARGA color map "
-                "%i.\n", __FUNCTION__, __LINE__, colorMap);
-        return -1;
-    }
+    // process the image
 
-    // obtain image type
+    targa->image = (unsigned char *)malloc(sizeof(unsigned char) *
+                                           targa->imageLength);
 
-    imageType = (int)ptr[0];
-    ptr++;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
-        return -1;
-    }
-    if((imageType == TGA_IMAGE_TYPE_NONE) ||
-       (imageType == TGA_IMAGE_TYPE_CM) ||
-       (imageType == TGA_IMAGE_TYPE_RLE_CM)) {
-        fprintf(stderr, "[%s():%i] error - unsupported image type %i.\n",
-                __FUNCTION__, __LINE__, imageType);
-        return -1;
-    }
+    return decodeImage(targa, data, dataLength, offset, targa->image);
+}
 
-    // skip 9 bytes (color-map information and x & y origins)
+int targa_mapFile(Targa *targa, char *filename)
+{
+    int fd = 0;
+    int offset = 0;
+    struct stat st;
+    unsigned char *data = NULL;
 
-    ptr += 9;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
+    if((targa == NULL) || (filename == NULL)) {
+        fprintf(stderr, "[%s():%i] error - invalid or missing argument(s).\n",
+                __FUNCTION__, __LINE__);
         return -1;
     }
 
-    // obtain image width
+    if((fd = open(filename, O_RDONLY)) < 0) {
+        return handleTargaError(NULL, fd, __FUNCTION__, __LINE__);
+    }
 
-    memcpy((char *)&sNumber, ptr, sizeof(short));
-    ptr += sizeof(short);
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
-        return -1;
+    if(fstat(fd, &st) != 0) {
+        close(fd);
+        return handleTargaError(NULL, -1, __FUNCTION__, __LINE__);
     }
-    if(sNumber < 1) {
-        fprintf(stderr, "[%s():%i] error - invalid image width %i.\n",
-                __FUNCTION__, __LINE__, (int)sNumber);
+
+    if(st.st_size < 18) {
+        fprintf(stderr, "error - TGA file '%s' length %i invalid.\n",
+                filename, (int)st.st_size);
+        close(fd);
         return -1;
     }
 
-    targa->width = (int)sNumber;
-
-    // obtain image height
-
-    memcpy((char *)&sNumber, ptr, sizeof(short));
-    ptr += sizeof(short);
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
-        return -1;
+    data = (unsigned char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+                                 fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return handleTargaError(NULL, -1, __FUNCTION__, __LINE__);
     }
-    if(sNumber < 1) {
-        fprintf(stderr, "[%s():%i] error - invalid image height %i.\n",
-                __FUNCTION__, __LINE__, (int)sNumber);
+
+    if((offset = readHeader(targa, data, (int)st.st_size)) < 0) {
+        munmap(data, st.st_size);
         return -1;
     }
 
-    targa->height = (int)sNumber;
+    // the pixels are read once, front to back, by the decode or the upload
 
-    // determine pixel depth
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
 
-    bitLength = (int)ptr[0];
-    ptr++;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
-        return -1;
-    }
-    if((bitLength != 16) && (bitLength != 24) && (bitLength != 32)) {
-        fprintf(stderr, "[%s():%i] error - unknown pixel depth of %i-bits.\n",
-                __FUNCTION__, __LINE__, bitLength);
-        return -1;
-    }
-    if((bitLength == 16) &&
-       ((imageType != TGA_IMAGE_TYPE_BGR) &&
-        (imageType != TGA_IMAGE_TYPE_BW))) {
-        fprintf(stderr, "[%s():%i] error - unable to RLE-decode pixel depth "
-                "of %i-bits.\n", __FUNCTION__, __LINE__, bitLength);
-        return -1;
-    }
+    targa->mapping = data;
+    targa->mappingLength = (int)st.st_size;
+    targa->pixelOffset = offset;
 
-    // skip 1 byte (image descriptor)
+    return 0;
+}
 
-    ptr++;
-    if((int)(ptr - data) > dataLength) {
-        fprintf(stderr, "[%s():%i] error - detected data overrun with %i vs "
-                "%i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                dataLength);
+int targa_getBgraPixels(Targa *targa, unsigned char **pixels)
+{
+    if((targa == NULL) || (pixels == NULL) || (targa->mapping == NULL)) {
+        fprintf(stderr, "[%s():%i] error - invalid or missing argument(s).\n",
+                __FUNCTION__, __LINE__);
         return -1;
     }
 
-    // obtain the image ID
-
-    if(imageIdLength > 0) {
-        if(((int)(ptr - data) + imageIdLength) > dataLength) {
-            fprintf(stderr, "[%s():%i] error - detected data overrun at %i "
-                    "(image ID) by %i bytes.\n", __FUNCTION__, __LINE__,
-                    (int)(ptr - data),
-                    (((int)(ptr - data) + imageIdLength) - dataLength));
-            return -1;
-        }
-        imageId = (unsigned char *)localStrndup((char *)ptr, imageIdLength);
-        ptr += imageIdLength;
-        if((int)(ptr - data) > dataLength) {
-            fprintf(stderr, "[%s():%i] error - detected data overrun with %i "
-                    "vs %i.\n", __FUNCTION__, __LINE__, (int)(ptr - data),
-                    dataLength);
-            return -1;
-        }
+    if((targa->imageType != TGA_IMAGE_TYPE_BGR) || (targa->bitLength != 32) ||
+       ((targa->pixelOffset + targa->imageLength) > targa->mappingLength)) {
+        *pixels = NULL;
+        return -1;
     }
 
-    // process the image
-
-    targa->imageLength = (long int)(targa->width * targa->height * 4);
-    targa->image = (unsigned char *)malloc(sizeof(unsigned char) *
-                                           targa->imageLength);
+    *pixels = (targa->mapping + targa->pixelOffset);
 
-    if((imageType == TGA_IMAGE_TYPE_BGR) || (imageType == TGA_IMAGE_TYPE_BW)) {
-        if(bitLength == 16) {
-            colorMode = 2;
-        }
-        else {
-            colorMode = (bitLength / 8);
-        }
-        length = (targa->width * targa->height * colorMode);
-        if(((int)(ptr - data) + length) > dataLength) {
-            fprintf(stderr, "[%s():%i] error - detected data overrun at %i "
-                    "(image pixels) by %i bytes.\n", __FUNCTION__, __LINE__,
-                    (int)(ptr - data),
-                    (((int)(ptr - data) + length) - dataLength));
-            return -1;
-        }
-        for(ii = 0, nn = 0; ((ii < length) && (nn < targa->imageLength));
-        ii += colorMode, nn += 4) {
-            if(colorMode == 2) {
-                memcpy((char *)&sNumber, ptr, sizeof(short));
-                pixel[TGA_R] = ctoi((sNumber & 0x1f) << 3);
-                pixel[TGA_G] = ctoi(((sNumber >> 5) & 0x1f) << 3);
-                pixel[TGA_B] = ctoi(((sNumber >> 10) & 0x1f) << 3);
-                pixel[TGA_A] = 255;
-            }
-            else {
-                pixel[TGA_R] = ctoi(ptr[2]);
-                pixel[TGA_G] = ctoi(ptr[1]);
-                pixel[TGA_B] = ctoi(ptr[0]);
-                if(colorMode == 3) {
-                    pixel[TGA_A] = 255;
-                }
-                else {
-                    pixel[TGA_A] = ctoi(ptr[3]);
-                }
-            }
-
-            targa->image[(nn + 0)] = (unsigned char)pixel[TGA_R];
-            targa->image[(nn + 1)] = (unsigned char)pixel[TGA_G];
-            targa->image[(nn + 2)] = (unsigned char)pixel[TGA_B];
-            targa->image[(nn + 3)] = (unsigned char)pixel[TGA_A];
-
-            ptr += colorMode;
-        }
-    }
-    else { // RLE image
-        ii = 0;
-        nn = 0;
-        rleId = 0;
-        colorMode = (bitLength / 8);
-        length = (targa->width * targa->height);
-        while(ii < length) {
-            rleId = (int)ptr[0];
-            ptr++;
-            if((int)(ptr - data) > dataLength) {
-                fprintf(stderr, "[%s():%i] error - detected data overrun with "
-                        "%i vs %i.\n", __FUNCTION__, __LINE__,
-                        (int)(ptr - data), dataLength);
-                return -1;
-            }
-
-            if(rleId < 128) {
-                rleId++;
-                while(rleId > 0) {
-                    pixel[TGA_R] = ctoi(ptr[2]);
-                    pixel[TGA_G] = ctoi(ptr[1]);
-                    pixel[TGA_B] = ctoi(ptr[0]);
-                    if(colorMode == 3) {
-                        pixel[TGA_A] = 255;
-                    }
-                    else {
-                        pixel[TGA_A] = ctoi(ptr[3]);
-                    }
-
-                    targa->image[(nn + 0)] = (unsigned char)pixel[TGA_R];
-                    targa->image[(nn + 1)] = (unsigned char)pixel[TGA_G];
-                    targa->image[(nn + 2)] = (unsigned char)pixel[TGA_B];
-                    targa->image[(nn + 3)] = (unsigned char)pixel[TGA_A];
-
-                    rleId--;
-                    ii++;
-                    nn += 4;
-                    if(nn >= targa->imageLength) {
-                        break;
-                    }
-                    ptr += colorMode;
-                    if((int)(ptr - data) > dataLength) {
-                        fprintf(stderr, "[%s():%i] error - detected data "
-                                "overrun with %i vs %i.\n", __FUNCTION__,
-                                __LINE__, (int)(ptr - data), dataLength);
-                        return -1;
-                    }
-                }
-            }
-            else {
-                pixel[TGA_R] = ctoi(ptr[2]);
-                pixel[TGA_G] = ctoi(ptr[1]);
-                pixel[TGA_B] = ctoi(ptr[0]);
-                if(colorMode == 3) {
-                    pixel[TGA_A] = 255;
-                }
-                else {
-                    pixel[TGA_A] = ctoi(ptr[3]);
-                }
-                ptr += colorMode;
-                if((int)(ptr - data) > dataLength) {
-                    fprintf(stderr, "[%s():%i] error - detected data overrun "
-                            "with %i vs %i.\n", __FUNCTION__, __LINE__,
-                            (int)(ptr - data), dataLength);
-                    return -1;
-                }
-
-                rleId -= 127;
-                while(rleId > 0) {
-                    targa->image[(nn + 0)] = (unsigned char)pixel[TGA_R];
-                    targa->image[(nn + 1)] = (unsigned char)pixel[TGA_G];
-                    targa->image[(nn + 2)] = (unsigned char)pixel[TGA_B];
-                    targa->image[(nn + 3)] = (unsigned char)pixel[TGA_A];
-
-                    rleId--;
-                    ii++;
-                    nn += 4;
-                    if(nn >= targa->imageLength) {
-                        break;
-                    }
-                }
-            }
-            if(nn >= targa->imageLength) {
-                break;
-            }
-        }
-    }
+    return 0;
+}
 
-    if(imageId != NULL) {
-        free(imageId);
+int targa_decodeInto(Targa *targa, unsigned char *image, int imageLength)
+{
+    if((targa == NULL) || (image == NULL) || (targa->mapping == NULL) ||
+       (imageLength < targa->imageLength)) {
+        fprintf(stderr, "[%s():%i] error - invalid or missing argument(s).\n",
+                __FUNCTION__, __LINE__);
+        return -1;
     }
 
-    return 0;
+    return decodeImage(targa, targa->mapping, targa->mappingLength,
+                       targa->pixelOffset, image);
 }
 
 int targa_applyRgbaMask(Targa *targa, int colorType, unsigned char value)
@@ -13,6 +13,11 @@ struct Targa {
     int height;
     int imageLength;
     unsigned char *image;
+    int imageType;
+    int bitLength;
+    int pixelOffset;
+    int mappingLength;
+    unsigned char *mapping;
 };
 
 
@@ -120,6 +125,57 @@ int targa_loadFromFile(Targa *targa, char *filename);
 int targa_loadFromData(Targa *targa, unsigned char *data, int dataLength);
 
 
+/**
+ * targa_mapFile()
+ *
+ * Map a targa file into memory and read its' header, without decoding the
+ * pixels. Use targa_getBgraPixels() or targa_decodeInto() to get at them,
+ * and targa_free() to release the mapping.
+ *
+ * @param	targa(in)		The Targa struct of an image to map.
+ *
+ * @param	filename(in)	The filename of the image to map.
+ *
+ * @return	An integer where zero is pass, less than zero is failure.
+ */
+int targa_mapFile(Targa *targa, char *filename);
+
+
+/**
+ * targa_getBgraPixels()
+ *
+ * Obtain the pixels of a mapped, uncompressed 32-bit Targa image in place,
+ * as serialized BGRA, for handing to a texture upload without a copy.
+ *
+ * @param	targa(in)		The Targa struct of a mapped image.
+ *
+ * @param	pixels(out)		The serialized BGRA image pointer, inside the
+ *							mapping.
+ *
+ * @return	An integer where zero is pass, less than zero means the image
+ *			has to be decoded with targa_decodeInto() instead.
+ */
+int targa_getBgraPixels(Targa *targa, unsigned char **pixels);
+
+
+/**
+ * targa_decodeInto()
+ *
+ * Decode a mapped Targa image into a 32-bit RGBA serialized image in a
+ * buffer of the caller's, such as a mapped pixel-unpack buffer.
+ *
+ * @param	targa(in)			The Targa struct of a mapped image.
+ *
+ * @param	image(out)			The buffer to decode the image into.
+ *
+ * @param	imageLength(in)		The length of the buffer in bytes, at least
+ *								targa_getImageLength().
+ *
+ * @return	An integer where zero is pass, less than zero is failure.
+ */
+int targa_decodeInto(Targa *targa, unsigned char *image, int imageLength);
+
+
 /**
  * targa_applyRgbaMask()
  *
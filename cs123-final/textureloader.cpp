@@ -0,0 +1,115 @@
+/**
+  Decodes textures off the drawing thread.
+**/
+
+#include "textureloader.h"
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTime>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+/**
+  One image being decoded, and how long it took.
+**/
+struct TextureLoader::Job : public QRunnable {
+    TextureLoader *loader;
+    QString path;
+    bool flip;
+    int width;
+    QImage image; ///the decoded image, valid once done
+    QSize size; ///size of the decoded image
+    bool done;
+    int decode_ms, upload_ms;
+
+    void run() {
+        QTime timer;
+        timer.start();
+        QImage decoded = TextureLoader::decode(path, flip, width);
+        int ms = timer.elapsed();
+        QMutexLocker locker(&loader->mutex_);
+        image = decoded;
+        size = decoded.size();
+        decode_ms = ms;
+        done = true;
+        loader->decoded_.wakeAll();
+    }
+};
+
+TextureLoader::TextureLoader() {
+}
+
+/**
+  @paragraph Waits for the images still decoding and frees the jobs.
+**/
+TextureLoader::~TextureLoader() {
+    pool_.waitForDone();
+    foreach (Job *job, jobs_)
+        delete job;
+}
+
+int TextureLoader::add(const QString &path, bool flip, int width) {
+    Job *job = new Job;
+    job->loader = this;
+    job->path = path;
+    job->flip = flip;
+    job->width = width;
+    job->done = false;
+    job->decode_ms = job->upload_ms = 0;
+    job->setAutoDelete(false);
+    jobs_.append(job);
+    pool_.start(job);
+    return jobs_.size() - 1;
+}
+
+bool TextureLoader::upload(int index, GLenum target) {
+    Job *job = jobs_[index];
+    {
+        QMutexLocker locker(&mutex_);
+        while (!job->done)
+            decoded_.wait(&mutex_);
+    }
+    if (job->image.isNull())
+        return false;
+    QTime timer;
+    timer.start();
+    glTexImage2D(target, 0, 3, job->image.width(), job->image.height(), 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 job->image.bits());
+    job->upload_ms = timer.elapsed();
+    //the pixels are in GL now
+    job->image = QImage();
+    return true;
+}
+
+void TextureLoader::report() const {
+    for (int i = 0; i < jobs_.size(); ++i) {
+        const Job *job = jobs_[i];
+        cout << "  " << QFileInfo(job->path).fileName().toStdString() << ": " << job->size.width() << "x"
+             << job->size.height() << ", decode " << job->decode_ms << " ms, upload " << job->upload_ms
+             << " ms" << endl;
+    }
+}
+
+/**
+  @paragraph Loads an image and converts it to what glTexImage2D() takes.
+
+  @param path: the image file.
+  @param flip: whether to mirror it vertically first.
+  @param width: the width to scale it to, or 0 to keep its size.
+  @return The image in GL's RGBA layout, or a null image if the file couldn't be
+  read.
+**/
+QImage TextureLoader::decode(const QString &path, bool flip, int width) {
+    QImage image;
+    if (!image.load(path))
+        return image;
+    if (flip)
+        image = image.mirrored(false, true);
+    image = QGLWidget::convertToGLFormat(image);
+    if (width > 0)
+        image = image.scaledToWidth(width, Qt::SmoothTransformation);
+    return image;
+}
@@ -0,0 +1,46 @@
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <qgl.h>
+
+/**
+  Decodes image files for textures on a thread pool.  Loading, flipping,
+  converting to GL's layout and scaling all happen there, so all the images
+  queued decode at once, and the thread with the OpenGL context only makes the
+  glTexImage2D() calls, each as soon as its image is ready.
+**/
+class TextureLoader {
+public:
+    TextureLoader();
+    ~TextureLoader();
+
+    //queues an image to decode and returns its index; flip mirrors it vertically
+    //first, and a width > 0 scales it to that width
+    int add(const QString &path, bool flip = false, int width = 0);
+
+    //waits for the image at index and uploads it to target (of the bound
+    //texture) as RGB.  Returns false if the file couldn't be read.
+    bool upload(int index, GLenum target);
+
+    //prints how long each image took to decode and upload
+    void report() const;
+
+    //decodes an image on the calling thread, the way add() does on the pool
+    static QImage decode(const QString &path, bool flip, int width);
+
+protected:
+    struct Job;
+
+    QThreadPool pool_;
+    QMutex mutex_;
+    QWaitCondition decoded_; ///signalled each time a job finishes
+    QList<Job *> jobs_;
+};
+
+#endif // TEXTURELOADER_H